@@ -0,0 +1,99 @@
+/**
+ * Trains a BIMac offline from recorded map dynamics traces.
+ *
+ * Every run_*.csv and episode_*.csv trace in the trace directory (or binary
+ * .trace file, see map_trace.h) is counted as one episode. The BIMac is
+ * written to the output directory as CSV files and a bimac.bin model file.
+ *
+ * If a visited directory is given, counting is restricted to what the robot
+ * would have seen with an 8-neighbour FOV, using the locations in
+ * visitedDir/<trace stem>.csv (as written by logVisitedLocations).
+ *
+ * Usage: bimacTrainer traceDir xDim yDim outDir [numThreads] [visitedDir]
+ *
+ * @author Charlie Street
+ */
+
+#include "coverage_plan/mod/bimac.h"
+#include "coverage_plan/mod/bimac_trainer.h"
+#include "coverage_plan/mod/grid_cell.h"
+#include "coverage_plan/mod/map_trace.h"
+#include "coverage_plan/mod/model_file.h"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Find the traces in a directory. Binary traces are only listed if there is
+ * no CSV trace with the same stem.
+ *
+ * @param traceDir The directory to search
+ *
+ * @returns The trace files, sorted by name
+ */
+std::vector<std::filesystem::path>
+findTraces(const std::filesystem::path &traceDir) {
+  std::set<std::filesystem::path> traces{};
+  for (const std::filesystem::directory_entry &entry :
+       std::filesystem::directory_iterator(traceDir)) {
+    std::filesystem::path file{entry.path()};
+    std::string stem{file.stem().string()};
+    if (!entry.is_regular_file() ||
+        (stem.rfind("run_", 0) != 0 && stem.rfind("episode_", 0) != 0)) {
+      continue;
+    }
+    if (file.extension() == ".csv") {
+      traces.insert(file);
+    } else if (file.extension() == MapTrace::fileExtension) {
+      // countTrace reads the binary trace in place of the CSV file
+      traces.insert(file.replace_extension(".csv"));
+    }
+  }
+  return std::vector<std::filesystem::path>(traces.begin(), traces.end());
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 5) {
+    std::cerr << "Usage: " << argv[0]
+              << " traceDir xDim yDim outDir [numThreads] [visitedDir]\n";
+    return 1;
+  }
+  std::filesystem::path traceDir{argv[1]};
+  int xDim{std::stoi(argv[2])};
+  int yDim{std::stoi(argv[3])};
+  std::filesystem::path outDir{argv[4]};
+  int numThreads{argc > 5 ? std::stoi(argv[5])
+                          : (int)std::thread::hardware_concurrency()};
+
+  std::vector<std::filesystem::path> traces{findTraces(traceDir)};
+  std::cout << "Training from " << traces.size() << " traces\n";
+
+  std::shared_ptr<BIMac> bimac{};
+  if (argc > 6) {
+    std::filesystem::path visitedDir{argv[6]};
+    std::vector<GridCell> fov{GridCell{-1, -1}, GridCell{0, -1},
+                              GridCell{1, -1},  GridCell{-1, 0},
+                              GridCell{1, 0},   GridCell{-1, 1},
+                              GridCell{0, 1},   GridCell{1, 1}};
+    std::vector<std::vector<GridCell>> trajectories{};
+    for (const std::filesystem::path &trace : traces) {
+      trajectories.push_back(BIMacTrainer::readTrajectory(
+          visitedDir / (trace.stem().string() + ".csv")));
+    }
+    bimac = BIMacTrainer::train(traces, xDim, yDim, fov, trajectories,
+                                numThreads);
+  } else {
+    bimac = BIMacTrainer::train(traces, xDim, yDim, numThreads);
+  }
+
+  std::filesystem::create_directories(outDir);
+  bimac->writeBIMac(outDir);
+  ModelFile::writeBIMac(*bimac, outDir / ModelFile::bimacFileName);
+  std::cout << "Written BIMac to " << outDir << "\n";
+  return 0;
+}
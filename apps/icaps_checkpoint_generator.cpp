@@ -1,9 +1,12 @@
 /**
  * Checkpoint generator for ICAPS framework experiment.
  *  Only considers posterior mean
+ *  Writes a BiMac log, which the posterior mean at each checkpoint is rebuilt
+ *  from (see bimac_log.h)
  *
  * @author Charlie Street
  */
+#include "coverage_plan/mod/bimac_log.h"
 #include "coverage_plan/mod/fixed_imac_executor.h"
 #include "coverage_plan/mod/grid_cell.h"
 #include "coverage_plan/mod/imac.h"
@@ -17,7 +20,6 @@
 #include <iostream>
 #include <memory>
 #include <random>
-#include <sys/stat.h>
 #include <vector>
 
 /**
@@ -39,26 +41,6 @@ getExecutor(const std::filesystem::path &inDir, const std::pair<int, int> &dim,
   return std::make_shared<FixedIMacExecutor>(runFiles, dim.first, dim.second);
 }
 
-/**
- * Checkpoint the BiMac posterior mean at a given episode.
- * @param episode The episode number
- * @param baseDir The base directory for the checkpoints
- * @param imacEstimate The imacEstimate to write out
- */
-void checkpointIMac(const int &episode, const std::filesystem::path &baseDir,
-                    std::shared_ptr<IMac> imacEstimate) {
-  std::filesystem::path imacDir{baseDir};
-  imacDir /= "episode_" + std::to_string(episode);
-
-  if (mkdir(imacDir.c_str(), S_IRWXU) == -1) {
-    std::cerr << "Error creating directory " << imacDir << '\n';
-    exit(1);
-  }
-
-  // write the IMac instance
-  imacEstimate->writeIMac(imacDir);
-}
-
 void runiMacCheckpointer(const std::filesystem::path &imacDir,
                          const std::filesystem::path &baseDir,
                          const int &timeBound, const int &xDim,
@@ -71,7 +53,6 @@ void runiMacCheckpointer(const std::filesystem::path &imacDir,
 
   GridCell initPos{0, 0};
   int numEpisodes{150};
-  std::set<int> toCheckpoint{0, 1, 5, 10, 50, 100, 150};
 
   // Start from scratch for each method
   // Episodes will be played in same order
@@ -83,21 +64,17 @@ void runiMacCheckpointer(const std::filesystem::path &imacDir,
                                            exec, nullptr,
                                            ParameterEstimate::posteriorMean)};
 
-  // Get initial error
-  std::shared_ptr<IMac> estimate{robot->getBIMac()->posteriorMean()};
-  checkpointIMac(0, baseDir, estimate);
+  // Log the initial BiMac, checkpoints are rebuilt from the log
+  std::filesystem::create_directories(baseDir);
+  BIMacLogWriter log{baseDir / BIMacLog::fileName, *robot->getBIMac()};
 
   for (int episode{1}; episode <= numEpisodes; ++episode) {
     std::cout << "Method: Posterior Mean; Episode: " << episode << '\n';
     // Write output logs to dummy file
     robot->runCoverageEpisode("/tmp/episodeVisited.csv");
 
-    if (toCheckpoint.count(episode) == 1) {
-      std::cout << "CHECKPOINTING CURRENT BIMAC Posterior Mean\n";
-      // Get current iMac error using BiMac MLE estimate
-      estimate = robot->getBIMac()->posteriorMean();
-      checkpointIMac(episode, baseDir, estimate);
-    }
+    // Only the counts changed in this episode are written
+    log.logEpisode(robot->getEpisodeObservations(), *robot->getBIMac());
   }
 }
 
@@ -1,9 +1,10 @@
 /**
- * Script which checkpoints the MLE iMac model at different points during
- * training.
+ * Script which logs the BiMac model during training, so the MLE iMac model can
+ * be rebuilt at any checkpoint episode (see bimac_log.h).
  *
  * @author Charlie Street
  */
+#include "coverage_plan/mod/bimac_log.h"
 #include "coverage_plan/mod/fixed_imac_executor.h"
 #include "coverage_plan/mod/grid_cell.h"
 #include "coverage_plan/mod/imac.h"
@@ -17,7 +18,6 @@
 #include <iostream>
 #include <memory>
 #include <random>
-#include <sys/stat.h>
 #include <vector>
 
 /**
@@ -40,33 +40,25 @@ getExecutor(const std::filesystem::path &inDir, const std::pair<int, int> &dim,
 }
 
 /**
- * Checkpoint the BiMac MLE at a given episode.
+ * Get the BiMac log file for a learning type.
  *
  * @param type The learning type
- * @param episode The episode number
  * @param baseDir The base directory for the checkpoints
- * @param imacEstimate The imacEstimate to write out
+ *
+ * @returns The path to the log file
  */
-void checkpointIMac(const ParameterEstimate &type, const int &episode,
-                    const std::filesystem::path &baseDir,
-                    std::shared_ptr<IMac> imacEstimate) {
-  std::filesystem::path imacDir{baseDir};
+std::filesystem::path getLogFile(const ParameterEstimate &type,
+                                 const std::filesystem::path &baseDir) {
+  std::filesystem::path logDir{baseDir};
 
   if (type == ParameterEstimate::posteriorSample) {
-    imacDir /= "posterior_sampling";
+    logDir /= "posterior_sampling";
   } else if (type == ParameterEstimate::maximumLikelihood) {
-    imacDir /= "maximum_likelihood";
+    logDir /= "maximum_likelihood";
   }
 
-  imacDir /= "episode_" + std::to_string(episode);
-
-  if (mkdir(imacDir.c_str(), S_IRWXU) == -1) {
-    std::cerr << "Error creating directory " << imacDir << '\n';
-    exit(1);
-  }
-
-  // write the IMac instance
-  imacEstimate->writeIMac(imacDir);
+  std::filesystem::create_directories(logDir);
+  return logDir / BIMacLog::fileName;
 }
 
 void runiMacCheckpointer(const std::filesystem::path &imacDir,
@@ -84,7 +76,6 @@ void runiMacCheckpointer(const std::filesystem::path &imacDir,
 
   std::vector<ParameterEstimate> methods{ParameterEstimate::posteriorSample,
                                          ParameterEstimate::maximumLikelihood};
-  std::set<int> toCheckpoint{0, 1, 5, 10, 50, 100, 150};
 
   for (const ParameterEstimate &method : methods) {
 
@@ -97,9 +88,8 @@ void runiMacCheckpointer(const std::filesystem::path &imacDir,
         std::make_unique<POMDPCoverageRobot>(initPos, timeBound, xDim, yDim,
                                              fov, exec, nullptr, method)};
 
-    // Get initial error
-    std::shared_ptr<IMac> estimate{robot->getBIMac()->mle()};
-    checkpointIMac(method, 0, baseDir, estimate);
+    // Log the initial BiMac, checkpoints are rebuilt from the log
+    BIMacLogWriter log{getLogFile(method, baseDir), *robot->getBIMac()};
 
     for (int episode{1}; episode <= numEpisodes; ++episode) {
       if (method == ParameterEstimate::posteriorSample) {
@@ -113,12 +103,8 @@ void runiMacCheckpointer(const std::filesystem::path &imacDir,
       // Write output logs to dummy file
       robot->runCoverageEpisode("/tmp/episodeVisited.csv");
 
-      if (toCheckpoint.count(episode) == 1) {
-        std::cout << "CHECKPOINTING CURRENT BIMAC MLE\n";
-        // Get current iMac error using BiMac MLE estimate
-        estimate = robot->getBIMac()->mle();
-        checkpointIMac(method, episode, baseDir, estimate);
-      }
+      // Only the counts changed in this episode are written
+      log.logEpisode(robot->getEpisodeObservations(), *robot->getBIMac());
     }
   }
 }
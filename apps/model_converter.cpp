@@ -0,0 +1,89 @@
+/**
+ * Converts IMac and BIMac CSV directories into binary model files, and CSV
+ * map dynamics traces into binary trace files.
+ *
+ * Every directory under the root directory containing IMac CSV files gets an
+ * imac.bin file, and every directory containing BIMac CSV files gets a
+ * bimac.bin file. Models are loaded from these files by ModelFile::loadIMac
+ * and ModelFile::loadBIMac if present.
+ *
+ * Every run_*.csv and episode_*.csv trace gets a .trace file next to it,
+ * which FixedIMacExecutor uses in place of the CSV file.
+ *
+ * Usage: modelConverter [rootDir] (defaults to ../../data)
+ *
+ * @author Charlie Street
+ */
+
+#include "coverage_plan/mod/map_trace.h"
+#include "coverage_plan/mod/model_file.h"
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+/**
+ * Converts any IMac or BIMac model stored in a directory.
+ *
+ * @param dir The directory to check
+ *
+ * @returns The number of models converted
+ */
+int convertDirectory(const std::filesystem::path &dir) {
+  int numConverted{0};
+  if (std::filesystem::exists(dir / "entry.csv") &&
+      std::filesystem::exists(dir / "exit.csv") &&
+      std::filesystem::exists(dir / "initial_belief.csv")) {
+    ModelFile::convertIMacDirectory(dir, dir / ModelFile::imacFileName);
+    std::cout << "Converted IMac in " << dir << "\n";
+    ++numConverted;
+  }
+  if (std::filesystem::exists(dir / "alpha_entry.csv") &&
+      std::filesystem::exists(dir / "beta_entry.csv") &&
+      std::filesystem::exists(dir / "alpha_exit.csv") &&
+      std::filesystem::exists(dir / "beta_exit.csv") &&
+      std::filesystem::exists(dir / "alpha_init.csv") &&
+      std::filesystem::exists(dir / "beta_init.csv")) {
+    ModelFile::convertBIMacDirectory(dir, dir / ModelFile::bimacFileName);
+    std::cout << "Converted BIMac in " << dir << "\n";
+    ++numConverted;
+  }
+  return numConverted;
+}
+
+/**
+ * Converts a file to a binary trace if it is a CSV map dynamics trace.
+ *
+ * @param file The file to check
+ *
+ * @returns The number of traces converted
+ */
+int convertTrace(const std::filesystem::path &file) {
+  std::string stem{file.stem().string()};
+  if (file.extension() != ".csv" ||
+      (stem.rfind("run_", 0) != 0 && stem.rfind("episode_", 0) != 0)) {
+    return 0;
+  }
+  std::filesystem::path outFile{file};
+  outFile.replace_extension(MapTrace::fileExtension);
+  MapTrace::convertCSV(file, outFile);
+  return 1;
+}
+
+int main(int argc, char *argv[]) {
+  std::filesystem::path rootDir{argc > 1 ? argv[1] : "../../data"};
+
+  int numConverted{convertDirectory(rootDir)};
+  int numTraces{0};
+  for (const std::filesystem::directory_entry &entry :
+       std::filesystem::recursive_directory_iterator(rootDir)) {
+    if (entry.is_directory()) {
+      numConverted += convertDirectory(entry.path());
+    } else if (entry.is_regular_file()) {
+      numTraces += convertTrace(entry.path());
+    }
+  }
+
+  std::cout << "Converted " << numConverted << " models and " << numTraces
+            << " traces\n";
+  return 0;
+}
@@ -4,6 +4,7 @@
  * @author Charlie Street
  */
 
+#include "coverage_plan/mod/bit_grid.h"
 #include "coverage_plan/mod/imac.h"
 #include "coverage_plan/mod/imac_belief_sampler.h"
 #include "coverage_plan/util/seed.h"
@@ -26,12 +27,12 @@ void profileMapUpdate() {
 
   // Generate initial matrix from IMacExecutor
   std::unique_ptr<IMacExecutor> exec{std::make_unique<IMacExecutor>(imac)};
-  Eigen::MatrixXi map{exec->restart()};
+  BitGrid map{exec->restart()};
 
   // Time the test
   auto start{std::chrono::high_resolution_clock::now()};
   for (int i{0}; i < 1000000; ++i) {
-    map = sampler->sampleFromBelief(imac->forwardStep(map.cast<double>()));
+    sampler->forwardStepAndSample(*imac, map);
   }
   auto stop{std::chrono::high_resolution_clock::now()};
   auto duration{
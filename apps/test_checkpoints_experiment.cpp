@@ -6,9 +6,11 @@
  * @author Charlie Street
  */
 
+#include "coverage_plan/mod/bimac_log.h"
 #include "coverage_plan/mod/fixed_imac_executor.h"
 #include "coverage_plan/mod/grid_cell.h"
 #include "coverage_plan/mod/imac.h"
+#include "coverage_plan/mod/model_file.h"
 #include "coverage_plan/planning/coverage_robot.h"
 #include "coverage_plan/planning/coverage_world.h"
 #include "coverage_plan/planning/pomdp_coverage_robot.h"
@@ -122,17 +124,27 @@ getIMacModels(const std::filesystem::path &checkpointDir,
   std::vector<int> checkpoints{0, 1, 5, 10, 50, 100, 150};
 
   for (const std::string &type : learningTypes) {
+    std::unique_ptr<BIMacLogReader> log{};
     for (const int &checkpoint : checkpoints) {
       std::filesystem::path imacDir{checkpointDir};
       imacDir /= type;
       imacDir /= ("episode_" + std::to_string(checkpoint));
 
-      imacs.push_back(std::make_shared<IMac>(imacDir));
+      // Without a model directory, rebuild the checkpoint from the BiMac log
+      if (std::filesystem::exists(imacDir)) {
+        imacs.push_back(ModelFile::loadIMac(imacDir));
+      } else {
+        if (log == nullptr) {
+          log = std::make_unique<BIMacLogReader>(checkpointDir / type /
+                                                 BIMacLog::fileName);
+        }
+        imacs.push_back(log->replay(checkpoint)->mle());
+      }
       imacNames.push_back(type + "_episode_" + std::to_string(checkpoint));
     }
   }
   // Add ground truth
-  imacs.push_back(std::make_shared<IMac>(groundTruthDir));
+  imacs.push_back(ModelFile::loadIMac(groundTruthDir));
   imacNames.push_back("ground_truth");
 
   return std::make_pair(imacs, imacNames);
@@ -10,6 +10,7 @@
 #define GREEDY_COVERAGE_ROBOT_H
 
 #include "coverage_plan/planning/pomdp_coverage_robot.h"
+#include <Eigen/Dense>
 
 /**
  * Subclass of POMDPCoverageRobot which instead uses a greedy policy.
@@ -20,11 +21,14 @@
  * As its over a belief, not a state, we can't use the implementation in the
  * bounds classes.
  *
- * Members: As in superclass
+ * Members: As in superclass, plus:
+ * * _nextBelief: Buffer for the next step's map belief, reused across calls
  */
 class GreedyCoverageRobot : public POMDPCoverageRobot {
 
 private:
+  Eigen::MatrixXd _nextBelief{};
+
   /**
    * Greedily selects action which maximises immediate reward.
    * Recall that x goes from left to right, y from top to bottom.
@@ -41,7 +45,7 @@ private:
    */
   Action _planFn(const GridCell &currentLoc,
                  const std::vector<Action> &enabledActions, int ts,
-                 int timeBound, std::shared_ptr<IMac> imac,
+                 int timeBound, const std::shared_ptr<IMac> &imac,
                  const std::vector<GridCell> &visited,
                  const std::vector<IMacObservation> &currentObs);
 
@@ -67,7 +71,8 @@ public:
                       const ParameterEstimate &estimationType =
                           ParameterEstimate::posteriorSample)
       : POMDPCoverageRobot(currentLoc, timeBound, xDim, yDim, fov, exec,
-                           groundTruthIMac, estimationType, "DEFAULT") {}
+                           groundTruthIMac, estimationType, "DEFAULT"),
+        _nextBelief{yDim, xDim} {}
 };
 
 #endif
\ No newline at end of file
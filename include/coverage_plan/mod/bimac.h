@@ -15,13 +15,16 @@
 #ifndef BIMAC_H
 #define BIMAC_H
 
+#include "coverage_plan/mod/bit_grid.h"
 #include "coverage_plan/mod/grid_cell.h"
 #include "coverage_plan/mod/imac.h"
 #include <Eigen/Dense>
+#include <cstdint>
 #include <filesystem>
 #include <functional>
 #include <memory>
 #include <random>
+#include <vector>
 
 /**
  * Struct for storing BiMac observations.
@@ -70,6 +73,13 @@ struct BIMacObservation {
  * parameter, i.e. the initial state distribution
  * * _betaInit: The matrix of beta parameters for the Pr(occupied at time 0)
  * parameter, i.e. the initial state distribution
+ * * _meanEntry, _meanExit, _meanInit: Cached posterior mean matrices
+ * * _mleEntry, _mleExit, _mleInit: Cached MLE matrices
+ * * _dirtyCells: Indices of cells updated since the caches were refreshed
+ * * _dirtyMask: Marks the cells in _dirtyCells, to avoid duplicates
+ * * _meanSnapshot: The IMac returned by posteriorMean, if still valid
+ * * _mleSnapshot: The IMac returned by mle, if still valid
+ * * _estimatesStale: True if the cached estimates need a full recompute
  */
 class BIMac {
 private:
@@ -79,6 +89,29 @@ private:
   Eigen::MatrixXi _betaExit{};
   Eigen::MatrixXi _alphaInit{};
   Eigen::MatrixXi _betaInit{};
+  Eigen::MatrixXd _meanEntry{};
+  Eigen::MatrixXd _meanExit{};
+  Eigen::MatrixXd _meanInit{};
+  Eigen::MatrixXd _mleEntry{};
+  Eigen::MatrixXd _mleExit{};
+  Eigen::MatrixXd _mleInit{};
+  std::vector<int> _dirtyCells{};
+  BitGrid _dirtyMask{};
+  std::shared_ptr<IMac> _meanSnapshot{};
+  std::shared_ptr<IMac> _mleSnapshot{};
+  bool _estimatesStale{false};
+
+  /**
+   * Computes the cached posterior mean and MLE matrices from scratch.
+   */
+  void _initialiseEstimates();
+
+  /**
+   * Updates the cached posterior mean and MLE matrices for any dirty cells,
+   * or recomputes them if they are stale.
+   * Snapshots are discarded if any cells were dirty.
+   */
+  void _refreshEstimates();
 
   /**
    * Reads BIMac matrix in from file.
@@ -97,26 +130,6 @@ private:
   void _writeBIMacMatrix(const Eigen::MatrixXi &matrix,
                          const std::filesystem::path &outFile);
 
-  /**
-   * Sample single IMac parameter.
-   *
-   * Samples a uniform random number in [0,1] and runs it through the Beta
-   * quantile function
-   *
-   * Note neither gen or sampler are passed by const reference as they maintain
-   * an internal state which we want to change to ensure different random
-   * numbers are generated
-   *
-   * @param alpha The alpha value for the corresponding Beta distribtion
-   * @param beta The beta value for the corresponding Beta distribtion
-   * @param gen A random number generator
-   * @param sampler A sampler from a uniform distribution which uses gen
-   *
-   * @returns The sampled IMac parameter value
-   */
-  double _sampleForCell(int alpha, int beta, std::mt19937_64 &gen,
-                        std::uniform_real_distribution<double> &sampler);
-
   /**
    * Compute the MLE value for a single parameter.
    * Used in a nullary expression in mle
@@ -166,9 +179,10 @@ public:
         _betaEntry{Eigen::MatrixXi::Ones(y, x)},
         _alphaExit{Eigen::MatrixXi::Ones(y, x)},
         _betaExit{Eigen::MatrixXi::Ones(y, x)},
-        _alphaInit{Eigen::MatrixXi::Ones(y, x)}, _betaInit{
-                                                     Eigen::MatrixXi::Ones(
-                                                         y, x)} {}
+        _alphaInit{Eigen::MatrixXi::Ones(y, x)},
+        _betaInit{Eigen::MatrixXi::Ones(y, x)} {
+    this->_initialiseEstimates();
+  }
 
   /**
    * This constructor reads a BIMac config in from file.
@@ -181,21 +195,123 @@ public:
         _alphaExit{_readBIMacMatrix(inDir / "alpha_exit.csv")},
         _betaExit{_readBIMacMatrix(inDir / "beta_exit.csv")},
         _alphaInit{_readBIMacMatrix(inDir / "alpha_init.csv")},
-        _betaInit{_readBIMacMatrix(inDir / "beta_init.csv")} {}
+        _betaInit{_readBIMacMatrix(inDir / "beta_init.csv")} {
+    this->_initialiseEstimates();
+  }
+
+  /**
+   * This constructor initialises BIMac from existing parameter matrices.
+   *
+   * @param alphaEntry The alpha matrix for lambda_entry
+   * @param betaEntry The beta matrix for lambda_entry
+   * @param alphaExit The alpha matrix for lambda_exit
+   * @param betaExit The beta matrix for lambda_exit
+   * @param alphaInit The alpha matrix for the initial state distribution
+   * @param betaInit The beta matrix for the initial state distribution
+   */
+  BIMac(const Eigen::MatrixXi &alphaEntry, const Eigen::MatrixXi &betaEntry,
+        const Eigen::MatrixXi &alphaExit, const Eigen::MatrixXi &betaExit,
+        const Eigen::MatrixXi &alphaInit, const Eigen::MatrixXi &betaInit)
+      : _alphaEntry{alphaEntry}, _betaEntry{betaEntry}, _alphaExit{alphaExit},
+        _betaExit{betaExit}, _alphaInit{alphaInit}, _betaInit{betaInit} {
+    this->_initialiseEstimates();
+  }
+
+  /**
+   * Getter for _alphaEntry.
+   *
+   * @returns The alpha matrix for lambda_entry
+   */
+  const Eigen::MatrixXi &getAlphaEntry() const { return this->_alphaEntry; }
+
+  /**
+   * Getter for _betaEntry.
+   *
+   * @returns The beta matrix for lambda_entry
+   */
+  const Eigen::MatrixXi &getBetaEntry() const { return this->_betaEntry; }
+
+  /**
+   * Getter for _alphaExit.
+   *
+   * @returns The alpha matrix for lambda_exit
+   */
+  const Eigen::MatrixXi &getAlphaExit() const { return this->_alphaExit; }
+
+  /**
+   * Getter for _betaExit.
+   *
+   * @returns The beta matrix for lambda_exit
+   */
+  const Eigen::MatrixXi &getBetaExit() const { return this->_betaExit; }
+
+  /**
+   * Getter for _alphaInit.
+   *
+   * @returns The alpha matrix for the initial state distribution
+   */
+  const Eigen::MatrixXi &getAlphaInit() const { return this->_alphaInit; }
+
+  /**
+   * Getter for _betaInit.
+   *
+   * @returns The beta matrix for the initial state distribution
+   */
+  const Eigen::MatrixXi &getBetaInit() const { return this->_betaInit; }
 
   /**
    * Take a posterior sample from BIMac to get a single IMac instance.
+   * Uses a fresh random seed on each call.
    *
    * @returns A shared ptr to an IMac instance
    */
   std::shared_ptr<IMac> posteriorSample();
 
+  /**
+   * Take a posterior sample from BIMac to get a single IMac instance.
+   *
+   * The sample only depends on seed, not on numThreads.
+   *
+   * @param seed The random seed
+   * @param numThreads The number of threads to split the cells across
+   *
+   * @returns A shared ptr to an IMac instance
+   */
+  std::shared_ptr<IMac> posteriorSample(uint64_t seed, int numThreads = 1);
+
+  /**
+   * Take a batch of posterior samples from BIMac.
+   *
+   * Per-cell setup is shared across the batch, and the work is spread over
+   * numThreads threads. Sample k is keyed on a mix of seed and k, so
+   * batches with different seeds are independent, and sample 0 is identical
+   * to posteriorSample(seed).
+   *
+   * Beta(alpha, beta) is sampled as X / (X + Y) with X ~ Gamma(alpha) and
+   * Y ~ Gamma(beta). As alpha and beta are integer counts, small shapes are
+   * sampled as a sum of exponentials, and larger ones with Marsaglia and
+   * Tsang's method. Random numbers come from a counter-based generator keyed
+   * on the seed, the parameter and the cell, so results don't depend on how
+   * the work is split.
+   *
+   * @param n The number of samples
+   * @param seed The random seed
+   * @param numThreads The number of threads to use
+   *
+   * @returns A vector of n IMac instances
+   */
+  std::vector<std::shared_ptr<IMac>> posteriorSamples(int n, uint64_t seed,
+                                                      int numThreads = 1);
+
   /**
    * Compute the MLE given the observed data.
    *
    * Given how BiMac is initialised, this corresponds to computing the mode
    * of each beta distribution.
    *
+   * The MLE is maintained incrementally, and the same IMac instance is
+   * returned until the posterior changes. The instance must not be modified.
+   *
    * @returns A shared ptr to an IMac instance
    */
   std::shared_ptr<IMac> mle();
@@ -206,6 +322,9 @@ public:
    * As the + 1 part is already in the beta distribution, its just:
    * alpha/(alpha + beta)
    *
+   * The mean is maintained incrementally, and the same IMac instance is
+   * returned until the posterior changes. The instance must not be modified.
+   *
    * @returns A shared ptr to an IMac instance
    */
   std::shared_ptr<IMac> posteriorMean();
@@ -217,6 +336,31 @@ public:
    */
   void updatePosterior(const std::vector<BIMacObservation> &observations);
 
+  /**
+   * Update the BIMac posterior given a new set of observations, from
+   * several threads at once.
+   *
+   * Counts are added with relaxed atomic operations, so any number of threads
+   * can call this concurrently on the same BIMac. It must not run alongside
+   * any other method; read the model once all the updating threads are done.
+   * The cached estimates are recomputed in full on the next read.
+   *
+   * @param observations A list of BIMacObservations
+   */
+  void
+  updatePosteriorConcurrent(const std::vector<BIMacObservation> &observations);
+
+  /**
+   * Add the observation counts from another BIMac into this one.
+   *
+   * The other BIMac is assumed to start from the same uniform Beta(1,1)
+   * prior, so only its counts above one are added. This lets independent
+   * workers learn separate models which are combined afterwards.
+   *
+   * @param other The BIMac to merge in. Must have the same dimensions
+   */
+  void merge(const BIMac &other);
+
   /**
    * Write BiMac matrices out to file.
    *
@@ -0,0 +1,253 @@
+/**
+ * @file bimac_log.h
+ *
+ * @brief An append-only log of BIMac updates.
+ *
+ * Checkpointing a BIMac with writeBIMac rewrites six full CSV matrices. This
+ * log instead appends the counts added in each episode, which costs
+ * O(cells touched), plus a full snapshot every few episodes. The BIMac at any
+ * logged episode can be rebuilt by replaying from the nearest snapshot.
+ *
+ * File layout (all values little-endian):
+ * * A 32 byte BIMacLogHeader
+ * * A sequence of records, each a 24 byte BIMacLogRecordHeader followed by
+ * its payload. Snapshot payloads hold the six count arrays (alpha entry, beta
+ * entry, alpha exit, beta exit, alpha init, beta init) as column major int32
+ * arrays. Delta payloads hold numEntries entries of 7 int32s: the column major
+ * cell index and the counts added to each of the six arrays
+ *
+ * Each record carries a 64 bit FNV-1a checksum of its payload. A record which
+ * is truncated or fails its checksum (e.g. after a crash mid-append) ends the
+ * log, and is removed when the log is reopened for appending.
+ *
+ * @author Charlie Street
+ */
+#ifndef BIMAC_LOG_H
+#define BIMAC_LOG_H
+
+#include "coverage_plan/mod/bimac.h"
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Struct for the fixed size header at the start of a BIMac log.
+ *
+ * Members:
+ * * magic: Always "COVBMLOG"
+ * * version: The format version
+ * * rows: The number of rows (y dimension) in the BIMac
+ * * cols: The number of columns (x dimension) in the BIMac
+ * * snapshotInterval: The number of episodes between snapshots
+ * * reserved: Unused, kept at zero
+ */
+struct BIMacLogHeader {
+  char magic[8]{};
+  uint32_t version{};
+  uint32_t rows{};
+  uint32_t cols{};
+  uint32_t snapshotInterval{};
+  uint8_t reserved[8]{};
+};
+
+static_assert(sizeof(BIMacLogHeader) == 32, "BIMac log header not 32 bytes");
+
+/**
+ * Struct for the header of each record in a BIMac log.
+ *
+ * Members:
+ * * type: 0 for a snapshot, 1 for a delta
+ * * episode: The episode the record brings the BIMac up to
+ * * numEntries: The number of cells in a delta, or rows * cols for a snapshot
+ * * reserved: Unused, kept at zero
+ * * checksum: The 64 bit FNV-1a checksum of the payload
+ */
+struct BIMacLogRecordHeader {
+  uint32_t type{};
+  uint32_t episode{};
+  uint32_t numEntries{};
+  uint32_t reserved{};
+  uint64_t checksum{};
+};
+
+static_assert(sizeof(BIMacLogRecordHeader) == 24,
+              "BIMac log record header not 24 bytes");
+
+/**
+ * Appends episodes to a BIMac log.
+ *
+ * Members:
+ * * _file: The log file, opened for appending
+ * * _header: The log header
+ * * _episode: The last episode written to the log
+ */
+class BIMacLogWriter {
+private:
+  std::ofstream _file{};
+  BIMacLogHeader _header{};
+  int _episode{};
+
+  /**
+   * Append a record to the log and flush it.
+   *
+   * @param type The record type
+   * @param numEntries The number of entries in the payload
+   * @param payload The record payload
+   */
+  void _writeRecord(uint32_t type, uint32_t numEntries,
+                    const std::vector<int32_t> &payload);
+
+  /**
+   * Append a snapshot of a BIMac for the current episode.
+   *
+   * @param bimac The BIMac to snapshot
+   */
+  void _writeSnapshot(const BIMac &bimac);
+
+public:
+  /**
+   * Start a new log, overwriting any existing file. The initial BIMac is
+   * written as a snapshot for episode 0.
+   *
+   * @param logFile The log file to create
+   * @param initial The BIMac at episode 0
+   * @param snapshotInterval The number of episodes between snapshots
+   */
+  BIMacLogWriter(const std::filesystem::path &logFile, const BIMac &initial,
+                 int snapshotInterval = 50);
+
+  /**
+   * Reopen an existing log to append to it, continuing from its last
+   * episode. Any incomplete record at the end of the file is removed.
+   * Throws if the log can't be read.
+   *
+   * @param logFile The log file to reopen
+   */
+  BIMacLogWriter(const std::filesystem::path &logFile);
+
+  /**
+   * Log the next episode.
+   *
+   * @param observations The observations added to the BIMac in the episode,
+   * i.e. those passed to BIMac::updatePosterior
+   * @param bimac The BIMac after the episode, which is snapshotted if the
+   * episode is a multiple of the snapshot interval
+   */
+  void logEpisode(const std::vector<BIMacObservation> &observations,
+                  const BIMac &bimac);
+
+  /**
+   * Returns the last episode written to the log.
+   *
+   * @returns The last logged episode
+   */
+  int episode() const { return this->_episode; }
+};
+
+/**
+ * Reads a BIMac log into memory.
+ *
+ * Members:
+ * * _header: The log header
+ * * _snapshotEpisodes: The episode of each snapshot, in order
+ * * _snapshots: The payload of each snapshot
+ * * _deltas: The payload of the delta for each episode (index 0 is unused)
+ * * _validBytes: The size of the valid prefix of the file
+ */
+class BIMacLogReader {
+private:
+  BIMacLogHeader _header{};
+  std::vector<int> _snapshotEpisodes{};
+  std::vector<std::vector<int32_t>> _snapshots{};
+  std::vector<std::vector<int32_t>> _deltas{};
+  uint64_t _validBytes{};
+
+public:
+  /**
+   * Reads and validates a log. Reading stops at the first incomplete or
+   * corrupted record. Throws if the file can't be opened, has an invalid
+   * header, or doesn't start with a snapshot.
+   *
+   * @param logFile The log file to read
+   */
+  BIMacLogReader(const std::filesystem::path &logFile);
+
+  /**
+   * Returns the number of rows (y dimension) in the BIMac.
+   *
+   * @returns The number of rows
+   */
+  int rows() const { return (int)this->_header.rows; }
+
+  /**
+   * Returns the number of columns (x dimension) in the BIMac.
+   *
+   * @returns The number of columns
+   */
+  int cols() const { return (int)this->_header.cols; }
+
+  /**
+   * Returns the number of episodes between snapshots.
+   *
+   * @returns The snapshot interval
+   */
+  int snapshotInterval() const {
+    return (int)this->_header.snapshotInterval;
+  }
+
+  /**
+   * Returns the last episode in the log.
+   *
+   * @returns The last logged episode
+   */
+  int lastEpisode() const { return (int)this->_deltas.size() - 1; }
+
+  /**
+   * Returns the number of snapshots in the log.
+   *
+   * @returns The number of snapshots
+   */
+  int numSnapshots() const { return (int)this->_snapshots.size(); }
+
+  /**
+   * Returns the size of the valid part of the log file in bytes.
+   *
+   * @returns The number of valid bytes
+   */
+  uint64_t validBytes() const { return this->_validBytes; }
+
+  /**
+   * Rebuild the BIMac at a logged episode, replaying deltas from the last
+   * snapshot at or before it. Throws if the episode isn't in the log.
+   *
+   * @param episode The episode to rebuild
+   *
+   * @returns The BIMac after the episode
+   */
+  std::shared_ptr<BIMac> replay(int episode) const;
+};
+
+namespace BIMacLog {
+
+/**
+ * The file name used for BIMac logs in checkpoint directories.
+ */
+const std::string fileName{"bimac.log"};
+
+/**
+ * Rebuild the BIMac at a logged episode.
+ *
+ * @param logFile The log file to read
+ * @param episode The episode to rebuild
+ *
+ * @returns The BIMac after the episode
+ */
+std::shared_ptr<BIMac> replay(const std::filesystem::path &logFile,
+                              int episode);
+
+} // namespace BIMacLog
+
+#endif
@@ -0,0 +1,99 @@
+/**
+ * @file bimac_trainer.h
+ *
+ * @brief Offline BIMac training from recorded map dynamics traces.
+ *
+ * Learning a BIMac by running CoverageRobot episodes means planning at every
+ * step. When map dynamics have already been recorded (e.g. the run_*.csv and
+ * episode_*.csv files written by IMacExecutor::logMapDynamics), the BIMac can
+ * be trained by counting per-cell transitions directly.
+ *
+ * Traces are streamed one timestep at a time, so memory is O(cells) per
+ * thread however long the traces are. Counting can either use the whole map
+ * at every timestep, or be restricted to what a robot following a given
+ * trajectory with a given FOV would have seen.
+ *
+ * @author Charlie Street
+ */
+#ifndef BIMAC_TRAINER_H
+#define BIMAC_TRAINER_H
+
+#include "coverage_plan/mod/bimac.h"
+#include "coverage_plan/mod/grid_cell.h"
+#include "coverage_plan/mod/transition_counter.h"
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+namespace BIMacTrainer {
+
+/**
+ * Count the transitions in a single trace.
+ *
+ * The trace may be a CSV file in the format written by
+ * IMacExecutor::logMapDynamics, or a binary trace (see map_trace.h). If a CSV
+ * file has a binary trace next to it with the same stem, the binary trace is
+ * read instead. Throws if the trace can't be read or doesn't match the
+ * counter's dimensions.
+ *
+ * @param traceFile The trace to count
+ * @param counter The counter to add the trace's observations to. It is reset
+ * first
+ * @param fov The FOV relative to the robot. Ignored if trajectory is empty
+ * @param trajectory The robot's location at each timestep. If empty, every
+ * cell is observed at every timestep. Else, only cells in the FOV are
+ * observed, and counting stops at the end of the trajectory
+ */
+void countTrace(const std::filesystem::path &traceFile,
+                TransitionCounter &counter,
+                const std::vector<GridCell> &fov = {},
+                const std::vector<GridCell> &trajectory = {});
+
+/**
+ * Train a BIMac from a set of traces, with every cell observed at every
+ * timestep. Each trace is treated as a separate episode.
+ *
+ * @param traceFiles The traces to train from
+ * @param xDim The x dimension of the map
+ * @param yDim The y dimension of the map
+ * @param numThreads The number of threads to count traces with
+ *
+ * @returns A BIMac with a Beta(1,1) prior updated with every trace
+ */
+std::shared_ptr<BIMac>
+train(const std::vector<std::filesystem::path> &traceFiles, int xDim, int yDim,
+      int numThreads = 1);
+
+/**
+ * Train a BIMac from a set of traces, counting only what a robot following a
+ * trajectory through each trace would have seen.
+ *
+ * @param traceFiles The traces to train from
+ * @param xDim The x dimension of the map
+ * @param yDim The y dimension of the map
+ * @param fov The FOV relative to the robot
+ * @param trajectories The robot's trajectory for each trace. An empty
+ * trajectory means nothing in that trace was seen
+ * @param numThreads The number of threads to count traces with
+ *
+ * @returns A BIMac with a Beta(1,1) prior updated with every trace
+ */
+std::shared_ptr<BIMac>
+train(const std::vector<std::filesystem::path> &traceFiles, int xDim, int yDim,
+      const std::vector<GridCell> &fov,
+      const std::vector<std::vector<GridCell>> &trajectories,
+      int numThreads = 1);
+
+/**
+ * Read a trajectory in the format written by
+ * CoverageRobot::logVisitedLocations (one x,y pair per line).
+ *
+ * @param visitedFile The file to read
+ *
+ * @returns The location at each timestep
+ */
+std::vector<GridCell> readTrajectory(const std::filesystem::path &visitedFile);
+
+} // namespace BIMacTrainer
+
+#endif
@@ -0,0 +1,678 @@
+/**
+ * @file bit_grid.h
+ *
+ * @brief Header file for the BitGrid class.
+ *
+ * BitGrid is a compact binary grid storing one bit per cell. It is used for the
+ * occupancy maps and covered sets in coverage planning states, which are
+ * copied many times during planning.
+ *
+ * @author Charlie Street
+ */
+#ifndef BIT_GRID_H
+#define BIT_GRID_H
+
+#include "coverage_plan/mod/grid_cell.h"
+#include <Eigen/Dense>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <set>
+
+/**
+ * A binary grid which packs one bit per cell into 64 bit words.
+ *
+ * Cells are stored in column major order (i.e. the same linear ordering as
+ * Eigen matrices), so element (row, col) is bit col * rows + row. Accessors
+ * which take a GridCell follow the Cartesian convention used elsewhere, where
+ * (x,y) maps to (row=y, col=x).
+ *
+ * Small grids (up to kInlineWords * 64 cells) are stored inline, so copying a
+ * BitGrid doesn't touch the heap. Larger grids use a reference counted heap
+ * block which is shared by copies, and only cloned by the first copy to write
+ * to it (copy-on-write). Copying a grid of any size is therefore O(1). Freed
+ * blocks are pooled per thread, so cloning rarely calls the allocator.
+ * Bits beyond the stored cells are always kept at zero, so count() and == are
+ * exact.
+ *
+ * A grid can also be padded (see padded()), adding a one cell border around
+ * the grid which always holds a fixed sentinel value. For a padded grid, cell
+ * (x,y) is bit (x + 1) * (rows + 2) + (y + 1), so every neighbour of a cell in
+ * the grid can be read without a bounds check, and a neighbour's index is the
+ * cell's index plus a constant offset (see index() and stride()). The border
+ * is invisible to the (x,y) and (row, col) accessors, count(), toMatrix() and
+ * ==, but reading a border cell (e.g. test(GridCell{-1, 0})) is allowed, and
+ * returns the sentinel value.
+ *
+ * Members:
+ * * _rows: The number of rows in the grid
+ * * _cols: The number of columns in the grid
+ * * _padding: The width of the border (0 or 1)
+ * * _border: The value of the border cells
+ * * _stride: The number of bits per column, including the border
+ * * _origin: The bit index of cell (0,0)
+ * * _numWords: The number of 64 bit words used by the grid
+ * * _inlineWords: Inline storage for small grids
+ * * _heapWords: Shared storage for grids too large for _inlineWords
+ */
+class BitGrid {
+public:
+  static constexpr int kInlineWords{4};
+
+  /**
+   * Proxy returned by the non-const operator(), so individual bits can be
+   * assigned in the same way as Eigen matrix elements.
+   */
+  class Reference {
+  private:
+    BitGrid *_grid{};
+    int _idx{};
+
+  public:
+    Reference(BitGrid *grid, int idx) : _grid{grid}, _idx{idx} {}
+
+    /**
+     * Set the bit. Any non-zero value is treated as 1.
+     *
+     * @param value The value to set the bit to
+     *
+     * @returns This reference
+     */
+    Reference &operator=(int value) {
+      this->_grid->_setBit(this->_idx, value != 0);
+      return *this;
+    }
+
+    /**
+     * Set the bit from another bit reference.
+     *
+     * @param other The reference to copy the bit value from
+     *
+     * @returns This reference
+     */
+    Reference &operator=(const Reference &other) {
+      return *this = (int)other;
+    }
+
+    /**
+     * Read the bit.
+     *
+     * @returns 1 if the bit is set, else 0
+     */
+    operator int() const {
+      const BitGrid &grid{*this->_grid};
+      return (int)((grid._words()[this->_idx >> 6] >> (this->_idx & 63)) & 1);
+    }
+  };
+
+private:
+  /**
+   * A reference counted heap block, holding numWords storage words directly
+   * after this header.
+   *
+   * Members:
+   * * refs: The number of grids sharing the block
+   * * numWords: The number of storage words in the block
+   */
+  struct SharedWords {
+    std::atomic<int> refs;
+    int numWords;
+
+    uint64_t *words() { return reinterpret_cast<uint64_t *>(this + 1); }
+  };
+
+  int _rows{};
+  int _cols{};
+  int _padding{};
+  bool _border{};
+  int _stride{};
+  int _origin{};
+  int _numWords{};
+  std::array<uint64_t, kInlineWords> _inlineWords{};
+  SharedWords *_heapWords{nullptr};
+
+  /**
+   * Sets the dimensions and layout of the grid, without allocating.
+   *
+   * @param rows The number of rows
+   * @param cols The number of columns
+   * @param padding The width of the border (0 or 1)
+   * @param border The value of the border cells
+   */
+  void _setLayout(int rows, int cols, int padding, bool border) {
+    this->_rows = rows;
+    this->_cols = cols;
+    this->_padding = padding;
+    this->_border = border;
+    this->_stride = rows + 2 * padding;
+    this->_origin = padding * (this->_stride + 1);
+  }
+
+  /**
+   * Allocates storage for a grid of the current dimensions and layout. All
+   * cells are 0 and all border cells hold the border value.
+   */
+  void _allocate();
+
+  /**
+   * Sets all border cells to the border value.
+   *
+   * @param words The storage words to write to
+   */
+  void _fillBorder(uint64_t *words) const;
+
+  /**
+   * Drops this grid's reference to its heap block, if it has one.
+   */
+  void _release();
+
+  /**
+   * Replaces a shared heap block with a private copy.
+   */
+  void _unshare();
+
+  /**
+   * Returns a const pointer to the first storage word.
+   *
+   * @returns A const pointer to the words holding the grid
+   */
+  const uint64_t *_words() const {
+    return this->_numWords <= kInlineWords ? this->_inlineWords.data()
+                                           : this->_heapWords->words();
+  }
+
+  /**
+   * Returns a pointer to the first storage word for writing, cloning the heap
+   * block first if it is shared with other grids.
+   *
+   * @returns A pointer to the words holding the grid
+   */
+  uint64_t *_mutableWords() {
+    if (this->_numWords <= kInlineWords) {
+      return this->_inlineWords.data();
+    }
+    if (this->_heapWords->refs.load(std::memory_order_acquire) > 1) {
+      this->_unshare();
+    }
+    return this->_heapWords->words();
+  }
+
+  /**
+   * Sets a single bit. Storage is only cloned if the bit changes.
+   *
+   * @param idx The bit index (see index())
+   * @param value The value to set the bit to
+   */
+  void _setBit(int idx, bool value) {
+    uint64_t mask{uint64_t{1} << (idx & 63)};
+    if (((this->_words()[idx >> 6] & mask) != 0) == value) {
+      return;
+    }
+    this->_mutableWords()[idx >> 6] ^= mask;
+  }
+
+  /**
+   * Sets the bits for the non-zero entries of a matrix. The storage must be
+   * zeroed and have the same dimensions as mat.
+   *
+   * @param mat The matrix (or matrix expression) to pack
+   */
+  template <typename Derived>
+  void _pack(const Eigen::MatrixBase<Derived> &mat) {
+    uint64_t *words{this->_mutableWords()};
+    for (int col{0}; col < this->_cols; ++col) {
+      for (int row{0}; row < this->_rows; ++row) {
+        if (mat(row, col) != 0) {
+          int idx{this->_origin + col * this->_stride + row};
+          words[idx >> 6] |= (uint64_t{1} << (idx & 63));
+        }
+      }
+    }
+  }
+
+public:
+  /**
+   * Creates an empty (0x0) grid.
+   */
+  BitGrid() {}
+
+  /**
+   * Creates a grid of the given dimensions with all bits set to 0.
+   *
+   * @param rows The number of rows
+   * @param cols The number of columns
+   */
+  BitGrid(int rows, int cols) {
+    this->_setLayout(rows, cols, 0, false);
+    this->_allocate();
+  }
+
+  /**
+   * Copies a grid, sharing its heap storage until either grid is written to.
+   *
+   * @param other The grid to copy
+   */
+  BitGrid(const BitGrid &other)
+      : _rows{other._rows}, _cols{other._cols}, _padding{other._padding},
+        _border{other._border}, _stride{other._stride},
+        _origin{other._origin}, _numWords{other._numWords},
+        _inlineWords{other._inlineWords}, _heapWords{other._heapWords} {
+    if (this->_heapWords != nullptr) {
+      this->_heapWords->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * Moves a grid, taking its heap storage.
+   *
+   * @param other The grid to move from, left empty (0x0)
+   */
+  BitGrid(BitGrid &&other) noexcept
+      : _rows{other._rows}, _cols{other._cols}, _padding{other._padding},
+        _border{other._border}, _stride{other._stride},
+        _origin{other._origin}, _numWords{other._numWords},
+        _inlineWords{other._inlineWords}, _heapWords{other._heapWords} {
+    other._setLayout(0, 0, 0, false);
+    other._numWords = 0;
+    other._heapWords = nullptr;
+  }
+
+  /**
+   * Drops the grid's reference to its heap storage.
+   */
+  ~BitGrid() { this->_release(); }
+
+  /**
+   * Copies a grid, sharing its heap storage until either grid is written to.
+   *
+   * @param other The grid to copy
+   *
+   * @returns This grid
+   */
+  BitGrid &operator=(const BitGrid &other);
+
+  /**
+   * Moves a grid, taking its heap storage.
+   *
+   * @param other The grid to move from, left empty (0x0)
+   *
+   * @returns This grid
+   */
+  BitGrid &operator=(BitGrid &&other) noexcept;
+
+  /**
+   * Creates a grid of the given dimensions with the bits in cells set to 1.
+   * Cells outside the grid are ignored.
+   *
+   * @param rows The number of rows
+   * @param cols The number of columns
+   * @param cells The (x,y) cells to set
+   */
+  BitGrid(int rows, int cols, const std::set<GridCell> &cells);
+
+  /**
+   * Creates a grid from an Eigen matrix. Non-zero entries are set to 1.
+   * Implicit so existing code which assigns matrices to maps still works.
+   *
+   * @param mat The matrix (or matrix expression) to pack
+   */
+  template <typename Derived> BitGrid(const Eigen::MatrixBase<Derived> &mat) {
+    this->_setLayout((int)mat.rows(), (int)mat.cols(), 0, false);
+    this->_allocate();
+    this->_pack(mat);
+  }
+
+  /**
+   * Overwrites the grid with an Eigen matrix. Non-zero entries are set to 1.
+   * If the dimensions match, the existing storage is reused, so this never
+   * allocates for a grid which is repeatedly assigned matrices of one size.
+   * The grid keeps its padding and border value.
+   *
+   * @param mat The matrix (or matrix expression) to pack
+   *
+   * @returns This grid
+   */
+  template <typename Derived>
+  BitGrid &operator=(const Eigen::MatrixBase<Derived> &mat) {
+    if (mat.rows() != this->_rows || mat.cols() != this->_cols) {
+      this->_setLayout((int)mat.rows(), (int)mat.cols(), this->_padding,
+                       this->_border);
+      this->_allocate();
+    } else {
+      this->clear();
+    }
+    this->_pack(mat);
+    return *this;
+  }
+
+  /**
+   * Copies a grid into the padded layout, with a one cell border around it.
+   * If grid already has this layout, the copy shares its storage.
+   *
+   * @param grid The grid to copy (padded or not)
+   * @param border The value of the border cells
+   *
+   * @returns The padded grid
+   */
+  static BitGrid padded(const BitGrid &grid, bool border);
+
+  /**
+   * Copies a grid into the unpadded layout. If grid is already unpadded, the
+   * copy shares its storage.
+   *
+   * @param grid The grid to copy (padded or not)
+   *
+   * @returns The unpadded grid
+   */
+  static BitGrid unpadded(const BitGrid &grid);
+
+  /**
+   * Returns the number of rows.
+   *
+   * @returns The number of rows
+   */
+  int rows() const { return this->_rows; }
+
+  /**
+   * Returns the number of columns.
+   *
+   * @returns The number of columns
+   */
+  int cols() const { return this->_cols; }
+
+  /**
+   * Returns the number of cells in the grid (not the number of set bits).
+   *
+   * @returns rows * cols
+   */
+  int size() const { return this->_rows * this->_cols; }
+
+  /**
+   * Returns the width of the border around the grid.
+   *
+   * @returns 1 for a padded grid, else 0
+   */
+  int padding() const { return this->_padding; }
+
+  /**
+   * Returns the value of the border cells. Meaningless if padding() is 0.
+   *
+   * @returns The border value
+   */
+  bool border() const { return this->_border; }
+
+  /**
+   * Returns the number of bits per column, so cell (x + dx, y + dy) is bit
+   * index(cell) + dx * stride() + dy.
+   *
+   * @returns rows + 2 * padding()
+   */
+  int stride() const { return this->_stride; }
+
+  /**
+   * Returns the bit index of an (x,y) cell. Border cells have valid indices in
+   * padded grids.
+   *
+   * @param cell The cell
+   *
+   * @returns The cell's bit index in data()
+   */
+  int index(const GridCell &cell) const {
+    return this->_origin + cell.x * this->_stride + cell.y;
+  }
+
+  /**
+   * Returns the (x,y) cell for a bit index. The inverse of index().
+   *
+   * @param idx The bit index
+   *
+   * @returns The cell at bit idx
+   */
+  GridCell cellAt(int idx) const {
+    return GridCell{idx / this->_stride - this->_padding,
+                    idx % this->_stride - this->_padding};
+  }
+
+  /**
+   * Check if a bit is set, given its index. No bounds checking is done.
+   *
+   * @param idx The bit index (see index())
+   *
+   * @returns True if the bit is set
+   */
+  bool testIndex(int idx) const {
+    return ((this->_words()[idx >> 6] >> (idx & 63)) & 1) != 0;
+  }
+
+  /**
+   * Returns the number of 64 bit words used for storage.
+   *
+   * @returns The number of storage words
+   */
+  int numWords() const { return this->_numWords; }
+
+  /**
+   * Returns a pointer to the raw storage words. Bit index() holds each cell.
+   *
+   * @returns A const pointer to the first storage word
+   */
+  const uint64_t *data() const { return this->_words(); }
+
+  /**
+   * Returns a pointer to the raw storage words for writing, cloning shared
+   * storage first. Bits beyond the stored cells must be left at zero, and
+   * border cells must keep the border value.
+   *
+   * @returns A pointer to the first storage word
+   */
+  uint64_t *data() { return this->_mutableWords(); }
+
+  /**
+   * Check if this grid shares its heap storage with another grid.
+   *
+   * @param other The grid to compare storage with
+   *
+   * @returns True if both grids use the same heap block
+   */
+  bool sharesStorage(const BitGrid &other) const {
+    return this->_heapWords != nullptr &&
+           this->_heapWords == other._heapWords;
+  }
+
+  /**
+   * Read element (row, col). No bounds checking is done.
+   *
+   * @param row The row index
+   * @param col The column index
+   *
+   * @returns 1 if the bit is set, else 0
+   */
+  int operator()(int row, int col) const {
+    return (int)this->testIndex(this->_origin + col * this->_stride + row);
+  }
+
+  /**
+   * Access element (row, col) for writing. No bounds checking is done.
+   *
+   * @param row The row index
+   * @param col The column index
+   *
+   * @returns A proxy reference to the bit
+   */
+  Reference operator()(int row, int col) {
+    return Reference{this, this->_origin + col * this->_stride + row};
+  }
+
+  /**
+   * Check if the bit for an (x,y) cell is set. No bounds checking is done,
+   * though cells in the border of a padded grid may be read.
+   *
+   * @param cell The cell to check
+   *
+   * @returns True if the bit is set
+   */
+  bool test(const GridCell &cell) const {
+    return this->testIndex(this->index(cell));
+  }
+
+  /**
+   * Set the bit for an (x,y) cell. No bounds checking is done.
+   *
+   * @param cell The cell to set
+   * @param value The value to set the bit to
+   */
+  void set(const GridCell &cell, bool value = true) {
+    this->_setBit(this->index(cell), value);
+  }
+
+  /**
+   * Check if an (x,y) cell lies within the grid.
+   *
+   * @param cell The cell to check
+   *
+   * @returns True if the cell is within the grid
+   */
+  bool inBounds(const GridCell &cell) const {
+    return !cell.outOfBounds(0, this->_cols, 0, this->_rows);
+  }
+
+  /**
+   * Returns the number of set bits, not including the border.
+   *
+   * @returns The number of set bits
+   */
+  int count() const;
+
+  /**
+   * Check if every cell in the grid is set.
+   *
+   * @returns True if all bits are set
+   */
+  bool all() const { return this->count() == this->size(); }
+
+  /**
+   * Set every bit to 0, keeping the dimensions and border.
+   */
+  void clear();
+
+  /**
+   * Unpacks the grid into an Eigen matrix.
+   *
+   * @returns The grid as a matrix of 0s and 1s
+   */
+  Eigen::MatrixXi toMatrix() const;
+
+  /**
+   * Implement == to allow comparisons.
+   *
+   * @param other The BitGrid to compare against
+   *
+   * @returns True if both grids have the same dimensions and bits. The
+   * padding and border are ignored
+   */
+  bool operator==(const BitGrid &other) const;
+
+  /**
+   * Implement != to allow comparisons.
+   *
+   * @param other The BitGrid to compare against
+   *
+   * @returns True if the grids differ
+   */
+  bool operator!=(const BitGrid &other) const { return !(*this == other); }
+};
+
+/**
+ * A read only view of a grid's cells. It either views a BitGrid, or raw
+ * storage words in BitGrid's layout (e.g. the maps in a ScenarioBatch), so
+ * code which only reads grids can take either without copying.
+ *
+ * The view doesn't own the words, so it must not outlive them. Views of a
+ * BitGrid are invalidated by writes to the grid, as these may clone its
+ * storage.
+ *
+ * Members:
+ * * _words: The storage words
+ * * _rows: The number of rows in the grid
+ * * _cols: The number of columns in the grid
+ * * _padding: The width of the border (0 or 1)
+ * * _border: The value of the border cells
+ * * _stride: The number of bits per column, including the border
+ * * _origin: The bit index of cell (0,0)
+ */
+class BitGridView {
+private:
+  const uint64_t *_words{};
+  int _rows{};
+  int _cols{};
+  int _padding{};
+  bool _border{};
+  int _stride{};
+  int _origin{};
+
+public:
+  /**
+   * Views a BitGrid. Implicit so BitGrids can be passed as views.
+   *
+   * @param grid The grid to view
+   */
+  BitGridView(const BitGrid &grid)
+      : _words{grid.data()}, _rows{grid.rows()}, _cols{grid.cols()},
+        _padding{grid.padding()}, _border{grid.border()},
+        _stride{grid.stride()}, _origin{grid.index(GridCell{0, 0})} {}
+
+  /**
+   * Views raw storage words in BitGrid's layout.
+   *
+   * @param words The storage words
+   * @param rows The number of rows
+   * @param cols The number of columns
+   * @param padding The width of the border (0 or 1)
+   * @param border The value of the border cells
+   */
+  BitGridView(const uint64_t *words, int rows, int cols, int padding,
+              bool border)
+      : _words{words}, _rows{rows}, _cols{cols}, _padding{padding},
+        _border{border}, _stride{rows + 2 * padding},
+        _origin{padding * (rows + 2 * padding + 1)} {}
+
+  /**
+   * As in BitGrid.
+   */
+  int rows() const { return this->_rows; }
+  int cols() const { return this->_cols; }
+  int padding() const { return this->_padding; }
+  bool border() const { return this->_border; }
+  int stride() const { return this->_stride; }
+  const uint64_t *data() const { return this->_words; }
+
+  /**
+   * As in BitGrid.
+   */
+  int index(const GridCell &cell) const {
+    return this->_origin + cell.x * this->_stride + cell.y;
+  }
+
+  /**
+   * As in BitGrid.
+   */
+  bool testIndex(int idx) const {
+    return ((this->_words[idx >> 6] >> (idx & 63)) & 1) != 0;
+  }
+
+  /**
+   * As in BitGrid.
+   */
+  bool test(const GridCell &cell) const {
+    return this->testIndex(this->index(cell));
+  }
+
+  /**
+   * As in BitGrid.
+   */
+  bool inBounds(const GridCell &cell) const {
+    return !cell.outOfBounds(0, this->_cols, 0, this->_rows);
+  }
+};
+
+#endif
@@ -0,0 +1,75 @@
+/**
+ * @file episode_cache.h
+ *
+ * @brief A process-wide cache of decoded map dynamics episodes.
+ *
+ * Experiments replay the same episode files many times, often from several
+ * executors. The cache decodes each file once and shares the (read-only)
+ * result, and episodes can be prefetched on a background thread.
+ *
+ * @author Charlie Street
+ */
+#ifndef EPISODE_CACHE_H
+#define EPISODE_CACHE_H
+
+#include <Eigen/Dense>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+/**
+ * A decoded episode: the map at each timestep.
+ */
+using Episode = std::vector<Eigen::MatrixXi>;
+
+namespace EpisodeCache {
+
+/**
+ * Get a decoded episode, loading it if it isn't already cached.
+ * Episodes are keyed on their path and modification time, so a file which is
+ * rewritten will be loaded again.
+ *
+ * If the file has a binary trace (see map_trace.h) next to it with the same
+ * stem, the binary trace is loaded instead. If another thread is already
+ * loading the episode, this waits for it rather than loading it again.
+ * Throws if the episode can't be loaded.
+ *
+ * @param file The episode file
+ *
+ * @returns The decoded episode
+ */
+std::shared_ptr<const Episode> get(const std::filesystem::path &file);
+
+/**
+ * Start loading an episode on a background thread, if it isn't already
+ * cached. Load errors are reported when the episode is retrieved with get.
+ *
+ * @param file The episode file
+ */
+void prefetch(const std::filesystem::path &file);
+
+/**
+ * Check if an episode is cached (or being loaded).
+ *
+ * @param file The episode file
+ *
+ * @returns True if the episode is in the cache
+ */
+bool contains(const std::filesystem::path &file);
+
+/**
+ * Returns the number of episodes in the cache.
+ *
+ * @returns The number of cached episodes
+ */
+int size();
+
+/**
+ * Remove all episodes from the cache. Episodes already handed out remain
+ * valid. Waits for any background loads to finish.
+ */
+void clear();
+
+} // namespace EpisodeCache
+
+#endif
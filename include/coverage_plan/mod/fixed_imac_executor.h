@@ -11,9 +11,11 @@
 #ifndef FIXED_IMAC_EXECUTOR_H
 #define FIXED_IMAC_EXECUTOR_H
 
+#include "coverage_plan/mod/episode_cache.h"
 #include "coverage_plan/mod/imac_executor.h"
 #include <Eigen/Dense>
 #include <filesystem>
+#include <memory>
 #include <vector>
 
 /**
@@ -21,12 +23,17 @@
  * The idea is that we read in a number of episodes, and once we run restart,
  * we switch to the next episode.
  *
+ * Episodes can be CSV traces or binary traces (see map_trace.h). If a CSV
+ * trace has a binary trace next to it with the same stem, the binary trace is
+ * used. Episodes are decoded once and shared through EpisodeCache, and the
+ * next episode is prefetched in the background while the current one runs.
+ *
  * Members:
  * As in superclass, plus:
  * * _files: A vector of files
  * * _episode: The episode number
  * * _ts: The current timestep
- * * _currentEpisode: The vector of matrices for the current episode
+ * * _currentEpisode: The (shared) vector of matrices for the current episode
  * * _xDim: Size of X dimension of the map
  * * _yDim: Size of Y dimension of the map
  */
@@ -36,12 +43,13 @@ private:
   const std::vector<std::filesystem::path> _files{};
   int _episode{};
   int _ts{};
-  std::vector<Eigen::MatrixXi> _currentEpisode{};
+  std::shared_ptr<const Episode> _currentEpisode{};
   const int _xDim{};
   const int _yDim{};
 
   /**
-   * Reads in data from file for new episode to get IMac trace.
+   * Gets the IMac trace for the new episode from the episode cache, and
+   * starts prefetching the episode after it.
    */
   void _setCurrentEpisode();
 
@@ -57,29 +65,35 @@ public:
   FixedIMacExecutor(const std::vector<std::filesystem::path> &files,
                     const int &xDim, const int &yDim)
       : IMacExecutor(nullptr), _files{files}, _episode{-1}, _ts{0},
-        _currentEpisode{std::vector<Eigen::MatrixXi>{}}, _xDim{xDim},
-        _yDim{yDim} {}
+        _currentEpisode{std::make_shared<const Episode>()}, _xDim{xDim},
+        _yDim{yDim} {
+    if (!this->_files.empty()) {
+      EpisodeCache::prefetch(this->_files.at(0));
+    }
+  }
 
   /**
    * Restart the simulation and start running the next episode
    *
    * @param observations Not used in this class.
    *
-   * @returns the initial state of the new episode
+   * @returns A reference to the initial state of the new episode
    */
-  Eigen::MatrixXi restart(const std::vector<IMacObservation> &observations =
-                              std::vector<IMacObservation>{});
+  const Eigen::MatrixXi &
+  restart(const std::vector<IMacObservation> &observations =
+              std::vector<IMacObservation>{});
 
   /**
    * Move onto the next IMac state in the episode
    *
    * @param observations Notused in this class
    *
-   * @returns The successor state in the episode
+   * @returns A reference to the successor state in the episode
    *
    * @throw outOfEpisode Thrown if update occurs beyond end of episode
    */
-  Eigen::MatrixXi updateState(const std::vector<IMacObservation> &observations);
+  const Eigen::MatrixXi &
+  updateState(const std::vector<IMacObservation> &observations);
 };
 
 #endif
\ No newline at end of file
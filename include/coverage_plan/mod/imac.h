@@ -16,9 +16,23 @@
 #ifndef IMAC_H
 #define IMAC_H
 
+#include "coverage_plan/mod/bit_grid.h"
+#include "coverage_plan/mod/grid_cell.h"
 #include <Eigen/Dense>
+#include <cstdint>
 #include <filesystem>
 #include <memory>
+#include <random>
+#include <vector>
+
+/**
+ * Enum for classifying the dynamics of a single IMac cell.
+ *
+ * Static cells take the same value at every timestep: static free cells have
+ * entry = 0, exit = 1 and initial belief = 0; static occupied cells have
+ * entry = 1, exit = 0 and initial belief = 1. All other cells are dynamic.
+ */
+enum class CellDynamics { staticFree, staticOccupied, dynamic };
 
 /**
  * Interactive Markov chain map of dynamics (IMac).
@@ -30,16 +44,47 @@
  * probability for (x,y)
  * * _exitMatrix: A matrix where _exitMatrix(x,y) is the (occupied->free)
  * probability for (x,y)
+ * * _stayMatrix: A matrix where _stayMatrix(x,y) is the (occupied->occupied)
+ * probability for (x,y), i.e. 1 - _exitMatrix(x,y). Cached for sampling
+ * * _stationaryMatrix: The stationary occupancy probability of each cell,
+ * entry / (entry + exit), or 0 where entry + exit = 0
+ * * _mixingMatrix: The mixing factor of each cell, 1 - entry - exit. The
+ * distance to the stationary probability shrinks by this factor each step
  * * _initialBelief: A 2D matrix representing the initial
  * belief over each cell being occupied
  * * _staticOccupancy: A 2D matrix estimating the static occupancy of a cell
+ * * _dynamicCells: The linear (column major) indices of all dynamic cells
+ * * _staticCells: The linear (column major) indices of all static cells
+ * * _dynamicMask: A BitGrid with the bits for dynamic cells set
+ * * _staticOccupiedMask: A BitGrid with the bits for static occupied cells set
+ * * _paddedEntryMatrix: _entryMatrix with a one cell border of static occupied
+ * cells (entry = 1), in the same layout as a padded BitGrid
+ * * _paddedExitMatrix: _exitMatrix with a one cell border of static occupied
+ * cells (exit = 0)
+ * * _paddedDynamicCells: The bit indices of all dynamic cells in a padded map,
+ * in the same order as _dynamicCells
+ * * _paddedDynamicMask: _dynamicMask in the padded layout, with the border set
+ * so sampling leaves a map's border alone
+ * * _paddedStaticOccupiedMask: _staticOccupiedMask in the padded layout
  */
 class IMac {
 private:
   const Eigen::MatrixXd _entryMatrix{};
   const Eigen::MatrixXd _exitMatrix{};
+  const Eigen::MatrixXd _stayMatrix{};
+  const Eigen::MatrixXd _stationaryMatrix{};
+  const Eigen::MatrixXd _mixingMatrix{};
   const Eigen::MatrixXd _initialBelief{};
   Eigen::MatrixXd _staticOccupancy{};
+  std::vector<int> _dynamicCells{};
+  std::vector<int> _staticCells{};
+  BitGrid _dynamicMask{};
+  BitGrid _staticOccupiedMask{};
+  Eigen::MatrixXd _paddedEntryMatrix{};
+  Eigen::MatrixXd _paddedExitMatrix{};
+  std::vector<int> _paddedDynamicCells{};
+  BitGrid _paddedDynamicMask{};
+  BitGrid _paddedStaticOccupiedMask{};
 
   /**
    * Reads IMac matrix in from file.
@@ -50,6 +95,62 @@ private:
    */
   Eigen::MatrixXd _readIMacMatrix(const std::filesystem::path &inFile);
 
+  /**
+   * Computes the stationary occupancy probability of each cell.
+   *
+   * @param entryMatrix The entry matrix
+   * @param exitMatrix The exit matrix
+   *
+   * @returns The stationary matrix
+   */
+  static Eigen::MatrixXd _computeStationary(const Eigen::MatrixXd &entryMatrix,
+                                            const Eigen::MatrixXd &exitMatrix);
+
+  /**
+   * Classifies each cell as static free, static occupied or dynamic, and fills
+   * in _dynamicCells, _staticCells, _dynamicMask and _staticOccupiedMask.
+   */
+  void _classifyCells();
+
+  /**
+   * Fills in the padded matrices, cell indices and masks from the unpadded
+   * ones, for sampling and reading padded maps without bounds checks.
+   */
+  void _buildPaddedLayout();
+
+  /**
+   * Returns the bit indices of the dynamic cells in a map's layout.
+   *
+   * @param padding The width of the map's border (0 or 1)
+   *
+   * @returns _paddedDynamicCells if the map is padded, else _dynamicCells
+   */
+  const std::vector<int> &_dynamicBits(int padding) const {
+    return padding > 0 ? this->_paddedDynamicCells : this->_dynamicCells;
+  }
+
+  /**
+   * Samples a block of dynamic cells in a binary map, in place.
+   *
+   * @param words The storage words of the map
+   * @param bits The bit index of each dynamic cell in the map's layout
+   * @param randoms One uniform random number per cell in the block
+   * @param start The position of the block's first cell in _dynamicCells
+   * @param numCells The number of cells in the block
+   */
+  void _sampleDynamicBlock(uint64_t *words, const int *bits,
+                           const double *randoms, int start,
+                           int numCells) const;
+
+  /**
+   * Sets all static cells in a binary map to their static value. The border
+   * of a padded map is left alone.
+   *
+   * @param words The storage words of the map
+   * @param padding The width of the map's border (0 or 1)
+   */
+  void _setStaticCells(uint64_t *words, int padding) const;
+
   /**
    * Write a single IMac matrix to file.
    *
@@ -70,7 +171,14 @@ public:
   IMac(const Eigen::MatrixXd &entryMatrix, const Eigen::MatrixXd &exitMatrix,
        const Eigen::MatrixXd &initialBelief)
       : _entryMatrix{entryMatrix}, _exitMatrix{exitMatrix},
-        _initialBelief{initialBelief}, _staticOccupancy{} {}
+        _stayMatrix{(1.0 - exitMatrix.array()).matrix()},
+        _stationaryMatrix{this->_computeStationary(entryMatrix, exitMatrix)},
+        _mixingMatrix{
+            (1.0 - entryMatrix.array() - exitMatrix.array()).matrix()},
+        _initialBelief{initialBelief}, _staticOccupancy{} {
+    this->_classifyCells();
+    this->_buildPaddedLayout();
+  }
 
   /**
    * This constructor reads an IMac config in from file.
@@ -80,8 +188,17 @@ public:
   IMac(const std::filesystem::path &inDir)
       : _entryMatrix{this->_readIMacMatrix(inDir / "entry.csv")},
         _exitMatrix{this->_readIMacMatrix(inDir / "exit.csv")},
+        _stayMatrix{(1.0 - this->_exitMatrix.array()).matrix()},
+        _stationaryMatrix{
+            this->_computeStationary(this->_entryMatrix, this->_exitMatrix)},
+        _mixingMatrix{(1.0 - this->_entryMatrix.array() -
+                       this->_exitMatrix.array())
+                          .matrix()},
         _initialBelief{this->_readIMacMatrix(inDir / "initial_belief.csv")},
-        _staticOccupancy{} {}
+        _staticOccupancy{} {
+    this->_classifyCells();
+    this->_buildPaddedLayout();
+  }
 
   /**
    *  Estimates the static occupancy of the map.
@@ -108,19 +225,178 @@ public:
    */
   Eigen::MatrixXd forwardStep(const Eigen::MatrixXd &currentBelief) const;
 
+  /**
+   * Runs a given belief or state through IMac, writing the next belief into
+   * an existing matrix rather than allocating a new one.
+   *
+   * Both matrices must match the map dimensions and be stored contiguously
+   * (e.g. a MatrixXd or a Map over one), else this throws. currentBelief and
+   * nextBelief may be the same matrix.
+   *
+   * @param currentBelief a 2D matrix of the current map belief or state
+   * @param nextBelief a 2D matrix overwritten with the subsequent map belief
+   */
+  void forwardStep(const Eigen::Ref<const Eigen::MatrixXd> &currentBelief,
+                   Eigen::Ref<Eigen::MatrixXd> nextBelief) const;
+
+  /**
+   * Runs a given belief or state through IMac for k timesteps.
+   *
+   * Each cell is a two state Markov chain, so this is computed in closed form
+   * as stationary + mixing^k * (currentBelief - stationary), which costs the
+   * same regardless of k.
+   *
+   * @param currentBelief a 2D matrix of the current map belief or state
+   * @param k The number of timesteps to propagate for (must be >= 0)
+   *
+   * @returns a 2D matrix of the map belief k timesteps later
+   */
+  Eigen::MatrixXd forwardSteps(const Eigen::MatrixXd &currentBelief,
+                               int k) const;
+
+  /**
+   * Computes the occupancy probability of a single cell k timesteps from now.
+   *
+   * @param cell The (x,y) cell to query
+   * @param currentProb The cell's current occupancy probability
+   * @param k The number of timesteps to propagate for (must be >= 0)
+   *
+   * @returns The occupancy probability of cell k timesteps later
+   */
+  double forwardSteps(const GridCell &cell, double currentProb, int k) const;
+
+  /**
+   * Runs a binary map state through IMac and samples the next state, in place.
+   *
+   * This fuses forwardStep and sampling, without any heap allocations.
+   * Static cells are set directly. For each dynamic cell the occupancy
+   * probability is entry (if free) or 1 - exit (if occupied), and one uniform
+   * random number is drawn per dynamic cell in column major order, where a
+   * draw <= the probability gives an occupied cell. This matches sampling
+   * forwardStep(map) with an IMacExecutor for this IMac, so the same generator
+   * state gives the same result.
+   *
+   * The map may be padded (see BitGrid::padded()). The draws don't depend on
+   * the map's layout, and its border is left alone.
+   *
+   * @param map The current map state, overwritten with the next state
+   * @param gen The random number generator to sample with
+   */
+  void forwardStepAndSample(BitGrid &map, std::mt19937_64 &gen) const;
+
+  /**
+   * Runs a binary map state through IMac and samples the next state, in place.
+   * Same as the BitGrid version, but for maps stored as Eigen matrices.
+   *
+   * @param map The current map state, overwritten with the next state
+   * @param gen The random number generator to sample with
+   */
+  void forwardStepAndSample(Eigen::MatrixXi &map, std::mt19937_64 &gen) const;
+
+  /**
+   * Runs a binary map state through IMac and samples the next state, in place,
+   * using a counter-based random number generator.
+   *
+   * Static cells are set directly. The draw for each dynamic cell is a pure
+   * function of (seed, time, cell index), so
+   * there is no generator state to seed or mutate. Calling this twice with the
+   * same arguments on the same map always gives the same result, and calls can
+   * safely be made from multiple threads. As with the generator version, the
+   * map may be padded, and the draws don't depend on its layout.
+   *
+   * @param map The current map state, overwritten with the next state
+   * @param seed The seed (e.g. the scenario's random number)
+   * @param time The timestep being sampled, used to separate draws in time
+   */
+  void forwardStepAndSample(BitGrid &map, uint64_t seed, uint64_t time) const;
+
+  /**
+   * Same as the counter-based BitGrid version, but for a map stored as raw
+   * words in BitGrid's layout (e.g. in a ScenarioBatch).
+   *
+   * @param words The storage words of the map, overwritten with the next state
+   * @param padding The width of the map's border (0 or 1)
+   * @param seed The seed (e.g. the scenario's random number)
+   * @param time The timestep being sampled, used to separate draws in time
+   */
+  void forwardStepAndSample(uint64_t *words, int padding, uint64_t seed,
+                            uint64_t time) const;
+
   /**
    * Getter for _entryMatrix. Need to retrieve for experimental purposes.
    *
-   * @returns A copy of_entryMatrix
+   * @returns A reference to _entryMatrix
    */
-  Eigen::MatrixXd getEntryMatrix() const { return this->_entryMatrix; }
+  const Eigen::MatrixXd &getEntryMatrix() const { return this->_entryMatrix; }
 
   /**
    * Getter for _exitMatrix. Need to retrieve for experimental purposes.
    *
-   * @returns A copy of_exitMatrix
+   * @returns A reference to _exitMatrix
+   */
+  const Eigen::MatrixXd &getExitMatrix() const { return this->_exitMatrix; }
+
+  /**
+   * Getter for _paddedEntryMatrix. Element i is the entry probability of bit i
+   * in a padded map of the same dimensions. Border cells are static occupied.
+   *
+   * @returns A reference to _paddedEntryMatrix
+   */
+  const Eigen::MatrixXd &getPaddedEntryMatrix() const {
+    return this->_paddedEntryMatrix;
+  }
+
+  /**
+   * Getter for _paddedExitMatrix. Element i is the exit probability of bit i
+   * in a padded map of the same dimensions. Border cells are static occupied.
+   *
+   * @returns A reference to _paddedExitMatrix
+   */
+  const Eigen::MatrixXd &getPaddedExitMatrix() const {
+    return this->_paddedExitMatrix;
+  }
+
+  /**
+   * Returns the classification of a single cell's dynamics.
+   *
+   * @param cell The (x,y) cell to classify
+   *
+   * @returns The cell's dynamics classification
+   */
+  CellDynamics getCellDynamics(const GridCell &cell) const;
+
+  /**
+   * Getter for _dynamicCells. Hot loops can iterate over this instead of the
+   * whole grid, as static cells never change.
+   *
+   * @returns The linear (column major) indices of all dynamic cells
+   */
+  const std::vector<int> &getDynamicCells() const {
+    return this->_dynamicCells;
+  }
+
+  /**
+   * Getter for _staticCells.
+   *
+   * @returns The linear (column major) indices of all static cells
+   */
+  const std::vector<int> &getStaticCells() const { return this->_staticCells; }
+
+  /**
+   * Getter for _stationaryMatrix.
+   *
+   * @returns The stationary occupancy probability of each cell
+   */
+  const Eigen::MatrixXd &getStationaryMatrix() const {
+    return this->_stationaryMatrix;
+  }
+
+  /**
+   * Getter for _mixingMatrix.
+   *
+   * @returns The mixing factor (1 - entry - exit) of each cell
    */
-  Eigen::MatrixXd getExitMatrix() const { return this->_exitMatrix; }
+  const Eigen::MatrixXd &getMixingMatrix() const { return this->_mixingMatrix; }
 
   /**
    * Return the initial belief over the map of dynamics.
@@ -129,7 +405,9 @@ public:
    *
    * @returns The initial belief over the map
    */
-  Eigen::MatrixXd getInitialBelief() const { return this->_initialBelief; }
+  const Eigen::MatrixXd &getInitialBelief() const {
+    return this->_initialBelief;
+  }
 
   /**
    * Write IMac matrices out to file.
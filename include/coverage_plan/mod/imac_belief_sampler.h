@@ -12,13 +12,16 @@
 #ifndef IMAC_BELIEF_SAMPLER_H
 #define IMAC_BELIEF_SAMPLER_H
 
+#include "coverage_plan/mod/bit_grid.h"
+#include "coverage_plan/mod/imac.h"
 #include "coverage_plan/mod/imac_executor.h"
 
 /**
  * Subclass which removes all functionality except IMac belief sampling.
  * This removes any function which uses this->_currentState (hence stateless).
- * The IMac model isn't even used, but  want to reuse the sampling
- * functionality. This is necessary for use within DEPSOT. When sampling, the
+ * The IMac model is optional, but  want to reuse the sampling
+ * functionality. If given, it is only used to skip sampling static cells.
+ * This is necessary for use within DEPSOT. When sampling, the
  * random seed can be specified.
  *
  * Members:
@@ -32,6 +35,14 @@ public:
    */
   IMacBeliefSampler() : IMacExecutor(nullptr) {}
 
+  /**
+   * Initialises all attributes with an IMac model. Beliefs passed to
+   * sampleFromBelief must then be consistent with the model's static cells.
+   *
+   * @param imac The IMac model the sampled beliefs come from
+   */
+  IMacBeliefSampler(std::shared_ptr<IMac> imac) : IMacExecutor(imac) {}
+
   /**
    * Sample from a belief over the current IMac state.
    *
@@ -46,18 +57,31 @@ public:
                    const std::vector<IMacObservation> &observations =
                        std::vector<IMacObservation>{});
 
+  /**
+   * Run a map state through an IMac model and sample the next state in place.
+   * Equivalent to sampleFromBelief(imac.forwardStep(map), seed), but without
+   * any heap allocations.
+   *
+   * @param imac The IMac model to step the map through
+   * @param map The current map state, overwritten with the next state
+   * @param seed The random seed (if 0, use current seed)
+   */
+  void forwardStepAndSample(const IMac &imac, BitGrid &map,
+                            const double &seed = 0.0);
+
   /**
    * Function not implemented in IMacBeliefSampler.
    */
-  Eigen::MatrixXi restart(const std::vector<IMacObservation> &observations =
-                              std::vector<IMacObservation>{}) {
+  const Eigen::MatrixXi &
+  restart(const std::vector<IMacObservation> &observations =
+              std::vector<IMacObservation>{}) {
     throw "restart not implemented in IMacBeliefSampler.";
   }
 
   /**
    * Function not implemented in IMacBeliefSampler.
    */
-  Eigen::MatrixXi
+  const Eigen::MatrixXi &
   updateState(const std::vector<IMacObservation> &observations) {
     throw "updateState not implemented in IMacBeliefSampler.";
   }
@@ -72,7 +96,7 @@ public:
   /**
    * Function not implemented in IMacBeliefSampler.
    */
-  Eigen::MatrixXi clearRobotPosition(const GridCell &cell) {
+  const Eigen::MatrixXi &clearRobotPosition(const GridCell &cell) {
     throw "clearRobotPosition not implemented in IMacBeliefSampler.";
   }
 };
@@ -12,6 +12,7 @@
 
 #include "coverage_plan/mod/grid_cell.h"
 #include "coverage_plan/mod/imac.h"
+#include "coverage_plan/mod/map_trace.h"
 #include "coverage_plan/util/seed.h"
 #include <Eigen/Dense>
 #include <filesystem>
@@ -45,6 +46,8 @@ struct IMacObservation {
  * Members:
  * * _imac: A shared ptr to an IMac model
  * * _currentState: The current MoD state (deterministic, i.e. just 0s and 1s)
+ * * _mapDynamics: The state at each timestep, for logMapDynamics
+ * * _keepHistory: If false, _mapDynamics isn't recorded
  *
  */
 class IMacExecutor {
@@ -56,16 +59,21 @@ private:
 protected:
   Eigen::MatrixXi _currentState{};
   std::mt19937_64 _gen{}; // Used for random sampling alongside _sampler
-  std::vector<Eigen::MatrixXi> _mapDynamics{};
+  MapTraceRecorder _mapDynamics{};
+  bool _keepHistory{true};
 
   /**
-   * Store the current state of the map for logging purposes.
+   * Store the current state of the map for logging purposes, if the history
+   * is being kept.
    */
   void _addMapForTs();
 
   /**
    * Helper function which samples an MoD state from a distribution matrix.
    *
+   * If an IMac model is set, only its dynamic cells are sampled. Static cells
+   * have a deterministic belief under the model, so are rounded instead.
+   *
    * @param distMatrix a matrix of probabilities. Each probability is the
    * occupation probability for the current timestep.
    *
@@ -81,7 +89,7 @@ public:
    */
   IMacExecutor(std::shared_ptr<IMac> imac)
       : _imac{imac}, _currentState{}, _gen{SeedHelpers::genRandomDeviceSeed()},
-        _sampler{0.0, 1.0}, _mapDynamics{} {}
+        _sampler{0.0, 1.0}, _mapDynamics{}, _keepHistory{true} {}
 
   /**
    * Restart the simulation and return the new initial state.
@@ -89,9 +97,10 @@ public:
    * @param observations A vector of IMacObservations (what is seen at t=0).
    * Optional.
    *
-   * @returns the initial state of the map of dynamics
+   * @returns A reference to the initial state of the map of dynamics, valid
+   * until the state next changes
    */
-  virtual Eigen::MatrixXi
+  virtual const Eigen::MatrixXi &
   restart(const std::vector<IMacObservation> &observations =
               std::vector<IMacObservation>{});
 
@@ -101,9 +110,10 @@ public:
    *
    * @param observations A vector of IMacObservations
    *
-   * @returns The successor IMac state
+   * @returns A reference to the successor IMac state, valid until the state
+   * next changes
    */
-  virtual Eigen::MatrixXi
+  virtual const Eigen::MatrixXi &
   updateState(const std::vector<IMacObservation> &observations);
 
   /**
@@ -112,7 +122,12 @@ public:
    * Each row is the state of the map at the corresponding timestep.
    * Row format: ts,(x,y,occ)*
    *
-   * @param outFile The CSV file to write the map logs
+   * If outFile has the MapTrace::fileExtension extension, the compact binary
+   * trace format in map_trace.h is written instead.
+   *
+   * Throws if the history has been switched off with setKeepHistory.
+   *
+   * @param outFile The CSV (or binary trace) file to write the map logs
    */
   virtual void logMapDynamics(const std::filesystem::path &outFile);
 
@@ -124,9 +139,35 @@ public:
    *
    * @param cell The grid cell to clear
    *
-   * @returns The updated currentState
+   * @returns A reference to the updated current state
+   */
+  virtual const Eigen::MatrixXi &clearRobotPosition(const GridCell &cell);
+
+  /**
+   * Getter for _currentState.
+   *
+   * @returns A reference to the current MoD state
+   */
+  const Eigen::MatrixXi &getCurrentState() const {
+    return this->_currentState;
+  }
+
+  /**
+   * Switch recording of the map history (used by logMapDynamics) on or off.
+   * The history is stored compactly (see MapTraceRecorder), but long runs
+   * which are never logged can switch it off entirely. Either way the history
+   * so far is discarded, so this should be called before restart.
+   *
+   * @param keepHistory True if the history should be recorded
+   */
+  void setKeepHistory(bool keepHistory);
+
+  /**
+   * Getter for _mapDynamics.
+   *
+   * @returns A reference to the recorded history
    */
-  virtual Eigen::MatrixXi clearRobotPosition(const GridCell &cell);
+  const MapTraceRecorder &getMapDynamics() const { return this->_mapDynamics; }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,319 @@
+/**
+ * @file map_trace.h
+ *
+ * @brief Compact binary file format for map dynamics traces.
+ *
+ * The CSV traces written by IMacExecutor::logMapDynamics store an x,y,value
+ * triplet for every cell at every timestep. This format stores one bit per
+ * cell for keyframes, and only the cells which changed for all other steps.
+ *
+ * File layout (all values little-endian):
+ * * A 48 byte MapTraceHeader
+ * * One record per timestep. Each record starts with a type byte:
+ *   * Keyframe (0): the full map as BitGrid storage words
+ *   * Delta (1): a varint count of changed cells, followed by the varint gaps
+ *     between the (ascending, column major) indices of the changed cells
+ * * An index of numSteps uint64 byte offsets, one per record, at indexOffset
+ *
+ * Step 0 is always a keyframe, as is every keyframeInterval-th step, so any
+ * step can be decoded by seeking to the previous keyframe.
+ *
+ * @author Charlie Street
+ */
+#ifndef MAP_TRACE_H
+#define MAP_TRACE_H
+
+#include "coverage_plan/mod/bit_grid.h"
+#include "coverage_plan/mod/grid_cell.h"
+#include <Eigen/Dense>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/**
+ * Struct for the fixed size header at the start of a trace file.
+ *
+ * Members:
+ * * magic: Always "COVTRACE"
+ * * version: The format version
+ * * rows: The number of rows in the map (y dimension)
+ * * cols: The number of columns in the map (x dimension)
+ * * numSteps: The number of timesteps in the trace
+ * * keyframeInterval: The maximum gap between keyframes
+ * * reserved: Unused, kept at zero
+ * * indexOffset: The byte offset of the record index
+ * * reservedTwo: Unused, kept at zero
+ */
+struct MapTraceHeader {
+  char magic[8]{};
+  uint32_t version{};
+  uint32_t rows{};
+  uint32_t cols{};
+  uint32_t numSteps{};
+  uint32_t keyframeInterval{};
+  uint32_t reserved{};
+  uint64_t indexOffset{};
+  uint64_t reservedTwo{};
+};
+
+static_assert(sizeof(MapTraceHeader) == 48, "Trace header not 48 bytes");
+
+/**
+ * A read-only memory mapped trace file.
+ *
+ * Steps can either be streamed in order with applyStep, or decoded directly
+ * with getStep.
+ *
+ * Members:
+ * * _fd: The file descriptor of the open file
+ * * _data: The start of the mapped file
+ * * _size: The size of the mapped file in bytes
+ * * _header: A copy of the file header
+ * * _index: Pointer to the record index in the mapped file
+ */
+class MapTraceReader {
+private:
+  int _fd{-1};
+  void *_data{nullptr};
+  size_t _size{};
+  MapTraceHeader _header{};
+  const uint64_t *_index{nullptr};
+
+  /**
+   * Returns a pointer to the start of a record in the mapped file.
+   *
+   * @param ts The timestep of the record
+   *
+   * @returns A pointer to the record's type byte
+   */
+  const uint8_t *_record(int ts) const;
+
+  /**
+   * Unmaps and closes the file, if open.
+   */
+  void _close();
+
+public:
+  /**
+   * Maps a trace file into memory and validates its header.
+   * Throws if the file can't be opened or is invalid.
+   *
+   * @param inFile The trace file to map
+   */
+  MapTraceReader(const std::filesystem::path &inFile);
+
+  /**
+   * Unmaps the file.
+   */
+  ~MapTraceReader() { this->_close(); }
+
+  MapTraceReader(const MapTraceReader &) = delete;
+  MapTraceReader &operator=(const MapTraceReader &) = delete;
+
+  /**
+   * Returns the number of rows (y dimension) in the map.
+   *
+   * @returns The number of rows
+   */
+  int rows() const { return (int)this->_header.rows; }
+
+  /**
+   * Returns the number of columns (x dimension) in the map.
+   *
+   * @returns The number of columns
+   */
+  int cols() const { return (int)this->_header.cols; }
+
+  /**
+   * Returns the number of timesteps in the trace.
+   *
+   * @returns The number of timesteps
+   */
+  int numSteps() const { return (int)this->_header.numSteps; }
+
+  /**
+   * Check if the record for a timestep is a keyframe.
+   *
+   * @param ts The timestep
+   *
+   * @returns True if the record is a keyframe
+   */
+  bool isKeyframe(int ts) const;
+
+  /**
+   * Apply a single record to a map. If ts is a keyframe the map is
+   * overwritten, else map must hold the state at ts - 1.
+   *
+   * @param ts The timestep to apply
+   * @param map The map to update in place. Resized if dimensions differ
+   */
+  void applyStep(int ts, BitGrid &map) const;
+
+  /**
+   * Decode the map at any timestep, seeking from the previous keyframe.
+   *
+   * @param ts The timestep
+   *
+   * @returns The map at ts
+   */
+  BitGrid getStep(int ts) const;
+};
+
+/**
+ * An in-memory trace, recorded one timestep at a time.
+ *
+ * Steps are stored as the same keyframe and delta records used in trace
+ * files, so a long run costs a few bytes per changed cell rather than a full
+ * map per timestep. The latest step is held unencoded, so it can still be
+ * edited with setCell until the next step is added.
+ *
+ * Members:
+ * * _keyframeInterval: The maximum gap between keyframes
+ * * _records: The encoded records for every step but the latest
+ * * _index: The offset of each encoded record in _records
+ * * _sinceKeyframe: The number of steps encoded since the last keyframe
+ * * _encoded: The map at the last encoded step
+ * * _latest: The map at the latest step
+ * * _numSteps: The number of recorded steps
+ */
+class MapTraceRecorder {
+private:
+  int _keyframeInterval{};
+  std::vector<uint8_t> _records{};
+  std::vector<uint64_t> _index{};
+  int _sinceKeyframe{};
+  BitGrid _encoded{};
+  BitGrid _latest{};
+  int _numSteps{};
+
+  /**
+   * Encodes the latest step and appends it to the records.
+   */
+  void _encodeLatest();
+
+  /**
+   * Checks a new step has the same dimensions as the recorded steps.
+   *
+   * @param rows The number of rows in the new step
+   * @param cols The number of columns in the new step
+   */
+  void _checkDimensions(int rows, int cols) const;
+
+public:
+  /**
+   * Creates an empty trace.
+   *
+   * @param keyframeInterval The maximum number of steps between keyframes
+   */
+  MapTraceRecorder(int keyframeInterval = 64);
+
+  /**
+   * Removes all steps, keeping the allocated buffers for reuse.
+   */
+  void clear();
+
+  /**
+   * Records the map at the next timestep.
+   * Throws if its dimensions differ from the previous steps.
+   *
+   * @param map The map (or matrix expression) at the next timestep
+   */
+  template <typename Derived>
+  void addStep(const Eigen::MatrixBase<Derived> &map) {
+    this->_checkDimensions(map.rows(), map.cols());
+    if (this->_numSteps > 0) {
+      this->_encodeLatest();
+    }
+    this->_latest = map;
+    ++this->_numSteps;
+  }
+
+  /**
+   * Records the map at the next timestep. Padded maps are stored unpadded.
+   * Throws if its dimensions differ from the previous steps.
+   *
+   * @param map The map at the next timestep
+   */
+  void addStep(const BitGrid &map);
+
+  /**
+   * Sets a cell in the latest step. Throws if no steps have been recorded.
+   *
+   * @param cell The (x,y) cell to set
+   * @param value The value to set the cell to
+   */
+  void setCell(const GridCell &cell, bool value);
+
+  /**
+   * Returns the number of recorded timesteps.
+   *
+   * @returns The number of timesteps
+   */
+  int numSteps() const { return this->_numSteps; }
+
+  /**
+   * Returns the number of bytes used by the encoded records.
+   *
+   * @returns The size of the encoded records in bytes
+   */
+  size_t numBytes() const { return this->_records.size(); }
+
+  /**
+   * Apply a single step to a map. If ts is a keyframe or the latest step the
+   * map is overwritten, else map must hold the state at ts - 1. Stepping
+   * through in order from 0 decodes the whole trace.
+   *
+   * @param ts The timestep to apply
+   * @param map The map to update in place. Resized if dimensions differ
+   */
+  void applyStep(int ts, BitGrid &map) const;
+
+  /**
+   * Write the trace to a binary trace file.
+   *
+   * @param outFile The file to write to
+   */
+  void write(const std::filesystem::path &outFile) const;
+};
+
+namespace MapTrace {
+
+/**
+ * The file extension used for binary trace files.
+ */
+const std::string fileExtension{".trace"};
+
+/**
+ * Write a sequence of maps to a binary trace file.
+ *
+ * @param maps The map at each timestep. All maps must have the same size
+ * @param outFile The file to write to
+ * @param keyframeInterval The maximum number of steps between keyframes
+ */
+void write(const std::vector<Eigen::MatrixXi> &maps,
+           const std::filesystem::path &outFile, int keyframeInterval = 64);
+
+/**
+ * Read a CSV trace in the format written by IMacExecutor::logMapDynamics.
+ * The map dimensions are inferred from the cell coordinates in the file.
+ *
+ * @param inFile The CSV file to read
+ *
+ * @returns The map at each timestep
+ */
+std::vector<Eigen::MatrixXi> readCSV(const std::filesystem::path &inFile);
+
+/**
+ * Convert a CSV trace into a binary trace file.
+ *
+ * @param inFile The CSV file to read
+ * @param outFile The binary file to write
+ */
+void convertCSV(const std::filesystem::path &inFile,
+                const std::filesystem::path &outFile);
+
+} // namespace MapTrace
+
+#endif
@@ -0,0 +1,295 @@
+/**
+ * @file model_file.h
+ *
+ * @brief Binary file format for IMac and BIMac models.
+ *
+ * The CSV format used by IMac and BIMac is slow to parse and BIMac needs six
+ * separate files. This binary format stores a whole model in one file which
+ * can be memory mapped and viewed with Eigen::Map without any parsing.
+ *
+ * File layout (all values little-endian):
+ * * A 64 byte ModelFileHeader
+ * * numArrays arrays, each of rows * cols elements stored in column major
+ * order (the same layout as Eigen). IMac files store 3 double arrays (entry,
+ * exit, initial belief), BIMac files store 6 int32 arrays (alpha entry, beta
+ * entry, alpha exit, beta exit, alpha init, beta init)
+ *
+ * The header holds a 64 bit FNV-1a checksum of the array data, which is
+ * verified whenever a file is opened.
+ *
+ * @author Charlie Street
+ */
+#ifndef MODEL_FILE_H
+#define MODEL_FILE_H
+
+#include "coverage_plan/mod/bimac.h"
+#include "coverage_plan/mod/imac.h"
+#include <Eigen/Dense>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+/**
+ * Enum for the types of model which can be stored in a model file.
+ */
+enum class ModelType : uint32_t { imac = 0, bimac = 1 };
+
+/**
+ * Struct for the fixed size header at the start of a model file.
+ *
+ * Members:
+ * * magic: Always "COVMODEL"
+ * * version: The format version
+ * * modelType: The ModelType stored in the file
+ * * rows: The number of rows in each array
+ * * cols: The number of columns in each array
+ * * numArrays: The number of arrays stored
+ * * elemSize: The size in bytes of each array element
+ * * payloadBytes: The total size of the array data in bytes
+ * * checksum: The 64 bit FNV-1a checksum of the array data
+ * * reserved: Unused, kept at zero
+ */
+struct ModelFileHeader {
+  char magic[8]{};
+  uint32_t version{};
+  uint32_t modelType{};
+  uint32_t rows{};
+  uint32_t cols{};
+  uint32_t numArrays{};
+  uint32_t elemSize{};
+  uint64_t payloadBytes{};
+  uint64_t checksum{};
+  uint8_t reserved[16]{};
+};
+
+static_assert(sizeof(ModelFileHeader) == 64, "Model file header not 64 bytes");
+
+/**
+ * A read-only memory mapped model file.
+ *
+ * The arrays in the file can be viewed as Eigen matrices without copying.
+ * The views are only valid while the MappedModelFile is alive.
+ *
+ * Members:
+ * * _fd: The file descriptor of the open file
+ * * _data: The start of the mapped file
+ * * _size: The size of the mapped file in bytes
+ * * _header: A copy of the file header
+ */
+class MappedModelFile {
+private:
+  int _fd{-1};
+  void *_data{nullptr};
+  size_t _size{};
+  ModelFileHeader _header{};
+
+  /**
+   * Returns a pointer to the start of an array in the mapped file.
+   *
+   * @param index The index of the array
+   *
+   * @returns A pointer to the first byte of the array
+   */
+  const std::byte *_arrayStart(int index) const;
+
+  /**
+   * Unmaps and closes the file, if open.
+   */
+  void _close();
+
+  /**
+   * Maps the open file in _fd and validates its header and checksum.
+   * Closes the file and throws if it is invalid.
+   */
+  void _mapAndValidate();
+
+public:
+  /**
+   * Maps a model file into memory and validates its header and checksum.
+   * Throws if the file can't be opened or is invalid.
+   *
+   * @param inFile The model file to map
+   */
+  MappedModelFile(const std::filesystem::path &inFile);
+
+  /**
+   * Maps an already open model file (e.g. a shared memory object), taking
+   * ownership of the file descriptor. Throws if the file is invalid.
+   *
+   * @param fd The open file descriptor
+   */
+  explicit MappedModelFile(int fd);
+
+  /**
+   * Unmaps the file.
+   */
+  ~MappedModelFile() { this->_close(); }
+
+  MappedModelFile(const MappedModelFile &) = delete;
+  MappedModelFile &operator=(const MappedModelFile &) = delete;
+
+  /**
+   * Returns the type of model stored in the file.
+   *
+   * @returns The model type
+   */
+  ModelType type() const { return (ModelType)this->_header.modelType; }
+
+  /**
+   * Returns the number of rows in each array.
+   *
+   * @returns The number of rows
+   */
+  int rows() const { return (int)this->_header.rows; }
+
+  /**
+   * Returns the number of columns in each array.
+   *
+   * @returns The number of columns
+   */
+  int cols() const { return (int)this->_header.cols; }
+
+  /**
+   * Returns the number of arrays in the file.
+   *
+   * @returns The number of arrays
+   */
+  int numArrays() const { return (int)this->_header.numArrays; }
+
+  /**
+   * View one of the arrays in an IMac file without copying.
+   *
+   * @param index The array index (0 = entry, 1 = exit, 2 = initial belief)
+   *
+   * @returns A read-only Eigen view of the array
+   */
+  Eigen::Map<const Eigen::MatrixXd> doubleArray(int index) const;
+
+  /**
+   * View one of the arrays in a BIMac file without copying.
+   *
+   * @param index The array index (0 = alpha entry, 1 = beta entry,
+   * 2 = alpha exit, 3 = beta exit, 4 = alpha init, 5 = beta init)
+   *
+   * @returns A read-only Eigen view of the array
+   */
+  Eigen::Map<const Eigen::MatrixXi> intArray(int index) const;
+};
+
+namespace ModelFile {
+
+/**
+ * The file name used for binary IMac files inside an IMac directory.
+ */
+const std::filesystem::path imacFileName{"imac.bin"};
+
+/**
+ * The file name used for binary BIMac files inside a BIMac directory.
+ */
+const std::filesystem::path bimacFileName{"bimac.bin"};
+
+/**
+ * Computes the 64 bit FNV-1a checksum of a block of memory.
+ *
+ * @param data The start of the memory block
+ * @param numBytes The size of the memory block in bytes
+ *
+ * @returns The checksum
+ */
+uint64_t checksum(const void *data, size_t numBytes);
+
+/**
+ * Encode an IMac model as the bytes of a binary model file.
+ *
+ * @param imac The IMac model to encode
+ *
+ * @returns The contents of the model file
+ */
+std::vector<std::byte> encodeIMac(const IMac &imac);
+
+/**
+ * Encode a BIMac model as the bytes of a binary model file.
+ *
+ * @param bimac The BIMac model to encode
+ *
+ * @returns The contents of the model file
+ */
+std::vector<std::byte> encodeBIMac(const BIMac &bimac);
+
+/**
+ * Write an IMac model out to a binary model file.
+ *
+ * @param imac The IMac model to write
+ * @param outFile The file to write to
+ */
+void writeIMac(const IMac &imac, const std::filesystem::path &outFile);
+
+/**
+ * Write a BIMac model out to a binary model file.
+ *
+ * @param bimac The BIMac model to write
+ * @param outFile The file to write to
+ */
+void writeBIMac(const BIMac &bimac, const std::filesystem::path &outFile);
+
+/**
+ * Read an IMac model from a binary model file.
+ *
+ * @param inFile The file to read from
+ *
+ * @returns The IMac model
+ */
+std::shared_ptr<IMac> readIMac(const std::filesystem::path &inFile);
+
+/**
+ * Read a BIMac model from a binary model file.
+ *
+ * @param inFile The file to read from
+ *
+ * @returns The BIMac model
+ */
+std::shared_ptr<BIMac> readBIMac(const std::filesystem::path &inFile);
+
+/**
+ * Load an IMac model from a directory, using the binary file in the
+ * directory if there is one, else the CSV files.
+ *
+ * @param inDir The IMac directory
+ *
+ * @returns The IMac model
+ */
+std::shared_ptr<IMac> loadIMac(const std::filesystem::path &inDir);
+
+/**
+ * Load a BIMac model from a directory, using the binary file in the
+ * directory if there is one, else the CSV files.
+ *
+ * @param inDir The BIMac directory
+ *
+ * @returns The BIMac model
+ */
+std::shared_ptr<BIMac> loadBIMac(const std::filesystem::path &inDir);
+
+/**
+ * Convert an IMac CSV directory into a binary model file.
+ *
+ * @param inDir The directory containing the IMac CSV files
+ * @param outFile The binary file to write
+ */
+void convertIMacDirectory(const std::filesystem::path &inDir,
+                          const std::filesystem::path &outFile);
+
+/**
+ * Convert a BIMac CSV directory into a binary model file.
+ *
+ * @param inDir The directory containing the BIMac CSV files
+ * @param outFile The binary file to write
+ */
+void convertBIMacDirectory(const std::filesystem::path &inDir,
+                           const std::filesystem::path &outFile);
+
+} // namespace ModelFile
+
+#endif
@@ -0,0 +1,111 @@
+/**
+ * @file model_store.h
+ *
+ * @brief A POSIX shared memory store for IMac and BIMac models.
+ *
+ * When many experiment processes run on one machine, each one would
+ * otherwise parse the same model CSVs. With the store, one process publishes
+ * a model under a key, and every worker maps the same read-only pages, so
+ * loading a model needs no parsing.
+ *
+ * This saves parse time, not memory. IMac and BIMac own their matrices (and
+ * IMac derives further matrices from them), so loadIMac and loadBIMac copy
+ * the mapped arrays into private storage, and each worker holds its own copy
+ * of the model. Only code which reads the raw arrays through map() shares
+ * the pages.
+ *
+ * Each published model is a shared memory object holding a binary model
+ * file (see model_file.h), so it is validated in the same way as a model file
+ * when mapped. The header is written last, so a model which is still being
+ * published is rejected rather than read half written.
+ *
+ * @author Charlie Street
+ */
+#ifndef MODEL_STORE_H
+#define MODEL_STORE_H
+
+#include "coverage_plan/mod/bimac.h"
+#include "coverage_plan/mod/imac.h"
+#include "coverage_plan/mod/model_file.h"
+#include <memory>
+#include <string>
+
+namespace ModelStore {
+
+/**
+ * Get the shared memory object name used for a key.
+ * Keys must be non-empty and can't contain '/'.
+ *
+ * @param key The model key
+ *
+ * @returns The shared memory object name
+ */
+std::string objectName(const std::string &key);
+
+/**
+ * Publish an IMac model under a key. Throws if the key is already in use.
+ *
+ * @param key The model key
+ * @param imac The IMac to publish
+ */
+void publishIMac(const std::string &key, const IMac &imac);
+
+/**
+ * Publish a BIMac model under a key. Throws if the key is already in use.
+ *
+ * @param key The model key
+ * @param bimac The BIMac to publish
+ */
+void publishBIMac(const std::string &key, const BIMac &bimac);
+
+/**
+ * Check if a model has been published under a key.
+ *
+ * @param key The model key
+ *
+ * @returns True if the key is in use
+ */
+bool contains(const std::string &key);
+
+/**
+ * Map a published model read-only. Its matrices can be viewed without
+ * copying using doubleArray and intArray. Throws if there is no valid model
+ * under the key.
+ *
+ * @param key The model key
+ *
+ * @returns The mapped model, which stays valid even if the key is removed
+ */
+std::shared_ptr<const MappedModelFile> map(const std::string &key);
+
+/**
+ * Construct an IMac from a published model, avoiding any CSV parsing.
+ * The matrices are copied out of the shared pages.
+ *
+ * @param key The model key
+ *
+ * @returns The IMac
+ */
+std::shared_ptr<IMac> loadIMac(const std::string &key);
+
+/**
+ * Construct a BIMac from a published model, avoiding any CSV parsing.
+ * The matrices are copied out of the shared pages.
+ *
+ * @param key The model key
+ *
+ * @returns The BIMac
+ */
+std::shared_ptr<BIMac> loadBIMac(const std::string &key);
+
+/**
+ * Remove a model from the store. Processes which already mapped it keep
+ * their mapping. Does nothing if the key isn't in use.
+ *
+ * @param key The model key
+ */
+void remove(const std::string &key);
+
+} // namespace ModelStore
+
+#endif
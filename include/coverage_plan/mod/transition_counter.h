@@ -0,0 +1,121 @@
+/**
+ * @file transition_counter.h
+ *
+ * @brief Header file for the TransitionCounter class.
+ *
+ * TransitionCounter accumulates the BIMac observation counts for an episode as
+ * each timestep's observations arrive, so the robot doesn't have to keep the
+ * full observation history.
+ *
+ * @author Charlie Street
+ */
+#ifndef TRANSITION_COUNTER_H
+#define TRANSITION_COUNTER_H
+
+#include "coverage_plan/mod/bimac.h"
+#include "coverage_plan/mod/imac_executor.h"
+#include <vector>
+
+/**
+ * Dense per-cell counters for the BIMac observations of an episode.
+ *
+ * The first batch of observations after construction or reset() counts
+ * towards the initial state counts. Every later batch counts a transition for
+ * each cell which was also observed in the batch before it. Out of bounds
+ * observations are ignored, and if a cell appears more than once in a batch,
+ * the last value is used for transitions (as with a map keyed on the cell).
+ *
+ * Each batch costs O(batch size), and memory is O(cells) regardless of the
+ * episode length. Cells are indexed as x * yDim + y, which matches the
+ * ordering of GridCell.
+ *
+ * Members:
+ * * _xDim: The x dimension of the map
+ * * _yDim: The y dimension of the map
+ * * _step: The step number of the most recent batch
+ * * _firstStep: The step number of the first batch since the last reset
+ * * _counts: The BIMac observation counts for each cell
+ * * _lastStep: The last step each cell was observed in
+ * * _lastValue: The value of each cell when last observed
+ * * _prevStep: The step each cell was observed in before _lastStep
+ * * _prevValue: The value of each cell at _prevStep
+ * * _counted: Whether each cell has an entry in _touched
+ * * _touched: The cells with non-zero counts (in no particular order)
+ */
+class TransitionCounter {
+private:
+  int _xDim{};
+  int _yDim{};
+  long _step{};
+  long _firstStep{};
+  std::vector<BIMacObservation> _counts{};
+  std::vector<long> _lastStep{};
+  std::vector<int> _lastValue{};
+  std::vector<long> _prevStep{};
+  std::vector<int> _prevValue{};
+  std::vector<bool> _counted{};
+  std::vector<int> _touched{};
+
+  /**
+   * Add (or remove) a transition count for a cell.
+   *
+   * @param idx The cell index
+   * @param prevState The previous state of the cell
+   * @param nextState The new state of the cell
+   * @param inc The amount to add to the count
+   */
+  void _countTransition(int idx, int prevState, int nextState, int inc);
+
+  /**
+   * Record that a cell has non-zero counts.
+   *
+   * @param idx The cell index
+   */
+  void _touch(int idx);
+
+public:
+  /**
+   * Allocates the counters for a map.
+   *
+   * @param xDim The x dimension of the map
+   * @param yDim The y dimension of the map
+   */
+  TransitionCounter(int xDim, int yDim);
+
+  /**
+   * Returns the x dimension of the map.
+   *
+   * @returns The x dimension
+   */
+  int xDim() const { return this->_xDim; }
+
+  /**
+   * Returns the y dimension of the map.
+   *
+   * @returns The y dimension
+   */
+  int yDim() const { return this->_yDim; }
+
+  /**
+   * Clear all counts, ready for a new episode.
+   * Costs O(cells observed) rather than O(cells).
+   */
+  void reset();
+
+  /**
+   * Add the observations made at the next timestep.
+   *
+   * @param observations The observations made at this timestep
+   */
+  void addObservations(const std::vector<IMacObservation> &observations);
+
+  /**
+   * Get the accumulated counts as a batch of BIMac observations.
+   * Only cells with non-zero counts are included, in GridCell order.
+   *
+   * @returns A vector of BIMacObservations
+   */
+  std::vector<BIMacObservation> getBIMacObservations() const;
+};
+
+#endif
@@ -9,15 +9,16 @@
 #ifndef COVERAGE_BELIEF_H
 #define COVERAGE_BELIEF_H
 
+#include "coverage_plan/mod/bit_grid.h"
 #include "coverage_plan/mod/grid_cell.h"
 #include "coverage_plan/mod/imac.h"
 #include "coverage_plan/mod/imac_belief_sampler.h"
+#include "coverage_plan/planning/coverage_observation.h"
 #include <Eigen/Dense>
 #include <despot/core/globals.h>
 #include <despot/interface/belief.h>
 #include <despot/interface/pomdp.h>
 #include <memory>
-#include <set>
 #include <string>
 #include <vector>
 
@@ -30,11 +31,13 @@
  * Members:
  * * _robotPosititon: The robot's position
  * * _time: The current time
- * * _covered: The locations covered by the robot
+ * * _covered: The locations covered by the robot (one bit per cell, padded
+ * as in CoverageState so sampled particles can share it)
  * * _mapBelief: A distribution over the occupancy map
  * * _imac: The IMac model
  * * _fov: The robot's FOV represented as a vector of GridCells relative to the
  * * robot's position
+ * * _obsCodec: Decodes observations (shared with the POMDP for wide FOVs)
  * * _beliefSampler: A pointer to an IMacBeliefSampler object required for
  * sampling
  */
@@ -43,10 +46,11 @@ class CoverageBelief : public despot::Belief {
 private:
   GridCell _robotPosition{};
   int _time{};
-  std::set<GridCell> _covered{};
+  BitGrid _covered{};
   Eigen::MatrixXd _mapBelief{};
   std::shared_ptr<IMac> _imac{};
   const std::vector<GridCell> _fov{};
+  const ObservationCodec _obsCodec;
   std::unique_ptr<IMacBeliefSampler> _beliefSampler{};
 
 public:
@@ -56,18 +60,40 @@ public:
    * @param model The POMDP model containing the memory pool
    * @param initPos The robot's initial position
    * @param initTime The initial time
-   * @param initCovered The initially covered vertices
+   * @param initCovered The initially covered cells
    * @param initBelief The initial map belief
    * @param imac The IMac model used for planning
    * @param fov The robot's FOV as a vector of relative grid cells
    */
   CoverageBelief(const despot::DSPOMDP *model, const GridCell &initPos,
-                 const int &initTime, const std::set<GridCell> &initCovered,
+                 const int &initTime, const BitGrid &initCovered,
                  const Eigen::MatrixXd &initBelief, std::shared_ptr<IMac> imac,
                  const std::vector<GridCell> &fov)
+      : CoverageBelief{model, initPos, initTime, initCovered, initBelief, imac,
+                       ObservationCodec{fov, (int)initBelief.rows(),
+                                        (int)initBelief.cols()}} {}
+
+  /**
+   * Initialise all attributes, sharing an observation codec.
+   * Beliefs for wide FOVs must share the codec of the POMDP which encodes
+   * their observations.
+   *
+   * @param model The POMDP model containing the memory pool
+   * @param initPos The robot's initial position
+   * @param initTime The initial time
+   * @param initCovered The initially covered cells
+   * @param initBelief The initial map belief
+   * @param imac The IMac model used for planning
+   * @param obsCodec The codec for the robot's FOV
+   */
+  CoverageBelief(const despot::DSPOMDP *model, const GridCell &initPos,
+                 const int &initTime, const BitGrid &initCovered,
+                 const Eigen::MatrixXd &initBelief, std::shared_ptr<IMac> imac,
+                 const ObservationCodec &obsCodec)
       : Belief{model}, _robotPosition{initPos}, _time{initTime},
-        _covered{initCovered}, _mapBelief{initBelief}, _imac{imac}, _fov{fov},
-        _beliefSampler{std::make_unique<IMacBeliefSampler>()} {}
+        _covered{BitGrid::padded(initCovered, true)}, _mapBelief{initBelief},
+        _imac{imac}, _fov{obsCodec.getFOV()}, _obsCodec{obsCodec},
+        _beliefSampler{std::make_unique<IMacBeliefSampler>(imac)} {}
 
   ~CoverageBelief() {}
 
@@ -106,9 +132,9 @@ public:
   /**
    * Return the occupancy map belief.
    *
-   * @returns The occupancy map belief
+   * @returns A reference to the occupancy map belief
    */
-  Eigen::MatrixXd getMapBelief() const;
+  const Eigen::MatrixXd &getMapBelief() const;
 };
 
 #endif
\ No newline at end of file
@@ -11,6 +11,8 @@
 
 #include "coverage_plan/mod/imac.h"
 #include "coverage_plan/planning/action.h"
+#include "coverage_plan/planning/scenario_batch.h"
+#include "coverage_plan/planning/transposition_table.h"
 #include "coverage_plan/util/seed.h"
 #include <Eigen/Dense>
 #include <despot/core/globals.h>
@@ -82,18 +84,71 @@ public:
 /**
  * A default policy which greedily chooses action based on immediate reward.
  *
+ * Rollouts step the particles in a ScenarioBatch (see
+ * CoveragePOMDP::StepBatch) rather than one CoverageState at a time. They
+ * otherwise follow DESPOT's DefaultPolicy exactly, so give the same values.
+ *
  * Attributes:
  * As in superclass, plus:
- * * _ imacEntry: The IMac entry matrix
- * * _imacExit: The IMac exit matrix
+ * * _imac: The IMac instance, whose entry and exit matrices are read in place
+ * * _table: If not nullptr, memoises rollout values within a search
+ * * _particleLowerBound: The bound used at the leaves of rollouts
+ * * _batch: The particles of the current rollout, reused between rollouts
  *
  */
 class GreedyCoverageDefaultPolicy : public despot::DefaultPolicy {
 
 private:
-  const Eigen::MatrixXd _imacEntry{};
-  const Eigen::MatrixXd _imacExit{};
+  const std::shared_ptr<IMac> _imac{};
   mutable std::mt19937_64 _rng{};
+  const std::shared_ptr<TranspositionTable> _table{};
+  despot::ParticleLowerBound *_particleLowerBound{};
+  mutable ScenarioBatch _batch{};
+
+  /**
+   * Rolls out the policy on some of the particles in _batch, as in DESPOT's
+   * DefaultPolicy::RecursiveValue.
+   *
+   * @param active The indices of the particles in _batch to roll out
+   * @param streams Random streams attached to the scenarios
+   * @param history The current action-observation history
+   * @param initialDepth The history size at the start of the rollout
+   *
+   * @returns The first rollout action and the rollout value
+   */
+  despot::ValuedAction _rollout(const std::vector<int> &active,
+                                despot::RandomStreams &streams,
+                                despot::History &history,
+                                int initialDepth) const;
+
+  /**
+   * Evaluates the particle lower bound at the leaf of a rollout.
+   *
+   * @param active The indices of the particles in _batch at the leaf
+   *
+   * @returns The lower bound's action and value
+   */
+  despot::ValuedAction _leafValue(const std::vector<int> &active) const;
+
+  /**
+   * Greedily chooses an action weighted on some of the particles in _batch,
+   * as in Action.
+   *
+   * @param active The indices of the particles in _batch
+   *
+   * @returns The chosen action
+   */
+  despot::ACT_TYPE _batchAction(const std::vector<int> &active) const;
+
+  /**
+   * Chooses uniformly at random between the actions with the best weighted
+   * immediate reward.
+   *
+   * @param immRewards The weighted immediate reward of each action
+   *
+   * @returns The chosen action
+   */
+  despot::ACT_TYPE _chooseAction(const std::vector<double> &immRewards) const;
 
 public:
   /**
@@ -102,13 +157,32 @@ public:
    * @param model The POMDP
    * @param particleLowerBound A lower bound on the cumulative reward
    * @param imac An IMac instance
+   * @param table A table to memoise rollout values in (default nullptr). The
+   * owner must clear it between searches
+   */
+  GreedyCoverageDefaultPolicy(
+      const despot::DSPOMDP *model,
+      despot::ParticleLowerBound *particleLowerBound,
+      const std::shared_ptr<IMac> &imac,
+      const std::shared_ptr<TranspositionTable> &table = nullptr)
+      : DefaultPolicy{model, particleLowerBound}, _imac{imac},
+        _rng{SeedHelpers::genRandomDeviceSeed()}, _table{table},
+        _particleLowerBound{particleLowerBound} {}
+
+  /**
+   * Estimates the value of a set of particles by rolling out the policy.
+   * If a table is set, the particles' rollout value is reused if the same
+   * particle set has already been rolled out in this search.
+   *
+   * @param particles The states at the head of the scenarios
+   * @param streams Random streams attached to the scenarios
+   * @param history The current action-observation history
+   *
+   * @returns The first rollout action and the rollout value
    */
-  GreedyCoverageDefaultPolicy(const despot::DSPOMDP *model,
-                              despot::ParticleLowerBound *particleLowerBound,
-                              std::shared_ptr<IMac> imac)
-      : DefaultPolicy{model, particleLowerBound},
-        _imacEntry{imac->getEntryMatrix()}, _imacExit{imac->getExitMatrix()},
-        _rng{SeedHelpers::genRandomDeviceSeed()} {}
+  despot::ValuedAction Value(const std::vector<despot::State *> &particles,
+                             despot::RandomStreams &streams,
+                             despot::History &history) const;
 
   /**
    * Function greedily chooses an action weighted on the particles.
@@ -12,15 +12,73 @@
 #ifndef COVERAGE_OBSERVATION_H
 #define COVERAGE_OBSERVATION_H
 
+#include "coverage_plan/mod/bit_grid.h"
 #include "coverage_plan/mod/grid_cell.h"
 #include "coverage_plan/mod/imac_executor.h"
 #include "coverage_plan/planning/action.h"
+#include "coverage_plan/planning/fov_kernels.h"
+#include <Eigen/Dense>
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <despot/core/globals.h>
+#include <memory>
 #include <tuple>
 #include <vector>
 
 namespace Observation {
 
+/**
+ * The largest FOV which fits directly in an observation. Wider FOVs are
+ * encoded by ObservationCodec.
+ */
+constexpr int kMaxDirectFOVSize{63};
+
+/**
+ * Returns the action success flag from an observation.
+ * This works for wide observations from ObservationCodec too.
+ *
+ * @param obsInt The observation as an integer
+ * @param fovSize The number of cells in the robot's FOV
+ *
+ * @returns True if the action succeeded
+ */
+inline bool actionSucceeded(const despot::OBS_TYPE &obsInt, int fovSize) {
+  return ((obsInt >> std::min(fovSize, kMaxDirectFOVSize)) & 1) == 1;
+}
+
+/**
+ * Returns whether a cell in the FOV was observed as occupied.
+ *
+ * @param obsInt The observation as an integer
+ * @param fovSize The number of cells in the robot's FOV
+ * @param index The index of the cell in the FOV
+ *
+ * @returns 1 if the cell was occupied, else 0
+ */
+inline int cellOccupied(const despot::OBS_TYPE &obsInt, int fovSize,
+                        int index) {
+  return (int)((obsInt >> ((fovSize - 1) - index)) & 1);
+}
+
+/**
+ * Converts a uint64_t representing an observation into IMacObservations,
+ * writing into an existing vector so its storage can be reused.
+ *
+ * @param obsInt The observation as an integer
+ * @param fov The robot's field of view as a vector of relative grid cells
+ * @param robotPos The robot's current position, used to make the observed
+ * cells absolute
+ * @param obsVector Overwritten with the observations in FOV order
+ *
+ * @returns The action success flag
+ *
+ * @exception tooManyCells Raised if > 63 cells in FOV (see ObservationCodec
+ * for wider FOVs)
+ */
+bool decode(const despot::OBS_TYPE &obsInt, const std::vector<GridCell> &fov,
+            const GridCell &robotPos, std::vector<IMacObservation> &obsVector);
+
 /**
  * Converts a uint64_t representing an observation into a vector of
  * IMacObservations.
@@ -38,7 +96,8 @@ namespace Observation {
  * @returns A vector of observations capturing the robot's absolute
  * observation paired with an action success flag
  *
- * @exception tooManyCells Raised if > 63 cells in FOV
+ * @exception tooManyCells Raised if > 63 cells in FOV (see ObservationCodec
+ * for wider FOVs)
  */
 std::pair<std::vector<IMacObservation>, bool>
 fromObsType(const despot::OBS_TYPE &obsInt, const std::vector<GridCell> &fov,
@@ -54,7 +113,8 @@ fromObsType(const despot::OBS_TYPE &obsInt, const std::vector<GridCell> &fov,
  *
  * @returns The observation as an integer
  *
- * @exception tooManyCells Raised if > 63 cells in FOV
+ * @exception tooManyCells Raised if > 63 cells in FOV (see ObservationCodec
+ * for wider FOVs)
  */
 despot::OBS_TYPE toObsType(const std::vector<IMacObservation> &obsVector,
                            const ActionOutcome &outcome);
@@ -74,5 +134,347 @@ despot::OBS_TYPE computeObservation(const Eigen::MatrixXi &map,
                                     const ActionOutcome &outcome,
                                     const std::vector<GridCell> &fov);
 
+/**
+ * Compute the observation given a bit packed map, robot position and fov.
+ *
+ * @param map The BitGrid capturing the state of the environment
+ * @param robotPos The robot's position
+ * @param outcome The action outcome
+ * @param fov The robot's field of view as a vector of relative grid cells
+ *
+ * @returns The observation as a number
+ */
+despot::OBS_TYPE computeObservation(const BitGrid &map,
+                                    const GridCell &robotPos,
+                                    const ActionOutcome &outcome,
+                                    const std::vector<GridCell> &fov);
+
+/**
+ * Checks if an observation's map cells match a map, ignoring the action
+ * success flag. Cells outside the map must be observed as occupied.
+ *
+ * @param obsInt The observation as an integer
+ * @param map The BitGrid capturing the state of the environment
+ * @param robotPos The robot's position
+ * @param fov The robot's field of view as a vector of relative grid cells
+ *
+ * @returns True if every FOV cell matches the map
+ */
+bool matchesMap(const despot::OBS_TYPE &obsInt, const BitGrid &map,
+                const GridCell &robotPos, const std::vector<GridCell> &fov);
+
 } // namespace Observation
+
+/**
+ * Stores the cell bits of recorded wide observations (see ObservationCodec).
+ * Defined in coverage_observation.cpp.
+ */
+class WideObservationTable;
+
+/**
+ * Encodes and checks observations for one FOV and map size at the bit level.
+ *
+ * The bit offset of each FOV cell from the robot's bit in a BitGrid is
+ * computed once. When the whole FOV is inside the map, a cell is read
+ * straight from the map's storage words, without any bounds checks. Padded
+ * maps with an occupied border (e.g. in CoverageStates) extend this to FOV
+ * cells in the border, so the standard FOV shapes never need bounds checks.
+ * Otherwise near the border, each cell is bounds checked as in
+ * Observation::computeObservation. Maps of other sizes are also handled with
+ * bounds checks.
+ *
+ * FOVs of up to 63 cells are encoded as in Observation::toObsType. Wider
+ * FOVs (e.g. a 9x9 window) don't fit in an OBS_TYPE, so the observation's
+ * top bit is the action success flag, and the rest is a 63 bit hash of the
+ * cell bits. Distinct cell bits collide with negligible probability (around
+ * n^2 / 2^64 for n distinct observations). encode and matches only hash, so
+ * they are side effect free, and the search never changes the codec.
+ *
+ * Decoding a wide observation needs its cell bits, so observations which
+ * are decoded or applied to a belief (i.e. the real ones, from CoverageWorld
+ * and the initial observation) must be encoded with record, which stores
+ * them in a table. Copies of a codec share the table, so every object which
+ * handles the same observations (e.g. the POMDP, world, and belief) should
+ * use copies of one codec. The table grows by at most one entry per real
+ * step, and is cleared between episodes (see CoveragePOMDP::InitialBelief).
+ * record changes the shared table even though it is const, so it isn't
+ * thread safe, even across copies.
+ *
+ * Members:
+ * * _fov: The robot's field of view as a vector of relative grid cells
+ * * _rows: The number of rows in the map the offsets are computed for
+ * * _cols: The number of columns in the map the offsets are computed for
+ * * _offsets: The bit offset of each FOV cell from the robot's bit
+ * * _paddedOffsets: As _offsets, for padded maps (see BitGrid::padded())
+ * * _minX, _maxX, _minY, _maxY: The bounding box of the FOV
+ * * _cellMask: The mask of the map bits in a narrow observation
+ * * _wideTable: The table of recorded wide observations, or nullptr for
+ * narrow FOVs
+ * * _shape: The FOV's shape, if it has a specialised kernel (see
+ * fov_kernels.h)
+ */
+class ObservationCodec {
+public:
+  /**
+   * The largest FOV supported, in 64 bit words (i.e. 1024 cells).
+   */
+  static constexpr int kMaxWideWords{16};
+
+private:
+  /**
+   * The mask of the cell bits' key in a wide observation.
+   */
+  static constexpr despot::OBS_TYPE kWideKeyMask{
+      ~(despot::OBS_TYPE{1} << 63)};
+
+  std::vector<GridCell> _fov{};
+  int _rows{};
+  int _cols{};
+  std::vector<int> _offsets{};
+  std::vector<int> _paddedOffsets{};
+  int _minX{};
+  int _maxX{};
+  int _minY{};
+  int _maxY{};
+  despot::OBS_TYPE _cellMask{};
+  std::shared_ptr<WideObservationTable> _wideTable{};
+  FOVKernels::Shape _shape{};
+
+  /**
+   * Checks if the whole FOV is inside a map with the precomputed offsets.
+   *
+   * @param rows The number of rows in the map
+   * @param cols The number of columns in the map
+   * @param padding The width of an occupied border around the map, which can
+   * be read in place of cells off the map
+   * @param robotPos The robot's position
+   *
+   * @returns True if the offsets can be used without bounds checks
+   */
+  bool _fastPath(int rows, int cols, int padding,
+                 const GridCell &robotPos) const {
+    return rows == this->_rows && cols == this->_cols &&
+           robotPos.x + this->_minX >= -padding &&
+           robotPos.x + this->_maxX < this->_cols + padding &&
+           robotPos.y + this->_minY >= -padding &&
+           robotPos.y + this->_maxY < this->_rows + padding;
+  }
+
+  /**
+   * Checks if the whole FOV can be read from a BitGrid without bounds checks.
+   * For a padded map with an occupied border, this holds for the standard
+   * FOV shapes wherever the robot is.
+   *
+   * @param map A view of the map capturing the state of the environment
+   * @param robotPos The robot's position
+   *
+   * @returns True if the offsets can be used without bounds checks
+   */
+  bool _fastPath(const BitGridView &map, const GridCell &robotPos) const {
+    return this->_fastPath(map.rows(), map.cols(),
+                           map.border() ? map.padding() : 0, robotPos);
+  }
+
+  /**
+   * Returns the precomputed offsets for a map's layout.
+   *
+   * @param map A view of the map capturing the state of the environment
+   *
+   * @returns _paddedOffsets if map is padded, else _offsets
+   */
+  const std::vector<int> &_offsetsFor(const BitGridView &map) const {
+    return map.padding() > 0 ? this->_paddedOffsets : this->_offsets;
+  }
+
+  /**
+   * Computes the map bits of a narrow observation.
+   *
+   * @param map A view of the map capturing the state of the environment
+   * @param robotPos The robot's position
+   *
+   * @returns The FOV cells in observation order, without the success flag
+   */
+  despot::OBS_TYPE _cellBits(const BitGridView &map,
+                             const GridCell &robotPos) const;
+
+  /**
+   * Gathers the map bits of a wide observation. FOV cell i is written to bit
+   * i % 64 of word i / 64.
+   *
+   * @param map A view of the map capturing the state of the environment
+   * @param robotPos The robot's position
+   * @param words Overwritten with the cell bits
+   */
+  void _gather(const BitGridView &map, const GridCell &robotPos,
+               std::array<uint64_t, kMaxWideWords> &words) const;
+
+  /**
+   * Computes the key of a wide observation's cell bits.
+   *
+   * @param words The cell bits, laid out as in _gather
+   *
+   * @returns A 63 bit hash of the cell bits
+   */
+  despot::OBS_TYPE
+  _wideKey(const std::array<uint64_t, kMaxWideWords> &words) const;
+
+  /**
+   * Returns the recorded cell bits of a wide observation.
+   *
+   * @param obsInt The observation as an integer
+   *
+   * @returns A pointer to the cell bits, laid out as in _gather
+   *
+   * @exception unknownObservation Raised if obsInt wasn't recorded by this
+   * codec (or a copy)
+   */
+  const uint64_t *_widePattern(const despot::OBS_TYPE &obsInt) const;
+
+public:
+  /**
+   * Constructor precomputes the FOV offsets.
+   *
+   * @param fov The robot's field of view as a vector of relative grid cells
+   * @param rows The number of rows in the map
+   * @param cols The number of columns in the map
+   *
+   * @exception tooManyCells Raised if > 1024 cells in FOV
+   */
+  ObservationCodec(const std::vector<GridCell> &fov, int rows, int cols);
+
+  /**
+   * Returns whether the FOV is too wide to fit directly in an observation.
+   *
+   * @returns True if observations hold a hash of their cell bits
+   */
+  bool isWide() const { return this->_wideTable != nullptr; }
+
+  /**
+   * Forgets every recorded wide observation, in every copy of the codec.
+   * Observations recorded before the call can no longer be decoded, so this
+   * must only be called when nothing holds them (e.g. between episodes).
+   * Does nothing for narrow FOVs.
+   */
+  void clearWideObservations() const;
+
+  /**
+   * Returns the number of distinct wide observations recorded.
+   *
+   * @returns The size of the wide observation table, or 0 for narrow FOVs
+   */
+  uint64_t numWideObservations() const;
+
+  /**
+   * Returns the robot's field of view.
+   *
+   * @returns The FOV as a vector of relative grid cells
+   */
+  const std::vector<GridCell> &getFOV() const { return this->_fov; }
+
+  /**
+   * Compute the observation given a bit packed map and robot position.
+   * For narrow FOVs, this matches Observation::computeObservation. Wide
+   * observations can be checked with matches, but can't be decoded unless
+   * they are also recorded (see record).
+   *
+   * @param map A view of the map capturing the state of the environment
+   * @param robotPos The robot's position
+   * @param success The action success flag
+   *
+   * @returns The observation as a number
+   */
+  despot::OBS_TYPE encode(const BitGridView &map, const GridCell &robotPos,
+                          bool success) const;
+
+  /**
+   * Computes an observation as in encode, and records a wide observation's
+   * cell bits in the table shared by every copy of the codec, so it can be
+   * decoded. This isn't thread safe, so is only for real observations.
+   *
+   * @param map A view of the map capturing the state of the environment
+   * @param robotPos The robot's position
+   * @param success The action success flag
+   *
+   * @returns The observation as a number, equal to encode's
+   *
+   * @exception hashCollision Raised if different cell bits were recorded
+   * with the same hash
+   */
+  despot::OBS_TYPE record(const BitGridView &map, const GridCell &robotPos,
+                          bool success) const;
+
+  /**
+   * Checks if an observation's map cells match a map, ignoring the action
+   * success flag. For narrow FOVs, this matches Observation::matchesMap.
+   *
+   * @param obsInt The observation as an integer
+   * @param map A view of the map capturing the state of the environment
+   * @param robotPos The robot's position
+   *
+   * @returns True if every FOV cell matches the map
+   */
+  bool matches(const despot::OBS_TYPE &obsInt, const BitGridView &map,
+               const GridCell &robotPos) const;
+
+  /**
+   * Returns the action success flag from an observation.
+   *
+   * @param obsInt The observation as an integer
+   *
+   * @returns True if the action succeeded
+   */
+  bool actionSucceeded(const despot::OBS_TYPE &obsInt) const {
+    return Observation::actionSucceeded(obsInt, (int)this->_fov.size());
+  }
+
+  /**
+   * Returns whether a cell in the FOV was observed as occupied.
+   *
+   * @param obsInt The observation as an integer
+   * @param index The index of the cell in the FOV
+   *
+   * @returns 1 if the cell was occupied, else 0   *
+   * @exception unknownObservation Raised if a wide obsInt wasn't recorded by
+   * this codec (or a copy)
+   */
+  int cellOccupied(const despot::OBS_TYPE &obsInt, int index) const;
+
+  /**
+   * Sets the cells seen in an observation in a map belief, to 1 if occupied
+   * and 0 if free. Cells outside the map are skipped.
+   *
+   * @param obsInt The observation as an integer
+   * @param robotPos The robot's position when the observation was made
+   * @param mapBelief The map belief to write the observed cells into   *
+   * @exception unknownObservation Raised if a wide obsInt wasn't recorded by
+   * this codec (or a copy)
+   */
+  void applyObservation(const despot::OBS_TYPE &obsInt,
+                        const GridCell &robotPos,
+                        Eigen::MatrixXd &mapBelief) const;
+
+  /**
+   * Returns the FOV's shape, if it has a specialised kernel.
+   *
+   * @returns The FOV's shape, or FOVKernels::Shape::generic
+   */
+  FOVKernels::Shape getShape() const { return this->_shape; }
+
+  /**
+   * Converts an observation into IMacObservations, writing into an existing
+   * vector so its storage can be reused.
+   *
+   * @param obsInt The observation as an integer
+   * @param robotPos The robot's current position, used to make the observed
+   * cells absolute
+   * @param obsVector Overwritten with the observations in FOV order
+   *
+   * @returns The action success flag   *
+   * @exception unknownObservation Raised if a wide obsInt wasn't recorded by
+   * this codec (or a copy)
+   */
+  bool decode(const despot::OBS_TYPE &obsInt, const GridCell &robotPos,
+              std::vector<IMacObservation> &obsVector) const;
+};
+
 #endif
\ No newline at end of file
@@ -13,13 +13,16 @@
 #define COVERAGE_POMDP_H
 
 #include "coverage_plan/mod/imac.h"
-#include "coverage_plan/mod/imac_belief_sampler.h"
 #include "coverage_plan/planning/coverage_bounds.h"
+#include "coverage_plan/planning/coverage_observation.h"
 #include "coverage_plan/planning/coverage_state.h"
+#include "coverage_plan/planning/scenario_batch.h"
+#include "coverage_plan/planning/transposition_table.h"
 #include <despot/interface/default_policy.h>
 #include <despot/interface/lower_bound.h>
 #include <despot/interface/pomdp.h>
 #include <despot/interface/upper_bound.h>
+#include <despot/random_streams.h>
 #include <despot/util/memorypool.h>
 #include <memory>
 #include <string>
@@ -33,16 +36,18 @@
  * * _fov: A vector of GridCells relative to the robot's position which capture
  * its FOV.
  * * _imac: The IMac instance used for planning
- * * _beliefSampler: The IMac belief sampler used for the simulator
  * * _timeBound: The planning horizon in timesteps
+ * * _transpositionTable: Memoises default policy values within a search
+ * * _obsCodec: Encodes and checks observations against maps at the bit level
  */
 class CoveragePOMDP : public despot::DSPOMDP {
 private:
   mutable despot::MemoryPool<CoverageState> _memoryPool{};
   const std::vector<GridCell> _fov{};
   std::shared_ptr<IMac> _imac{};
-  std::unique_ptr<IMacBeliefSampler> _beliefSampler{};
   const int _timeBound{};
+  std::shared_ptr<TranspositionTable> _transpositionTable{};
+  const ObservationCodec _obsCodec;
 
 public:
   /**
@@ -56,8 +61,35 @@ public:
   CoveragePOMDP(const std::vector<GridCell> &fov, std::shared_ptr<IMac> imac,
                 int timeBound)
       : despot::DSPOMDP{}, _memoryPool{}, _fov{fov}, _imac{imac},
-        _timeBound{timeBound}, _beliefSampler{
-                                   std::make_unique<IMacBeliefSampler>()} {}
+        _timeBound{timeBound},
+        _transpositionTable{std::make_shared<TranspositionTable>()},
+        _obsCodec{fov, imac ? (int)imac->getEntryMatrix().rows() : 0,
+                  imac ? (int)imac->getEntryMatrix().cols() : 0} {}
+
+  /**
+   * Empties the table used by the GREEDY lower bound to memoise rollouts.
+   * This must be called before each search, as DESPOT resamples scenarios.
+   */
+  void clearTranspositionTable() { this->_transpositionTable->clear(); }
+
+  /**
+   * Returns the table used by the GREEDY lower bound to memoise rollouts.
+   *
+   * @returns The transposition table
+   */
+  const std::shared_ptr<TranspositionTable> &getTranspositionTable() const {
+    return this->_transpositionTable;
+  }
+
+  /**
+   * Returns the codec used to encode observations.
+   * Objects handling this POMDP's observations should use copies of it.
+   *
+   * @returns The observation codec
+   */
+  const ObservationCodec &getObservationCodec() const {
+    return this->_obsCodec;
+  }
 
   /**
    * The deterministic simulative model for the POMDP.
@@ -78,6 +110,21 @@ public:
   bool Step(despot::State &state, double random_num, despot::ACT_TYPE action,
             double &reward, despot::OBS_TYPE &obs) const;
 
+  /**
+   * Steps a set of particles in a batch under the same action, in place.
+   * Each particle is stepped exactly as Step would step it with its
+   * scenario's current random number, and the rewards, observations and
+   * terminal flags are written into the batch's output arrays.
+   *
+   * @param batch The particles, updated with their successor states
+   * @param active The indices of the particles in batch to step
+   * @param streams Random streams attached to the scenarios
+   * @param action The action to be executed
+   */
+  void StepBatch(ScenarioBatch &batch, const std::vector<int> &active,
+                 const despot::RandomStreams &streams,
+                 despot::ACT_TYPE action) const;
+
   /**
    * Returns the number of actions.
    * Makes the assumption that all actions are enabled at each state (not
@@ -105,6 +152,9 @@ public:
 
   /**
    * Return the initial belief, which corresponds to the initial IMac belief.
+   * This starts a new episode, so clears the table of wide observations (see
+   * ObservationCodec). Beliefs and histories from previous episodes can't be
+   * used afterwards.
    *
    * @param start A (partial) initial state, e.g. the robot's initial position
    * @param type A parameter which allows to specify the type of the belief
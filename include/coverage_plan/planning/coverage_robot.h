@@ -19,9 +19,9 @@
 #include "coverage_plan/mod/grid_cell.h"
 #include "coverage_plan/mod/imac.h"
 #include "coverage_plan/mod/imac_executor.h"
+#include "coverage_plan/mod/transition_counter.h"
 #include "coverage_plan/planning/action.h"
 #include <filesystem>
-#include <map>
 #include <memory>
 #include <vector>
 
@@ -63,6 +63,7 @@ struct CoverageResult {
  * * _groundTruthIMac: The ground truth IMac model, if specified
  * * _estimationType: The type of parameter estimation for each episode's IMac
  * instance
+ * * _transitionCounter: Accumulates the BIMac observations during an episode
  */
 class CoverageRobot {
 private:
@@ -73,6 +74,7 @@ private:
   std::shared_ptr<BIMac> _bimac{};
   std::shared_ptr<IMac> _groundTruthIMac{};
   const ParameterEstimate _estimationType{};
+  TransitionCounter _transitionCounter;
 
   /**
    * Function gets the IMac instance to be used for an episode.
@@ -82,38 +84,6 @@ private:
    */
   virtual std::shared_ptr<IMac> _getIMacInstanceForEpisode();
 
-  /**
-   * Helper function to add an initial state observation to a BIMacObservation.
-   *
-   * @param biMacObsMap a map from grid cells to corresponding BIMacObservations
-   * @param obs an IMacObservation for time t=0
-   */
-  void _addInitObservation(std::map<GridCell, BIMacObservation> &biMacObsMap,
-                           const IMacObservation &obs);
-
-  /**
-   * Helper function to add IMac transition observation to a BIMacObservation.
-   *
-   * @param biMacObsMap a map from grid cells to corresponding BIMacObservations
-   * @param cell The grid cell the observation is for
-   * @param prevState The previous state of the grid cell
-   * @param nextState The new state of the grid cell
-   */
-  void
-  _addTransitionObservation(std::map<GridCell, BIMacObservation> &biMacObsMap,
-                            const GridCell &cell, const int &prevState,
-                            const int &nextState);
-
-  /**
-   * Converts IMacObservation vectors into a BIMacObservation vector.
-   *
-   * @param observations a vector of IMacObservation vectors
-   *
-   * @returns A vector of BIMacObservations
-   */
-  std::vector<BIMacObservation> _generateBIMacObservations(
-      const std::vector<std::vector<IMacObservation>> &observations);
-
   /**
    * Returns a vector of actions that can be executed from the current location.
    *
@@ -152,7 +122,7 @@ protected:
    */
   virtual Action _planFn(const GridCell &currentLoc,
                          const std::vector<Action> &enabledActions, int ts,
-                         int timeBound, std::shared_ptr<IMac> imac,
+                         int timeBound, const std::shared_ptr<IMac> &imac,
                          const std::vector<GridCell> &visited,
                          const std::vector<IMacObservation> &currentObs) = 0;
 
@@ -201,7 +171,8 @@ public:
       : _initLoc{initLoc}, _currentLoc{initLoc}, _visited{},
         _timeBound{timeBound}, _xDim{xDim}, _yDim{yDim},
         _bimac{std::make_shared<BIMac>(xDim, yDim)},
-        _groundTruthIMac{groundTruthIMac}, _estimationType{estimationType} {}
+        _groundTruthIMac{groundTruthIMac}, _estimationType{estimationType},
+        _transitionCounter{xDim, yDim} {}
 
   /**
    * Wrapper around _planFn which fills in the gaps from class members.
@@ -212,7 +183,7 @@ public:
    *
    * @returns The next action for the robot to execute
    */
-  Action planNextAction(int time, std::shared_ptr<IMac> imac,
+  Action planNextAction(int time, const std::shared_ptr<IMac> &imac,
                         const std::vector<IMacObservation> &obsVector);
 
   /**
@@ -272,6 +243,18 @@ public:
    * @returns A shared ptr to a BIMac instance
    */
   std::shared_ptr<BIMac> getBIMac() { return this->_bimac; }
+
+  /**
+   * Getter for the BIMac observations from the most recent episode.
+   *
+   * These are the counts added to the BIMac at the end of the episode, e.g.
+   * for logging with a BIMacLogWriter.
+   *
+   * @returns A vector of BIMacObservations
+   */
+  std::vector<BIMacObservation> getEpisodeObservations() const {
+    return this->_transitionCounter.getBIMacObservations();
+  }
 };
 
 #endif
\ No newline at end of file
@@ -11,34 +11,54 @@
 #ifndef COVERAGE_STATE_H
 #define COVERAGE_STATE_H
 
+#include "coverage_plan/mod/bit_grid.h"
 #include "coverage_plan/mod/grid_cell.h"
-#include <Eigen/Dense>
+#include "coverage_plan/util/zobrist.h"
+#include <cstdint>
 #include <despot/interface/pomdp.h>
 #include <set>
 #include <string>
 
 /**
  * State of Coverage POMDP.
- * Contains robot position, the time, the map, and the covered cells
+ * Contains robot position, the time, the map, and the covered cells.
+ * The map and covered cells are bit packed, as states are copied constantly
+ * during planning. Copies share the map and covered storage (see BitGrid), so
+ * copying a state is O(1), and each grid is only cloned the first time a
+ * copy writes to it (e.g. in CoveragePOMDP::Step).
+ *
+ * Each state also carries a Zobrist hash of the robot position, time, and
+ * covered cells. CoveragePOMDP::Step updates it in O(1), so search can key
+ * memoised values on it. Code which sets the fields directly (rather than
+ * through the constructors or Step) must reset it with computeHash().
+ *
+ * The map and covered cells are padded (see BitGrid::padded()) by the
+ * constructors and CoverageBelief::Sample. The map's border is occupied, so
+ * moving off the map fails, and observations of cells off the map are
+ * occupied, without any bounds checks. The covered border is set, so cells
+ * off the map never give a reward. Code which assigns unpadded grids to the
+ * fields still works, as Step and the default policy call pad() first.
  *
  * Members:
  * * robotPosition: The robot's position
  * * time: The current time
- * * map: The current map
- * * covered: The set of covered cells
+ * * map: The current map (one bit per cell, 1 is occupied)
+ * * covered: The covered cells (one bit per cell, 1 is covered)
+ * * hash: The Zobrist hash of robotPosition, time, and covered
  */
 class CoverageState : public despot::State {
 
   // Following conventions in DESPOT and making fields public
 public:
-  GridCell robotPosition{};     // The robot's current grid position
-  int time{};                   // The current time step
-  Eigen::MatrixXi map{};        // The current map state
-  std::set<GridCell> covered{}; // The set of covered nodes
+  GridCell robotPosition{}; // The robot's current grid position
+  int time{};               // The current time step
+  BitGrid map{};            // The current map state
+  BitGrid covered{};        // The covered cells
+  uint64_t hash{};          // Zobrist hash of position, time and covered
 
   // If overwriting default constructor, you should also overwrite the
   // destructor iirc
-  CoverageState() : despot::State{} {}
+  CoverageState() : despot::State{}, hash{this->computeHash()} {}
   ~CoverageState() {}
 
   /**
@@ -47,16 +67,89 @@ public:
    * @param curPosition The robot's current position
    * @param curTime The current time step
    * @param curMap The curent state of the map
+   * @param curCovered The robot's current covered cells
+   * @param particleWeight The weight if the state is a particle
+   * @param id The state's id (default -1)
+   */
+  CoverageState(const GridCell &curPosition, const int &curTime,
+                const BitGrid &curMap, const BitGrid &curCovered,
+                const double &particleWeight, const int &id = -1)
+      : State{id, particleWeight}, robotPosition{curPosition}, time{curTime},
+        map{BitGrid::padded(curMap, true)},
+        covered{BitGrid::padded(curCovered, true)},
+        hash{this->computeHash()} {}
+
+  /**
+   * Constructor initialises fields, taking the covered cells as a set.
+   * Covered cells outside of the map are ignored.
+   *
+   * @param curPosition The robot's current position
+   * @param curTime The current time step
+   * @param curMap The curent state of the map
    * @param curCovered The robot's current covered set
    * @param particleWeight The weight if the state is a particle
    * @param id The state's id (default -1)
    */
   CoverageState(const GridCell &curPosition, const int &curTime,
-                const Eigen::MatrixXi &curMap,
-                const std::set<GridCell> &curCovered,
+                const BitGrid &curMap, const std::set<GridCell> &curCovered,
                 const double &particleWeight, const int &id = -1)
       : State{id, particleWeight}, robotPosition{curPosition}, time{curTime},
-        map{curMap}, covered{curCovered} {}
+        map{BitGrid::padded(curMap, true)},
+        covered{BitGrid::padded(
+            BitGrid{curMap.rows(), curMap.cols(), curCovered}, true)},
+        hash{this->computeHash()} {}
+
+  /**
+   * Switches the map and covered cells to the padded layout, with their
+   * borders set, if they aren't already. This is O(1) for padded states.
+   */
+  void pad() {
+    if (this->map.padding() == 0 || !this->map.border()) {
+      this->map = BitGrid::padded(this->map, true);
+    }
+    if (this->covered.padding() == 0 || !this->covered.border()) {
+      this->covered = BitGrid::padded(this->covered, true);
+    }
+  }
+
+  /**
+   * Returns the Zobrist key for the robot being at a cell.
+   *
+   * @param cell The robot's position
+   *
+   * @returns The position key
+   */
+  static uint64_t positionKey(const GridCell &cell) {
+    return Zobrist::key(0, cell.x, cell.y);
+  }
+
+  /**
+   * Returns the Zobrist key for a cell being covered.
+   *
+   * @param cell The covered cell
+   *
+   * @returns The covered key
+   */
+  static uint64_t coveredKey(const GridCell &cell) {
+    return Zobrist::key(1, cell.x, cell.y);
+  }
+
+  /**
+   * Returns the Zobrist key for a timestep.
+   *
+   * @param ts The timestep
+   *
+   * @returns The time key
+   */
+  static uint64_t timeKey(int ts) { return Zobrist::key(2, ts, 0); }
+
+  /**
+   * Computes the Zobrist hash of the state from scratch.
+   * This is O(cells), so should only be used when a state is (re)built.
+   *
+   * @returns The hash of robotPosition, time, and covered
+   */
+  uint64_t computeHash() const;
 
   /**
    * Produces a string description of a state.
@@ -14,6 +14,7 @@
 #include "coverage_plan/mod/grid_cell.h"
 #include "coverage_plan/mod/imac.h"
 #include "coverage_plan/mod/imac_executor.h"
+#include "coverage_plan/planning/coverage_observation.h"
 #include "coverage_plan/planning/coverage_state.h"
 #include <despot/core/globals.h>
 #include <despot/interface/pomdp.h>
@@ -30,6 +31,7 @@
  * * _initTime: The initial time the robot starts coverage
  * * _timeBound: The time bound on coverage planning
  * * _exec: An IMacExecutor which we sample through
+ * * _obsCodec: Encodes observations (shared with the POMDP for wide FOVs)
  */
 class CoverageWorld : public despot::World {
 
@@ -39,6 +41,7 @@ private:
   const int _timeBound{};
   const std::vector<GridCell> _fov{};
   std::shared_ptr<IMacExecutor> _exec{};
+  const ObservationCodec _obsCodec;
 
 public:
   /** Initialises attributes.
@@ -52,8 +55,25 @@ public:
   CoverageWorld(const GridCell &initPos, const int &initTime,
                 const int &timeBound, const std::vector<GridCell> &fov,
                 std::shared_ptr<IMacExecutor> exec)
+      : CoverageWorld{initPos, initTime, timeBound, exec,
+                      ObservationCodec{fov, 0, 0}} {}
+
+  /** Initialises attributes, sharing an observation codec.
+   * Worlds for wide FOVs must share the codec of the POMDP which plans with
+   * their observations.
+   *
+   * @param initPos The initial position of the robot
+   * @param initTime The time the robot starts coverage
+   * @param timeBound The time bound on coverage planning
+   * @param exec The IMac executor instance we are sampling with
+   * @param obsCodec The codec for the robot's FOV
+   */
+  CoverageWorld(const GridCell &initPos, const int &initTime,
+                const int &timeBound, std::shared_ptr<IMacExecutor> exec,
+                const ObservationCodec &obsCodec)
       : World{}, _initPos{initPos}, _initTime{initTime},
-        _timeBound{timeBound}, _fov{fov}, _exec{exec} {
+        _timeBound{timeBound}, _fov{obsCodec.getFOV()}, _exec{exec},
+        _obsCodec{obsCodec} {
     this->state_ = new CoverageState();
   }
 
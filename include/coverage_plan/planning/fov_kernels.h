@@ -0,0 +1,158 @@
+/**
+ * @file fov_kernels.h
+ *
+ * @brief Compile-time specialised observation kernels for common FOV shapes.
+ *
+ * The FOV is a runtime vector of GridCells, so generic observation code
+ * loops over it and computes each cell's position. Almost every experiment
+ * uses one of a couple of standard shapes though. For those, the kernels here
+ * are instantiated with the shape's cells as compile-time constants, so the
+ * loop over the FOV is fully unrolled and each cell's bit position is a
+ * constant. ObservationCodec picks a kernel at runtime with FOVKernels::match,
+ * and falls back to the generic loop for custom FOVs and near the border of
+ * unpadded maps.
+ *
+ * The functions are defined in the header so they can be inlined into the
+ * ObservationCodec functions which use them.
+ *
+ * @author Charlie Street
+ */
+
+#ifndef FOV_KERNELS_H
+#define FOV_KERNELS_H
+
+#include "coverage_plan/mod/grid_cell.h"
+#include <Eigen/Dense>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <despot/core/globals.h>
+#include <utility>
+#include <vector>
+
+namespace FOVKernels {
+
+/**
+ * The 4-neighbourhood (left, right, up, down).
+ */
+struct FourNeighbour {
+  static constexpr std::array<GridCell, 4> cells{
+      {GridCell{-1, 0}, GridCell{1, 0}, GridCell{0, -1}, GridCell{0, 1}}};
+};
+
+/**
+ * The 8-neighbourhood (the 3x3 window without the robot's cell), in the
+ * row-major order used by the experiment apps.
+ */
+struct EightNeighbour {
+  static constexpr std::array<GridCell, 8> cells{
+      {GridCell{-1, -1}, GridCell{0, -1}, GridCell{1, -1}, GridCell{-1, 0},
+       GridCell{1, 0}, GridCell{-1, 1}, GridCell{0, 1}, GridCell{1, 1}}};
+};
+
+/**
+ * The FOV shapes with specialised kernels.
+ */
+enum class Shape { generic, fourNeighbour, eightNeighbour };
+
+/**
+ * Checks if a FOV is exactly a shape's cells, in the same order.
+ *
+ * @param fov The robot's field of view as a vector of relative grid cells
+ *
+ * @returns True if fov matches S
+ */
+template <typename S> bool isShape(const std::vector<GridCell> &fov) {
+  if (fov.size() != S::cells.size()) {
+    return false;
+  }
+  for (std::size_t i{0}; i < fov.size(); ++i) {
+    if (fov[i] != S::cells[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Finds the specialised kernel for a FOV.
+ *
+ * @param fov The robot's field of view as a vector of relative grid cells
+ *
+ * @returns The FOV's shape, or Shape::generic if there is no kernel for it
+ */
+inline Shape match(const std::vector<GridCell> &fov) {
+  if (isShape<EightNeighbour>(fov)) {
+    return Shape::eightNeighbour;
+  }
+  if (isShape<FourNeighbour>(fov)) {
+    return Shape::fourNeighbour;
+  }
+  return Shape::generic;
+}
+
+/**
+ * Calls fn once per cell in a shape, fully unrolled.
+ *
+ * @param fn Called with a std::integral_constant holding each cell's index
+ */
+template <typename S, typename Fn, std::size_t... I>
+inline void forEachCell(Fn &&fn, std::index_sequence<I...>) {
+  (fn(std::integral_constant<std::size_t, I>{}), ...);
+}
+
+/**
+ * Calls fn once per cell in a shape, fully unrolled.
+ *
+ * @param fn Called with a std::integral_constant holding each cell's index
+ */
+template <typename S, typename Fn> inline void forEachCell(Fn &&fn) {
+  forEachCell<S>(std::forward<Fn>(fn),
+                 std::make_index_sequence<S::cells.size()>{});
+}
+
+/**
+ * Computes the map bits of an observation, as in
+ * ObservationCodec::_cellBits. The whole FOV must be inside the map, or
+ * inside the occupied border of a padded map.
+ *
+ * @param words The map's storage words (see BitGrid::data())
+ * @param stride The number of bits per map column (see BitGrid::stride())
+ * @param robotIdx The bit index of the robot's position
+ *
+ * @returns The FOV cells in observation order, without the success flag
+ */
+template <typename S>
+inline despot::OBS_TYPE cellBits(const uint64_t *words, int stride,
+                                 int robotIdx) {
+  constexpr std::size_t n{S::cells.size()};
+  despot::OBS_TYPE obsInt{0};
+  forEachCell<S>([&](auto i) {
+    int idx{robotIdx + S::cells[i].x * stride + S::cells[i].y};
+    obsInt |= ((words[idx >> 6] >> (idx & 63)) & 1) << (n - 1 - i);
+  });
+  return obsInt;
+}
+
+/**
+ * Sets the observed cells in a map belief, as in
+ * ObservationCodec::applyObservation. The whole FOV must be inside the map.
+ *
+ * @param obsInt The observation as an integer
+ * @param robotPos The robot's position
+ * @param mapBelief The map belief to write the observed cells into
+ */
+template <typename S>
+inline void applyObservation(const despot::OBS_TYPE &obsInt,
+                             const GridCell &robotPos,
+                             Eigen::MatrixXd &mapBelief) {
+  constexpr std::size_t n{S::cells.size()};
+  forEachCell<S>([&](auto i) {
+    mapBelief(robotPos.y + S::cells[i].y, robotPos.x + S::cells[i].x) =
+        (double)((obsInt >> (n - 1 - i)) & 1);
+  });
+}
+
+} // namespace FOVKernels
+
+#endif
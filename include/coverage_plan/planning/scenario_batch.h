@@ -0,0 +1,171 @@
+/**
+ * @file scenario_batch.h
+ *
+ * @brief A structure-of-arrays store for stepping many scenarios together.
+ *
+ * Rolling out a policy steps every particle at a node under the same action.
+ * Done one CoverageState at a time, each step copies the state from the
+ * memory pool and touches its map and covered grids wherever they were
+ * allocated. ScenarioBatch instead keeps each field of the particles in its
+ * own array, and the maps and covered cells back to back in two contiguous
+ * word buffers, so CoveragePOMDP::StepBatch runs down flat arrays. The
+ * buffers are reused between batches, so refilling a batch doesn't allocate
+ * once it has grown to size.
+ *
+ * @author Charlie Street
+ */
+#ifndef SCENARIO_BATCH_H
+#define SCENARIO_BATCH_H
+
+#include "coverage_plan/mod/bit_grid.h"
+#include "coverage_plan/planning/coverage_state.h"
+#include <cstdint>
+#include <despot/core/globals.h>
+#include <despot/interface/pomdp.h>
+#include <vector>
+
+/**
+ * A batch of scenario particles stored as a structure of arrays.
+ * Particle i's fields are at index i of each array. The maps and covered
+ * cells are stored in BitGrid's padded layout with the border set (see
+ * BitGrid::padded()), numWords() words per particle.
+ *
+ * The arrays are public, following CoverageState. Code which edits them
+ * directly must keep hash and numCovered in line with the other fields.
+ *
+ * Members:
+ * * x, y: The robot's position
+ * * time: The current time
+ * * scenarioId: The scenario each particle belongs to
+ * * weight: The weight of each particle
+ * * hash: The Zobrist hash of the robot position, time, and covered cells
+ * * numCovered: The number of covered cells (inside the map)
+ * * maps: The map words of each particle
+ * * covered: The covered words of each particle
+ * * reward: The reward of each particle's last step
+ * * obs: The observation of each particle's last step
+ * * terminal: 1 if the particle's last step reached a terminal state
+ * * _rows: The number of rows in each map
+ * * _cols: The number of columns in each map
+ * * _stride: The number of bits per map column
+ * * _numWords: The number of words in each map
+ */
+class ScenarioBatch {
+public:
+  std::vector<int> x{};
+  std::vector<int> y{};
+  std::vector<int> time{};
+  std::vector<int> scenarioId{};
+  std::vector<double> weight{};
+  std::vector<uint64_t> hash{};
+  std::vector<int> numCovered{};
+  std::vector<uint64_t> maps{};
+  std::vector<uint64_t> covered{};
+  std::vector<double> reward{};
+  std::vector<despot::OBS_TYPE> obs{};
+  std::vector<uint8_t> terminal{};
+
+private:
+  int _rows{};
+  int _cols{};
+  int _stride{};
+  int _numWords{};
+
+public:
+  /**
+   * Fills the batch with copies of a set of particles, replacing its
+   * contents. The particles are left alone.
+   *
+   * @param particles A vector of CoverageStates with the same map dimensions
+   */
+  void assign(const std::vector<despot::State *> &particles);
+
+  /**
+   * Writes a particle in the batch back into a CoverageState.
+   * The state's map and covered cells are replaced with padded grids.
+   *
+   * @param i The particle's index in the batch
+   * @param state The state to write to
+   */
+  void toState(int i, CoverageState &state) const;
+
+  /**
+   * Returns the number of particles in the batch.
+   *
+   * @returns The batch size
+   */
+  int size() const { return (int)this->x.size(); }
+
+  /**
+   * Returns the number of rows in each map.
+   *
+   * @returns The number of rows
+   */
+  int rows() const { return this->_rows; }
+
+  /**
+   * Returns the number of columns in each map.
+   *
+   * @returns The number of columns
+   */
+  int cols() const { return this->_cols; }
+
+  /**
+   * Returns the number of bits per map column, as in BitGrid::stride().
+   *
+   * @returns The stride
+   */
+  int stride() const { return this->_stride; }
+
+  /**
+   * Returns the number of storage words in each map and covered grid.
+   *
+   * @returns The number of words per grid
+   */
+  int numWords() const { return this->_numWords; }
+
+  /**
+   * Returns the bit index of a particle's robot position.
+   *
+   * @param i The particle's index in the batch
+   *
+   * @returns The bit index, as in BitGrid::index()
+   */
+  int index(int i) const {
+    return this->_stride + 1 + this->x[i] * this->_stride + this->y[i];
+  }
+
+  /**
+   * Returns a particle's map words.
+   *
+   * @param i The particle's index in the batch
+   *
+   * @returns A pointer to the first word of the particle's map
+   */
+  uint64_t *mapWords(int i) { return this->maps.data() + i * this->_numWords; }
+
+  /**
+   * Returns a particle's covered words.
+   *
+   * @param i The particle's index in the batch
+   *
+   * @returns A pointer to the first word of the particle's covered cells
+   */
+  uint64_t *coveredWords(int i) {
+    return this->covered.data() + i * this->_numWords;
+  }
+
+  /**
+   * Returns a read-only view of a particle's map.
+   *
+   * @param i The particle's index in the batch
+   *
+   * @returns The particle's map as a BitGridView
+   */
+  BitGridView map(int i) const {
+    return BitGridView{this->maps.data() + i * this->_numWords, this->_rows,
+                       this->_cols, 1, true};
+  }
+};
+
+#endif
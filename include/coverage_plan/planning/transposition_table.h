@@ -0,0 +1,120 @@
+/**
+ * @file transposition_table.h
+ *
+ * @brief A per-search table memoising default policy values.
+ *
+ * In a DESPOT tree, many action sequences reach the same robot position and
+ * covered set at the same time, and each new node evaluates the default
+ * policy on its particles from scratch. TranspositionTable caches these
+ * evaluations, keyed on the Zobrist hashes of the particles (see
+ * CoverageState) and their scenarios.
+ *
+ * The hashes don't include the map, so two particle sets with the same key
+ * can differ in map cells the robot failed to move into. Within one search,
+ * each scenario's map is otherwise driven by the same random numbers, so a
+ * cached value is a close estimate for the whole transposition. The table
+ * must be cleared between searches, as the scenarios are resampled.
+ *
+ * @author Charlie Street
+ */
+#ifndef TRANSPOSITION_TABLE_H
+#define TRANSPOSITION_TABLE_H
+
+#include <cstdint>
+#include <despot/core/globals.h>
+#include <despot/interface/pomdp.h>
+#include <vector>
+
+/**
+ * A fixed size, direct mapped cache from particle set keys to values.
+ * A colliding store replaces the previous entry. Clearing bumps a generation
+ * counter rather than touching every entry, so it is O(1).
+ *
+ * Members:
+ * * _entries: The table entries
+ * * _mask: The mask which maps a key to an entry index
+ * * _generation: The current generation. Entries from others are empty
+ * * _hits: The number of successful lookups since the last clear
+ * * _misses: The number of failed lookups since the last clear
+ */
+class TranspositionTable {
+private:
+  /**
+   * A single table entry.
+   *
+   * Members:
+   * * key: The full key of the cached particle set
+   * * generation: The generation the entry was stored in
+   * * action: The cached action
+   * * value: The cached value
+   */
+  struct Entry {
+    uint64_t key{};
+    uint32_t generation{};
+    despot::ACT_TYPE action{};
+    double value{};
+  };
+
+  std::vector<Entry> _entries{};
+  uint64_t _mask{};
+  uint32_t _generation{1};
+  int _hits{};
+  int _misses{};
+
+public:
+  /**
+   * Constructor allocates the table.
+   *
+   * @param log2Size The log2 of the number of entries
+   */
+  explicit TranspositionTable(int log2Size = 16);
+
+  /**
+   * Computes the key for a set of particles, combining each particle's state
+   * hash with its scenario ID. The key doesn't depend on the particle order.
+   *
+   * @param particles A vector of CoverageStates
+   *
+   * @returns The key for the particle set
+   */
+  static uint64_t particlesKey(const std::vector<despot::State *> &particles);
+
+  /**
+   * Looks up a cached value.
+   *
+   * @param key The particle set key
+   * @param result Set to the cached action and value on a hit
+   *
+   * @returns True if the key was found
+   */
+  bool lookup(uint64_t key, despot::ValuedAction &result);
+
+  /**
+   * Caches a value, replacing any entry in the same slot.
+   *
+   * @param key The particle set key
+   * @param result The action and value to cache
+   */
+  void store(uint64_t key, const despot::ValuedAction &result);
+
+  /**
+   * Empties the table. Should be called before each search.
+   */
+  void clear();
+
+  /**
+   * Returns the number of successful lookups since the last clear.
+   *
+   * @returns The number of hits
+   */
+  int hits() const { return this->_hits; }
+
+  /**
+   * Returns the number of failed lookups since the last clear.
+   *
+   * @returns The number of misses
+   */
+  int misses() const { return this->_misses; }
+};
+
+#endif
@@ -0,0 +1,104 @@
+/**
+ * @file counter_rng.h
+ * @brief A counter-based random number generator (Philox4x32-10).
+ *
+ * Counter-based generators map a (counter, key) pair straight to random bits,
+ * so there is no generator state to seed or carry around. This makes it cheap
+ * to get reproducible draws indexed by e.g. (seed, time, cell), which is what
+ * is needed in the POMDP simulator.
+ *
+ * Based on: Salmon, J.K., Moraes, M.A., Dror, R.O. and Shaw, D.E., 2011.
+ * Parallel random numbers: as easy as 1, 2, 3. In Proceedings of 2011
+ * International Conference for High Performance Computing, Networking, Storage
+ * and Analysis (pp. 1-12).
+ *
+ * The functions are defined in the header so they can be inlined into the
+ * sampling loops which use them.
+ *
+ * @author Charlie Street
+ */
+
+#ifndef COUNTER_RNG_H
+#define COUNTER_RNG_H
+
+#include <array>
+#include <cstdint>
+
+namespace CounterRNG {
+
+/**
+ * Computes the high and low 32 bits of a 32x32 bit multiplication.
+ *
+ * @param a The first operand
+ * @param b The second operand
+ * @param hi Set to the high 32 bits of a*b
+ *
+ * @returns The low 32 bits of a*b
+ */
+inline uint32_t mulhilo(uint32_t a, uint32_t b, uint32_t &hi) {
+  uint64_t product{(uint64_t)a * (uint64_t)b};
+  hi = (uint32_t)(product >> 32);
+  return (uint32_t)product;
+}
+
+/**
+ * The Philox4x32-10 bijection. Maps a 128 bit counter to 128 random bits under
+ * a 64 bit key.
+ *
+ * @param counter The counter
+ * @param key The key
+ *
+ * @returns 128 random bits as 4 32 bit words
+ */
+inline std::array<uint32_t, 4> philox4x32(std::array<uint32_t, 4> counter,
+                                          std::array<uint32_t, 2> key) {
+  for (int round{0}; round < 10; ++round) {
+    if (round > 0) {
+      key[0] += 0x9E3779B9;
+      key[1] += 0xBB67AE85;
+    }
+    uint32_t hi0{};
+    uint32_t hi1{};
+    uint32_t lo0{mulhilo(0xD2511F53, counter[0], hi0)};
+    uint32_t lo1{mulhilo(0xCD9E8D57, counter[2], hi1)};
+    counter = {hi1 ^ counter[1] ^ key[0], lo1, hi0 ^ counter[3] ^ key[1], lo0};
+  }
+  return counter;
+}
+
+/**
+ * Converts 64 random bits into a double uniformly distributed in [0,1).
+ *
+ * @param hi The high 32 random bits
+ * @param lo The low 32 random bits
+ *
+ * @returns A double in [0,1) with 53 bits of randomness
+ */
+inline double toUniform(uint32_t hi, uint32_t lo) {
+  uint64_t bits{((uint64_t)hi << 32) | lo};
+  return (double)(bits >> 11) * 0x1.0p-53;
+}
+
+/**
+ * Computes two uniform random doubles in [0,1) for a given key and counter.
+ * Each (seed, stream, index) triple gives an independent pair of draws.
+ *
+ * @param seed The 64 bit key (e.g. a scenario seed)
+ * @param stream A 64 bit stream identifier (e.g. a timestep)
+ * @param index A 64 bit index within the stream
+ * @param first Set to the first uniform draw
+ * @param second Set to the second uniform draw
+ */
+inline void uniformPair(uint64_t seed, uint64_t stream, uint64_t index,
+                        double &first, double &second) {
+  std::array<uint32_t, 4> bits{philox4x32(
+      {(uint32_t)index, (uint32_t)(index >> 32), (uint32_t)stream,
+       (uint32_t)(stream >> 32)},
+      {(uint32_t)seed, (uint32_t)(seed >> 32)})};
+  first = toUniform(bits[0], bits[1]);
+  second = toUniform(bits[2], bits[3]);
+}
+
+} // namespace CounterRNG
+
+#endif
@@ -0,0 +1,54 @@
+/**
+ * @file zobrist.h
+ * @brief Stateless Zobrist keys for incrementally hashing planning states.
+ *
+ * A Zobrist hash XORs together one random key per feature present in a state,
+ * so adding or removing a feature is a single XOR. Rather than storing a table
+ * of random keys (whose size would depend on the map), each key is computed
+ * on demand by mixing the feature's index with the SplitMix64 finaliser.
+ *
+ * Based on: Zobrist, A.L., 1970. A new hashing method with application for
+ * game playing. Technical report 88, University of Wisconsin.
+ *
+ * @author Charlie Street
+ */
+
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <cstdint>
+
+namespace Zobrist {
+
+/**
+ * The SplitMix64 finaliser, a bijection on 64 bit words with good avalanche.
+ *
+ * @param z The word to mix
+ *
+ * @returns The mixed word
+ */
+inline uint64_t mix(uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+  return z ^ (z >> 31);
+}
+
+/**
+ * Computes the key for a feature at a 2D index.
+ * Distinct (feature, x, y) triples give (with high probability) unrelated
+ * keys.
+ *
+ * @param feature An identifier for the type of feature (e.g. covered cell)
+ * @param x The x index
+ * @param y The y index
+ *
+ * @returns The 64 bit key
+ */
+inline uint64_t key(uint64_t feature, int x, int y) {
+  uint64_t index{((uint64_t)(uint32_t)x << 32) | (uint32_t)y};
+  return mix(mix(index) ^ (feature * 0x9E3779B97F4A7C15));
+}
+
+} // namespace Zobrist
+
+#endif
@@ -18,7 +18,7 @@
  */
 Action BoustrophedonCoverageRobot::_planFn(
     const GridCell &currentLoc, const std::vector<Action> &enabledActions,
-    int ts, int timeBound, std::shared_ptr<IMac> imac,
+    int ts, int timeBound, const std::shared_ptr<IMac> &imac,
     const std::vector<GridCell> &visited,
     const std::vector<IMacObservation> &currentObs) {
 
@@ -99,7 +99,7 @@ double EnergyFunctionalCoverageRobot::_E(const GridCell &currentCell,
  */
 Action EnergyFunctionalCoverageRobot::_planFn(
     const GridCell &currentLoc, const std::vector<Action> &enabledActions,
-    int ts, int timeBound, std::shared_ptr<IMac> imac,
+    int ts, int timeBound, const std::shared_ptr<IMac> &imac,
     const std::vector<GridCell> &visited,
     const std::vector<IMacObservation> &currentObs) {
   // Get hash map of neighbouring observations
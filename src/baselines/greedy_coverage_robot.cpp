@@ -19,12 +19,13 @@
 Action
 GreedyCoverageRobot::_planFn(const GridCell &currentLoc,
                              const std::vector<Action> &enabledActions, int ts,
-                             int timeBound, std::shared_ptr<IMac> imac,
+                             int timeBound, const std::shared_ptr<IMac> &imac,
                              const std::vector<GridCell> &visited,
                              const std::vector<IMacObservation> &currentObs) {
 
   // Roll current belief forward to get occupancy probs at next time step
-  Eigen::MatrixXd nextBelief{imac->forwardStep(this->_belief->getMapBelief())};
+  imac->forwardStep(this->_belief->getMapBelief(), this->_nextBelief);
+  const Eigen::MatrixXd &nextBelief{this->_nextBelief};
 
   // bestAct stores all actions with the best reward
   std::vector<Action> bestAct{};
@@ -19,7 +19,7 @@
 Action
 RandomCoverageRobot::_planFn(const GridCell &currentLoc,
                              const std::vector<Action> &enabledActions, int ts,
-                             int timeBound, std::shared_ptr<IMac> imac,
+                             int timeBound, const std::shared_ptr<IMac> &imac,
                              const std::vector<GridCell> &visited,
                              const std::vector<IMacObservation> &currentObs) {
   std::mt19937_64 gen{SeedHelpers::genRandomDeviceSeed()};
@@ -40,7 +40,7 @@ ActionOutcome RandomCoverageRobot::_executeFn(const GridCell &currentLoc,
   this->_world->ExecuteAction(ActionHelpers::toInt(action), obs);
 
   // Get the action outcome object out of the observation
-  bool succ{std::get<1>(Observation::fromObsType(obs, this->_fov))};
+  bool succ{Observation::actionSucceeded(obs, (int)this->_fov.size())};
   GridCell nextLoc{currentLoc};
   if (succ) {
     nextLoc = ActionHelpers::applySuccessfulAction(currentLoc, action);
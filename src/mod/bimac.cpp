@@ -6,12 +6,159 @@
  */
 #include "coverage_plan/mod/bimac.h"
 #include "coverage_plan/mod/imac.h"
+#include "coverage_plan/util/counter_rng.h"
 #include "coverage_plan/util/seed.h"
+#include "coverage_plan/util/zobrist.h"
 #include <Eigen/Dense>
-#include <boost/math/special_functions/beta.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
 #include <filesystem>
 #include <fstream>
 #include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/**
+ * A stream of uniform random numbers for a single cell, drawn in pairs from
+ * the counter-based generator.
+ */
+class CellUniforms {
+private:
+  uint64_t _seed{};
+  uint64_t _stream{};
+  uint64_t _index{};
+  uint64_t _draw{};
+  double _spare{};
+  bool _hasSpare{false};
+
+public:
+  CellUniforms(uint64_t seed, uint64_t stream, uint64_t index)
+      : _seed{seed}, _stream{stream}, _index{index} {}
+
+  /**
+   * Returns the next uniform random number in (0,1].
+   */
+  double next() {
+    if (this->_hasSpare) {
+      this->_hasSpare = false;
+      return 1.0 - this->_spare;
+    }
+    double first{};
+    CounterRNG::uniformPair(this->_seed, this->_stream + this->_draw++,
+                            this->_index, first, this->_spare);
+    this->_hasSpare = true;
+    return 1.0 - first;
+  }
+};
+
+/**
+ * Per-cell constants for sampling Gamma(shape, 1), stored as a structure of
+ * arrays so they can be computed once and reused across many samples.
+ *
+ * Members:
+ * * shape: The (integer) shape parameter of each cell
+ * * d: shape - 1/3, for Marsaglia and Tsang's method
+ * * c: 1 / sqrt(9d), for Marsaglia and Tsang's method
+ */
+struct GammaTable {
+  std::vector<int> shape{};
+  std::vector<double> d{};
+  std::vector<double> c{};
+
+  GammaTable(const Eigen::MatrixXi &shapes)
+      : shape(shapes.data(), shapes.data() + shapes.size()),
+        d(shapes.size()), c(shapes.size()) {
+    for (int i{0}; i < (int)this->shape.size(); ++i) {
+      if (this->shape[i] < 1) {
+        throw "BIMac alpha and beta values must be positive";
+      }
+      this->d[i] = this->shape[i] - 1.0 / 3.0;
+      this->c[i] = 1.0 / std::sqrt(9.0 * this->d[i]);
+    }
+  }
+};
+
+/**
+ * The Gamma tables for the alpha and beta matrices of one Beta parameter.
+ *
+ * Members:
+ * * alpha: The table for the alpha matrix
+ * * beta: The table for the beta matrix
+ * * stream: The random stream used for this parameter
+ */
+struct BetaTable {
+  GammaTable alpha;
+  GammaTable beta;
+  uint64_t stream{};
+};
+
+/**
+ * Sample from Gamma(shape, 1) for a positive integer shape.
+ *
+ * @param shape The shape parameter
+ * @param d Precomputed shape - 1/3
+ * @param c Precomputed 1 / sqrt(9d)
+ * @param uniforms The uniform random numbers to use
+ *
+ * @returns The gamma sample
+ */
+double sampleGamma(int shape, double d, double c, CellUniforms &uniforms) {
+  // Small integer shapes are a sum of exponentials, i.e. -log(prod(u))
+  if (shape <= 8) {
+    double product{1.0};
+    for (int i{0}; i < shape; ++i) {
+      product *= uniforms.next();
+    }
+    return -std::log(product);
+  }
+
+  // Marsaglia, G. and Tsang, W.W., 2000. A simple method for generating
+  // gamma variables. ACM Transactions on Mathematical Software, 26(3).
+  while (true) {
+    // Box-Muller for the normal sample
+    double x{std::sqrt(-2.0 * std::log(uniforms.next())) *
+             std::cos(2.0 * M_PI * uniforms.next())};
+    double v{1.0 + c * x};
+    if (v <= 0.0) {
+      continue;
+    }
+    v = v * v * v;
+    double u{uniforms.next()};
+    double xSq{x * x};
+    if (u < 1.0 - 0.0331 * xSq * xSq ||
+        std::log(u) < 0.5 * xSq + d * (1.0 - v + std::log(v))) {
+      return d * v;
+    }
+  }
+}
+
+/**
+ * Sample a range of cells of one Beta parameter matrix, using the gamma ratio
+ * X / (X + Y) with X ~ Gamma(alpha), Y ~ Gamma(beta).
+ *
+ * @param table The Gamma tables for the parameter
+ * @param seed The random seed
+ * @param start The first cell index to sample
+ * @param end One past the last cell index to sample
+ * @param out The output array (indexed by cell)
+ */
+void sampleCells(const BetaTable &table, uint64_t seed, int start, int end,
+                 double *out) {
+  const GammaTable &alpha{table.alpha};
+  const GammaTable &beta{table.beta};
+  for (int i{start}; i < end; ++i) {
+    CellUniforms uniforms{seed, table.stream, (uint64_t)i};
+    double x{sampleGamma(alpha.shape[i], alpha.d[i], alpha.c[i], uniforms)};
+    double y{sampleGamma(beta.shape[i], beta.d[i], beta.c[i], uniforms)};
+    out[i] = x / (x + y);
+  }
+}
+
+} // namespace
 
 /**
  * Read BIMac matrix in from file.
@@ -77,11 +224,6 @@ void BIMac::_writeBIMacMatrix(const Eigen::MatrixXi &matrix,
   }
 }
 
-double BIMac::_sampleForCell(int alpha, int beta, std::mt19937_64 &gen,
-                             std::uniform_real_distribution<double> &sampler) {
-  return boost::math::ibeta_inv(alpha, beta, sampler(gen));
-}
-
 /**
  * Compute the MLE value for a single parameter.
  */
@@ -117,17 +259,147 @@ BIMac::_createIMacMatrix(const Eigen::MatrixXi &alphaMat,
  * Take a posterior sample from BIMac to get a single IMac instance
  */
 std::shared_ptr<IMac> BIMac::posteriorSample() {
-  // Generate a uniform rng between 0 and 1 to sample IMac parameters
-  std::mt19937_64 gen{SeedHelpers::genRandomDeviceSeed()};
-  std::uniform_real_distribution<double> sampler{0.0, 1.0};
+  return this->posteriorSample(SeedHelpers::genRandomDeviceSeed());
+}
+
+/**
+ * Take a posterior sample from BIMac using a given seed.
+ */
+std::shared_ptr<IMac> BIMac::posteriorSample(uint64_t seed, int numThreads) {
+  return this->posteriorSamples(1, seed, numThreads).at(0);
+}
+
+/**
+ * Take a batch of posterior samples from BIMac.
+ */
+std::vector<std::shared_ptr<IMac>>
+BIMac::posteriorSamples(int n, uint64_t seed, int numThreads) {
+  // Streams are spaced apart as each cell uses several consecutive counters
+  const uint64_t streamGap{uint64_t{1} << 32};
+  const std::array<BetaTable, 3> tables{
+      BetaTable{GammaTable{this->_alphaEntry}, GammaTable{this->_betaEntry}, 0},
+      BetaTable{GammaTable{this->_alphaExit}, GammaTable{this->_betaExit},
+                streamGap},
+      BetaTable{GammaTable{this->_alphaInit}, GammaTable{this->_betaInit},
+                2 * streamGap}};
+
+  const int rows{(int)this->_alphaEntry.rows()};
+  const int cols{(int)this->_alphaEntry.cols()};
+  const int numCells{rows * cols};
+  std::vector<std::array<Eigen::MatrixXd, 3>> matrices(
+      std::max(n, 0),
+      {Eigen::MatrixXd{rows, cols}, Eigen::MatrixXd{rows, cols},
+       Eigen::MatrixXd{rows, cols}});
+
+  // Work is split into (sample, matrix, cell range) chunks. Whole matrices are
+  // used unless there are too few to keep every thread busy
+  numThreads = std::max(1, numThreads);
+  const int numMatrices{3 * (int)matrices.size()};
+  const int totalCells{numCells * numMatrices};
+  const int chunkSize{numMatrices >= numThreads
+                          ? numCells
+                          : std::max(1, (totalCells + numThreads - 1) /
+                                            numThreads)};
+  const int chunksPerMatrix{
+      numCells == 0 ? 0 : (numCells + chunkSize - 1) / chunkSize};
+  const int numChunks{numMatrices * chunksPerMatrix};
+
+  // Each sample's key mixes the seed with the sample index, so batches with
+  // nearby seeds (e.g. seed and seed + 1) don't share samples
+  const uint64_t batchKey{Zobrist::mix(seed)};
+
+  std::atomic<int> nextChunk{0};
+  auto worker{[&]() {
+    for (int chunk{nextChunk++}; chunk < numChunks; chunk = nextChunk++) {
+      int matrix{chunk / chunksPerMatrix};
+      int start{(chunk % chunksPerMatrix) * chunkSize};
+      int sample{matrix / 3};
+      sampleCells(tables[matrix % 3], batchKey ^ (uint64_t)sample, start,
+                  std::min(start + chunkSize, numCells),
+                  matrices[sample][matrix % 3].data());
+    }
+  }};
 
-  auto psLambda{[&](int alpha, int beta) {
-    return this->_sampleForCell(alpha, beta, gen, sampler);
+  std::vector<std::thread> threads{};
+  for (int t{1}; t < std::min(numThreads, numChunks); ++t) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  std::vector<std::shared_ptr<IMac>> samples{};
+  samples.reserve(matrices.size());
+  for (const std::array<Eigen::MatrixXd, 3> &sample : matrices) {
+    samples.push_back(std::make_shared<IMac>(sample[0], sample[1], sample[2]));
+  }
+  return samples;
+}
+
+/**
+ * Computes the cached posterior mean and MLE matrices from scratch.
+ */
+void BIMac::_initialiseEstimates() {
+  auto mleLambda{[&](int alpha, int beta) {
+    return this->_computeMleForCell(alpha, beta);
+  }};
+  auto pmLambda{[&](int alpha, int beta) {
+    return this->_computePosteriorMeanForCell(alpha, beta);
   }};
-  return std::make_shared<IMac>(
-      this->_createIMacMatrix(this->_alphaEntry, this->_betaEntry, psLambda),
-      this->_createIMacMatrix(this->_alphaExit, this->_betaExit, psLambda),
-      this->_createIMacMatrix(this->_alphaInit, this->_betaInit, psLambda));
+
+  this->_mleEntry =
+      this->_createIMacMatrix(this->_alphaEntry, this->_betaEntry, mleLambda);
+  this->_mleExit =
+      this->_createIMacMatrix(this->_alphaExit, this->_betaExit, mleLambda);
+  this->_mleInit =
+      this->_createIMacMatrix(this->_alphaInit, this->_betaInit, mleLambda);
+  this->_meanEntry =
+      this->_createIMacMatrix(this->_alphaEntry, this->_betaEntry, pmLambda);
+  this->_meanExit =
+      this->_createIMacMatrix(this->_alphaExit, this->_betaExit, pmLambda);
+  this->_meanInit =
+      this->_createIMacMatrix(this->_alphaInit, this->_betaInit, pmLambda);
+
+  this->_dirtyCells.clear();
+  this->_dirtyMask = BitGrid{(int)this->_alphaEntry.rows(),
+                             (int)this->_alphaEntry.cols()};
+  this->_meanSnapshot = nullptr;
+  this->_mleSnapshot = nullptr;
+}
+
+/**
+ * Updates the cached posterior mean and MLE matrices for any dirty cells.
+ */
+void BIMac::_refreshEstimates() {
+  if (this->_estimatesStale) {
+    this->_initialiseEstimates();
+    this->_estimatesStale = false;
+    return;
+  }
+  if (this->_dirtyCells.empty()) {
+    return;
+  }
+
+  for (int i : this->_dirtyCells) {
+    this->_mleEntry(i) =
+        this->_computeMleForCell(this->_alphaEntry(i), this->_betaEntry(i));
+    this->_mleExit(i) =
+        this->_computeMleForCell(this->_alphaExit(i), this->_betaExit(i));
+    this->_mleInit(i) =
+        this->_computeMleForCell(this->_alphaInit(i), this->_betaInit(i));
+    this->_meanEntry(i) = this->_computePosteriorMeanForCell(
+        this->_alphaEntry(i), this->_betaEntry(i));
+    this->_meanExit(i) = this->_computePosteriorMeanForCell(
+        this->_alphaExit(i), this->_betaExit(i));
+    this->_meanInit(i) = this->_computePosteriorMeanForCell(
+        this->_alphaInit(i), this->_betaInit(i));
+  }
+
+  this->_dirtyCells.clear();
+  this->_dirtyMask.clear();
+  this->_meanSnapshot = nullptr;
+  this->_mleSnapshot = nullptr;
 }
 
 /**
@@ -137,13 +409,12 @@ std::shared_ptr<IMac> BIMac::posteriorSample() {
  * mode = (alpha - 1) / (alpha + beta - 2)
  */
 std::shared_ptr<IMac> BIMac::mle() {
-  auto mleLambda{[&](int alpha, int beta) {
-    return this->_computeMleForCell(alpha, beta);
-  }};
-  return std::make_shared<IMac>(
-      this->_createIMacMatrix(this->_alphaEntry, this->_betaEntry, mleLambda),
-      this->_createIMacMatrix(this->_alphaExit, this->_betaExit, mleLambda),
-      this->_createIMacMatrix(this->_alphaInit, this->_betaInit, mleLambda));
+  this->_refreshEstimates();
+  if (this->_mleSnapshot == nullptr) {
+    this->_mleSnapshot = std::make_shared<IMac>(
+        this->_mleEntry, this->_mleExit, this->_mleInit);
+  }
+  return this->_mleSnapshot;
 }
 
 /**
@@ -152,13 +423,12 @@ std::shared_ptr<IMac> BIMac::mle() {
  * The mean of a beta distribution is alpha/(alpha + beta)
  */
 std::shared_ptr<IMac> BIMac::posteriorMean() {
-  auto pmLambda{[&](int alpha, int beta) {
-    return this->_computePosteriorMeanForCell(alpha, beta);
-  }};
-  return std::make_shared<IMac>(
-      this->_createIMacMatrix(this->_alphaEntry, this->_betaEntry, pmLambda),
-      this->_createIMacMatrix(this->_alphaExit, this->_betaExit, pmLambda),
-      this->_createIMacMatrix(this->_alphaInit, this->_betaInit, pmLambda));
+  this->_refreshEstimates();
+  if (this->_meanSnapshot == nullptr) {
+    this->_meanSnapshot = std::make_shared<IMac>(
+        this->_meanEntry, this->_meanExit, this->_meanInit);
+  }
+  return this->_meanSnapshot;
 }
 
 /**
@@ -181,9 +451,61 @@ void BIMac::updatePosterior(const std::vector<BIMacObservation> &observations) {
     // gets the initOccupied observations
     this->_alphaInit(obs.cell.y, obs.cell.x) += obs.initOccupied;
     this->_betaInit(obs.cell.y, obs.cell.x) += obs.initFree;
+
+    // Mark the cell so the cached estimates are refreshed
+    if (!this->_dirtyMask.test(obs.cell)) {
+      this->_dirtyMask.set(obs.cell);
+      this->_dirtyCells.push_back(obs.cell.x * this->_alphaEntry.rows() +
+                                  obs.cell.y);
+    }
+  }
+}
+
+/**
+ * Update the BIMac posterior from several threads at once.
+ */
+void BIMac::updatePosteriorConcurrent(
+    const std::vector<BIMacObservation> &observations) {
+  auto atomicAdd{[](Eigen::MatrixXi &mat, const GridCell &cell, int count) {
+    if (count != 0) {
+      __atomic_fetch_add(&mat(cell.y, cell.x), count, __ATOMIC_RELAXED);
+    }
+  }};
+
+  for (const BIMacObservation &obs : observations) {
+    atomicAdd(this->_alphaEntry, obs.cell, obs.freeToOccupied);
+    atomicAdd(this->_betaEntry, obs.cell, obs.freeToFree);
+    atomicAdd(this->_alphaExit, obs.cell, obs.occupiedToFree);
+    atomicAdd(this->_betaExit, obs.cell, obs.occupiedToOccupied);
+    atomicAdd(this->_alphaInit, obs.cell, obs.initOccupied);
+    atomicAdd(this->_betaInit, obs.cell, obs.initFree);
+  }
+
+  // Dirty cell tracking isn't thread safe, so recompute everything on read
+  if (!observations.empty()) {
+    __atomic_store_n(&this->_estimatesStale, true, __ATOMIC_RELAXED);
   }
 }
 
+/**
+ * Add the observation counts from another BIMac into this one.
+ */
+void BIMac::merge(const BIMac &other) {
+  if (other._alphaEntry.rows() != this->_alphaEntry.rows() ||
+      other._alphaEntry.cols() != this->_alphaEntry.cols()) {
+    throw "Cannot merge BIMacs with different dimensions";
+  }
+
+  // Subtract the other BIMac's Beta(1,1) prior so it isn't counted twice
+  this->_alphaEntry.array() += other._alphaEntry.array() - 1;
+  this->_betaEntry.array() += other._betaEntry.array() - 1;
+  this->_alphaExit.array() += other._alphaExit.array() - 1;
+  this->_betaExit.array() += other._betaExit.array() - 1;
+  this->_alphaInit.array() += other._alphaInit.array() - 1;
+  this->_betaInit.array() += other._betaInit.array() - 1;
+  this->_estimatesStale = true;
+}
+
 /**
  * Writes each of the BIMac matrices out to file
  */
@@ -0,0 +1,269 @@
+/**
+ * Implementation of the BIMac log in bimac_log.h.
+ * @see bimac_log.h
+ *
+ * @author Charlie Street
+ */
+#include "coverage_plan/mod/bimac_log.h"
+#include "coverage_plan/mod/bimac.h"
+#include "coverage_plan/mod/grid_cell.h"
+#include "coverage_plan/mod/model_file.h"
+#include <Eigen/Dense>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+// Records are written straight from memory, so the host must be little-endian
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "BIMac logs require a little-endian host");
+
+namespace {
+
+const char kMagic[8]{'C', 'O', 'V', 'B', 'M', 'L', 'O', 'G'};
+const uint32_t kVersion{1};
+const uint32_t kSnapshot{0};
+const uint32_t kDelta{1};
+const int kDeltaEntrySize{7};
+
+} // namespace
+
+/**
+ * Start a new log, overwriting any existing file.
+ */
+BIMacLogWriter::BIMacLogWriter(const std::filesystem::path &logFile,
+                               const BIMac &initial, int snapshotInterval)
+    : _file{}, _header{}, _episode{0} {
+  if (snapshotInterval < 1) {
+    throw "BIMac log snapshot interval must be positive";
+  }
+  std::memcpy(this->_header.magic, kMagic, sizeof(kMagic));
+  this->_header.version = kVersion;
+  this->_header.rows = (uint32_t)initial.getAlphaEntry().rows();
+  this->_header.cols = (uint32_t)initial.getAlphaEntry().cols();
+  this->_header.snapshotInterval = (uint32_t)snapshotInterval;
+
+  this->_file.open(logFile, std::ios::binary | std::ios::trunc);
+  if (!this->_file.is_open()) {
+    throw "Unable to open BIMac log for writing";
+  }
+  this->_file.write(reinterpret_cast<const char *>(&this->_header),
+                    sizeof(this->_header));
+  this->_writeSnapshot(initial);
+}
+
+/**
+ * Reopen an existing log to append to it.
+ */
+BIMacLogWriter::BIMacLogWriter(const std::filesystem::path &logFile)
+    : _file{}, _header{}, _episode{0} {
+  BIMacLogReader reader{logFile};
+  std::memcpy(this->_header.magic, kMagic, sizeof(kMagic));
+  this->_header.version = kVersion;
+  this->_header.rows = (uint32_t)reader.rows();
+  this->_header.cols = (uint32_t)reader.cols();
+  this->_header.snapshotInterval = (uint32_t)reader.snapshotInterval();
+  this->_episode = reader.lastEpisode();
+
+  // Drop any incomplete record left at the end of the file
+  std::filesystem::resize_file(logFile, reader.validBytes());
+  this->_file.open(logFile, std::ios::binary | std::ios::app);
+  if (!this->_file.is_open()) {
+    throw "Unable to open BIMac log for writing";
+  }
+}
+
+/**
+ * Append a record to the log and flush it.
+ */
+void BIMacLogWriter::_writeRecord(uint32_t type, uint32_t numEntries,
+                                  const std::vector<int32_t> &payload) {
+  BIMacLogRecordHeader record{};
+  record.type = type;
+  record.episode = (uint32_t)this->_episode;
+  record.numEntries = numEntries;
+  record.checksum =
+      ModelFile::checksum(payload.data(), payload.size() * sizeof(int32_t));
+
+  this->_file.write(reinterpret_cast<const char *>(&record), sizeof(record));
+  this->_file.write(reinterpret_cast<const char *>(payload.data()),
+                    payload.size() * sizeof(int32_t));
+  this->_file.flush();
+  if (!this->_file.good()) {
+    throw "Failed to write to BIMac log";
+  }
+}
+
+/**
+ * Append a snapshot of a BIMac for the current episode.
+ */
+void BIMacLogWriter::_writeSnapshot(const BIMac &bimac) {
+  static_assert(sizeof(int) == sizeof(int32_t), "BIMac logs need 32 bit int");
+  size_t numCells{(size_t)this->_header.rows * this->_header.cols};
+  if ((uint32_t)bimac.getAlphaEntry().rows() != this->_header.rows ||
+      (uint32_t)bimac.getAlphaEntry().cols() != this->_header.cols) {
+    throw "BIMac dimensions do not match BIMac log";
+  }
+
+  std::vector<int32_t> payload(numCells * 6);
+  const Eigen::MatrixXi *arrays[6]{
+      &bimac.getAlphaEntry(), &bimac.getBetaEntry(), &bimac.getAlphaExit(),
+      &bimac.getBetaExit(),   &bimac.getAlphaInit(), &bimac.getBetaInit()};
+  for (int i{0}; i < 6; ++i) {
+    std::memcpy(payload.data() + i * numCells, arrays[i]->data(),
+                numCells * sizeof(int32_t));
+  }
+  this->_writeRecord(kSnapshot, (uint32_t)numCells, payload);
+}
+
+/**
+ * Log the next episode.
+ */
+void BIMacLogWriter::logEpisode(
+    const std::vector<BIMacObservation> &observations, const BIMac &bimac) {
+  std::vector<int32_t> payload{};
+  payload.reserve(observations.size() * kDeltaEntrySize);
+  uint32_t numEntries{0};
+  for (const BIMacObservation &obs : observations) {
+    if (obs.cell.outOfBounds(0, this->_header.cols, 0, this->_header.rows)) {
+      throw "BIMac log observation out of bounds";
+    }
+    if (obs.freeToOccupied == 0 && obs.freeToFree == 0 &&
+        obs.occupiedToFree == 0 && obs.occupiedToOccupied == 0 &&
+        obs.initOccupied == 0 && obs.initFree == 0) {
+      continue;
+    }
+    payload.insert(payload.end(),
+                   {(int32_t)(obs.cell.x * this->_header.rows + obs.cell.y),
+                    obs.freeToOccupied, obs.freeToFree, obs.occupiedToFree,
+                    obs.occupiedToOccupied, obs.initOccupied, obs.initFree});
+    ++numEntries;
+  }
+
+  ++this->_episode;
+  this->_writeRecord(kDelta, numEntries, payload);
+  if (this->_episode % this->_header.snapshotInterval == 0) {
+    this->_writeSnapshot(bimac);
+  }
+}
+
+/**
+ * Reads and validates a log.
+ */
+BIMacLogReader::BIMacLogReader(const std::filesystem::path &logFile) {
+  std::ifstream f(logFile, std::ios::binary);
+  if (!f.is_open()) {
+    throw "Unable to open BIMac log";
+  }
+  if (!f.read(reinterpret_cast<char *>(&this->_header),
+              sizeof(this->_header)) ||
+      std::memcmp(this->_header.magic, kMagic, sizeof(kMagic)) != 0) {
+    throw "Not a BIMac log";
+  }
+  if (this->_header.version != kVersion) {
+    throw "Unsupported BIMac log version";
+  }
+  if (this->_header.snapshotInterval == 0) {
+    throw "Invalid BIMac log header";
+  }
+  uint32_t numCells{this->_header.rows * this->_header.cols};
+  this->_validBytes = sizeof(this->_header);
+
+  BIMacLogRecordHeader record{};
+  while (f.read(reinterpret_cast<char *>(&record), sizeof(record))) {
+    size_t payloadSize{record.type == kSnapshot
+                           ? (size_t)numCells * 6
+                           : (size_t)record.numEntries * kDeltaEntrySize};
+    if ((record.type == kSnapshot && record.numEntries != numCells) ||
+        record.type > kDelta) {
+      break;
+    }
+    std::vector<int32_t> payload(payloadSize);
+    if (!f.read(reinterpret_cast<char *>(payload.data()),
+                payloadSize * sizeof(int32_t)) ||
+        ModelFile::checksum(payload.data(), payloadSize * sizeof(int32_t)) !=
+            record.checksum) {
+      break; // Incomplete or corrupted tail
+    }
+
+    if (record.type == kSnapshot) {
+      // Snapshots follow the delta for the same episode
+      bool first{this->_snapshots.empty()};
+      if ((first && record.episode != 0) ||
+          (!first && ((int)record.episode != this->lastEpisode() ||
+                      (int)record.episode == this->_snapshotEpisodes.back()))) {
+        throw "BIMac log snapshot out of order";
+      }
+      if (first) {
+        this->_deltas.emplace_back();
+      }
+      this->_snapshotEpisodes.push_back(record.episode);
+      this->_snapshots.push_back(std::move(payload));
+    } else {
+      if (this->_snapshots.empty() ||
+          (int)record.episode != this->lastEpisode() + 1) {
+        throw "BIMac log delta out of order";
+      }
+      for (size_t i{0}; i < payloadSize; i += kDeltaEntrySize) {
+        if (payload[i] < 0 || (uint32_t)payload[i] >= numCells) {
+          throw "BIMac log delta cell out of range";
+        }
+      }
+      this->_deltas.push_back(std::move(payload));
+    }
+    this->_validBytes += sizeof(record) + payloadSize * sizeof(int32_t);
+  }
+
+  if (this->_snapshots.empty()) {
+    throw "BIMac log has no initial snapshot";
+  }
+}
+
+/**
+ * Rebuild the BIMac at a logged episode.
+ */
+std::shared_ptr<BIMac> BIMacLogReader::replay(int episode) const {
+  if (episode < 0 || episode > this->lastEpisode()) {
+    throw "Episode not in BIMac log";
+  }
+
+  // Find the last snapshot at or before the episode
+  int snap{0};
+  while (snap + 1 < this->numSnapshots() &&
+         this->_snapshotEpisodes.at(snap + 1) <= episode) {
+    ++snap;
+  }
+
+  int rows{this->rows()};
+  int cols{this->cols()};
+  size_t numCells{(size_t)rows * cols};
+  const int32_t *data{this->_snapshots.at(snap).data()};
+  auto array{[&](int i) {
+    return Eigen::Map<const Eigen::MatrixXi>{data + i * numCells, rows, cols};
+  }};
+  std::shared_ptr<BIMac> bimac{std::make_shared<BIMac>(
+      array(0), array(1), array(2), array(3), array(4), array(5))};
+
+  std::vector<BIMacObservation> observations{};
+  for (int ep{this->_snapshotEpisodes.at(snap) + 1}; ep <= episode; ++ep) {
+    const std::vector<int32_t> &delta{this->_deltas.at(ep)};
+    observations.clear();
+    for (size_t i{0}; i < delta.size(); i += kDeltaEntrySize) {
+      GridCell cell{delta[i] / rows, delta[i] % rows};
+      observations.push_back(BIMacObservation{
+          cell, delta[i + 1], delta[i + 2], delta[i + 3], delta[i + 4],
+          delta[i + 6], delta[i + 5]});
+    }
+    bimac->updatePosterior(observations);
+  }
+  return bimac;
+}
+
+/**
+ * Rebuild the BIMac at a logged episode.
+ */
+std::shared_ptr<BIMac> BIMacLog::replay(const std::filesystem::path &logFile,
+                                        int episode) {
+  return BIMacLogReader{logFile}.replay(episode);
+}
@@ -0,0 +1,254 @@
+/**
+ * Implementation of offline BIMac training in bimac_trainer.h.
+ * @see bimac_trainer.h
+ *
+ * @author Charlie Street
+ */
+#include "coverage_plan/mod/bimac_trainer.h"
+#include "coverage_plan/mod/bimac.h"
+#include "coverage_plan/mod/bit_grid.h"
+#include "coverage_plan/mod/grid_cell.h"
+#include "coverage_plan/mod/imac_executor.h"
+#include "coverage_plan/mod/map_trace.h"
+#include "coverage_plan/mod/transition_counter.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/**
+ * Stream the map at each timestep of a trace, without loading the whole
+ * trace into memory.
+ *
+ * @param traceFile The trace file (CSV or binary)
+ * @param rows The expected number of rows in the map
+ * @param cols The expected number of columns in the map
+ * @param fn Called with each timestep's map. Streaming stops if it returns
+ * false
+ */
+void streamTrace(const std::filesystem::path &traceFile, int rows, int cols,
+                 const std::function<bool(int, const BitGrid &)> &fn) {
+  std::filesystem::path binaryFile{traceFile};
+  binaryFile.replace_extension(MapTrace::fileExtension);
+  BitGrid map{rows, cols};
+
+  if (std::filesystem::exists(binaryFile)) {
+    MapTraceReader reader{binaryFile};
+    if (reader.rows() != rows || reader.cols() != cols) {
+      throw "Trace dimensions do not match BIMac";
+    }
+    for (int ts{0}; ts < reader.numSteps(); ++ts) {
+      reader.applyStep(ts, map);
+      if (!fn(ts, map)) {
+        return;
+      }
+    }
+    return;
+  }
+
+  std::ifstream f{traceFile};
+  if (!f.is_open()) {
+    throw "Unable to open trace file";
+  }
+
+  // Each line is ts,x,y,occ,x,y,occ,...
+  std::string line{};
+  for (int ts{0}; getline(f, line); ++ts) {
+    map.clear();
+    const char *ptr{line.c_str()};
+    char *end{nullptr};
+    std::strtol(ptr, &end, 10); // Skip the timestep
+    ptr = end;
+    while (*ptr == ',') {
+      int vals[3]{};
+      int numRead{0};
+      for (; numRead < 3 && *ptr == ','; ++numRead) {
+        vals[numRead] = (int)std::strtol(ptr + 1, &end, 10);
+        if (end == ptr + 1) {
+          break;
+        }
+        ptr = end;
+      }
+      if (numRead < 3) {
+        break; // Trailing comma
+      }
+      GridCell cell{vals[0], vals[1]};
+      if (!map.inBounds(cell)) {
+        throw "Trace cell out of bounds";
+      }
+      map.set(cell, vals[2] != 0);
+    }
+    if (!fn(ts, map)) {
+      return;
+    }
+  }
+}
+
+/**
+ * Count traces on several threads, each into its own BIMac, then merge.
+ *
+ * @param numTraces The number of traces
+ * @param xDim The x dimension of the map
+ * @param yDim The y dimension of the map
+ * @param numThreads The number of threads to use
+ * @param countFn Counts trace i into a counter
+ *
+ * @returns The merged BIMac
+ */
+std::shared_ptr<BIMac>
+trainParallel(int numTraces, int xDim, int yDim, int numThreads,
+              const std::function<void(int, TransitionCounter &)> &countFn) {
+  numThreads = std::max(1, std::min(numThreads, numTraces));
+  std::vector<BIMac> partials(numThreads, BIMac{xDim, yDim});
+
+  std::atomic<int> nextTrace{0};
+  std::mutex errorMutex{};
+  std::exception_ptr error{nullptr};
+  auto worker{[&](int id) {
+    TransitionCounter counter{xDim, yDim};
+    try {
+      for (int i{nextTrace++}; i < numTraces; i = nextTrace++) {
+        countFn(i, counter);
+        partials.at(id).updatePosterior(counter.getBIMacObservations());
+      }
+    } catch (...) {
+      // Stop the other workers and report the first error
+      nextTrace = numTraces;
+      std::lock_guard<std::mutex> lock{errorMutex};
+      if (error == nullptr) {
+        error = std::current_exception();
+      }
+    }
+  }};
+
+  std::vector<std::thread> threads{};
+  for (int t{1}; t < numThreads; ++t) {
+    threads.emplace_back(worker, t);
+  }
+  worker(0);
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  if (error != nullptr) {
+    std::rethrow_exception(error);
+  }
+
+  std::shared_ptr<BIMac> bimac{std::make_shared<BIMac>(xDim, yDim)};
+  for (const BIMac &partial : partials) {
+    bimac->merge(partial);
+  }
+  return bimac;
+}
+
+} // namespace
+
+/**
+ * Count the transitions in a single trace.
+ */
+void BIMacTrainer::countTrace(const std::filesystem::path &traceFile,
+                              TransitionCounter &counter,
+                              const std::vector<GridCell> &fov,
+                              const std::vector<GridCell> &trajectory) {
+  counter.reset();
+  int rows{counter.yDim()};
+  int cols{counter.xDim()};
+  std::vector<IMacObservation> obs{};
+
+  if (trajectory.empty()) {
+    obs.resize((size_t)rows * cols);
+    streamTrace(traceFile, rows, cols, [&](int, const BitGrid &map) {
+      for (int x{0}; x < cols; ++x) {
+        for (int y{0}; y < rows; ++y) {
+          obs[x * rows + y] = IMacObservation{GridCell{x, y}, map(y, x)};
+        }
+      }
+      counter.addObservations(obs);
+      return true;
+    });
+    return;
+  }
+
+  streamTrace(traceFile, rows, cols, [&](int ts, const BitGrid &map) {
+    if ((size_t)ts >= trajectory.size()) {
+      return false;
+    }
+    obs.clear();
+    for (const GridCell &offset : fov) {
+      GridCell cell{trajectory.at(ts) + offset};
+      if (map.inBounds(cell)) {
+        obs.push_back(IMacObservation{cell, map.test(cell)});
+      }
+    }
+    counter.addObservations(obs);
+    return true;
+  });
+}
+
+/**
+ * Train a BIMac from a set of traces, with every cell observed.
+ */
+std::shared_ptr<BIMac>
+BIMacTrainer::train(const std::vector<std::filesystem::path> &traceFiles,
+                    int xDim, int yDim, int numThreads) {
+  return trainParallel(traceFiles.size(), xDim, yDim, numThreads,
+                       [&](int i, TransitionCounter &counter) {
+                         BIMacTrainer::countTrace(traceFiles.at(i), counter);
+                       });
+}
+
+/**
+ * Train a BIMac from a set of traces, restricted to a robot's FOV.
+ */
+std::shared_ptr<BIMac> BIMacTrainer::train(
+    const std::vector<std::filesystem::path> &traceFiles, int xDim, int yDim,
+    const std::vector<GridCell> &fov,
+    const std::vector<std::vector<GridCell>> &trajectories, int numThreads) {
+  if (trajectories.size() != traceFiles.size()) {
+    throw "Need one trajectory per trace";
+  }
+  return trainParallel(traceFiles.size(), xDim, yDim, numThreads,
+                       [&](int i, TransitionCounter &counter) {
+                         if (trajectories.at(i).empty()) {
+                           counter.reset(); // Nothing was seen
+                           return;
+                         }
+                         BIMacTrainer::countTrace(traceFiles.at(i), counter,
+                                                  fov, trajectories.at(i));
+                       });
+}
+
+/**
+ * Read a trajectory written by CoverageRobot::logVisitedLocations.
+ */
+std::vector<GridCell>
+BIMacTrainer::readTrajectory(const std::filesystem::path &visitedFile) {
+  std::ifstream f{visitedFile};
+  if (!f.is_open()) {
+    throw "Unable to open trajectory file";
+  }
+  std::vector<GridCell> trajectory{};
+  std::string line{};
+  while (getline(f, line)) {
+    if (line.empty()) {
+      continue;
+    }
+    char *end{nullptr};
+    int x{(int)std::strtol(line.c_str(), &end, 10)};
+    if (*end != ',') {
+      throw "Invalid trajectory file";
+    }
+    int y{(int)std::strtol(end + 1, nullptr, 10)};
+    trajectory.push_back(GridCell{x, y});
+  }
+  return trajectory;
+}
@@ -0,0 +1,316 @@
+/**
+ * Implementation of the BitGrid class in bit_grid.h.
+ * @see bit_grid.h
+ *
+ * @author Charlie Street
+ */
+
+#include "coverage_plan/mod/bit_grid.h"
+#include "coverage_plan/mod/grid_cell.h"
+#include <Eigen/Dense>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <set>
+#include <vector>
+
+namespace {
+
+/**
+ * Per-thread free lists of heap blocks, indexed by their number of words.
+ * Blocks are returned to the pool of whichever thread frees them.
+ *
+ * Members:
+ * * freeLists: The free blocks for each block size
+ */
+struct WordPool {
+  std::vector<std::vector<void *>> freeLists{};
+
+  WordPool();
+  ~WordPool();
+};
+
+// The most blocks of one size kept in a thread's pool
+const size_t kMaxPooledBlocks{1024};
+
+// Trivially destructible, so they can be checked after the pool is destroyed
+thread_local bool poolAlive{false};
+thread_local bool poolDestroyed{false};
+thread_local WordPool pool{};
+
+WordPool::WordPool() { poolAlive = true; }
+
+WordPool::~WordPool() {
+  poolAlive = false;
+  poolDestroyed = true;
+  for (std::vector<void *> &freeList : this->freeLists) {
+    for (void *block : freeList) {
+      ::operator delete(block);
+    }
+  }
+}
+
+/**
+ * Returns this thread's pool, constructing it on first use.
+ *
+ * @returns The pool, or nullptr if it has been destroyed (e.g. when a grid is
+ * allocated by another thread_local's destructor during thread exit)
+ */
+WordPool *livePool() {
+  if (poolDestroyed) {
+    return nullptr;
+  }
+  WordPool &threadPool{pool}; // The constructor sets poolAlive
+  return poolAlive ? &threadPool : nullptr;
+}
+
+} // namespace
+
+/**
+ * Allocates storage for a grid of the current dimensions and layout.
+ */
+void BitGrid::_allocate() {
+  this->_release();
+  int numCells{this->_stride * (this->_cols + 2 * this->_padding)};
+  this->_numWords = (numCells + 63) / 64;
+  this->_inlineWords.fill(0);
+  if (this->_numWords <= kInlineWords) {
+    this->_fillBorder(this->_inlineWords.data());
+    return;
+  }
+
+  void *block{nullptr};
+  WordPool *threadPool{livePool()};
+  if (threadPool != nullptr &&
+      this->_numWords < (int)threadPool->freeLists.size() &&
+      !threadPool->freeLists.at(this->_numWords).empty()) {
+    block = threadPool->freeLists.at(this->_numWords).back();
+    threadPool->freeLists.at(this->_numWords).pop_back();
+  } else {
+    block = ::operator new(sizeof(SharedWords) +
+                           this->_numWords * sizeof(uint64_t));
+  }
+  this->_heapWords = new (block) SharedWords{};
+  this->_heapWords->refs.store(1, std::memory_order_relaxed);
+  this->_heapWords->numWords = this->_numWords;
+  uint64_t *words{this->_heapWords->words()};
+  std::fill(words, words + this->_numWords, 0);
+  this->_fillBorder(words);
+}
+
+/**
+ * Sets all border cells to the border value.
+ */
+void BitGrid::_fillBorder(uint64_t *words) const {
+  if (this->_padding == 0 || !this->_border) {
+    return;
+  }
+  // The first and last columns are all border, as are the first and last
+  // cells of every other column
+  int lastCol{(this->_cols + 1) * this->_stride};
+  for (int row{0}; row < this->_stride; ++row) {
+    words[row >> 6] |= uint64_t{1} << (row & 63);
+    words[(lastCol + row) >> 6] |= uint64_t{1} << ((lastCol + row) & 63);
+  }
+  for (int col{1}; col <= this->_cols; ++col) {
+    int top{col * this->_stride};
+    int bottom{top + this->_stride - 1};
+    words[top >> 6] |= uint64_t{1} << (top & 63);
+    words[bottom >> 6] |= uint64_t{1} << (bottom & 63);
+  }
+}
+
+/**
+ * Drops this grid's reference to its heap block, if it has one.
+ */
+void BitGrid::_release() {
+  SharedWords *block{this->_heapWords};
+  this->_heapWords = nullptr;
+  if (block == nullptr ||
+      block->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+    return;
+  }
+
+  int numWords{block->numWords};
+  block->~SharedWords();
+  if (!poolAlive) {
+    ::operator delete(block);
+    return;
+  }
+  if ((int)pool.freeLists.size() <= numWords) {
+    pool.freeLists.resize(numWords + 1);
+  }
+  if (pool.freeLists.at(numWords).size() < kMaxPooledBlocks) {
+    pool.freeLists.at(numWords).push_back(block);
+  } else {
+    ::operator delete(block);
+  }
+}
+
+/**
+ * Replaces a shared heap block with a private copy.
+ */
+void BitGrid::_unshare() {
+  BitGrid copy{*this};
+  this->_allocate();
+  std::copy(copy._words(), copy._words() + this->_numWords,
+            this->_heapWords->words());
+}
+
+/**
+ * Copies a grid, sharing its heap storage.
+ */
+BitGrid &BitGrid::operator=(const BitGrid &other) {
+  if (this->_heapWords != other._heapWords) {
+    if (other._heapWords != nullptr) {
+      other._heapWords->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    this->_release();
+    this->_heapWords = other._heapWords;
+  }
+  this->_setLayout(other._rows, other._cols, other._padding, other._border);
+  this->_numWords = other._numWords;
+  this->_inlineWords = other._inlineWords;
+  return *this;
+}
+
+/**
+ * Moves a grid, taking its heap storage.
+ */
+BitGrid &BitGrid::operator=(BitGrid &&other) noexcept {
+  if (this != &other) {
+    this->_release();
+    this->_setLayout(other._rows, other._cols, other._padding, other._border);
+    this->_numWords = other._numWords;
+    this->_inlineWords = other._inlineWords;
+    this->_heapWords = other._heapWords;
+    other._setLayout(0, 0, 0, false);
+    other._numWords = 0;
+    other._heapWords = nullptr;
+  }
+  return *this;
+}
+
+/**
+ * Creates a grid of the given dimensions with the bits in cells set to 1.
+ */
+BitGrid::BitGrid(int rows, int cols, const std::set<GridCell> &cells) {
+  this->_setLayout(rows, cols, 0, false);
+  this->_allocate();
+  for (const GridCell &cell : cells) {
+    if (this->inBounds(cell)) {
+      this->set(cell);
+    }
+  }
+}
+
+/**
+ * Copies a grid into the padded layout.
+ */
+BitGrid BitGrid::padded(const BitGrid &grid, bool border) {
+  if (grid._padding == 1 && grid._border == border) {
+    return grid; // Shares storage, so this is O(1)
+  }
+  BitGrid result{};
+  result._setLayout(grid._rows, grid._cols, 1, border);
+  result._allocate();
+  uint64_t *words{result._mutableWords()};
+  for (int col{0}; col < grid._cols; ++col) {
+    for (int row{0}; row < grid._rows; ++row) {
+      if (grid(row, col) != 0) {
+        int idx{result._origin + col * result._stride + row};
+        words[idx >> 6] |= uint64_t{1} << (idx & 63);
+      }
+    }
+  }
+  return result;
+}
+
+/**
+ * Copies a grid into the unpadded layout.
+ */
+BitGrid BitGrid::unpadded(const BitGrid &grid) {
+  if (grid._padding == 0) {
+    return grid;
+  }
+  BitGrid result{grid._rows, grid._cols};
+  uint64_t *words{result._mutableWords()};
+  for (int col{0}; col < grid._cols; ++col) {
+    for (int row{0}; row < grid._rows; ++row) {
+      if (grid(row, col) != 0) {
+        int idx{col * grid._rows + row};
+        words[idx >> 6] |= uint64_t{1} << (idx & 63);
+      }
+    }
+  }
+  return result;
+}
+
+/**
+ * Returns the number of set bits, not including the border.
+ */
+int BitGrid::count() const {
+  const uint64_t *words{this->_words()};
+  int total{0};
+  for (int i{0}; i < this->_numWords; ++i) {
+    total += __builtin_popcountll(words[i]);
+  }
+  if (this->_padding > 0 && this->_border) {
+    total -= 2 * (this->_stride + this->_cols);
+  }
+  return total;
+}
+
+/**
+ * Set every bit to 0, keeping the dimensions and border.
+ */
+void BitGrid::clear() {
+  // Shared storage is swapped for a fresh zeroed block rather than cloned
+  if (this->_heapWords != nullptr &&
+      this->_heapWords->refs.load(std::memory_order_acquire) > 1) {
+    this->_allocate();
+    return;
+  }
+  uint64_t *words{this->_mutableWords()};
+  std::fill(words, words + this->_numWords, 0);
+  this->_fillBorder(words);
+}
+
+/**
+ * Unpacks the grid into an Eigen matrix.
+ */
+Eigen::MatrixXi BitGrid::toMatrix() const {
+  Eigen::MatrixXi mat{this->_rows, this->_cols};
+  for (int col{0}; col < this->_cols; ++col) {
+    for (int row{0}; row < this->_rows; ++row) {
+      mat(row, col) = (*this)(row, col);
+    }
+  }
+  return mat;
+}
+
+/**
+ * Implement == to allow comparisons.
+ */
+bool BitGrid::operator==(const BitGrid &other) const {
+  if (this->_rows != other._rows || this->_cols != other._cols) {
+    return false;
+  }
+  if (this->sharesStorage(other)) {
+    return true;
+  }
+  // Grids with different layouts are compared cell by cell
+  if (this->_padding != other._padding ||
+      (this->_padding > 0 && this->_border != other._border)) {
+    for (int col{0}; col < this->_cols; ++col) {
+      for (int row{0}; row < this->_rows; ++row) {
+        if ((*this)(row, col) != other(row, col)) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+  return std::equal(this->_words(), this->_words() + this->_numWords,
+                    other._words());
+}
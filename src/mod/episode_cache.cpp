@@ -0,0 +1,161 @@
+/**
+ * Implementation of the episode cache in episode_cache.h.
+ * @see episode_cache.h
+ *
+ * @author Charlie Street
+ */
+#include "coverage_plan/mod/episode_cache.h"
+#include "coverage_plan/mod/bit_grid.h"
+#include "coverage_plan/mod/map_trace.h"
+#include <Eigen/Dense>
+#include <filesystem>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace {
+
+using EpisodeFuture = std::shared_future<std::shared_ptr<const Episode>>;
+
+std::mutex cacheMutex{};
+std::map<std::string, EpisodeFuture> cache{};
+
+/**
+ * Get the size and modification time of a file as a string, or "-" if it is
+ * missing.
+ *
+ * @param file The file
+ *
+ * @returns The file's size and modification time as a string
+ */
+std::string fileVersion(const std::filesystem::path &file) {
+  std::error_code err{};
+  std::uintmax_t size{std::filesystem::file_size(file, err)};
+  if (err) {
+    return "-";
+  }
+  std::filesystem::file_time_type time{
+      std::filesystem::last_write_time(file, err)};
+  if (err) {
+    return "-";
+  }
+  return std::to_string(size) + ":" +
+         std::to_string(time.time_since_epoch().count());
+}
+
+/**
+ * Get the cache key for an episode file. The key includes the size and
+ * modification time of the file and any binary trace, so rewritten files are
+ * reloaded.
+ *
+ * @param file The episode file
+ *
+ * @returns The cache key
+ */
+std::string cacheKey(const std::filesystem::path &file) {
+  std::filesystem::path traceFile{file};
+  traceFile.replace_extension(MapTrace::fileExtension);
+  return std::filesystem::absolute(file).string() + "|" + fileVersion(file) +
+         "|" + fileVersion(traceFile);
+}
+
+/**
+ * Decode an episode from file, preferring a binary trace if there is one.
+ *
+ * @param file The episode file
+ *
+ * @returns The decoded episode
+ */
+std::shared_ptr<const Episode> loadEpisode(const std::filesystem::path &file) {
+  std::filesystem::path traceFile{file};
+  traceFile.replace_extension(MapTrace::fileExtension);
+  if (!std::filesystem::exists(traceFile)) {
+    return std::make_shared<const Episode>(MapTrace::readCSV(file));
+  }
+
+  MapTraceReader reader{traceFile};
+  std::shared_ptr<Episode> episode{std::make_shared<Episode>()};
+  episode->reserve(reader.numSteps());
+  BitGrid map{};
+  for (int ts{0}; ts < reader.numSteps(); ++ts) {
+    reader.applyStep(ts, map);
+    episode->push_back(map.toMatrix());
+  }
+  return episode;
+}
+
+/**
+ * Find or insert the cache entry for an episode.
+ *
+ * @param file The episode file
+ * @param policy The launch policy to use if the episode isn't cached
+ *
+ * @returns The future holding the decoded episode
+ */
+EpisodeFuture findOrLoad(const std::filesystem::path &file,
+                         std::launch policy) {
+  std::string key{cacheKey(file)};
+  std::lock_guard<std::mutex> lock{cacheMutex};
+  auto it{cache.find(key)};
+  if (it != cache.end()) {
+    return it->second;
+  }
+  EpisodeFuture future{
+      std::async(policy, loadEpisode, std::filesystem::absolute(file))
+          .share()};
+  cache.emplace(key, future);
+  return future;
+}
+
+} // namespace
+
+/**
+ * Get a decoded episode, loading it if it isn't already cached.
+ */
+std::shared_ptr<const Episode>
+EpisodeCache::get(const std::filesystem::path &file) {
+  // Deferred, so a cache miss is loaded on this thread when get() is called
+  return findOrLoad(file, std::launch::deferred).get();
+}
+
+/**
+ * Start loading an episode on a background thread.
+ */
+void EpisodeCache::prefetch(const std::filesystem::path &file) {
+  findOrLoad(file, std::launch::async);
+}
+
+/**
+ * Check if an episode is cached (or being loaded).
+ */
+bool EpisodeCache::contains(const std::filesystem::path &file) {
+  std::lock_guard<std::mutex> lock{cacheMutex};
+  return cache.find(cacheKey(file)) != cache.end();
+}
+
+/**
+ * Returns the number of episodes in the cache.
+ */
+int EpisodeCache::size() {
+  std::lock_guard<std::mutex> lock{cacheMutex};
+  return cache.size();
+}
+
+/**
+ * Remove all episodes from the cache.
+ */
+void EpisodeCache::clear() {
+  std::map<std::string, EpisodeFuture> oldCache{};
+  {
+    std::lock_guard<std::mutex> lock{cacheMutex};
+    oldCache.swap(cache);
+  }
+  // Wait for background loads outside the lock
+  for (const auto &entry : oldCache) {
+    entry.second.wait();
+  }
+}
@@ -6,46 +6,31 @@
  */
 
 #include "coverage_plan/mod/fixed_imac_executor.h"
+#include "coverage_plan/mod/episode_cache.h"
 #include "coverage_plan/mod/imac_executor.h"
-#include <fstream>
 #include <iostream>
-#include <sstream>
-#include <string>
 
 /**
- * Reads in data from file for new episode to get IMac trace.
+ * Gets the IMac trace for the new episode from the episode cache.
  */
 void FixedIMacExecutor::_setCurrentEpisode() {
-  this->_currentEpisode.clear();
-  std::ifstream f{this->_files.at(this->_episode)};
-  if (f.is_open()) {
-    // Placeholder variables for file reading
-    std::string row{};
-    std::string entry{};
-    std::vector<int> matAtTs{};
+  this->_currentEpisode = EpisodeCache::get(this->_files.at(this->_episode));
 
-    while (getline(f, row)) {
-      std::stringstream rowStream{row};
-      while (getline(rowStream, entry, ',')) {
-        // Get each number in the file
-        matAtTs.push_back(std::stoi(entry));
-      }
-
-      // Now reconstruct the matrix, assuming format output in logMapDynamics
-      Eigen::MatrixXi currentMat{this->_yDim, this->_xDim};
-      for (int i{1}; i < matAtTs.size(); i += 3) {
-        currentMat(matAtTs.at(i + 1), matAtTs.at(i)) = matAtTs.at(i + 2);
-      }
-      this->_currentEpisode.push_back(currentMat);
-      matAtTs.clear();
-    }
+  if (!this->_currentEpisode->empty() &&
+      (this->_currentEpisode->at(0).rows() != this->_yDim ||
+       this->_currentEpisode->at(0).cols() != this->_xDim)) {
+    throw "Episode dimensions do not match FixedIMacExecutor";
   }
+
+  // Load the next episode while this one runs
+  EpisodeCache::prefetch(
+      this->_files.at((this->_episode + 1) % this->_files.size()));
 }
 
 /**
  * Restart the simulation and start running the next episode.
  */
-Eigen::MatrixXi
+const Eigen::MatrixXi &
 FixedIMacExecutor::restart(const std::vector<IMacObservation> &observations) {
   this->_mapDynamics.clear(); // Clear as new run
   ++this->_episode;
@@ -59,7 +44,7 @@ FixedIMacExecutor::restart(const std::vector<IMacObservation> &observations) {
   // Get new matrices
   this->_setCurrentEpisode();
 
-  this->_currentState = this->_currentEpisode.at(this->_ts);
+  this->_currentState = this->_currentEpisode->at(this->_ts);
 
   this->_addMapForTs();
   return this->_currentState;
@@ -68,20 +53,20 @@ FixedIMacExecutor::restart(const std::vector<IMacObservation> &observations) {
 /**
  * Move onto the next IMac state in the episode
  */
-Eigen::MatrixXi FixedIMacExecutor::updateState(
+const Eigen::MatrixXi &FixedIMacExecutor::updateState(
     const std::vector<IMacObservation> &observations) {
 
   // Update timestep and check if we've reached the end
   ++this->_ts;
 
-  if (this->_ts >= this->_currentEpisode.size()) {
+  if (this->_ts >= this->_currentEpisode->size()) {
     std::cerr
         << "ERROR: Trying to update FixedIMacExecutor after end of episode.\n";
     throw "ERROR: Trying to update FixedIMacExecutor after end of episode.\n";
   }
 
-  // Get next state from episode vector
-  this->_currentState = this->_currentEpisode.at(this->_ts);
+  // Get next state from episode
+  this->_currentState = this->_currentEpisode->at(this->_ts);
 
   this->_addMapForTs();
   return this->_currentState;
@@ -5,10 +5,17 @@
  */
 
 #include "coverage_plan/mod/imac.h"
+#include "coverage_plan/mod/bit_grid.h"
+#include "coverage_plan/mod/grid_cell.h"
+#include "coverage_plan/util/counter_rng.h"
 #include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <memory>
+#include <random>
 
 /**
  * Reads IMac matrix in from file.
@@ -49,6 +56,20 @@ Eigen::MatrixXd IMac::_readIMacMatrix(const std::filesystem::path &inFile) {
   return matrix;
 }
 
+/**
+ * Computes the stationary occupancy probability of each cell.
+ */
+Eigen::MatrixXd IMac::_computeStationary(const Eigen::MatrixXd &entryMatrix,
+                                         const Eigen::MatrixXd &exitMatrix) {
+  // If entry + exit = 0 the cell never changes, so mixing = 1 and the
+  // stationary value never affects forwardSteps
+  Eigen::MatrixXd total{entryMatrix + exitMatrix};
+  return Eigen::MatrixXd::NullaryExpr(
+      entryMatrix.rows(), entryMatrix.cols(), [&](Eigen::Index i) {
+        return total(i) > 0.0 ? entryMatrix(i) / total(i) : 0.0;
+      });
+}
+
 /**
  * Write a single IMac matrix to file.
  */
@@ -83,10 +104,265 @@ Eigen::MatrixXd IMac::estimateStaticOccupancy() {
  * timestep
  */
 Eigen::MatrixXd IMac::forwardStep(const Eigen::MatrixXd &currentBelief) const {
-  Eigen::MatrixXd ones{Eigen::MatrixXd::Ones(this->_entryMatrix.rows(),
-                                             this->_entryMatrix.cols())};
-  return (ones - currentBelief).cwiseProduct(this->_entryMatrix) +
-         currentBelief.cwiseProduct((ones - this->_exitMatrix));
+  Eigen::MatrixXd nextBelief{this->_entryMatrix.rows(),
+                             this->_entryMatrix.cols()};
+  this->forwardStep(currentBelief, nextBelief);
+  return nextBelief;
+}
+
+/**
+ * Runs a given belief or state through IMac, writing into nextBelief.
+ */
+void IMac::forwardStep(const Eigen::Ref<const Eigen::MatrixXd> &currentBelief,
+                       Eigen::Ref<Eigen::MatrixXd> nextBelief) const {
+  Eigen::Index rows{this->_entryMatrix.rows()};
+  Eigen::Index cols{this->_entryMatrix.cols()};
+  if (currentBelief.rows() != rows || currentBelief.cols() != cols ||
+      nextBelief.rows() != rows || nextBelief.cols() != cols ||
+      currentBelief.outerStride() != rows || nextBelief.outerStride() != rows) {
+    throw "IMac beliefs must be contiguous and match the map dimensions";
+  }
+  const double *entry{this->_entryMatrix.data()};
+  const double *mixing{this->_mixingMatrix.data()};
+  const double *current{currentBelief.data()};
+  double *next{nextBelief.data()};
+
+  // Static cells take their static value, which is the entry probability
+  for (int idx : this->_staticCells) {
+    next[idx] = entry[idx];
+  }
+  // (1 - b) * entry + b * (1 - exit) = entry + b * (1 - entry - exit)
+  for (int idx : this->_dynamicCells) {
+    next[idx] = entry[idx] + current[idx] * mixing[idx];
+  }
+}
+
+/**
+ * Runs a given belief or state through IMac for k timesteps.
+ */
+Eigen::MatrixXd IMac::forwardSteps(const Eigen::MatrixXd &currentBelief,
+                                   int k) const {
+  if (k < 0) {
+    throw "Cannot propagate IMac belief a negative number of steps.";
+  }
+  return (this->_stationaryMatrix.array() +
+          this->_mixingMatrix.array().pow(k) *
+              (currentBelief.array() - this->_stationaryMatrix.array()))
+      .matrix();
+}
+
+/**
+ * Computes the occupancy probability of a single cell k timesteps from now.
+ */
+double IMac::forwardSteps(const GridCell &cell, double currentProb,
+                          int k) const {
+  if (k < 0) {
+    throw "Cannot propagate IMac belief a negative number of steps.";
+  }
+  // y is row, x is column
+  double stationary{this->_stationaryMatrix(cell.y, cell.x)};
+  return stationary +
+         std::pow(this->_mixingMatrix(cell.y, cell.x), k) *
+             (currentProb - stationary);
+}
+
+/**
+ * Samples a block of dynamic cells in a binary map.
+ */
+void IMac::_sampleDynamicBlock(uint64_t *words, const int *bits,
+                               const double *randoms, int start,
+                               int numCells) const {
+  const double *entry{this->_entryMatrix.data()};
+  const double *stay{this->_stayMatrix.data()};
+  const int *dynamic{this->_dynamicCells.data() + start};
+  bits += start;
+  for (int i{0}; i < numCells; ++i) {
+    int idx{dynamic[i]};
+    uint64_t mask{uint64_t{1} << (bits[i] & 63)};
+    uint64_t &word{words[bits[i] >> 6]};
+    double prob{(word & mask) ? stay[idx] : entry[idx]};
+    word = (word & ~mask) | (-(uint64_t)(randoms[i] <= prob) & mask);
+  }
+}
+
+/**
+ * Sets all static cells in a binary map to their static value.
+ */
+void IMac::_setStaticCells(uint64_t *words, int padding) const {
+  bool padded{padding > 0};
+  const uint64_t *dynamicMask{padded ? this->_paddedDynamicMask.data()
+                                     : this->_dynamicMask.data()};
+  const uint64_t *staticOccupied{padded
+                                     ? this->_paddedStaticOccupiedMask.data()
+                                     : this->_staticOccupiedMask.data()};
+  int numWords{padded ? this->_paddedDynamicMask.numWords()
+                      : this->_dynamicMask.numWords()};
+  for (int w{0}; w < numWords; ++w) {
+    words[w] = (words[w] & dynamicMask[w]) | staticOccupied[w];
+  }
+}
+
+/**
+ * Runs a binary map state through IMac and samples the next state, in place.
+ */
+void IMac::forwardStepAndSample(BitGrid &map, std::mt19937_64 &gen) const {
+  std::uniform_real_distribution<double> sampler{0.0, 1.0};
+  uint64_t *words{map.data()};
+  const int *bits{this->_dynamicBits(map.padding()).data()};
+
+  // Only dynamic cells are sampled, 64 at a time. The random draws are
+  // separated from the thresholding to keep the latter loop tight
+  double randoms[64];
+  int numDynamic{(int)this->_dynamicCells.size()};
+  for (int start{0}; start < numDynamic; start += 64) {
+    int numCells{std::min(64, numDynamic - start)};
+    for (int i{0}; i < numCells; ++i) {
+      randoms[i] = sampler(gen);
+    }
+    this->_sampleDynamicBlock(words, bits, randoms, start, numCells);
+  }
+  this->_setStaticCells(words, map.padding());
+}
+
+/**
+ * Runs a binary map state through IMac and samples the next state, in place.
+ */
+void IMac::forwardStepAndSample(Eigen::MatrixXi &map,
+                                std::mt19937_64 &gen) const {
+  std::uniform_real_distribution<double> sampler{0.0, 1.0};
+  const double *entry{this->_entryMatrix.data()};
+  const double *stay{this->_stayMatrix.data()};
+  int *cells{map.data()};
+
+  // Same blocking as the BitGrid version
+  double randoms[64];
+  int numDynamic{(int)this->_dynamicCells.size()};
+  for (int start{0}; start < numDynamic; start += 64) {
+    int numCells{std::min(64, numDynamic - start)};
+    for (int i{0}; i < numCells; ++i) {
+      randoms[i] = sampler(gen);
+    }
+    for (int i{0}; i < numCells; ++i) {
+      int idx{this->_dynamicCells[start + i]};
+      double prob{cells[idx] != 0 ? stay[idx] : entry[idx]};
+      cells[idx] = randoms[i] <= prob ? 1 : 0;
+    }
+  }
+
+  // Static cells take their static value, which is the entry probability
+  for (int idx : this->_staticCells) {
+    cells[idx] = (int)entry[idx];
+  }
+}
+
+/**
+ * Runs a binary map state through IMac and samples the next state, in place,
+ * using a counter-based random number generator.
+ */
+void IMac::forwardStepAndSample(BitGrid &map, uint64_t seed,
+                                uint64_t time) const {
+  this->forwardStepAndSample(map.data(), map.padding(), seed, time);
+}
+
+/**
+ * Runs a binary map state, stored as raw words, through IMac and samples the
+ * next state, in place, using a counter-based random number generator.
+ */
+void IMac::forwardStepAndSample(uint64_t *words, int padding, uint64_t seed,
+                                uint64_t time) const {
+  const int *bits{this->_dynamicBits(padding).data()};
+
+  // Each Philox call gives the draws for a pair of cells, indexed by the
+  // linear (column major) index of the first cell. Adjacent dynamic cells
+  // often share a pair, so the last pair is reused where possible
+  double randoms[64];
+  double pair[2]{};
+  int lastPair{-1};
+  int numDynamic{(int)this->_dynamicCells.size()};
+  for (int start{0}; start < numDynamic; start += 64) {
+    int numCells{std::min(64, numDynamic - start)};
+    for (int i{0}; i < numCells; ++i) {
+      int idx{this->_dynamicCells[start + i]};
+      if (idx / 2 != lastPair) {
+        lastPair = idx / 2;
+        CounterRNG::uniformPair(seed, time, lastPair, pair[0], pair[1]);
+      }
+      randoms[i] = pair[idx & 1];
+    }
+    this->_sampleDynamicBlock(words, bits, randoms, start, numCells);
+  }
+  this->_setStaticCells(words, padding);
+}
+
+/**
+ * Classifies each cell as static free, static occupied or dynamic.
+ */
+void IMac::_classifyCells() {
+  int rows{(int)this->_entryMatrix.rows()};
+  int cols{(int)this->_entryMatrix.cols()};
+  this->_dynamicCells.clear();
+  this->_staticCells.clear();
+  this->_dynamicMask = BitGrid{rows, cols};
+  this->_staticOccupiedMask = BitGrid{rows, cols};
+
+  // Iterate in column major order so the index lists are sorted
+  for (int x{0}; x < cols; ++x) {
+    for (int y{0}; y < rows; ++y) {
+      int idx{x * rows + y};
+      switch (this->getCellDynamics(GridCell{x, y})) {
+      case CellDynamics::dynamic:
+        this->_dynamicCells.push_back(idx);
+        this->_dynamicMask(y, x) = 1;
+        break;
+      case CellDynamics::staticOccupied:
+        this->_staticCells.push_back(idx);
+        this->_staticOccupiedMask(y, x) = 1;
+        break;
+      case CellDynamics::staticFree:
+        this->_staticCells.push_back(idx);
+        break;
+      }
+    }
+  }
+}
+
+/**
+ * Fills in the padded matrices, cell indices and masks.
+ */
+void IMac::_buildPaddedLayout() {
+  int rows{(int)this->_entryMatrix.rows()};
+  int cols{(int)this->_entryMatrix.cols()};
+
+  // The border behaves as static occupied cells
+  this->_paddedEntryMatrix = Eigen::MatrixXd::Ones(rows + 2, cols + 2);
+  this->_paddedEntryMatrix.block(1, 1, rows, cols) = this->_entryMatrix;
+  this->_paddedExitMatrix = Eigen::MatrixXd::Zero(rows + 2, cols + 2);
+  this->_paddedExitMatrix.block(1, 1, rows, cols) = this->_exitMatrix;
+
+  this->_paddedDynamicMask = BitGrid::padded(this->_dynamicMask, true);
+  this->_paddedStaticOccupiedMask =
+      BitGrid::padded(this->_staticOccupiedMask, false);
+  this->_paddedDynamicCells.clear();
+  for (int idx : this->_dynamicCells) {
+    this->_paddedDynamicCells.push_back(this->_paddedDynamicMask.index(
+        GridCell{idx / rows, idx % rows}));
+  }
+}
+
+/**
+ * Returns the classification of a single cell's dynamics.
+ */
+CellDynamics IMac::getCellDynamics(const GridCell &cell) const {
+  // y is row, x is column
+  double entry{this->_entryMatrix(cell.y, cell.x)};
+  double exit{this->_exitMatrix(cell.y, cell.x)};
+  double init{this->_initialBelief(cell.y, cell.x)};
+  if (entry == 0.0 && exit == 1.0 && init == 0.0) {
+    return CellDynamics::staticFree;
+  } else if (entry == 1.0 && exit == 0.0 && init == 1.0) {
+    return CellDynamics::staticOccupied;
+  }
+  return CellDynamics::dynamic;
 }
 
 /**
@@ -6,6 +6,8 @@
  */
 
 #include "coverage_plan/mod/imac_belief_sampler.h"
+#include "coverage_plan/mod/bit_grid.h"
+#include "coverage_plan/mod/imac.h"
 #include "coverage_plan/util/seed.h"
 
 /**
@@ -26,4 +28,15 @@ Eigen::MatrixXi IMacBeliefSampler::sampleFromBelief(
   }
 
   return sampledState;
+}
+
+/**
+ * Run a map state through an IMac model and sample the next state in place.
+ */
+void IMacBeliefSampler::forwardStepAndSample(const IMac &imac, BitGrid &map,
+                                             const double &seed) {
+  if (seed != 0.0) {
+    this->_gen.seed(SeedHelpers::doubleToUInt64(seed));
+  }
+  imac.forwardStepAndSample(map, this->_gen);
 }
\ No newline at end of file
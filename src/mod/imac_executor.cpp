@@ -5,7 +5,9 @@
  */
 
 #include "coverage_plan/mod/imac_executor.h"
+#include "coverage_plan/mod/bit_grid.h"
 #include "coverage_plan/mod/imac.h"
+#include "coverage_plan/mod/map_trace.h"
 #include <Eigen/Dense>
 #include <fstream>
 #include <memory>
@@ -15,7 +17,9 @@
  * Store the current state of the map for logging purposes.
  */
 void IMacExecutor::_addMapForTs() {
-  this->_mapDynamics.push_back(this->_currentState);
+  if (this->_keepHistory) {
+    this->_mapDynamics.addStep(this->_currentState);
+  }
 }
 
 /**
@@ -24,16 +28,33 @@ void IMacExecutor::_addMapForTs() {
 Eigen::MatrixXi IMacExecutor::_sampleState(const Eigen::MatrixXd &distMatrix) {
   // Return 1 if sampled double is <= value in distMatrix, else 0
   // A value of 1 means the cell is occupied
-  return Eigen::MatrixXi::NullaryExpr(
-      distMatrix.rows(), distMatrix.cols(), [&](Eigen::Index i) {
-        return (this->_sampler(this->_gen) <= distMatrix(i)) ? 1 : 0;
-      });
+  if (this->_imac == nullptr ||
+      this->_imac->getDynamicCells().size() +
+              this->_imac->getStaticCells().size() !=
+          (size_t)distMatrix.size()) {
+    return Eigen::MatrixXi::NullaryExpr(
+        distMatrix.rows(), distMatrix.cols(), [&](Eigen::Index i) {
+          return (this->_sampler(this->_gen) <= distMatrix(i)) ? 1 : 0;
+        });
+  }
+
+  // Only sample the dynamic cells, static cells are either 0 or 1
+  Eigen::MatrixXi sampledState{distMatrix.rows(), distMatrix.cols()};
+  const double *probs{distMatrix.data()};
+  int *cells{sampledState.data()};
+  for (int idx : this->_imac->getStaticCells()) {
+    cells[idx] = probs[idx] >= 0.5 ? 1 : 0;
+  }
+  for (int idx : this->_imac->getDynamicCells()) {
+    cells[idx] = (this->_sampler(this->_gen) <= probs[idx]) ? 1 : 0;
+  }
+  return sampledState;
 }
 
 /**
  * Restarts the MoD execution
  */
-Eigen::MatrixXi
+const Eigen::MatrixXi &
 IMacExecutor::restart(const std::vector<IMacObservation> &observations) {
   this->_mapDynamics.clear(); // Clear as new run
   this->_currentState = this->_sampleState(this->_imac->getInitialBelief());
@@ -52,11 +73,10 @@ IMacExecutor::restart(const std::vector<IMacObservation> &observations) {
 /**
  * Updates the current MoD state based on the IMac model and observations
  */
-Eigen::MatrixXi
+const Eigen::MatrixXi &
 IMacExecutor::updateState(const std::vector<IMacObservation> &observations) {
   // First, sample through the next belief in the iMac model
-  this->_currentState = this->_sampleState(
-      _imac->forwardStep(this->_currentState.cast<double>()));
+  this->_imac->forwardStepAndSample(this->_currentState, this->_gen);
 
   // Explicitly set the values in the observation list
   for (IMacObservation obs : observations) {
@@ -72,10 +92,19 @@ IMacExecutor::updateState(const std::vector<IMacObservation> &observations) {
  * Output the map dynamic information into a csv file.
  */
 void IMacExecutor::logMapDynamics(const std::filesystem::path &outFile) {
+  if (!this->_keepHistory) {
+    throw "Map dynamics history is switched off";
+  }
+  if (outFile.extension() == MapTrace::fileExtension) {
+    this->_mapDynamics.write(outFile);
+    return;
+  }
+
   std::ofstream f{outFile};
   if (f.is_open()) {
-    int ts{0};
-    for (const Eigen::MatrixXi &mapAtTs : this->_mapDynamics) {
+    BitGrid mapAtTs{};
+    for (int ts{0}; ts < this->_mapDynamics.numSteps(); ++ts) {
+      this->_mapDynamics.applyStep(ts, mapAtTs);
       f << ts << ',';
       // Recall that coordinate (x,y) is (y,x) wrt. matrix indexing
       for (int y{0}; y < mapAtTs.rows(); ++y) {
@@ -84,7 +113,6 @@ void IMacExecutor::logMapDynamics(const std::filesystem::path &outFile) {
         }
       }
       f << '\n';
-      ++ts;
     }
   }
   f.close();
@@ -93,8 +121,18 @@ void IMacExecutor::logMapDynamics(const std::filesystem::path &outFile) {
 /**
  * Clear the robot's position in the map.
  */
-Eigen::MatrixXi IMacExecutor::clearRobotPosition(const GridCell &cell) {
+const Eigen::MatrixXi &IMacExecutor::clearRobotPosition(const GridCell &cell) {
   this->_currentState(cell.y, cell.x) = 0;
-  this->_mapDynamics.at(this->_mapDynamics.size() - 1)(cell.y, cell.x) = 0;
+  if (this->_keepHistory) {
+    this->_mapDynamics.setCell(cell, false);
+  }
   return this->_currentState;
-}
\ No newline at end of file
+}
+
+/**
+ * Switch recording of the map history on or off.
+ */
+void IMacExecutor::setKeepHistory(bool keepHistory) {
+  this->_keepHistory = keepHistory;
+  this->_mapDynamics.clear();
+}
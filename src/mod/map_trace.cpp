@@ -0,0 +1,504 @@
+/**
+ * Implementation of the binary trace format in map_trace.h.
+ * @see map_trace.h
+ *
+ * @author Charlie Street
+ */
+#include "coverage_plan/mod/map_trace.h"
+#include "coverage_plan/mod/bit_grid.h"
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// Records are written straight from memory, so the host must be little-endian
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "Trace files require a little-endian host");
+
+namespace {
+
+const char kMagic[8]{'C', 'O', 'V', 'T', 'R', 'A', 'C', 'E'};
+const uint32_t kVersion{1};
+const uint8_t kKeyframe{0};
+const uint8_t kDelta{1};
+
+/**
+ * Append an unsigned LEB128 varint to a buffer.
+ *
+ * @param value The value to append
+ * @param buffer The buffer to append to
+ */
+void putVarint(uint32_t value, std::vector<uint8_t> &buffer) {
+  while (value >= 0x80) {
+    buffer.push_back((uint8_t)(value | 0x80));
+    value >>= 7;
+  }
+  buffer.push_back((uint8_t)value);
+}
+
+/**
+ * Read an unsigned LEB128 varint, throwing if it runs past end.
+ *
+ * @param ptr The read position, advanced past the varint
+ * @param end The end of the readable region
+ *
+ * @returns The decoded value
+ */
+uint32_t getVarint(const uint8_t *&ptr, const uint8_t *end) {
+  uint32_t value{0};
+  for (int shift{0}; shift < 35; shift += 7) {
+    if (ptr >= end) {
+      throw "Truncated trace record";
+    }
+    uint8_t byte{*ptr++};
+    value |= (uint32_t)(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+  throw "Invalid varint in trace record";
+}
+
+/**
+ * Returns the number of bytes putVarint uses for a value.
+ *
+ * @param value The value to encode
+ *
+ * @returns The encoded size in bytes
+ */
+size_t varintSize(uint32_t value) {
+  size_t numBytes{1};
+  while (value >= 0x80) {
+    value >>= 7;
+    ++numBytes;
+  }
+  return numBytes;
+}
+
+/**
+ * Append the record for a map to a buffer. A delta against prev is written,
+ * unless a keyframe is requested or the delta would be larger than one.
+ *
+ * @param map The map to encode
+ * @param prev The map at the previous step. Ignored for keyframes
+ * @param keyframe True if a keyframe must be written
+ * @param records The buffer to append to
+ *
+ * @returns True if a keyframe was written
+ */
+bool encodeRecord(const BitGrid &map, const BitGrid &prev, bool keyframe,
+                  std::vector<uint8_t> &records) {
+  size_t keyframeBytes{(size_t)map.numWords() * sizeof(uint64_t)};
+  const uint64_t *words{map.data()};
+  const uint64_t *prevWords{prev.data()};
+
+  // Size the delta first, so nothing is written if a keyframe is smaller
+  uint32_t numChanged{0};
+  if (!keyframe) {
+    size_t deltaBytes{0};
+    uint32_t last{0};
+    for (int w{0}; w < map.numWords(); ++w) {
+      uint64_t diff{words[w] ^ prevWords[w]};
+      while (diff != 0) {
+        uint32_t idx{(uint32_t)(w * 64 + __builtin_ctzll(diff))};
+        deltaBytes += varintSize(idx - last);
+        last = idx;
+        ++numChanged;
+        diff &= diff - 1;
+      }
+    }
+    deltaBytes += varintSize(numChanged);
+    keyframe = deltaBytes >= keyframeBytes;
+  }
+
+  if (keyframe) {
+    records.push_back(kKeyframe);
+    const uint8_t *bytes{reinterpret_cast<const uint8_t *>(words)};
+    records.insert(records.end(), bytes, bytes + keyframeBytes);
+    return true;
+  }
+
+  records.push_back(kDelta);
+  putVarint(numChanged, records);
+  uint32_t last{0};
+  for (int w{0}; w < map.numWords(); ++w) {
+    uint64_t diff{words[w] ^ prevWords[w]};
+    while (diff != 0) {
+      uint32_t idx{(uint32_t)(w * 64 + __builtin_ctzll(diff))};
+      putVarint(idx - last, records);
+      last = idx;
+      diff &= diff - 1;
+    }
+  }
+  return false;
+}
+
+/**
+ * Apply a single record to a map.
+ *
+ * @param ptr The start of the record (its type byte)
+ * @param end The end of the readable region
+ * @param rows The number of rows in the trace
+ * @param cols The number of columns in the trace
+ * @param map The map to update in place. Resized for keyframes if dimensions
+ * differ
+ */
+void decodeRecord(const uint8_t *ptr, const uint8_t *end, int rows, int cols,
+                  BitGrid &map) {
+  uint8_t type{*ptr++};
+
+  if (type == kKeyframe) {
+    // Records hold unpadded words, so padded maps are replaced too
+    if (map.rows() != rows || map.cols() != cols || map.padding() != 0) {
+      map = BitGrid{rows, cols};
+    }
+    size_t numBytes{(size_t)map.numWords() * sizeof(uint64_t)};
+    if ((size_t)(end - ptr) < numBytes) {
+      throw "Truncated trace record";
+    }
+    std::memcpy(map.data(), ptr, numBytes);
+  } else if (type == kDelta) {
+    if (map.rows() != rows || map.cols() != cols || map.padding() != 0) {
+      throw "Map dimensions do not match trace";
+    }
+    uint64_t *words{map.data()};
+    uint32_t numChanged{getVarint(ptr, end)};
+    uint32_t idx{0};
+    for (uint32_t i{0}; i < numChanged; ++i) {
+      idx += getVarint(ptr, end);
+      if (idx >= (uint32_t)map.size()) {
+        throw "Trace cell index out of range";
+      }
+      words[idx >> 6] ^= uint64_t{1} << (idx & 63);
+    }
+  } else {
+    throw "Unknown trace record type";
+  }
+}
+
+} // namespace
+
+/**
+ * Maps a trace file into memory and validates its header.
+ */
+MapTraceReader::MapTraceReader(const std::filesystem::path &inFile) {
+  this->_fd = open(inFile.c_str(), O_RDONLY);
+  if (this->_fd < 0) {
+    throw "Unable to open trace file";
+  }
+
+  struct stat fileStat {};
+  if (fstat(this->_fd, &fileStat) != 0 ||
+      (size_t)fileStat.st_size < sizeof(MapTraceHeader)) {
+    this->_close();
+    throw "Trace file too small to contain a header";
+  }
+  this->_size = (size_t)fileStat.st_size;
+
+  this->_data =
+      mmap(nullptr, this->_size, PROT_READ, MAP_PRIVATE, this->_fd, 0);
+  if (this->_data == MAP_FAILED) {
+    this->_data = nullptr;
+    this->_close();
+    throw "Unable to memory map trace file";
+  }
+
+  std::memcpy(&this->_header, this->_data, sizeof(MapTraceHeader));
+  const MapTraceHeader &header{this->_header};
+
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+    this->_close();
+    throw "Not a trace file";
+  }
+  if (header.version != kVersion) {
+    this->_close();
+    throw "Unsupported trace file version";
+  }
+  // The index is 8-byte aligned by the writer
+  if (header.indexOffset % sizeof(uint64_t) != 0 ||
+      header.indexOffset < sizeof(MapTraceHeader) ||
+      header.indexOffset + (uint64_t)header.numSteps * sizeof(uint64_t) !=
+          this->_size) {
+    this->_close();
+    throw "Trace file size does not match header";
+  }
+
+  this->_index = reinterpret_cast<const uint64_t *>(
+      static_cast<const uint8_t *>(this->_data) + header.indexOffset);
+  for (int ts{0}; ts < this->numSteps(); ++ts) {
+    if (this->_index[ts] < sizeof(MapTraceHeader) ||
+        this->_index[ts] >= header.indexOffset) {
+      this->_close();
+      throw "Invalid trace record offset";
+    }
+  }
+  if (this->numSteps() > 0 && !this->isKeyframe(0)) {
+    this->_close();
+    throw "First trace record must be a keyframe";
+  }
+}
+
+/**
+ * Returns a pointer to the start of a record in the mapped file.
+ */
+const uint8_t *MapTraceReader::_record(int ts) const {
+  if (ts < 0 || ts >= this->numSteps()) {
+    throw "Trace timestep out of range";
+  }
+  return static_cast<const uint8_t *>(this->_data) + this->_index[ts];
+}
+
+/**
+ * Unmaps and closes the file, if open.
+ */
+void MapTraceReader::_close() {
+  if (this->_data != nullptr) {
+    munmap(this->_data, this->_size);
+    this->_data = nullptr;
+  }
+  if (this->_fd >= 0) {
+    close(this->_fd);
+    this->_fd = -1;
+  }
+}
+
+/**
+ * Check if the record for a timestep is a keyframe.
+ */
+bool MapTraceReader::isKeyframe(int ts) const {
+  return *this->_record(ts) == kKeyframe;
+}
+
+/**
+ * Apply a single record to a map.
+ */
+void MapTraceReader::applyStep(int ts, BitGrid &map) const {
+  decodeRecord(this->_record(ts),
+               static_cast<const uint8_t *>(this->_data) +
+                   this->_header.indexOffset,
+               this->rows(), this->cols(), map);
+}
+
+/**
+ * Decode the map at any timestep, seeking from the previous keyframe.
+ */
+BitGrid MapTraceReader::getStep(int ts) const {
+  int keyframe{ts};
+  while (!this->isKeyframe(keyframe)) {
+    --keyframe;
+  }
+  BitGrid map{this->rows(), this->cols()};
+  for (int t{keyframe}; t <= ts; ++t) {
+    this->applyStep(t, map);
+  }
+  return map;
+}
+
+/**
+ * Creates an empty trace.
+ */
+MapTraceRecorder::MapTraceRecorder(int keyframeInterval)
+    : _keyframeInterval{keyframeInterval} {
+  if (keyframeInterval < 1) {
+    throw "Keyframe interval must be positive";
+  }
+}
+
+/**
+ * Encodes the latest step and appends it to the records.
+ */
+void MapTraceRecorder::_encodeLatest() {
+  this->_index.push_back(this->_records.size());
+  bool keyframe{this->_index.size() == 1 ||
+                this->_sinceKeyframe >= this->_keyframeInterval};
+  if (encodeRecord(this->_latest, this->_encoded, keyframe, this->_records)) {
+    this->_sinceKeyframe = 1;
+  } else {
+    ++this->_sinceKeyframe;
+  }
+  this->_encoded = this->_latest;
+}
+
+/**
+ * Checks a new step has the same dimensions as the recorded steps.
+ */
+void MapTraceRecorder::_checkDimensions(int rows, int cols) const {
+  if (this->_numSteps > 0 &&
+      (rows != this->_latest.rows() || cols != this->_latest.cols())) {
+    throw "All maps in a trace must have the same dimensions";
+  }
+}
+
+/**
+ * Removes all steps, keeping the allocated buffers for reuse.
+ */
+void MapTraceRecorder::clear() {
+  this->_records.clear();
+  this->_index.clear();
+  this->_sinceKeyframe = 0;
+  this->_numSteps = 0;
+}
+
+/**
+ * Records the map at the next timestep.
+ */
+void MapTraceRecorder::addStep(const BitGrid &map) {
+  this->_checkDimensions(map.rows(), map.cols());
+  if (this->_numSteps > 0) {
+    this->_encodeLatest();
+  }
+  this->_latest = BitGrid::unpadded(map);
+  ++this->_numSteps;
+}
+
+/**
+ * Sets a cell in the latest step.
+ */
+void MapTraceRecorder::setCell(const GridCell &cell, bool value) {
+  if (this->_numSteps == 0) {
+    throw "No steps recorded in trace";
+  }
+  if (!this->_latest.inBounds(cell)) {
+    throw "Trace cell out of bounds";
+  }
+  this->_latest.set(cell, value);
+}
+
+/**
+ * Apply a single step to a map.
+ */
+void MapTraceRecorder::applyStep(int ts, BitGrid &map) const {
+  if (ts < 0 || ts >= this->_numSteps) {
+    throw "Trace timestep out of range";
+  }
+  if (ts == this->_numSteps - 1) {
+    map = this->_latest;
+    return;
+  }
+  size_t end{ts + 1 < (int)this->_index.size() ? this->_index.at(ts + 1)
+                                               : this->_records.size()};
+  decodeRecord(this->_records.data() + this->_index.at(ts),
+               this->_records.data() + end, this->_latest.rows(),
+               this->_latest.cols(), map);
+}
+
+/**
+ * Write the trace to a binary trace file.
+ */
+void MapTraceRecorder::write(const std::filesystem::path &outFile) const {
+  MapTraceHeader header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.rows = this->_numSteps == 0 ? 0 : (uint32_t)this->_latest.rows();
+  header.cols = this->_numSteps == 0 ? 0 : (uint32_t)this->_latest.cols();
+  header.numSteps = (uint32_t)this->_numSteps;
+  header.keyframeInterval = (uint32_t)this->_keyframeInterval;
+
+  // The latest step is only encoded for the file
+  std::vector<uint8_t> latest{};
+  if (this->_numSteps > 0) {
+    encodeRecord(this->_latest, this->_encoded,
+                 this->_index.empty() ||
+                     this->_sinceKeyframe >= this->_keyframeInterval,
+                 latest);
+  }
+
+  // Pad so the index is 8-byte aligned
+  size_t recordsEnd{sizeof(MapTraceHeader) + this->_records.size() +
+                    latest.size()};
+  std::vector<char> padding((sizeof(uint64_t) - recordsEnd % sizeof(uint64_t)) %
+                            sizeof(uint64_t));
+  header.indexOffset = recordsEnd + padding.size();
+
+  std::vector<uint64_t> index{};
+  for (uint64_t offset : this->_index) {
+    index.push_back(sizeof(MapTraceHeader) + offset);
+  }
+  if (this->_numSteps > 0) {
+    index.push_back(sizeof(MapTraceHeader) + this->_records.size());
+  }
+
+  std::ofstream f(outFile, std::ios::binary | std::ios::trunc);
+  if (!f.is_open()) {
+    throw "Unable to open trace file for writing";
+  }
+  f.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  f.write(reinterpret_cast<const char *>(this->_records.data()),
+          this->_records.size());
+  f.write(reinterpret_cast<const char *>(latest.data()), latest.size());
+  f.write(padding.data(), padding.size());
+  f.write(reinterpret_cast<const char *>(index.data()),
+          index.size() * sizeof(uint64_t));
+  if (!f.good()) {
+    throw "Failed to write trace file";
+  }
+}
+
+/**
+ * Write a sequence of maps to a binary trace file.
+ */
+void MapTrace::write(const std::vector<Eigen::MatrixXi> &maps,
+                     const std::filesystem::path &outFile,
+                     int keyframeInterval) {
+  MapTraceRecorder recorder{keyframeInterval};
+  for (const Eigen::MatrixXi &mapAtTs : maps) {
+    recorder.addStep(mapAtTs);
+  }
+  recorder.write(outFile);
+}
+
+/**
+ * Read a CSV trace in the format written by IMacExecutor::logMapDynamics.
+ */
+std::vector<Eigen::MatrixXi>
+MapTrace::readCSV(const std::filesystem::path &inFile) {
+  std::ifstream f{inFile};
+  if (!f.is_open()) {
+    throw "Unable to open CSV trace file";
+  }
+
+  // Read all the triplets first, as the dimensions aren't stored
+  std::vector<std::vector<int>> triplets{};
+  int xDim{0};
+  int yDim{0};
+  std::string row{};
+  std::string entry{};
+  while (getline(f, row)) {
+    std::stringstream rowStream{row};
+    std::vector<int> matAtTs{};
+    while (getline(rowStream, entry, ',')) {
+      matAtTs.push_back(std::stoi(entry));
+    }
+    for (int i{1}; i + 2 < (int)matAtTs.size(); i += 3) {
+      xDim = std::max(xDim, matAtTs.at(i) + 1);
+      yDim = std::max(yDim, matAtTs.at(i + 1) + 1);
+    }
+    triplets.push_back(matAtTs);
+  }
+
+  std::vector<Eigen::MatrixXi> maps{};
+  for (const std::vector<int> &matAtTs : triplets) {
+    Eigen::MatrixXi currentMat{Eigen::MatrixXi::Zero(yDim, xDim)};
+    for (int i{1}; i + 2 < (int)matAtTs.size(); i += 3) {
+      currentMat(matAtTs.at(i + 1), matAtTs.at(i)) = matAtTs.at(i + 2);
+    }
+    maps.push_back(currentMat);
+  }
+  return maps;
+}
+
+/**
+ * Convert a CSV trace into a binary trace file.
+ */
+void MapTrace::convertCSV(const std::filesystem::path &inFile,
+                          const std::filesystem::path &outFile) {
+  MapTrace::write(MapTrace::readCSV(inFile), outFile);
+}
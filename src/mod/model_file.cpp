@@ -0,0 +1,346 @@
+/**
+ * Implementation of the binary model file format in model_file.h.
+ * @see model_file.h
+ *
+ * @author Charlie Street
+ */
+#include "coverage_plan/mod/model_file.h"
+#include "coverage_plan/mod/bimac.h"
+#include "coverage_plan/mod/imac.h"
+#include <Eigen/Dense>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// Arrays are written straight from memory, so the host must be little-endian
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "Model files require a little-endian host");
+
+namespace {
+
+const char kMagic[8]{'C', 'O', 'V', 'M', 'O', 'D', 'E', 'L'};
+const uint32_t kVersion{1};
+
+/**
+ * Continues a 64 bit FNV-1a hash over a block of memory.
+ *
+ * @param hash The hash so far
+ * @param data The start of the memory block
+ * @param numBytes The size of the memory block in bytes
+ *
+ * @returns The updated hash
+ */
+uint64_t fnv1a(uint64_t hash, const void *data, size_t numBytes) {
+  const unsigned char *bytes{static_cast<const unsigned char *>(data)};
+  for (size_t i{0}; i < numBytes; ++i) {
+    hash ^= bytes[i];
+    hash *= 0x100000001B3;
+  }
+  return hash;
+}
+
+/**
+ * Encodes a header and a list of equally sized arrays as a model file.
+ *
+ * @param type The type of model being encoded
+ * @param rows The number of rows in each array
+ * @param cols The number of columns in each array
+ * @param elemSize The size of each array element in bytes
+ * @param arrays Pointers to the (column major) data of each array
+ *
+ * @returns The contents of the model file
+ */
+std::vector<std::byte>
+encodeModelFile(ModelType type, int rows, int cols, size_t elemSize,
+                const std::vector<const void *> &arrays) {
+  size_t arrayBytes{(size_t)rows * (size_t)cols * elemSize};
+
+  ModelFileHeader header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.modelType = (uint32_t)type;
+  header.rows = (uint32_t)rows;
+  header.cols = (uint32_t)cols;
+  header.numArrays = (uint32_t)arrays.size();
+  header.elemSize = (uint32_t)elemSize;
+  header.payloadBytes = arrayBytes * arrays.size();
+  header.checksum = 0xCBF29CE484222325;
+  for (const void *array : arrays) {
+    header.checksum = fnv1a(header.checksum, array, arrayBytes);
+  }
+
+  std::vector<std::byte> contents(sizeof(header) + header.payloadBytes);
+  std::memcpy(contents.data(), &header, sizeof(header));
+  for (size_t i{0}; i < arrays.size(); ++i) {
+    std::memcpy(contents.data() + sizeof(header) + i * arrayBytes, arrays[i],
+                arrayBytes);
+  }
+  return contents;
+}
+
+/**
+ * Writes the contents of a model file to disk.
+ *
+ * @param contents The contents of the model file
+ * @param outFile The file to write to
+ */
+void writeModelFile(const std::vector<std::byte> &contents,
+                    const std::filesystem::path &outFile) {
+  std::ofstream f(outFile, std::ios::binary | std::ios::trunc);
+  if (!f.is_open()) {
+    throw "Unable to open model file for writing";
+  }
+  f.write(reinterpret_cast<const char *>(contents.data()), contents.size());
+  if (!f.good()) {
+    throw "Failed to write model file";
+  }
+}
+
+} // namespace
+
+/**
+ * Maps a model file into memory and validates its header and checksum.
+ */
+MappedModelFile::MappedModelFile(const std::filesystem::path &inFile) {
+  this->_fd = open(inFile.c_str(), O_RDONLY);
+  if (this->_fd < 0) {
+    throw "Unable to open model file";
+  }
+  this->_mapAndValidate();
+}
+
+/**
+ * Maps an already open model file, taking ownership of the file descriptor.
+ */
+MappedModelFile::MappedModelFile(int fd) : _fd{fd} {
+  if (this->_fd < 0) {
+    throw "Invalid model file descriptor";
+  }
+  this->_mapAndValidate();
+}
+
+/**
+ * Maps the open file and validates its header and checksum.
+ */
+void MappedModelFile::_mapAndValidate() {
+  struct stat fileStat {};
+  if (fstat(this->_fd, &fileStat) != 0 ||
+      (size_t)fileStat.st_size < sizeof(ModelFileHeader)) {
+    this->_close();
+    throw "Model file too small to contain a header";
+  }
+  this->_size = (size_t)fileStat.st_size;
+
+  this->_data =
+      mmap(nullptr, this->_size, PROT_READ, MAP_PRIVATE, this->_fd, 0);
+  if (this->_data == MAP_FAILED) {
+    this->_data = nullptr;
+    this->_close();
+    throw "Unable to memory map model file";
+  }
+
+  std::memcpy(&this->_header, this->_data, sizeof(ModelFileHeader));
+  const ModelFileHeader &header{this->_header};
+
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+    this->_close();
+    throw "Not a model file";
+  }
+  if (header.version != kVersion) {
+    this->_close();
+    throw "Unsupported model file version";
+  }
+
+  size_t expectedElemSize{header.modelType == (uint32_t)ModelType::imac
+                              ? sizeof(double)
+                              : sizeof(int32_t)};
+  size_t expectedArrays{header.modelType == (uint32_t)ModelType::imac ? 3u
+                                                                      : 6u};
+  if (header.modelType > (uint32_t)ModelType::bimac ||
+      header.elemSize != expectedElemSize ||
+      header.numArrays != expectedArrays) {
+    this->_close();
+    throw "Invalid model file header";
+  }
+
+  uint64_t payloadBytes{(uint64_t)header.rows * header.cols *
+                        header.numArrays * header.elemSize};
+  if (header.payloadBytes != payloadBytes ||
+      this->_size != sizeof(ModelFileHeader) + payloadBytes) {
+    this->_close();
+    throw "Model file size does not match header";
+  }
+
+  if (ModelFile::checksum(this->_arrayStart(0), payloadBytes) !=
+      header.checksum) {
+    this->_close();
+    throw "Model file checksum mismatch";
+  }
+}
+
+/**
+ * Returns a pointer to the start of an array in the mapped file.
+ */
+const std::byte *MappedModelFile::_arrayStart(int index) const {
+  return static_cast<const std::byte *>(this->_data) +
+         sizeof(ModelFileHeader) +
+         (size_t)index * this->_header.rows * this->_header.cols *
+             this->_header.elemSize;
+}
+
+/**
+ * Unmaps and closes the file, if open.
+ */
+void MappedModelFile::_close() {
+  if (this->_data != nullptr) {
+    munmap(this->_data, this->_size);
+    this->_data = nullptr;
+  }
+  if (this->_fd >= 0) {
+    close(this->_fd);
+    this->_fd = -1;
+  }
+}
+
+/**
+ * View one of the arrays in an IMac file without copying.
+ */
+Eigen::Map<const Eigen::MatrixXd>
+MappedModelFile::doubleArray(int index) const {
+  if (this->type() != ModelType::imac) {
+    throw "Model file does not store double arrays";
+  }
+  if (index < 0 || index >= this->numArrays()) {
+    throw "Model file array index out of range";
+  }
+  return Eigen::Map<const Eigen::MatrixXd>{
+      reinterpret_cast<const double *>(this->_arrayStart(index)), this->rows(),
+      this->cols()};
+}
+
+/**
+ * View one of the arrays in a BIMac file without copying.
+ */
+Eigen::Map<const Eigen::MatrixXi> MappedModelFile::intArray(int index) const {
+  if (this->type() != ModelType::bimac) {
+    throw "Model file does not store int arrays";
+  }
+  if (index < 0 || index >= this->numArrays()) {
+    throw "Model file array index out of range";
+  }
+  return Eigen::Map<const Eigen::MatrixXi>{
+      reinterpret_cast<const int *>(this->_arrayStart(index)), this->rows(),
+      this->cols()};
+}
+
+/**
+ * Computes the 64 bit FNV-1a checksum of a block of memory.
+ */
+uint64_t ModelFile::checksum(const void *data, size_t numBytes) {
+  return fnv1a(0xCBF29CE484222325, data, numBytes);
+}
+
+/**
+ * Encode an IMac model as the bytes of a binary model file.
+ */
+std::vector<std::byte> ModelFile::encodeIMac(const IMac &imac) {
+  return encodeModelFile(
+      ModelType::imac, imac.getEntryMatrix().rows(),
+      imac.getEntryMatrix().cols(), sizeof(double),
+      {imac.getEntryMatrix().data(), imac.getExitMatrix().data(),
+       imac.getInitialBelief().data()});
+}
+
+/**
+ * Encode a BIMac model as the bytes of a binary model file.
+ */
+std::vector<std::byte> ModelFile::encodeBIMac(const BIMac &bimac) {
+  static_assert(sizeof(int) == sizeof(int32_t), "BIMac files need 32 bit int");
+  return encodeModelFile(
+      ModelType::bimac, bimac.getAlphaEntry().rows(),
+      bimac.getAlphaEntry().cols(), sizeof(int32_t),
+      {bimac.getAlphaEntry().data(), bimac.getBetaEntry().data(),
+       bimac.getAlphaExit().data(), bimac.getBetaExit().data(),
+       bimac.getAlphaInit().data(), bimac.getBetaInit().data()});
+}
+
+/**
+ * Write an IMac model out to a binary model file.
+ */
+void ModelFile::writeIMac(const IMac &imac,
+                          const std::filesystem::path &outFile) {
+  writeModelFile(ModelFile::encodeIMac(imac), outFile);
+}
+
+/**
+ * Write a BIMac model out to a binary model file.
+ */
+void ModelFile::writeBIMac(const BIMac &bimac,
+                           const std::filesystem::path &outFile) {
+  writeModelFile(ModelFile::encodeBIMac(bimac), outFile);
+}
+
+/**
+ * Read an IMac model from a binary model file.
+ */
+std::shared_ptr<IMac>
+ModelFile::readIMac(const std::filesystem::path &inFile) {
+  MappedModelFile file{inFile};
+  return std::make_shared<IMac>(file.doubleArray(0), file.doubleArray(1),
+                                file.doubleArray(2));
+}
+
+/**
+ * Read a BIMac model from a binary model file.
+ */
+std::shared_ptr<BIMac>
+ModelFile::readBIMac(const std::filesystem::path &inFile) {
+  MappedModelFile file{inFile};
+  return std::make_shared<BIMac>(file.intArray(0), file.intArray(1),
+                                 file.intArray(2), file.intArray(3),
+                                 file.intArray(4), file.intArray(5));
+}
+
+/**
+ * Load an IMac model from a directory, preferring the binary file.
+ */
+std::shared_ptr<IMac> ModelFile::loadIMac(const std::filesystem::path &inDir) {
+  if (std::filesystem::exists(inDir / ModelFile::imacFileName)) {
+    return ModelFile::readIMac(inDir / ModelFile::imacFileName);
+  }
+  return std::make_shared<IMac>(inDir);
+}
+
+/**
+ * Load a BIMac model from a directory, preferring the binary file.
+ */
+std::shared_ptr<BIMac>
+ModelFile::loadBIMac(const std::filesystem::path &inDir) {
+  if (std::filesystem::exists(inDir / ModelFile::bimacFileName)) {
+    return ModelFile::readBIMac(inDir / ModelFile::bimacFileName);
+  }
+  return std::make_shared<BIMac>(inDir);
+}
+
+/**
+ * Convert an IMac CSV directory into a binary model file.
+ */
+void ModelFile::convertIMacDirectory(const std::filesystem::path &inDir,
+                                     const std::filesystem::path &outFile) {
+  ModelFile::writeIMac(IMac{inDir}, outFile);
+}
+
+/**
+ * Convert a BIMac CSV directory into a binary model file.
+ */
+void ModelFile::convertBIMacDirectory(const std::filesystem::path &inDir,
+                                      const std::filesystem::path &outFile) {
+  ModelFile::writeBIMac(BIMac{inDir}, outFile);
+}
@@ -0,0 +1,137 @@
+/**
+ * Implementation of the shared memory model store in model_store.h.
+ * @see model_store.h
+ *
+ * @author Charlie Street
+ */
+#include "coverage_plan/mod/model_store.h"
+#include "coverage_plan/mod/bimac.h"
+#include "coverage_plan/mod/imac.h"
+#include "coverage_plan/mod/model_file.h"
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+/**
+ * Copy an encoded model file into a new shared memory object.
+ *
+ * @param key The model key
+ * @param contents The encoded model file
+ */
+void publish(const std::string &key, const std::vector<std::byte> &contents) {
+  std::string name{ModelStore::objectName(key)};
+  int fd{shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644)};
+  if (fd < 0) {
+    throw errno == EEXIST ? "Model store key already in use"
+                          : "Unable to create shared memory model";
+  }
+  if (ftruncate(fd, contents.size()) != 0) {
+    close(fd);
+    shm_unlink(name.c_str());
+    throw "Unable to size shared memory model";
+  }
+  void *data{
+      mmap(nullptr, contents.size(), PROT_WRITE, MAP_SHARED, fd, 0)};
+  close(fd);
+  if (data == MAP_FAILED) {
+    shm_unlink(name.c_str());
+    throw "Unable to map shared memory model";
+  }
+
+  // Write the payload before the header, so readers never see a valid
+  // header in front of a partly written payload
+  std::byte *bytes{static_cast<std::byte *>(data)};
+  std::memcpy(bytes + sizeof(ModelFileHeader),
+              contents.data() + sizeof(ModelFileHeader),
+              contents.size() - sizeof(ModelFileHeader));
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(bytes, contents.data(), sizeof(ModelFileHeader));
+  munmap(data, contents.size());
+}
+
+} // namespace
+
+/**
+ * Get the shared memory object name used for a key.
+ */
+std::string ModelStore::objectName(const std::string &key) {
+  if (key.empty() || key.find('/') != std::string::npos) {
+    throw "Invalid model store key";
+  }
+  return "/coverage_plan." + key;
+}
+
+/**
+ * Publish an IMac model under a key.
+ */
+void ModelStore::publishIMac(const std::string &key, const IMac &imac) {
+  publish(key, ModelFile::encodeIMac(imac));
+}
+
+/**
+ * Publish a BIMac model under a key.
+ */
+void ModelStore::publishBIMac(const std::string &key, const BIMac &bimac) {
+  publish(key, ModelFile::encodeBIMac(bimac));
+}
+
+/**
+ * Check if a model has been published under a key.
+ */
+bool ModelStore::contains(const std::string &key) {
+  int fd{shm_open(ModelStore::objectName(key).c_str(), O_RDONLY, 0)};
+  if (fd < 0) {
+    return false;
+  }
+  close(fd);
+  return true;
+}
+
+/**
+ * Map a published model read-only.
+ */
+std::shared_ptr<const MappedModelFile>
+ModelStore::map(const std::string &key) {
+  int fd{shm_open(ModelStore::objectName(key).c_str(), O_RDONLY, 0)};
+  if (fd < 0) {
+    throw "No model published under key";
+  }
+  return std::make_shared<const MappedModelFile>(fd);
+}
+
+/**
+ * Construct an IMac from a published model.
+ * IMac owns its matrices, so this copies them out of the mapped views.
+ */
+std::shared_ptr<IMac> ModelStore::loadIMac(const std::string &key) {
+  std::shared_ptr<const MappedModelFile> model{ModelStore::map(key)};
+  return std::make_shared<IMac>(model->doubleArray(0), model->doubleArray(1),
+                                model->doubleArray(2));
+}
+
+/**
+ * Construct a BIMac from a published model.
+ * BIMac owns its counts, so this copies them out of the mapped views.
+ */
+std::shared_ptr<BIMac> ModelStore::loadBIMac(const std::string &key) {
+  std::shared_ptr<const MappedModelFile> model{ModelStore::map(key)};
+  return std::make_shared<BIMac>(model->intArray(0), model->intArray(1),
+                                 model->intArray(2), model->intArray(3),
+                                 model->intArray(4), model->intArray(5));
+}
+
+/**
+ * Remove a model from the store.
+ */
+void ModelStore::remove(const std::string &key) {
+  shm_unlink(ModelStore::objectName(key).c_str());
+}
@@ -0,0 +1,130 @@
+/**
+ * Implementation of the TransitionCounter class in transition_counter.h.
+ * @see transition_counter.h
+ *
+ * @author Charlie Street
+ */
+
+#include "coverage_plan/mod/transition_counter.h"
+#include "coverage_plan/mod/bimac.h"
+#include "coverage_plan/mod/grid_cell.h"
+#include "coverage_plan/mod/imac_executor.h"
+#include <algorithm>
+#include <vector>
+
+/**
+ * Allocates the counters for a map.
+ */
+TransitionCounter::TransitionCounter(int xDim, int yDim)
+    : _xDim{xDim}, _yDim{yDim}, _step{0}, _firstStep{1},
+      _counts((size_t)xDim * yDim), _lastStep((size_t)xDim * yDim, -1),
+      _lastValue((size_t)xDim * yDim, 0), _prevStep((size_t)xDim * yDim, -1),
+      _prevValue((size_t)xDim * yDim, 0), _counted((size_t)xDim * yDim, false),
+      _touched{} {
+  for (int x{0}; x < xDim; ++x) {
+    for (int y{0}; y < yDim; ++y) {
+      this->_counts.at(x * yDim + y).cell = GridCell{x, y};
+    }
+  }
+}
+
+/**
+ * Add (or remove) a transition count for a cell.
+ */
+void TransitionCounter::_countTransition(int idx, int prevState,
+                                         int nextState, int inc) {
+  BIMacObservation &counts{this->_counts[idx]};
+  if (prevState == 0 && nextState == 0) {
+    counts.freeToFree += inc;
+  } else if (prevState == 0 && nextState == 1) {
+    counts.freeToOccupied += inc;
+  } else if (prevState == 1 && nextState == 0) {
+    counts.occupiedToFree += inc;
+  } else {
+    counts.occupiedToOccupied += inc;
+  }
+}
+
+/**
+ * Record that a cell has non-zero counts.
+ */
+void TransitionCounter::_touch(int idx) {
+  if (!this->_counted[idx]) {
+    this->_counted[idx] = true;
+    this->_touched.push_back(idx);
+  }
+}
+
+/**
+ * Clear all counts, ready for a new episode.
+ */
+void TransitionCounter::reset() {
+  for (int idx : this->_touched) {
+    GridCell cell{this->_counts[idx].cell};
+    this->_counts[idx] = BIMacObservation{cell, 0, 0, 0, 0, 0, 0};
+    this->_counted[idx] = false;
+  }
+  this->_touched.clear();
+
+  // Leave a gap in the step numbers so no stale observation looks recent
+  ++this->_step;
+  this->_firstStep = this->_step + 1;
+}
+
+/**
+ * Add the observations made at the next timestep.
+ */
+void TransitionCounter::addObservations(
+    const std::vector<IMacObservation> &observations) {
+  long step{++this->_step};
+  bool initStep{step == this->_firstStep};
+
+  for (const IMacObservation &obs : observations) {
+    if (obs.cell.outOfBounds(0, this->_xDim, 0, this->_yDim)) {
+      continue;
+    }
+    int idx{obs.cell.x * this->_yDim + obs.cell.y};
+
+    if (initStep) {
+      if (obs.occupied == 1) {
+        this->_counts[idx].initOccupied += 1;
+      } else {
+        this->_counts[idx].initFree += 1;
+      }
+      this->_touch(idx);
+    } else if (this->_lastStep[idx] != step) {
+      // First time the cell is seen this step
+      if (this->_lastStep[idx] == step - 1) {
+        this->_countTransition(idx, this->_lastValue[idx], obs.occupied, 1);
+        this->_touch(idx);
+      }
+    } else if (this->_prevStep[idx] == step - 1) {
+      // Seen again this step, so the later value replaces the transition
+      this->_countTransition(idx, this->_prevValue[idx],
+                             this->_lastValue[idx], -1);
+      this->_countTransition(idx, this->_prevValue[idx], obs.occupied, 1);
+    }
+
+    if (this->_lastStep[idx] != step) {
+      this->_prevStep[idx] = this->_lastStep[idx];
+      this->_prevValue[idx] = this->_lastValue[idx];
+      this->_lastStep[idx] = step;
+    }
+    this->_lastValue[idx] = obs.occupied;
+  }
+}
+
+/**
+ * Get the accumulated counts as a batch of BIMac observations.
+ */
+std::vector<BIMacObservation> TransitionCounter::getBIMacObservations() const {
+  std::vector<int> cells{this->_touched};
+  std::sort(cells.begin(), cells.end());
+
+  std::vector<BIMacObservation> biMacObsVector{};
+  biMacObsVector.reserve(cells.size());
+  for (int idx : cells) {
+    biMacObsVector.push_back(this->_counts[idx]);
+  }
+  return biMacObsVector;
+}
@@ -17,7 +17,6 @@
 #include <iomanip>
 #include <sstream>
 #include <string>
-#include <tuple>
 
 /**
  * Sample a number of states from the IMac model.
@@ -39,8 +38,10 @@ std::vector<despot::State *> CoverageBelief::Sample(int num) const {
     particle->time = this->_time;
     particle->covered = this->_covered;
 
-    // Sample a map state from the current belief
-    particle->map = this->_beliefSampler->sampleFromBelief(this->_mapBelief);
+    // Sample a map state from the current belief, padded for planning
+    particle->map = BitGrid::padded(
+        this->_beliefSampler->sampleFromBelief(this->_mapBelief), true);
+    particle->hash = particle->computeHash();
 
     particles.push_back(particle);
   }
@@ -56,35 +57,25 @@ void CoverageBelief::Update(despot::ACT_TYPE action, despot::OBS_TYPE obs) {
   // I'm not using the history, but store for completeness
   history_.Add(action, obs);
 
-  // First get relative observation just to get the success flag
-  std::pair<std::vector<IMacObservation>, bool> obsInfo{
-      Observation::fromObsType(obs, this->_fov)};
-
   // Update robot location if action successful (action success is observable)
-  if (std::get<1>(obsInfo)) {
+  if (this->_obsCodec.actionSucceeded(obs)) {
     this->_robotPosition = ActionHelpers::applySuccessfulAction(
         this->_robotPosition, ActionHelpers::fromInt(action));
   }
 
-  // Now get absolute observation location
-  obsInfo = Observation::fromObsType(obs, this->_fov, this->_robotPosition);
-
   // Update time (time is observable)
   ++this->_time;
 
   // Update covered (location is observable)
-  this->_covered.insert(this->_robotPosition);
+  this->_covered.set(this->_robotPosition);
 
   // Update map belief (forward step of IMac model and setting known locations)
   this->_mapBelief = this->_imac->forwardStep(this->_mapBelief);
   // Set robot position as being free of obstacles
   this->_mapBelief(this->_robotPosition.y, this->_robotPosition.x) = 0;
-  for (const IMacObservation &imacObs : std::get<0>(obsInfo)) {
-    if (!imacObs.cell.outOfBounds(0, this->_mapBelief.cols(), 0,
-                                  this->_mapBelief.rows())) {
-      this->_mapBelief(imacObs.cell.y, imacObs.cell.x) = imacObs.occupied;
-    }
-  }
+  // Read the observed cells straight from obs, rather than decoding them
+  this->_obsCodec.applyObservation(obs, this->_robotPosition,
+                                   this->_mapBelief);
 }
 
 /**
@@ -93,7 +84,7 @@ void CoverageBelief::Update(despot::ACT_TYPE action, despot::OBS_TYPE obs) {
 std::string CoverageBelief::text() const {
   std::ostringstream stream{};
 
-  int pctCovered{int(round(100 * (double)this->_covered.size() /
+  int pctCovered{int(round(100 * (double)this->_covered.count() /
                            (double)this->_mapBelief.size()))};
 
   // Write out pos, time, percentage covered
@@ -120,13 +111,13 @@ despot::Belief *CoverageBelief::MakeCopy() const {
   // Note: Allocated with new, so make sure this is deallocated...
   return new CoverageBelief(this->model_, this->_robotPosition, this->_time,
                             this->_covered, this->_mapBelief, this->_imac,
-                            this->_fov);
+                            this->_obsCodec);
 }
 
 /**
  * Return the occupancy map belief.
  *
  */
-Eigen::MatrixXd CoverageBelief::getMapBelief() const {
+const Eigen::MatrixXd &CoverageBelief::getMapBelief() const {
   return this->_mapBelief;
 }
\ No newline at end of file
@@ -8,19 +8,24 @@
 #include "coverage_plan/planning/coverage_bounds.h"
 #include "coverage_plan/mod/grid_cell.h"
 #include "coverage_plan/planning/action.h"
+#include "coverage_plan/planning/coverage_pomdp.h"
 #include "coverage_plan/planning/coverage_state.h"
+#include "coverage_plan/planning/scenario_batch.h"
 #include <algorithm>
+#include <cstdint>
 #include <despot/core/globals.h>
 #include <despot/interface/default_policy.h>
 #include <iterator>
+#include <map>
 #include <math.h>
+#include <numeric>
 
 /**
  * Returns an upper bound on the max reward obtainable from state.
  */
 double MaxCellsUpperBound::Value(const despot::State &state) const {
   const CoverageState &coverState{static_cast<const CoverageState &>(state)};
-  return std::min((double)(this->_numCells - coverState.covered.size()),
+  return std::min((double)(this->_numCells - coverState.covered.count()),
                   (double)(this->_timeBound - coverState.time));
 }
 
@@ -32,6 +37,137 @@ despot::ValuedAction ZeroParticleLowerBound::Value(
   return despot::ValuedAction(ActionHelpers::toInt(Action::up), 0.0);
 }
 
+/**
+ * Estimates the value of a set of particles by rolling out the policy.
+ */
+despot::ValuedAction GreedyCoverageDefaultPolicy::Value(
+    const std::vector<despot::State *> &particles,
+    despot::RandomStreams &streams, despot::History &history) const {
+  uint64_t key{};
+  despot::ValuedAction result{};
+  if (this->_table != nullptr) {
+    key = TranspositionTable::particlesKey(particles);
+    if (this->_table->lookup(key, result)) {
+      return result;
+    }
+  }
+
+  // The batch holds copies, so the particles are left alone
+  this->_batch.assign(particles);
+  std::vector<int> active(particles.size());
+  std::iota(active.begin(), active.end(), 0);
+  result = this->_rollout(active, streams, history, history.Size());
+
+  if (this->_table != nullptr) {
+    this->_table->store(key, result);
+  }
+  return result;
+}
+
+/**
+ * Rolls out the policy on some of the particles in _batch.
+ */
+despot::ValuedAction GreedyCoverageDefaultPolicy::_rollout(
+    const std::vector<int> &active, despot::RandomStreams &streams,
+    despot::History &history, int initialDepth) const {
+  if (streams.Exhausted() ||
+      history.Size() - initialDepth >=
+          despot::Globals::config.max_policy_sim_len) {
+    return this->_leafValue(active);
+  }
+
+  despot::ACT_TYPE action{this->_batchAction(active)};
+  static_cast<const CoveragePOMDP *>(this->model_)
+      ->StepBatch(this->_batch, active, streams, action);
+
+  // Sum the rewards and split the particles on their observations
+  double value{0.0};
+  std::map<despot::OBS_TYPE, std::vector<int>> partitions{};
+  for (int i : active) {
+    value += this->_batch.reward[i] * this->_batch.weight[i];
+    if (!this->_batch.terminal[i]) {
+      partitions[this->_batch.obs[i]].push_back(i);
+    }
+  }
+
+  for (const auto &partition : partitions) {
+    history.Add(action, partition.first);
+    streams.Advance();
+    despot::ValuedAction childValue{
+        this->_rollout(partition.second, streams, history, initialDepth)};
+    value += despot::Globals::Discount() * childValue.value;
+    streams.Back();
+    history.RemoveLast();
+  }
+
+  return despot::ValuedAction(action, value);
+}
+
+/**
+ * Evaluates the particle lower bound at the leaf of a rollout.
+ */
+despot::ValuedAction
+GreedyCoverageDefaultPolicy::_leafValue(const std::vector<int> &active) const {
+  // The zero bound ignores its particles, so don't build them
+  if (dynamic_cast<const ZeroParticleLowerBound *>(
+          this->_particleLowerBound) != nullptr) {
+    return this->_particleLowerBound->Value(std::vector<despot::State *>{});
+  }
+
+  std::vector<despot::State *> leaves{};
+  for (int i : active) {
+    CoverageState *state{
+        static_cast<CoverageState *>(this->model_->Allocate())};
+    this->_batch.toState(i, *state);
+    leaves.push_back(state);
+  }
+  despot::ValuedAction result{this->_particleLowerBound->Value(leaves)};
+  for (despot::State *state : leaves) {
+    this->model_->Free(state);
+  }
+  return result;
+}
+
+/**
+ * Greedily chooses an action weighted on some of the particles in _batch.
+ */
+despot::ACT_TYPE GreedyCoverageDefaultPolicy::_batchAction(
+    const std::vector<int> &active) const {
+  // The batch's maps share a layout with the padded matrices
+  const double *imacEntry{this->_imac->getPaddedEntryMatrix().data()};
+  const double *imacExit{this->_imac->getPaddedExitMatrix().data()};
+
+  // Each action as a bit offset from the robot's position
+  std::vector<int> offsets{};
+  for (int a{0}; a < this->model_->NumActions(); ++a) {
+    GridCell move{ActionHelpers::applySuccessfulAction(
+        GridCell{0, 0}, ActionHelpers::fromInt(a))};
+    offsets.push_back(move.x * this->_batch.stride() + move.y);
+  }
+
+  std::vector<double> immRewards(this->model_->NumActions(), 0.0);
+  for (int i : active) { // Get weighted immediate reward, as in Action
+    const uint64_t *map{this->_batch.maps.data() +
+                        i * this->_batch.numWords()};
+    const uint64_t *covered{this->_batch.covered.data() +
+                            i * this->_batch.numWords()};
+    double weight{this->_batch.weight[i]};
+    int robotIdx{this->_batch.index(i)};
+    for (int a{0}; a < this->model_->NumActions(); ++a) {
+      int idx{robotIdx + offsets[a]};
+      if (((covered[idx >> 6] >> (idx & 63)) & 1) == 0) {
+        if (((map[idx >> 6] >> (idx & 63)) & 1) != 0) {
+          immRewards[a] += (imacExit[idx] * weight);
+        } else {
+          immRewards[a] += ((1.0 - imacEntry[idx]) * weight);
+        }
+      }
+    }
+  }
+
+  return this->_chooseAction(immRewards);
+}
+
 /**
  * Function greedily chooses an action weighted on the particles.
  *
@@ -42,6 +178,10 @@ despot::ValuedAction ZeroParticleLowerBound::Value(
 despot::ACT_TYPE GreedyCoverageDefaultPolicy::Action(
     const std::vector<despot::State *> &particles,
     despot::RandomStreams &streams, despot::History &history) const {
+  // Padded, so the successor cells can be read without bounds checks
+  const double *imacEntry{this->_imac->getPaddedEntryMatrix().data()};
+  const double *imacExit{this->_imac->getPaddedExitMatrix().data()};
+
   // Entry for each action
   std::vector<double> immRewards{};
   for (int i{0}; i < this->model_->NumActions(); ++i) {
@@ -50,25 +190,33 @@ despot::ACT_TYPE GreedyCoverageDefaultPolicy::Action(
 
   for (despot::State *state : particles) { // Get weighted immediate reward
     CoverageState *coverState{static_cast<CoverageState *>(state)};
+    coverState->pad();
     for (int a{0}; a < this->model_->NumActions(); ++a) {
       GridCell succLoc{ActionHelpers::applySuccessfulAction(
           coverState->robotPosition, ActionHelpers::fromInt(a))};
-      if (coverState->covered.count(succLoc) == 0 &&
-          !succLoc.outOfBounds(
-              0, this->_imacEntry.cols(), 0,
-              this->_imacEntry.rows())) { // Not already covered and in bounds
+      // The map and covered cells share a layout with the padded matrices.
+      // Cells off the map are covered and static occupied, so give 0
+      int idx{coverState->map.index(succLoc)};
+      if (!coverState->covered.testIndex(idx)) { // Not already covered
         // prob of being free in next step weighted by particle weight
-        if (coverState->map(succLoc.y, succLoc.x) == 1) { // occupied, use exit
-          immRewards.at(a) +=
-              (this->_imacExit(succLoc.y, succLoc.x) * coverState->weight);
+        if (coverState->map.testIndex(idx)) { // occupied, use exit
+          immRewards.at(a) += (imacExit[idx] * coverState->weight);
         } else { // free, use 1 - entry
-          immRewards.at(a) += ((1.0 - this->_imacEntry(succLoc.y, succLoc.x)) *
-                               coverState->weight);
+          immRewards.at(a) += ((1.0 - imacEntry[idx]) * coverState->weight);
         }
       }
     }
   }
 
+  return this->_chooseAction(immRewards);
+}
+
+/**
+ * Chooses uniformly at random between the actions with the best weighted
+ * immediate reward.
+ */
+despot::ACT_TYPE GreedyCoverageDefaultPolicy::_chooseAction(
+    const std::vector<double> &immRewards) const {
   // Get best set of actions
   std::vector<int> bestAct{};
   double maxReward{0.0};
@@ -6,40 +6,67 @@
  */
 
 #include "coverage_plan/planning/coverage_observation.h"
+#include "coverage_plan/mod/bit_grid.h"
 #include "coverage_plan/mod/grid_cell.h"
 #include "coverage_plan/mod/imac_executor.h"
 #include "coverage_plan/planning/action.h"
-#include <cmath>
+#include "coverage_plan/util/zobrist.h"
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <despot/core/globals.h>
+#include <memory>
 #include <tuple>
+#include <unordered_map>
 #include <vector>
 
+namespace {
+
 /**
- * Converts a uint64_t representing an observation into a vector of
- * IMacObservations.
+ * Throws if a FOV is too big to be encoded in an observation.
+ *
+ * @param fovSize The number of cells in the FOV
  */
-std::pair<std::vector<IMacObservation>, bool>
-Observation::fromObsType(const despot::OBS_TYPE &obsInt,
-                         const std::vector<GridCell> &fov,
-                         const GridCell &robotPos) {
-
-  int fovLength{(int)fov.size()};
-  if (fovLength > 63) {
+void checkFOVSize(std::size_t fovSize) {
+  if (fovSize > Observation::kMaxDirectFOVSize) {
     throw "FOV too big for uint64_t representation.";
   }
+}
 
-  std::vector<IMacObservation> obsVector{};
+} // namespace
 
-  // Get the leftmost bit in the integer
-  bool actSuccess{(obsInt >> fovLength) == 1};
+/**
+ * Converts a uint64_t representing an observation into IMacObservations,
+ * writing into an existing vector.
+ */
+bool Observation::decode(const despot::OBS_TYPE &obsInt,
+                         const std::vector<GridCell> &fov,
+                         const GridCell &robotPos,
+                         std::vector<IMacObservation> &obsVector) {
+  int fovLength{(int)fov.size()};
+  checkFOVSize(fovLength);
 
-  // Shift so bit of interest is rightmost. Then do a modulo check for 0 or 1
+  // Resizing only allocates if obsVector has never held this many cells
+  obsVector.resize(fovLength);
   for (int i{0}; i < fovLength; ++i) {
-
-    obsVector.push_back(IMacObservation{
-        robotPos + fov.at(i), (int)(obsInt >> ((fovLength - 1) - i)) % 2});
+    obsVector[i].cell = robotPos + fov[i];
+    obsVector[i].occupied = Observation::cellOccupied(obsInt, fovLength, i);
   }
 
+  return Observation::actionSucceeded(obsInt, fovLength);
+}
+
+/**
+ * Converts a uint64_t representing an observation into a vector of
+ * IMacObservations.
+ */
+std::pair<std::vector<IMacObservation>, bool>
+Observation::fromObsType(const despot::OBS_TYPE &obsInt,
+                         const std::vector<GridCell> &fov,
+                         const GridCell &robotPos) {
+  std::vector<IMacObservation> obsVector{};
+  bool actSuccess{Observation::decode(obsInt, fov, robotPos, obsVector)};
   return std::make_pair(obsVector, actSuccess);
 }
 
@@ -50,22 +77,12 @@ Observation::fromObsType(const despot::OBS_TYPE &obsInt,
 despot::OBS_TYPE
 Observation::toObsType(const std::vector<IMacObservation> &obsVector,
                        const ActionOutcome &outcome) {
-  if (obsVector.size() > 63) {
-    throw "FOV too big for uint64_t representation.";
-  }
-
-  int bitVal{(int)pow(2, obsVector.size())};
-
-  // Convert bool to int
-  despot::OBS_TYPE obsInt{(despot::OBS_TYPE)(((int)outcome.success) * bitVal)};
+  checkFOVSize(obsVector.size());
 
-  // Continuously right shift the bitVal by 1 (i.e. divide by 2)
-  bitVal = bitVal >> 1;
-
-  // Assume same ordering as in obsVector
+  // The success flag is the leftmost bit, followed by the cells in order
+  despot::OBS_TYPE obsInt{(despot::OBS_TYPE)outcome.success};
   for (const IMacObservation &imacObs : obsVector) {
-    obsInt += imacObs.occupied * bitVal;
-    bitVal = bitVal >> 1;
+    obsInt = (obsInt << 1) | (despot::OBS_TYPE)(imacObs.occupied != 0);
   }
 
   return obsInt;
@@ -77,15 +94,374 @@ Observation::toObsType(const std::vector<IMacObservation> &obsVector,
 despot::OBS_TYPE Observation::computeObservation(
     const Eigen::MatrixXi &map, const GridCell &robotPos,
     const ActionOutcome &outcome, const std::vector<GridCell> &fov) {
-  // Now get the observation
-  std::vector<IMacObservation> obsVec{};
+  checkFOVSize(fov.size());
+  despot::OBS_TYPE obsInt{(despot::OBS_TYPE)outcome.success};
   for (const GridCell &cell : fov) {
     GridCell obsLoc{robotPos + cell};
-    if (!obsLoc.outOfBounds(0, map.cols(), 0, map.rows())) {
-      obsVec.push_back(IMacObservation{cell, map(obsLoc.y, obsLoc.x)});
-    } else { // Out of bounds cells are occupied
-      obsVec.push_back(IMacObservation{cell, 1});
+    // Out of bounds cells are occupied
+    bool occupied{obsLoc.outOfBounds(0, map.cols(), 0, map.rows()) ||
+                  map(obsLoc.y, obsLoc.x) != 0};
+    obsInt = (obsInt << 1) | (despot::OBS_TYPE)occupied;
+  }
+  return obsInt;
+}
+
+/**
+ * Compute the observation given a bit packed map, robot position and fov.
+ */
+despot::OBS_TYPE Observation::computeObservation(
+    const BitGrid &map, const GridCell &robotPos, const ActionOutcome &outcome,
+    const std::vector<GridCell> &fov) {
+  checkFOVSize(fov.size());
+  despot::OBS_TYPE obsInt{(despot::OBS_TYPE)outcome.success};
+  for (const GridCell &cell : fov) {
+    GridCell obsLoc{robotPos + cell};
+    // Out of bounds cells are occupied
+    bool occupied{!map.inBounds(obsLoc) || map.test(obsLoc)};
+    obsInt = (obsInt << 1) | (despot::OBS_TYPE)occupied;
+  }
+  return obsInt;
+}
+
+/**
+ * Checks if an observation's map cells match a map.
+ */
+bool Observation::matchesMap(const despot::OBS_TYPE &obsInt,
+                             const BitGrid &map, const GridCell &robotPos,
+                             const std::vector<GridCell> &fov) {
+  despot::OBS_TYPE cellMask{(despot::OBS_TYPE{1} << fov.size()) - 1};
+  despot::OBS_TYPE expected{Observation::computeObservation(
+      map, robotPos, ActionOutcome{Action::wait, false, robotPos}, fov)};
+  return ((obsInt ^ expected) & cellMask) == 0;
+}
+
+/**
+ * Stores the cell bits of recorded wide observations, keyed on their hashes.
+ *
+ * Members:
+ * * _numWords: The number of words per entry
+ * * _patterns: The entries, stored back to back
+ * * _indices: The index of each key's entry
+ */
+class WideObservationTable {
+private:
+  const int _numWords{};
+  std::vector<uint64_t> _patterns{};
+  std::unordered_map<uint64_t, uint64_t> _indices{};
+
+public:
+  /**
+   * Constructor sets the entry size.
+   *
+   * @param numWords The number of words per entry
+   */
+  explicit WideObservationTable(int numWords) : _numWords{numWords} {}
+
+  /**
+   * Returns the number of entries.
+   *
+   * @returns The number of entries
+   */
+  uint64_t size() const { return this->_indices.size(); }
+
+  /**
+   * Finds the entry stored under a key.
+   *
+   * @param key The key of the cell bits
+   *
+   * @returns A pointer to the entry's words, or nullptr if there isn't one
+   */
+  const uint64_t *find(uint64_t key) const {
+    std::unordered_map<uint64_t, uint64_t>::const_iterator it{
+        this->_indices.find(key)};
+    if (it == this->_indices.end()) {
+      return nullptr;
+    }
+    return this->_patterns.data() + it->second * this->_numWords;
+  }
+
+  /**
+   * Stores some cell bits under their key, if they aren't stored already.
+   *
+   * @param key The key of the cell bits
+   * @param words The cell bits
+   *
+   * @exception hashCollision Raised if different cell bits have the same key
+   */
+  void store(uint64_t key, const uint64_t *words) {
+    const uint64_t *stored{this->find(key)};
+    if (stored != nullptr) {
+      if (!std::equal(words, words + this->_numWords, stored)) {
+        throw "Wide observation hash collision.";
+      }
+      return;
+    }
+
+    this->_indices.emplace(key, this->_patterns.size() / this->_numWords);
+    this->_patterns.insert(this->_patterns.end(), words,
+                           words + this->_numWords);
+  }
+
+  /**
+   * Removes every entry. The storage is kept, so refilling the table to its
+   * old size doesn't allocate.
+   */
+  void clear() {
+    this->_patterns.clear();
+    this->_indices.clear();
+  }
+};
+
+/**
+ * Constructor precomputes the FOV offsets.
+ */
+ObservationCodec::ObservationCodec(const std::vector<GridCell> &fov, int rows,
+                                   int cols)
+    : _fov{fov}, _rows{rows}, _cols{cols}, _offsets{}, _minX{0}, _maxX{0},
+      _minY{0}, _maxY{0}, _cellMask{0}, _wideTable{nullptr},
+      _shape{FOVKernels::match(fov)} {
+  int fovSize{(int)fov.size()};
+  if (fovSize > 64 * ObservationCodec::kMaxWideWords) {
+    throw "FOV too big for observation encoding.";
+  }
+  if (fovSize > Observation::kMaxDirectFOVSize) {
+    this->_wideTable =
+        std::make_shared<WideObservationTable>((fovSize + 63) / 64);
+  } else {
+    this->_cellMask = (despot::OBS_TYPE{1} << fovSize) - 1;
+  }
+
+  for (const GridCell &cell : fov) {
+    // Bit (x * stride + y) holds cell (x,y), relative to cell (0,0)
+    this->_offsets.push_back(cell.x * rows + cell.y);
+    this->_paddedOffsets.push_back(cell.x * (rows + 2) + cell.y);
+    this->_minX = std::min(this->_minX, cell.x);
+    this->_maxX = std::max(this->_maxX, cell.x);
+    this->_minY = std::min(this->_minY, cell.y);
+    this->_maxY = std::max(this->_maxY, cell.y);
+  }
+}
+
+/**
+ * Computes the map bits of a narrow observation.
+ */
+despot::OBS_TYPE ObservationCodec::_cellBits(const BitGridView &map,
+                                             const GridCell &robotPos) const {
+  despot::OBS_TYPE obsInt{0};
+  if (this->_fastPath(map, robotPos)) {
+    // The whole FOV is in the map (or its border), so read the bits directly
+    int robotIdx{map.index(robotPos)};
+    switch (this->_shape) {
+    case FOVKernels::Shape::eightNeighbour:
+      return FOVKernels::cellBits<FOVKernels::EightNeighbour>(
+          map.data(), map.stride(), robotIdx);
+    case FOVKernels::Shape::fourNeighbour:
+      return FOVKernels::cellBits<FOVKernels::FourNeighbour>(
+          map.data(), map.stride(), robotIdx);
+    default:
+      break;
+    }
+
+    const uint64_t *words{map.data()};
+    for (int offset : this->_offsetsFor(map)) {
+      int idx{robotIdx + offset};
+      obsInt = (obsInt << 1) | ((words[idx >> 6] >> (idx & 63)) & 1);
+    }
+    return obsInt;
+  }
+
+  for (const GridCell &cell : this->_fov) {
+    GridCell obsLoc{robotPos + cell};
+    // Out of bounds cells are occupied
+    bool occupied{!map.inBounds(obsLoc) || map.test(obsLoc)};
+    obsInt = (obsInt << 1) | (despot::OBS_TYPE)occupied;
+  }
+  return obsInt;
+}
+
+/**
+ * Gathers the map bits of a wide observation.
+ */
+void ObservationCodec::_gather(
+    const BitGridView &map, const GridCell &robotPos,
+    std::array<uint64_t, ObservationCodec::kMaxWideWords> &words) const {
+  int fovSize{(int)this->_fov.size()};
+  int numWords{(fovSize + 63) / 64};
+  if (this->_fastPath(map, robotPos)) {
+    // Each output word is built without branches, so the loop vectorises
+    const uint64_t *mapWords{map.data()};
+    const int *offsets{this->_offsetsFor(map).data()};
+    int robotIdx{map.index(robotPos)};
+    for (int w{0}; w < numWords; ++w) {
+      uint64_t word{0};
+      int end{std::min(64, fovSize - w * 64)};
+      for (int b{0}; b < end; ++b) {
+        int idx{robotIdx + offsets[w * 64 + b]};
+        word |= ((mapWords[idx >> 6] >> (idx & 63)) & 1) << b;
+      }
+      words[w] = word;
     }
+    return;
+  }
+
+  for (int w{0}; w < numWords; ++w) {
+    words[w] = 0;
+  }
+  for (int i{0}; i < fovSize; ++i) {
+    GridCell obsLoc{robotPos + this->_fov[i]};
+    // Out of bounds cells are occupied
+    bool occupied{!map.inBounds(obsLoc) || map.test(obsLoc)};
+    words[i >> 6] |= (uint64_t)occupied << (i & 63);
+  }
+}
+
+/**
+ * Computes the key of a wide observation's cell bits.
+ */
+despot::OBS_TYPE ObservationCodec::_wideKey(
+    const std::array<uint64_t, ObservationCodec::kMaxWideWords> &words) const {
+  despot::OBS_TYPE key{Zobrist::mix(this->_fov.size())};
+  for (int w{0}; w < ((int)this->_fov.size() + 63) / 64; ++w) {
+    key = Zobrist::mix(key ^ words[w]);
+  }
+  return key & ObservationCodec::kWideKeyMask;
+}
+
+/**
+ * Forgets every recorded wide observation.
+ */
+void ObservationCodec::clearWideObservations() const {
+  if (this->_wideTable != nullptr) {
+    this->_wideTable->clear();
   }
-  return Observation::toObsType(obsVec, outcome);
-}
\ No newline at end of file
+}
+
+/**
+ * Returns the number of distinct wide observations recorded.
+ */
+uint64_t ObservationCodec::numWideObservations() const {
+  return this->_wideTable != nullptr ? this->_wideTable->size() : 0;
+}
+
+/**
+ * Returns the recorded cell bits of a wide observation.
+ */
+const uint64_t *
+ObservationCodec::_widePattern(const despot::OBS_TYPE &obsInt) const {
+  const uint64_t *pattern{
+      this->_wideTable->find(obsInt & ObservationCodec::kWideKeyMask)};
+  if (pattern == nullptr) {
+    throw "Wide observation not recorded by this codec.";
+  }
+  return pattern;
+}
+
+/**
+ * Compute the observation given a bit packed map and robot position.
+ */
+despot::OBS_TYPE ObservationCodec::encode(const BitGridView &map,
+                                          const GridCell &robotPos,
+                                          bool success) const {
+  if (!this->isWide()) {
+    return this->_cellBits(map, robotPos) |
+           ((despot::OBS_TYPE)success << this->_fov.size());
+  }
+
+  std::array<uint64_t, ObservationCodec::kMaxWideWords> words{};
+  this->_gather(map, robotPos, words);
+  return this->_wideKey(words) | ((despot::OBS_TYPE)success << 63);
+}
+
+/**
+ * Computes an observation and records it so it can be decoded.
+ */
+despot::OBS_TYPE ObservationCodec::record(const BitGridView &map,
+                                          const GridCell &robotPos,
+                                          bool success) const {
+  if (!this->isWide()) {
+    return this->encode(map, robotPos, success);
+  }
+
+  std::array<uint64_t, ObservationCodec::kMaxWideWords> words{};
+  this->_gather(map, robotPos, words);
+  despot::OBS_TYPE key{this->_wideKey(words)};
+  this->_wideTable->store(key, words.data());
+  return key | ((despot::OBS_TYPE)success << 63);
+}
+
+/**
+ * Checks if an observation's map cells match a map.
+ */
+bool ObservationCodec::matches(const despot::OBS_TYPE &obsInt,
+                               const BitGridView &map,
+                               const GridCell &robotPos) const {
+  if (!this->isWide()) {
+    return ((obsInt ^ this->_cellBits(map, robotPos)) & this->_cellMask) == 0;
+  }
+
+  // Compare the keys of the cell bits, ignoring the success flag
+  std::array<uint64_t, ObservationCodec::kMaxWideWords> words{};
+  this->_gather(map, robotPos, words);
+  despot::OBS_TYPE diff{obsInt ^ this->_wideKey(words)};
+  return (diff & ObservationCodec::kWideKeyMask) == 0;
+}
+
+/**
+ * Returns whether a cell in the FOV was observed as occupied.
+ */
+int ObservationCodec::cellOccupied(const despot::OBS_TYPE &obsInt,
+                                   int index) const {
+  if (!this->isWide()) {
+    return Observation::cellOccupied(obsInt, this->_fov.size(), index);
+  }
+  return (int)((this->_widePattern(obsInt)[index >> 6] >> (index & 63)) & 1);
+}
+
+/**
+ * Sets the cells seen in an observation in a map belief.
+ */
+void ObservationCodec::applyObservation(const despot::OBS_TYPE &obsInt,
+                                        const GridCell &robotPos,
+                                        Eigen::MatrixXd &mapBelief) const {
+  if (this->_fastPath(mapBelief.rows(), mapBelief.cols(), 0, robotPos)) {
+    switch (this->_shape) {
+    case FOVKernels::Shape::eightNeighbour:
+      FOVKernels::applyObservation<FOVKernels::EightNeighbour>(
+          obsInt, robotPos, mapBelief);
+      return;
+    case FOVKernels::Shape::fourNeighbour:
+      FOVKernels::applyObservation<FOVKernels::FourNeighbour>(
+          obsInt, robotPos, mapBelief);
+      return;
+    default:
+      break;
+    }
+  }
+
+  for (int i{0}; i < (int)this->_fov.size(); ++i) {
+    GridCell cell{robotPos + this->_fov[i]};
+    if (!cell.outOfBounds(0, mapBelief.cols(), 0, mapBelief.rows())) {
+      mapBelief(cell.y, cell.x) = this->cellOccupied(obsInt, i);
+    }
+  }
+}
+
+/**
+ * Converts an observation into IMacObservations, writing into an existing
+ * vector.
+ */
+bool ObservationCodec::decode(const despot::OBS_TYPE &obsInt,
+                              const GridCell &robotPos,
+                              std::vector<IMacObservation> &obsVector) const {
+  if (!this->isWide()) {
+    return Observation::decode(obsInt, this->_fov, robotPos, obsVector);
+  }
+
+  const uint64_t *pattern{this->_widePattern(obsInt)};
+  obsVector.resize(this->_fov.size());
+  for (int i{0}; i < (int)this->_fov.size(); ++i) {
+    obsVector[i].cell = robotPos + this->_fov[i];
+    obsVector[i].occupied = (int)((pattern[i >> 6] >> (i & 63)) & 1);
+  }
+  return this->actionSucceeded(obsInt);
+}
@@ -30,9 +30,14 @@ despot::World *
 CoveragePlanner::InitializeWorld(std::string &world_type,
                                  despot::DSPOMDP *model,
                                  despot::option::Option *options) {
-  CoverageWorld *world{new CoverageWorld(this->_initPos, this->_initTime,
-                                         this->_timeBound, this->_fov,
-                                         this->_exec)};
+  // The world shares the POMDP's codec, so wide observations are shared too
+  CoverageWorld *world{
+      model == nullptr
+          ? new CoverageWorld(this->_initPos, this->_initTime,
+                              this->_timeBound, this->_fov, this->_exec)
+          : new CoverageWorld(
+                this->_initPos, this->_initTime, this->_timeBound, this->_exec,
+                static_cast<CoveragePOMDP *>(model)->getObservationCodec())};
   world->Connect();
   world->Initialize();
   return world;
@@ -5,12 +5,14 @@
  */
 
 #include "coverage_plan/planning/coverage_pomdp.h"
+#include "coverage_plan/mod/bit_grid.h"
 #include "coverage_plan/mod/grid_cell.h"
 #include "coverage_plan/mod/imac_executor.h"
 #include "coverage_plan/planning/action.h"
 #include "coverage_plan/planning/coverage_belief.h"
 #include "coverage_plan/planning/coverage_observation.h"
 #include "coverage_plan/planning/coverage_state.h"
+#include "coverage_plan/util/seed.h"
 #include <Eigen/Dense>
 #include <algorithm>
 #include <despot/core/builtin_lower_bounds.h>
@@ -31,12 +33,18 @@ bool CoveragePOMDP::Step(despot::State &state, double random_num,
                          despot::ACT_TYPE action, double &reward,
                          despot::OBS_TYPE &obs) const {
   CoverageState &coverageState = static_cast<CoverageState &>(state);
+  coverageState.pad();
 
   // Update the map state (only stochastic element)
-  coverageState.map = this->_beliefSampler->sampleFromBelief(
-      this->_imac->forwardStep(coverageState.map.cast<double>()), random_num);
+  // Draws are keyed by (random_num, time, cell), so Step has no side effects
+  this->_imac->forwardStepAndSample(coverageState.map,
+                                    SeedHelpers::doubleToUInt64(random_num),
+                                    coverageState.time);
 
   // The time is increased in each transition
+  // The hash is updated in O(1) alongside each change to the state
+  coverageState.hash ^= CoverageState::timeKey(coverageState.time) ^
+                        CoverageState::timeKey(coverageState.time + 1);
   ++coverageState.time;
 
   GridCell expectedLoc{ActionHelpers::applySuccessfulAction(
@@ -45,15 +53,17 @@ bool CoveragePOMDP::Step(despot::State &state, double random_num,
   outcome.action = ActionHelpers::fromInt(action);
 
   // Action success
-  // Occurs if location in bounds and 0
-  if ((!expectedLoc.outOfBounds(0, coverageState.map.cols(), 0,
-                                coverageState.map.rows())) &&
-      coverageState.map(expectedLoc.y, expectedLoc.x) == 0) {
+  // Occurs if location in bounds and 0. The map's border is occupied, so
+  // moves off the map fail without a bounds check
+  if (!coverageState.map.test(expectedLoc)) {
+    coverageState.hash ^=
+        CoverageState::positionKey(coverageState.robotPosition) ^
+        CoverageState::positionKey(expectedLoc);
     coverageState.robotPosition = expectedLoc;
     outcome.success = true;
 
     // Get a reward if we reach an previously unreached state
-    reward = 1.0 - (double)coverageState.covered.count(expectedLoc);
+    reward = coverageState.covered.test(expectedLoc) ? 0.0 : 1.0;
 
   } else {
     // If action failed, the robot's old location must be free
@@ -70,19 +80,87 @@ bool CoveragePOMDP::Step(despot::State &state, double random_num,
   outcome.location = coverageState.robotPosition;
 
   // Add to covered
-  coverageState.covered.insert(coverageState.robotPosition);
+  if (!coverageState.covered.test(coverageState.robotPosition)) {
+    coverageState.covered.set(coverageState.robotPosition);
+    coverageState.hash ^=
+        CoverageState::coveredKey(coverageState.robotPosition);
+  }
 
-  obs = Observation::computeObservation(
-      coverageState.map, coverageState.robotPosition, outcome, this->_fov);
+  obs = this->_obsCodec.encode(coverageState.map, coverageState.robotPosition,
+                               outcome.success);
 
   // Termination condition (time bound reached or all cells covered)
-  if (coverageState.time >= this->_timeBound or
-      coverageState.covered.size() == coverageState.map.size()) {
+  if (coverageState.time >= this->_timeBound or coverageState.covered.all()) {
     return true;
   }
   return false;
 }
 
+/**
+ * Steps a set of particles in a batch under the same action, in place.
+ */
+void CoveragePOMDP::StepBatch(ScenarioBatch &batch,
+                              const std::vector<int> &active,
+                              const despot::RandomStreams &streams,
+                              despot::ACT_TYPE action) const {
+  // Sample every map first, so the loop below only touches the flat arrays
+  for (int i : active) {
+    this->_imac->forwardStepAndSample(
+        batch.mapWords(i), 1,
+        SeedHelpers::doubleToUInt64(streams.Entry(batch.scenarioId[i])),
+        batch.time[i]);
+  }
+
+  // The same move as a bit offset. The maps' borders are occupied, so moves
+  // off the map fail without a bounds check
+  GridCell move{ActionHelpers::applySuccessfulAction(
+      GridCell{0, 0}, ActionHelpers::fromInt(action))};
+  int offset{move.x * batch.stride() + move.y};
+  bool isWait{action == ActionHelpers::toInt(Action::wait)};
+  int numCells{batch.rows() * batch.cols()};
+
+  for (int i : active) {
+    uint64_t *map{batch.mapWords(i)};
+    uint64_t *covered{batch.coveredWords(i)};
+    batch.hash[i] ^= CoverageState::timeKey(batch.time[i]) ^
+                     CoverageState::timeKey(batch.time[i] + 1);
+    ++batch.time[i];
+
+    int idx{batch.index(i)};
+    int expectedIdx{idx + offset};
+    bool success{true};
+    if (((map[expectedIdx >> 6] >> (expectedIdx & 63)) & 1) == 0) {
+      GridCell oldLoc{batch.x[i], batch.y[i]};
+      GridCell newLoc{oldLoc + move};
+      batch.hash[i] ^= CoverageState::positionKey(oldLoc) ^
+                       CoverageState::positionKey(newLoc);
+      batch.x[i] = newLoc.x;
+      batch.y[i] = newLoc.y;
+      idx = expectedIdx;
+      batch.reward[i] =
+          ((covered[idx >> 6] >> (idx & 63)) & 1) != 0 ? 0.0 : 1.0;
+    } else {
+      // If action failed, the robot's old location must be free
+      map[idx >> 6] &= ~(uint64_t{1} << (idx & 63));
+      success = isWait; // wait always succeeds
+      batch.reward[i] = 0.0;
+    }
+
+    // Add to covered
+    if (((covered[idx >> 6] >> (idx & 63)) & 1) == 0) {
+      covered[idx >> 6] |= uint64_t{1} << (idx & 63);
+      batch.hash[i] ^=
+          CoverageState::coveredKey(GridCell{batch.x[i], batch.y[i]});
+      ++batch.numCovered[i];
+    }
+
+    batch.obs[i] = this->_obsCodec.encode(
+        batch.map(i), GridCell{batch.x[i], batch.y[i]}, success);
+    batch.terminal[i] =
+        batch.time[i] >= this->_timeBound || batch.numCovered[i] == numCells;
+  }
+}
+
 /**
  * Returns the total number of actions.
  *
@@ -99,29 +177,12 @@ double CoveragePOMDP::ObsProb(despot::OBS_TYPE obs, const despot::State &state,
 
   const CoverageState &coverageState{static_cast<const CoverageState &>(state)};
 
-  // Don't need action success marker here, just the obs vector
-  std::vector<IMacObservation> obsVec{std::get<0>(
-      Observation::fromObsType(obs, this->_fov, coverageState.robotPosition))};
-
   // If one cell doesn't match, we return 0.0. If all good, we return 1.0
-  for (const IMacObservation &imacObs : obsVec) {
-
-    if (imacObs.cell.outOfBounds(0, coverageState.map.cols(), 0,
-                                 coverageState.map.rows())) {
-      // Out of bounds location should always be marked as occupied
-      if (!imacObs.occupied) {
-        return 0.0;
-      }
-    } else {
-      // coverageState.map has to be indexed (y,x)
-      if (coverageState.map(imacObs.cell.y, imacObs.cell.x) !=
-          imacObs.occupied) {
-        return 0.0;
-      }
-    }
-  }
-
-  return 1.0;
+  // Out of bounds locations should always be marked as occupied
+  return this->_obsCodec.matches(obs, coverageState.map,
+                                 coverageState.robotPosition)
+             ? 1.0
+             : 0.0;
 }
 
 /**
@@ -135,26 +196,23 @@ despot::Belief *CoveragePOMDP::InitialBelief(const despot::State *start,
     // privileged access to
     const CoverageState *initState{static_cast<const CoverageState *>(start)};
 
+    // A new belief starts a new episode, so no belief or history holds
+    // the wide observations recorded in previous episodes
+    this->_obsCodec.clearWideObservations();
+
     Eigen::MatrixXd initMapBelief{this->_imac->getInitialBelief()};
     // Add initial observation into initial belief
     // The robot should be able to make an initial observation before moving
-    for (const GridCell &cell : this->_fov) {
-      GridCell absCell{initState->robotPosition + cell};
+    this->_obsCodec.applyObservation(
+        this->_obsCodec.record(initState->map, initState->robotPosition, true),
+        initState->robotPosition, initMapBelief);
 
-      if (!absCell.outOfBounds(0, initMapBelief.cols(), 0,
-                               initMapBelief.rows())) {
-        initMapBelief(absCell.y, absCell.x) =
-            initState->map(absCell.y, absCell.x);
-      }
-
-      // Robot's initial location must be unoccupied by obstacles
-      initMapBelief(initState->robotPosition.y, initState->robotPosition.x) =
-          0.0;
-    }
+    // Robot's initial location must be unoccupied by obstacles
+    initMapBelief(initState->robotPosition.y, initState->robotPosition.x) = 0.0;
 
     return new CoverageBelief(this, initState->robotPosition, initState->time,
                               initState->covered, initMapBelief, this->_imac,
-                              this->_fov);
+                              this->_obsCodec);
   } else { // Not supporting anything else (for now)
     std::cerr << "[CoveragePOMDP::InitialBelief] Unsupported belief type: "
               << type << '\n';
@@ -227,7 +285,8 @@ CoveragePOMDP::CreateScenarioLowerBound(std::string name,
                                         std::string particleBoundName) const {
   if (name == "GREEDY" || name == "DEFAULT") {
     return new GreedyCoverageDefaultPolicy(
-        this, this->CreateParticleLowerBound("ZERO"), this->_imac);
+        this, this->CreateParticleLowerBound("ZERO"), this->_imac,
+        this->_transpositionTable);
   } else if (name == "TRIVIAL") {
     return new despot::TrivialParticleLowerBound{this};
   } else if (name == "RANDOM") {
@@ -258,8 +317,9 @@ void CoveragePOMDP::PrintObs(const despot::State &state, despot::OBS_TYPE obs,
   const CoverageState &coverageState{static_cast<const CoverageState &>(state)};
 
   // Want relative observationshere
-  std::pair<std::vector<IMacObservation>, bool> obsInfo{
-      Observation::fromObsType(obs, this->_fov)};
+  std::pair<std::vector<IMacObservation>, bool> obsInfo{};
+  std::get<1>(obsInfo) = this->_obsCodec.decode(obs, GridCell{0, 0},
+                                                std::get<0>(obsInfo));
 
   // Print action success info
   if (std::get<1>(obsInfo)) {
@@ -361,6 +421,8 @@ despot::State *CoveragePOMDP::Allocate(int state_id, double weight) const {
 /**
  * Copy a state.
  * Copied with minor modifications from the DESPOT tutorial.
+ * The copy shares the map and covered storage with particle until either is
+ * written to, so this is O(1) in the map size.
  */
 despot::State *CoveragePOMDP::Copy(const despot::State *particle) const {
   CoverageState *state = this->_memoryPool.Allocate();
@@ -374,7 +436,12 @@ despot::State *CoveragePOMDP::Copy(const despot::State *particle) const {
  * Copied with minor modifications from the DESPOT tutorial.
  */
 void CoveragePOMDP::Free(despot::State *state) const {
-  this->_memoryPool.Free(static_cast<CoverageState *>(state));
+  // The pool keeps freed states alive, so drop their shared grid storage now.
+  // Otherwise live particles sharing it would clone it on their next write
+  CoverageState *coverState{static_cast<CoverageState *>(state)};
+  coverState->map = BitGrid{};
+  coverState->covered = BitGrid{};
+  this->_memoryPool.Free(coverState);
 }
 
 /**
@@ -11,7 +11,6 @@
 #include "coverage_plan/planning/action.h"
 #include <fstream>
 #include <iostream>
-#include <map>
 #include <memory>
 #include <set>
 #include <vector>
@@ -40,98 +39,6 @@ std::shared_ptr<IMac> CoverageRobot::_getIMacInstanceForEpisode() {
   }
 }
 
-/**
- * Helper function to add an initial state observation to a BIMacObservation
- */
-void CoverageRobot::_addInitObservation(
-    std::map<GridCell, BIMacObservation> &biMacObsMap,
-    const IMacObservation &obs) {
-
-  if (!obs.cell.outOfBounds(0, this->_xDim, 0, this->_yDim)) {
-    // count returns number of keys of obs.cell
-    if (biMacObsMap.count(obs.cell) == 0) {
-      biMacObsMap[obs.cell] = BIMacObservation{obs.cell, 0, 0, 0, 0, 0, 0};
-    }
-    if (obs.occupied == 1) {
-      biMacObsMap[obs.cell].initOccupied += 1;
-    } else {
-      biMacObsMap[obs.cell].initFree += 1;
-    }
-  }
-}
-
-/**
- * Helper function to add IMac transition observation to a BIMacObservation.
- */
-void CoverageRobot::_addTransitionObservation(
-    std::map<GridCell, BIMacObservation> &biMacObsMap, const GridCell &cell,
-    const int &prevState, const int &nextState) {
-
-  // Have we got an observation struct for this cell?
-  if (!cell.outOfBounds(0, this->_xDim, 0, this->_yDim)) {
-    if (biMacObsMap.count(cell) == 0) {
-      biMacObsMap[cell] = BIMacObservation{cell, 0, 0, 0, 0, 0, 0};
-    }
-    if (prevState == 0 && nextState == 0) {
-      biMacObsMap[cell].freeToFree += 1;
-    } else if (prevState == 0 && nextState == 1) {
-      biMacObsMap[cell].freeToOccupied += 1;
-    } else if (prevState == 1 && nextState == 0) {
-      biMacObsMap[cell].occupiedToFree += 1;
-    } else {
-      biMacObsMap[cell].occupiedToOccupied += 1;
-    }
-  }
-}
-
-/**
- * Converts IMacObservation vectors into a BIMacObservation vector.
- */
-std::vector<BIMacObservation> CoverageRobot::_generateBIMacObservations(
-    const std::vector<std::vector<IMacObservation>> &observations) {
-
-  std::map<GridCell, BIMacObservation> biMacObsMap{};
-  std::map<GridCell, int> prevObsMap{};
-  std::map<GridCell, int> currentObsMap{};
-
-  // Deal with initial observation
-  std::vector<IMacObservation> initObs{observations.at(0)};
-  for (const IMacObservation &obs : initObs) {
-    if (!obs.cell.outOfBounds(0, this->_xDim, 0, this->_yDim)) {
-      prevObsMap[obs.cell] = obs.occupied;
-      this->_addInitObservation(biMacObsMap, obs);
-    }
-  }
-
-  // Iterate through each timestep
-  for (int i{1}; i < observations.size(); ++i) {
-    for (const IMacObservation &obs : observations.at(i)) {
-      if (!obs.cell.outOfBounds(0, this->_xDim, 0, this->_yDim)) {
-        currentObsMap[obs.cell] = obs.occupied;
-      }
-    }
-    // Iterate over preObsMap
-    for (const auto &elem : prevObsMap) {
-      // Have we got a BIMac observation?
-      if (currentObsMap.count(elem.first) > 0) {
-        this->_addTransitionObservation(biMacObsMap, elem.first, elem.second,
-                                        currentObsMap[elem.first]);
-      }
-    }
-    // Prepare for next iteration
-    prevObsMap = currentObsMap;
-    currentObsMap.clear();
-  }
-
-  // Convert biMac map into biMac vector
-  std::vector<BIMacObservation> biMacObsVector{};
-  for (const auto &elem : biMacObsMap) {
-    biMacObsVector.push_back(elem.second);
-  }
-
-  return biMacObsVector;
-}
-
 /**
  * Returns a vector of actions that can be executed from the current location.
  */
@@ -199,7 +106,7 @@ void CoverageRobot::_printCurrentTransition(const GridCell &startLoc,
  * Wrapper around _planFn which fills in the gaps from class members.
  */
 Action
-CoverageRobot::planNextAction(int time, std::shared_ptr<IMac> imac,
+CoverageRobot::planNextAction(int time, const std::shared_ptr<IMac> &imac,
                               const std::vector<IMacObservation> &obsVector) {
   return this->_planFn(this->_currentLoc, this->_getEnabledActions(), time,
                        this->_timeBound, imac, this->_visited, obsVector);
@@ -263,11 +170,11 @@ CoverageRobot::runCoverageEpisode(const std::filesystem::path &outFile) {
   std::set<GridCell> covered{};
 
   std::shared_ptr<IMac> imacForEpisode{this->_getIMacInstanceForEpisode()};
-  int numCells{(int)(imacForEpisode->getEntryMatrix().rows() *
-                     imacForEpisode->getEntryMatrix().cols())};
+  int numCells{(int)imacForEpisode->getEntryMatrix().size()};
 
-  // At each timestep, we get a vector of observations
-  std::vector<std::vector<IMacObservation>> observations{};
+  // Only the latest observations are kept, BIMac counts are accumulated
+  std::vector<IMacObservation> currentObs{};
+  this->_transitionCounter.reset();
 
   // Additional setup for the episode
   this->episodeSetup(this->_initLoc, t, this->_timeBound, imacForEpisode);
@@ -275,17 +182,18 @@ CoverageRobot::runCoverageEpisode(const std::filesystem::path &outFile) {
   // Add initial location to visited and take initial observations
   this->_visited.push_back(this->_currentLoc);
   covered.insert(this->_currentLoc);
-  observations.push_back(this->makeObservations());
+  currentObs = this->makeObservations();
+  this->_transitionCounter.addObservations(currentObs);
 
   while (t < this->_timeBound and covered.size() < numCells) {
 
-    Action nextAction{this->planNextAction(
-        t, imacForEpisode, observations.at(observations.size() - 1))};
+    Action nextAction{this->planNextAction(t, imacForEpisode, currentObs)};
 
     ActionOutcome outcome{this->executeAction(nextAction)};
 
-    // Add current observation to observations
-    observations.push_back(this->makeObservations());
+    // Take the new observations and count any transitions
+    currentObs = this->makeObservations();
+    this->_transitionCounter.addObservations(currentObs);
 
     // Update location, visited, covered, and time
     this->_currentLoc = outcome.location;
@@ -295,7 +203,8 @@ CoverageRobot::runCoverageEpisode(const std::filesystem::path &outFile) {
   }
 
   // Update BiMac
-  this->_bimac->updatePosterior(this->_generateBIMacObservations(observations));
+  this->_bimac->updatePosterior(
+      this->_transitionCounter.getBIMacObservations());
 
   // Log results
   this->logVisitedLocations(outFile);
@@ -7,10 +7,33 @@
 
 #include "coverage_plan/planning/coverage_state.h"
 #include <cmath>
+#include <cstdint>
 #include <iomanip>
 #include <sstream>
 #include <string>
 
+/**
+ * Computes the Zobrist hash of the state from scratch.
+ */
+uint64_t CoverageState::computeHash() const {
+  uint64_t stateHash{CoverageState::positionKey(this->robotPosition) ^
+                     CoverageState::timeKey(this->time)};
+
+  // Walk the set bits of covered, skipping the border if it is padded
+  const uint64_t *words{this->covered.data()};
+  for (int w{0}; w < this->covered.numWords(); ++w) {
+    uint64_t word{words[w]};
+    while (word != 0) {
+      GridCell cell{this->covered.cellAt(w * 64 + __builtin_ctzll(word))};
+      if (this->covered.inBounds(cell)) {
+        stateHash ^= CoverageState::coveredKey(cell);
+      }
+      word &= word - 1;
+    }
+  }
+  return stateHash;
+}
+
 /**
  * Produces a string description of a state.
  *
@@ -23,7 +46,7 @@ std::string CoverageState::text() const {
 
   // Write out timestep and coverage %
   stream << "Time: " << this->time << "; Coverage: "
-         << int(round(100 * ((double)this->covered.size()) /
+         << int(round(100 * ((double)this->covered.count()) /
                       ((double)this->map.size())))
          << "%\n";
 
@@ -31,7 +54,7 @@ std::string CoverageState::text() const {
   for (int y{0}; y < this->map.rows(); ++y) {
     for (int x{0}; x < this->map.cols(); ++x) {
       // Write covered cells in green
-      if (this->covered.count(GridCell{x, y}) == 1) {
+      if (this->covered.test(GridCell{x, y})) {
         stream << "\x1b[1;32m";
       } else {
         stream << "\033[1;0m";
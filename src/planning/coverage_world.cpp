@@ -6,6 +6,7 @@
  */
 
 #include "coverage_plan/planning/coverage_world.h"
+#include "coverage_plan/mod/bit_grid.h"
 #include "coverage_plan/mod/grid_cell.h"
 #include "coverage_plan/mod/imac_executor.h"
 #include "coverage_plan/planning/action.h"
@@ -38,12 +39,16 @@ despot::State *CoverageWorld::Initialize() {
 
   coverState->robotPosition = this->_initPos;
   coverState->time = this->_initTime;
-  coverState->covered = std::set<GridCell>{this->_initPos};
 
   // Make sure to set the robot's initial position to free :)
   coverState->map = this->_exec->restart(
       std::vector<IMacObservation>{IMacObservation{this->_initPos, 0}});
 
+  coverState->covered =
+      BitGrid{coverState->map.rows(), coverState->map.cols(),
+              std::set<GridCell>{this->_initPos}};
+  coverState->hash = coverState->computeHash();
+
   return coverState;
 }
 
@@ -87,19 +92,20 @@ bool CoverageWorld::ExecuteAction(despot::ACT_TYPE action,
   outcome.location = succLoc;
   coverState->robotPosition = succLoc;
 
-  // Update robot pos in map
-  coverState->map = this->_exec->clearRobotPosition(coverState->robotPosition);
+  // Update robot pos in map (the map already holds the rest of the state)
+  this->_exec->clearRobotPosition(coverState->robotPosition);
+  coverState->map.set(coverState->robotPosition, false);
 
   // Update covered
-  coverState->covered.insert(coverState->robotPosition);
+  coverState->covered.set(coverState->robotPosition);
+  coverState->hash = coverState->computeHash();
 
-  // Compute observation
-  obs = Observation::computeObservation(
-      coverState->map, coverState->robotPosition, outcome, this->_fov);
+  // Compute observation, recorded so the belief can decode it
+  obs = this->_obsCodec.record(coverState->map, coverState->robotPosition,
+                               outcome.success);
 
   // Termination condition (time bound reached or all cells covered)
-  if (coverState->time >= this->_timeBound or
-      coverState->covered.size() == coverState->map.size()) {
+  if (coverState->time >= this->_timeBound or coverState->covered.all()) {
     return true;
   }
   return false;
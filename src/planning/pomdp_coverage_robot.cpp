@@ -22,7 +22,6 @@
 #include <despot/util/optionparser.h>
 #include <iostream>
 #include <memory>
-#include <tuple>
 #include <vector>
 
 /**
@@ -32,10 +31,12 @@
 Action
 POMDPCoverageRobot::_planFn(const GridCell &currentLoc,
                             const std::vector<Action> &enabledActions, int ts,
-                            int timeBound, std::shared_ptr<IMac> imac,
+                            int timeBound, const std::shared_ptr<IMac> &imac,
                             const std::vector<GridCell> &visited,
                             const std::vector<IMacObservation> &currentObs) {
   auto start{std::chrono::high_resolution_clock::now()};
+  // Rollout values are only valid for the scenarios sampled in one search
+  this->_pomdp->clearTranspositionTable();
   Action action{ActionHelpers::fromInt(this->_solver->Search().action)};
   auto end{std::chrono::high_resolution_clock::now()};
   auto duration{
@@ -53,12 +54,9 @@ ActionOutcome POMDPCoverageRobot::_executeFn(const GridCell &currentLoc,
   despot::OBS_TYPE obs{0};
   this->_world->ExecuteAction(ActionHelpers::toInt(action), obs);
 
-  // Reformat the observation
-  std::pair<std::vector<IMacObservation>, bool> obsInfo{
-      Observation::fromObsType(obs, this->_fov)};
-
   // Create the ActionOutcome object
-  bool succ{std::get<1>(obsInfo)};
+  const ObservationCodec &obsCodec{this->_pomdp->getObservationCodec()};
+  bool succ{obsCodec.actionSucceeded(obs)};
   GridCell nextLoc{currentLoc};
   if (succ) {
     nextLoc = ActionHelpers::applySuccessfulAction(currentLoc, action);
@@ -69,9 +67,8 @@ ActionOutcome POMDPCoverageRobot::_executeFn(const GridCell &currentLoc,
   this->_printCurrentTransition(currentLoc, outcome);
 
   // BiMac requires absolute observations, not relative!
-  obsInfo = Observation::fromObsType(obs, this->_fov, nextLoc);
-  // Add observation to be picked up by makeObservations
-  this->_latestObs = std::get<0>(obsInfo);
+  // Add observation to be picked up by makeObservations, reusing its storage
+  obsCodec.decode(obs, nextLoc, this->_latestObs);
 
   // Now do a belief update (has to be done here as we need the action)
   this->_solver->BeliefUpdate(ActionHelpers::toInt(action), obs);
@@ -97,11 +94,10 @@ POMDPCoverageRobot::_initialObservation(const GridCell &startLoc) {
       static_cast<CoverageState *>(this->_world->GetCurrentState())};
 
   // The action here doesn't matter
-  despot::OBS_TYPE obs{Observation::computeObservation(
-      state->map, startLoc, ActionOutcome{Action::wait, true, startLoc},
-      this->_fov)};
-
-  return std::get<0>(Observation::fromObsType(obs, this->_fov, startLoc));
+  const ObservationCodec &obsCodec{this->_pomdp->getObservationCodec()};
+  obsCodec.decode(obsCodec.record(state->map, startLoc, true), startLoc,
+                  initObs);
+  return initObs;
 }
 
 /**
@@ -0,0 +1,88 @@
+/**
+ * Implementation of the ScenarioBatch class in scenario_batch.h.
+ * @see scenario_batch.h
+ *
+ * @author Charlie Street
+ */
+
+#include "coverage_plan/planning/scenario_batch.h"
+#include "coverage_plan/mod/bit_grid.h"
+#include "coverage_plan/mod/grid_cell.h"
+#include "coverage_plan/planning/coverage_state.h"
+#include <algorithm>
+#include <cstdint>
+#include <despot/interface/pomdp.h>
+#include <utility>
+#include <vector>
+
+/**
+ * Fills the batch with copies of a set of particles.
+ */
+void ScenarioBatch::assign(const std::vector<despot::State *> &particles) {
+  int n{(int)particles.size()};
+  if (n > 0) {
+    const CoverageState *first{
+        static_cast<const CoverageState *>(particles.at(0))};
+    this->_rows = first->map.rows();
+    this->_cols = first->map.cols();
+    this->_stride = this->_rows + 2;
+    this->_numWords = BitGrid::padded(BitGrid{this->_rows, this->_cols}, true)
+                          .numWords();
+  }
+
+  // resize keeps the capacity, so a reused batch doesn't allocate
+  this->x.resize(n);
+  this->y.resize(n);
+  this->time.resize(n);
+  this->scenarioId.resize(n);
+  this->weight.resize(n);
+  this->hash.resize(n);
+  this->numCovered.resize(n);
+  this->maps.resize(n * this->_numWords);
+  this->covered.resize(n * this->_numWords);
+  this->reward.assign(n, 0.0);
+  this->obs.assign(n, 0);
+  this->terminal.assign(n, 0);
+
+  for (int i{0}; i < n; ++i) {
+    const CoverageState *state{
+        static_cast<const CoverageState *>(particles.at(i))};
+    if (state->map.rows() != this->_rows || state->map.cols() != this->_cols) {
+      throw "Particles in a batch must have the same map dimensions";
+    }
+    this->x[i] = state->robotPosition.x;
+    this->y[i] = state->robotPosition.y;
+    this->time[i] = state->time;
+    this->scenarioId[i] = state->scenario_id;
+    this->weight[i] = state->weight;
+    this->hash[i] = state->hash;
+
+    // padded() is O(1) for states already in the batch's layout
+    BitGrid map{BitGrid::padded(state->map, true)};
+    BitGrid coveredCells{BitGrid::padded(state->covered, true)};
+    std::copy(map.data(), map.data() + this->_numWords, this->mapWords(i));
+    std::copy(coveredCells.data(), coveredCells.data() + this->_numWords,
+              this->coveredWords(i));
+    this->numCovered[i] = coveredCells.count();
+  }
+}
+
+/**
+ * Writes a particle in the batch back into a CoverageState.
+ */
+void ScenarioBatch::toState(int i, CoverageState &state) const {
+  state.robotPosition = GridCell{this->x[i], this->y[i]};
+  state.time = this->time[i];
+  state.scenario_id = this->scenarioId[i];
+  state.weight = this->weight[i];
+  state.hash = this->hash[i];
+
+  BitGrid map{BitGrid::padded(BitGrid{this->_rows, this->_cols}, true)};
+  BitGrid coveredCells{map};
+  const uint64_t *mapStart{this->maps.data() + i * this->_numWords};
+  const uint64_t *coveredStart{this->covered.data() + i * this->_numWords};
+  std::copy(mapStart, mapStart + this->_numWords, map.data());
+  std::copy(coveredStart, coveredStart + this->_numWords, coveredCells.data());
+  state.map = std::move(map);
+  state.covered = std::move(coveredCells);
+}
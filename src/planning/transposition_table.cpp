@@ -0,0 +1,95 @@
+/**
+ * Implementation of the TranspositionTable class in transposition_table.h.
+ * @see transposition_table.h
+ *
+ * @author Charlie Street
+ */
+
+#include "coverage_plan/planning/transposition_table.h"
+#include "coverage_plan/planning/coverage_state.h"
+#include "coverage_plan/util/zobrist.h"
+#include <algorithm>
+#include <cstdint>
+#include <despot/core/globals.h>
+#include <despot/interface/pomdp.h>
+#include <vector>
+
+namespace {
+
+/**
+ * Get the number of table entries, checking the size is sensible.
+ *
+ * @param log2Size The log2 of the number of entries
+ *
+ * @returns The number of entries
+ */
+uint64_t tableSize(int log2Size) {
+  if (log2Size < 0 || log2Size > 30) {
+    throw "Transposition table size out of range";
+  }
+  return uint64_t{1} << log2Size;
+}
+
+} // namespace
+
+/**
+ * Constructor allocates the table.
+ */
+TranspositionTable::TranspositionTable(int log2Size)
+    : _entries(tableSize(log2Size)), _mask{tableSize(log2Size) - 1},
+      _generation{1}, _hits{0}, _misses{0} {}
+
+/**
+ * Computes the key for a set of particles.
+ */
+uint64_t TranspositionTable::particlesKey(
+    const std::vector<despot::State *> &particles) {
+  // Summing the mixed particle keys makes the key independent of order
+  uint64_t key{Zobrist::mix(particles.size())};
+  for (const despot::State *particle : particles) {
+    const CoverageState *coverState{
+        static_cast<const CoverageState *>(particle)};
+    key += Zobrist::mix(coverState->hash ^
+                        Zobrist::key(3, coverState->scenario_id, 0));
+  }
+  return key;
+}
+
+/**
+ * Looks up a cached value.
+ */
+bool TranspositionTable::lookup(uint64_t key, despot::ValuedAction &result) {
+  const Entry &entry{this->_entries[key & this->_mask]};
+  if (entry.generation != this->_generation || entry.key != key) {
+    ++this->_misses;
+    return false;
+  }
+  ++this->_hits;
+  result = despot::ValuedAction(entry.action, entry.value);
+  return true;
+}
+
+/**
+ * Caches a value, replacing any entry in the same slot.
+ */
+void TranspositionTable::store(uint64_t key,
+                               const despot::ValuedAction &result) {
+  Entry &entry{this->_entries[key & this->_mask]};
+  entry.key = key;
+  entry.generation = this->_generation;
+  entry.action = result.action;
+  entry.value = result.value;
+}
+
+/**
+ * Empties the table.
+ */
+void TranspositionTable::clear() {
+  ++this->_generation;
+  if (this->_generation == 0) { // Wrapped, so old entries could look valid
+    std::fill(this->_entries.begin(), this->_entries.end(), Entry{});
+    this->_generation = 1;
+  }
+  this->_hits = 0;
+  this->_misses = 0;
+}
@@ -0,0 +1,165 @@
+/**
+ * Tests for the BIMac log in bimac_log.h.
+ *
+ * @author Charlie Street
+ */
+#include "coverage_plan/mod/bimac.h"
+#include "coverage_plan/mod/bimac_log.h"
+#include "coverage_plan/mod/grid_cell.h"
+#include "util/bimac_checks.h"
+#include <Eigen/Dense>
+#include <catch2/catch.hpp>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+
+/**
+ * Generate a random batch of BIMac observations for an episode.
+ *
+ * @param gen The random generator
+ * @param xDim The x dimension of the map
+ * @param yDim The y dimension of the map
+ *
+ * @returns A vector of BIMacObservations
+ */
+std::vector<BIMacObservation> randomEpisode(std::mt19937 &gen, int xDim,
+                                            int yDim) {
+  std::uniform_int_distribution<int> countDist{0, 3};
+  std::bernoulli_distribution touchDist{0.3};
+  std::vector<BIMacObservation> observations{};
+  for (int x{0}; x < xDim; ++x) {
+    for (int y{0}; y < yDim; ++y) {
+      if (touchDist(gen)) {
+        observations.push_back(BIMacObservation{
+            GridCell{x, y}, countDist(gen), countDist(gen), countDist(gen),
+            countDist(gen), countDist(gen), countDist(gen)});
+      }
+    }
+  }
+  return observations;
+}
+
+} // namespace
+
+TEST_CASE("Tests for writing and replaying BIMac logs", "[BIMacLog]") {
+  std::mt19937 gen{5};
+  std::filesystem::path logFile{"/tmp/bimac_log_test.log"};
+  BIMac bimac{4, 3};
+  std::vector<BIMac> history{bimac};
+
+  {
+    BIMacLogWriter writer{logFile, bimac, 5};
+    REQUIRE(writer.episode() == 0);
+    for (int episode{1}; episode <= 12; ++episode) {
+      std::vector<BIMacObservation> obs{randomEpisode(gen, 4, 3)};
+      bimac.updatePosterior(obs);
+      writer.logEpisode(obs, bimac);
+      history.push_back(bimac);
+    }
+    REQUIRE(writer.episode() == 12);
+  }
+
+  BIMacLogReader reader{logFile};
+  REQUIRE(reader.rows() == 3);
+  REQUIRE(reader.cols() == 4);
+  REQUIRE(reader.snapshotInterval() == 5);
+  REQUIRE(reader.lastEpisode() == 12);
+  REQUIRE(reader.numSnapshots() == 3); // Episodes 0, 5, 10
+  REQUIRE(reader.validBytes() == std::filesystem::file_size(logFile));
+  for (int episode{0}; episode <= 12; ++episode) {
+    requireSameCounts(*reader.replay(episode), history.at(episode));
+  }
+  requireSameCounts(*BIMacLog::replay(logFile, 7), history.at(7));
+  REQUIRE_THROWS(reader.replay(13));
+  REQUIRE_THROWS(reader.replay(-1));
+
+  // Reopen and keep appending
+  {
+    BIMacLogWriter writer{logFile};
+    REQUIRE(writer.episode() == 12);
+    for (int episode{13}; episode <= 15; ++episode) {
+      std::vector<BIMacObservation> obs{randomEpisode(gen, 4, 3)};
+      bimac.updatePosterior(obs);
+      writer.logEpisode(obs, bimac);
+      history.push_back(bimac);
+    }
+  }
+  BIMacLogReader reopened{logFile};
+  REQUIRE(reopened.lastEpisode() == 15);
+  REQUIRE(reopened.numSnapshots() == 4);
+  for (int episode{0}; episode <= 15; ++episode) {
+    requireSameCounts(*reopened.replay(episode), history.at(episode));
+  }
+
+  std::filesystem::remove(logFile);
+}
+
+TEST_CASE("Tests for recovering truncated BIMac logs",
+          "[BIMacLog-truncated]") {
+  std::mt19937 gen{9};
+  std::filesystem::path logFile{"/tmp/bimac_log_truncated_test.log"};
+  BIMac bimac{3, 3};
+  std::vector<BIMac> history{bimac};
+  {
+    BIMacLogWriter writer{logFile, bimac, 50};
+    for (int episode{1}; episode <= 4; ++episode) {
+      std::vector<BIMacObservation> obs{randomEpisode(gen, 3, 3)};
+      bimac.updatePosterior(obs);
+      writer.logEpisode(obs, bimac);
+      history.push_back(bimac);
+    }
+  }
+
+  // Simulate a crash part way through writing the last record
+  std::filesystem::resize_file(logFile,
+                               std::filesystem::file_size(logFile) - 3);
+  BIMacLogReader reader{logFile};
+  REQUIRE(reader.lastEpisode() == 3);
+  REQUIRE(reader.validBytes() < std::filesystem::file_size(logFile));
+  requireSameCounts(*reader.replay(3), history.at(3));
+
+  // Reopening drops the incomplete record
+  {
+    BIMacLogWriter writer{logFile};
+    REQUIRE(writer.episode() == 3);
+    REQUIRE(std::filesystem::file_size(logFile) == reader.validBytes());
+    writer.logEpisode({BIMacObservation{GridCell{2, 1}, 1, 0, 0, 0, 0, 0}},
+                      bimac);
+  }
+  BIMac expected{history.at(3)};
+  expected.updatePosterior(
+      {BIMacObservation{GridCell{2, 1}, 1, 0, 0, 0, 0, 0}});
+  requireSameCounts(*BIMacLog::replay(logFile, 4), expected);
+
+  std::filesystem::remove(logFile);
+}
+
+TEST_CASE("Tests for invalid BIMac logs", "[BIMacLog-invalid]") {
+  std::filesystem::path logFile{"/tmp/bimac_log_invalid_test.log"};
+  REQUIRE_THROWS(BIMacLogReader{"/tmp/bimac_log_missing.log"});
+  REQUIRE_THROWS(BIMacLogWriter{"/tmp/bimac_log_missing.log"});
+
+  BIMac bimac{2, 2};
+  REQUIRE_THROWS(BIMacLogWriter{logFile, bimac, 0});
+
+  {
+    // Snapshot every episode, so mismatched BIMacs are caught
+    BIMacLogWriter writer{logFile, bimac, 1};
+    REQUIRE_THROWS(writer.logEpisode(
+        {BIMacObservation{GridCell{2, 0}, 1, 0, 0, 0, 0, 0}}, bimac));
+    REQUIRE_THROWS(writer.logEpisode({}, BIMac{3, 2}));
+  }
+
+  {
+    std::fstream f(logFile, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(0);
+    f.put('X');
+  }
+  REQUIRE_THROWS(BIMacLogReader{logFile});
+
+  std::filesystem::remove(logFile);
+}
@@ -11,6 +11,8 @@
 #include <catch2/catch.hpp>
 #include <filesystem>
 #include <memory>
+#include <thread>
+#include <vector>
 
 TEST_CASE("Tests for initialisation BIMac constructor", "[BIMac]") {
 
@@ -339,4 +341,259 @@ TEST_CASE("Tests for posterior sample", "[posteriorSample]") {
       REQUIRE(initBelief(i, j) > 0.99);
     }
   }
-}
\ No newline at end of file
+}
+TEST_CASE("Tests for seeded posterior sample", "[posteriorSample-seeded]") {
+  // Check the moments of each Beta distribution over many cells
+  std::vector<std::pair<int, int>> params{{1, 1}, {2, 5}, {8, 3}, {9, 9},
+                                          {30, 70}, {500, 20}};
+  for (const std::pair<int, int> &param : params) {
+    const int alpha{param.first};
+    const int beta{param.second};
+    BIMac bimac{Eigen::MatrixXi::Constant(100, 100, alpha),
+                Eigen::MatrixXi::Constant(100, 100, beta),
+                Eigen::MatrixXi::Constant(100, 100, beta),
+                Eigen::MatrixXi::Constant(100, 100, alpha),
+                Eigen::MatrixXi::Constant(100, 100, alpha),
+                Eigen::MatrixXi::Constant(100, 100, beta)};
+    std::shared_ptr<IMac> imac{bimac.posteriorSample(42)};
+
+    double n{alpha + beta + 0.0};
+    double mean{alpha / n};
+    double var{alpha * beta / (n * n * (n + 1.0))};
+    for (const Eigen::MatrixXd &sample :
+         {imac->getEntryMatrix(), imac->getInitialBelief(),
+          Eigen::MatrixXd{1.0 - imac->getExitMatrix().array()}}) {
+      REQUIRE(sample.minCoeff() >= 0.0);
+      REQUIRE(sample.maxCoeff() <= 1.0);
+      double sampleMean{sample.mean()};
+      double sampleVar{(sample.array() - sampleMean).square().mean()};
+      // 10000 samples, so allow 5 standard errors
+      REQUIRE(std::abs(sampleMean - mean) < 5.0 * std::sqrt(var / 10000.0));
+      REQUIRE_THAT(sampleVar, Catch::Matchers::WithinRel(var, 0.1));
+    }
+  }
+
+  // Same seed gives the same sample, regardless of the number of threads
+  BIMac bimac{57, 43};
+  std::vector<BIMacObservation> obsVec{};
+  for (int x{0}; x < 57; ++x) {
+    obsVec.push_back(BIMacObservation{GridCell{x, x % 43}, x, 2 * x, 3,
+                                      40 - x % 40, x % 2, 1 - x % 2});
+  }
+  bimac.updatePosterior(obsVec);
+  std::shared_ptr<IMac> first{bimac.posteriorSample(7)};
+  std::shared_ptr<IMac> second{bimac.posteriorSample(7, 4)};
+  std::shared_ptr<IMac> third{bimac.posteriorSample(8)};
+  REQUIRE(first->getEntryMatrix() == second->getEntryMatrix());
+  REQUIRE(first->getExitMatrix() == second->getExitMatrix());
+  REQUIRE(first->getInitialBelief() == second->getInitialBelief());
+  REQUIRE(first->getEntryMatrix() != third->getEntryMatrix());
+
+  // The three matrices use different random streams
+  BIMac uniform{4, 4};
+  std::shared_ptr<IMac> uniformSample{uniform.posteriorSample(3)};
+  REQUIRE(uniformSample->getEntryMatrix() != uniformSample->getExitMatrix());
+  REQUIRE(uniformSample->getEntryMatrix() !=
+          uniformSample->getInitialBelief());
+
+  // Invalid parameters
+  BIMac invalid{Eigen::MatrixXi::Zero(2, 2), Eigen::MatrixXi::Ones(2, 2),
+                Eigen::MatrixXi::Ones(2, 2), Eigen::MatrixXi::Ones(2, 2),
+                Eigen::MatrixXi::Ones(2, 2), Eigen::MatrixXi::Ones(2, 2)};
+  REQUIRE_THROWS(invalid.posteriorSample(1));
+}
+
+TEST_CASE("Tests for cached BIMac estimates", "[BIMac-cache]") {
+  BIMac bimac{4, 3};
+
+  // Nothing changed, so the same snapshot is returned
+  std::shared_ptr<IMac> mean{bimac.posteriorMean()};
+  std::shared_ptr<IMac> mle{bimac.mle()};
+  REQUIRE(bimac.posteriorMean() == mean);
+  REQUIRE(bimac.mle() == mle);
+  REQUIRE(mean->getEntryMatrix() == Eigen::MatrixXd::Constant(3, 4, 0.5));
+  REQUIRE(mle->getEntryMatrix() == Eigen::MatrixXd::Constant(3, 4, 0.5));
+
+  // Updating the posterior invalidates both snapshots
+  std::vector<BIMacObservation> obsVec{};
+  obsVec.push_back(BIMacObservation{GridCell{3, 1}, 3, 1, 0, 2, 1, 0});
+  obsVec.push_back(BIMacObservation{GridCell{0, 2}, 0, 4, 1, 1, 0, 1});
+  obsVec.push_back(BIMacObservation{GridCell{3, 1}, 1, 1, 2, 0, 0, 1});
+  bimac.updatePosterior(obsVec);
+
+  std::shared_ptr<IMac> newMean{bimac.posteriorMean()};
+  std::shared_ptr<IMac> newMle{bimac.mle()};
+  REQUIRE(newMean != mean);
+  REQUIRE(newMle != mle);
+  REQUIRE(bimac.posteriorMean() == newMean);
+  REQUIRE(bimac.mle() == newMle);
+
+  // Old snapshots are unchanged
+  REQUIRE(mean->getEntryMatrix() == Eigen::MatrixXd::Constant(3, 4, 0.5));
+
+  // Incremental results match a BIMac built from scratch
+  BIMac fresh{bimac.getAlphaEntry(), bimac.getBetaEntry(),
+              bimac.getAlphaExit(),  bimac.getBetaExit(),
+              bimac.getAlphaInit(),  bimac.getBetaInit()};
+  REQUIRE(newMean->getEntryMatrix() == fresh.posteriorMean()->getEntryMatrix());
+  REQUIRE(newMean->getExitMatrix() == fresh.posteriorMean()->getExitMatrix());
+  REQUIRE(newMean->getInitialBelief() ==
+          fresh.posteriorMean()->getInitialBelief());
+  REQUIRE(newMle->getEntryMatrix() == fresh.mle()->getEntryMatrix());
+  REQUIRE(newMle->getExitMatrix() == fresh.mle()->getExitMatrix());
+  REQUIRE(newMle->getInitialBelief() == fresh.mle()->getInitialBelief());
+
+  // Spot check the values at (3, 1)
+  REQUIRE_THAT(newMean->getEntryMatrix()(1, 3),
+               Catch::Matchers::WithinRel(5.0 / 8.0, 0.0001));
+  REQUIRE_THAT(newMle->getEntryMatrix()(1, 3),
+               Catch::Matchers::WithinRel(4.0 / 6.0, 0.0001));
+  REQUIRE_THAT(newMle->getExitMatrix()(1, 3),
+               Catch::Matchers::WithinRel(0.5, 0.0001));
+
+  // An empty update leaves the snapshots alone
+  bimac.updatePosterior(std::vector<BIMacObservation>{});
+  REQUIRE(bimac.posteriorMean() == newMean);
+  REQUIRE(bimac.mle() == newMle);
+}
+
+TEST_CASE("Tests for batched posterior samples", "[posteriorSamples]") {
+  BIMac bimac{13, 7};
+  std::vector<BIMacObservation> obsVec{};
+  for (int x{0}; x < 13; ++x) {
+    obsVec.push_back(
+        BIMacObservation{GridCell{x, x % 7}, 3 * x, 20, x, 4, 1, x % 3});
+  }
+  bimac.updatePosterior(obsVec);
+
+  REQUIRE(bimac.posteriorSamples(0, 5).empty());
+
+  // Samples don't depend on the number of threads, and sample 0 matches
+  // posteriorSample(seed)
+  std::vector<std::shared_ptr<IMac>> expectedSamples{
+      bimac.posteriorSamples(5, 100)};
+  std::shared_ptr<IMac> single{bimac.posteriorSample(100)};
+  REQUIRE(expectedSamples.at(0)->getEntryMatrix() == single->getEntryMatrix());
+  REQUIRE(expectedSamples.at(0)->getExitMatrix() == single->getExitMatrix());
+  REQUIRE(expectedSamples.at(0)->getInitialBelief() ==
+          single->getInitialBelief());
+  for (int numThreads : {3, 16}) {
+    std::vector<std::shared_ptr<IMac>> samples{
+        bimac.posteriorSamples(5, 100, numThreads)};
+    REQUIRE(samples.size() == 5);
+    for (int k{0}; k < 5; ++k) {
+      const IMac &expected{*expectedSamples.at(k)};
+      REQUIRE(samples.at(k)->getEntryMatrix() == expected.getEntryMatrix());
+      REQUIRE(samples.at(k)->getExitMatrix() == expected.getExitMatrix());
+      REQUIRE(samples.at(k)->getInitialBelief() ==
+              expected.getInitialBelief());
+    }
+  }
+  REQUIRE(expectedSamples.at(0)->getEntryMatrix() !=
+          expectedSamples.at(1)->getEntryMatrix());
+
+  // Batches with consecutive seeds share no samples
+  std::vector<std::shared_ptr<IMac>> nextSamples{
+      bimac.posteriorSamples(5, 101)};
+  for (const std::shared_ptr<IMac> &sample : expectedSamples) {
+    for (const std::shared_ptr<IMac> &next : nextSamples) {
+      REQUIRE(sample->getEntryMatrix() != next->getEntryMatrix());
+    }
+  }
+
+  // The mean over many samples approaches the posterior mean
+  std::vector<std::shared_ptr<IMac>> samples{
+      bimac.posteriorSamples(2000, 9, 4)};
+  Eigen::MatrixXd meanEntry{Eigen::MatrixXd::Zero(7, 13)};
+  for (const std::shared_ptr<IMac> &sample : samples) {
+    meanEntry += sample->getEntryMatrix();
+  }
+  meanEntry /= 2000.0;
+  Eigen::MatrixXd expected{bimac.posteriorMean()->getEntryMatrix()};
+  REQUIRE((meanEntry - expected).cwiseAbs().maxCoeff() < 0.03);
+
+  // Invalid parameters throw before any work starts
+  BIMac invalid{Eigen::MatrixXi::Ones(2, 2), Eigen::MatrixXi::Ones(2, 2),
+                Eigen::MatrixXi::Ones(2, 2), Eigen::MatrixXi::Zero(2, 2),
+                Eigen::MatrixXi::Ones(2, 2), Eigen::MatrixXi::Ones(2, 2)};
+  REQUIRE_THROWS(invalid.posteriorSamples(4, 1, 4));
+}
+
+TEST_CASE("Tests for concurrent BIMac updates and merging",
+          "[BIMac-concurrent]") {
+  // Each worker observes every cell with different counts
+  auto workerObs{[](int worker) {
+    std::vector<BIMacObservation> obsVec{};
+    for (int x{0}; x < 6; ++x) {
+      for (int y{0}; y < 5; ++y) {
+        obsVec.push_back(BIMacObservation{GridCell{x, y}, worker % 3, 1, x, y,
+                                          worker % 2, 1 - worker % 2});
+      }
+    }
+    return obsVec;
+  }};
+
+  BIMac sequential{6, 5};
+  for (int worker{0}; worker < 8; ++worker) {
+    for (int rep{0}; rep < 50; ++rep) {
+      sequential.updatePosterior(workerObs(worker));
+    }
+  }
+
+  BIMac concurrent{6, 5};
+  std::shared_ptr<IMac> oldMean{concurrent.posteriorMean()};
+  std::vector<std::thread> threads{};
+  for (int worker{0}; worker < 8; ++worker) {
+    threads.emplace_back([&concurrent, &workerObs, worker]() {
+      for (int rep{0}; rep < 50; ++rep) {
+        concurrent.updatePosteriorConcurrent(workerObs(worker));
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  REQUIRE(concurrent.getAlphaEntry() == sequential.getAlphaEntry());
+  REQUIRE(concurrent.getBetaEntry() == sequential.getBetaEntry());
+  REQUIRE(concurrent.getAlphaExit() == sequential.getAlphaExit());
+  REQUIRE(concurrent.getBetaExit() == sequential.getBetaExit());
+  REQUIRE(concurrent.getAlphaInit() == sequential.getAlphaInit());
+  REQUIRE(concurrent.getBetaInit() == sequential.getBetaInit());
+
+  // Cached estimates are refreshed
+  REQUIRE(concurrent.posteriorMean() != oldMean);
+  REQUIRE(concurrent.posteriorMean()->getEntryMatrix() ==
+          sequential.posteriorMean()->getEntryMatrix());
+  REQUIRE(concurrent.mle()->getExitMatrix() ==
+          sequential.mle()->getExitMatrix());
+
+  // Merging independent workers gives the same result
+  BIMac merged{6, 5};
+  merged.updatePosterior(workerObs(0));
+  std::shared_ptr<IMac> mergedMean{merged.posteriorMean()};
+  for (int worker{1}; worker < 8; ++worker) {
+    BIMac workerModel{6, 5};
+    workerModel.updatePosterior(workerObs(worker));
+    merged.merge(workerModel);
+  }
+  BIMac expected{6, 5};
+  for (int worker{0}; worker < 8; ++worker) {
+    expected.updatePosterior(workerObs(worker));
+  }
+  REQUIRE(merged.getAlphaEntry() == expected.getAlphaEntry());
+  REQUIRE(merged.getBetaEntry() == expected.getBetaEntry());
+  REQUIRE(merged.getAlphaExit() == expected.getAlphaExit());
+  REQUIRE(merged.getBetaExit() == expected.getBetaExit());
+  REQUIRE(merged.getAlphaInit() == expected.getAlphaInit());
+  REQUIRE(merged.getBetaInit() == expected.getBetaInit());
+  REQUIRE(merged.posteriorMean() != mergedMean);
+  REQUIRE(merged.posteriorMean()->getInitialBelief() ==
+          expected.posteriorMean()->getInitialBelief());
+
+  // Merging an empty model changes nothing
+  merged.merge(BIMac{6, 5});
+  REQUIRE(merged.getAlphaEntry() == expected.getAlphaEntry());
+
+  REQUIRE_THROWS(merged.merge(BIMac{5, 6}));
+}
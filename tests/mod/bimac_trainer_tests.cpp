@@ -0,0 +1,189 @@
+/**
+ * Tests for offline BIMac training in bimac_trainer.h.
+ *
+ * @author Charlie Street
+ */
+#include "coverage_plan/mod/bimac.h"
+#include "coverage_plan/mod/bimac_trainer.h"
+#include "coverage_plan/mod/grid_cell.h"
+#include "coverage_plan/mod/imac.h"
+#include "coverage_plan/mod/imac_executor.h"
+#include "util/bimac_checks.h"
+#include <Eigen/Dense>
+#include <catch2/catch.hpp>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ * Write random episodes to file.
+ *
+ * @param prefix The prefix for each file
+ * @param extension The file extension (.csv or .trace)
+ * @param numEpisodes The number of episodes
+ * @param eps Filled with each episode's maps
+ *
+ * @returns The episode files
+ */
+std::vector<std::filesystem::path>
+writeEpisodes(const std::string &prefix, const std::string &extension,
+              int numEpisodes, std::vector<std::vector<Eigen::MatrixXi>> &eps) {
+  // 4 rows (y) and 5 columns (x)
+  Eigen::MatrixXd imacMat{Eigen::MatrixXd::Constant(4, 5, 0.4)};
+  IMacExecutor exec{std::make_shared<IMac>(imacMat, imacMat, imacMat)};
+  std::vector<std::filesystem::path> files{};
+  eps.clear();
+  for (int e{0}; e < numEpisodes; ++e) {
+    std::vector<Eigen::MatrixXi> episode{exec.restart()};
+    for (int ts{0}; ts < 6 + e; ++ts) {
+      episode.push_back(exec.updateState(std::vector<IMacObservation>{}));
+    }
+    files.push_back(prefix + std::to_string(e) + extension);
+    exec.logMapDynamics(files.back());
+    eps.push_back(episode);
+  }
+  return files;
+}
+
+/**
+ * Build the expected BIMac by counting over the episodes directly.
+ *
+ * @param eps The maps in each episode
+ * @param fov The FOV, if trajectories isn't empty
+ * @param trajectories The robot's trajectory in each episode, or empty if
+ * every cell is observed
+ *
+ * @returns The expected BIMac
+ */
+BIMac expectedBIMac(const std::vector<std::vector<Eigen::MatrixXi>> &eps,
+                    const std::vector<GridCell> &fov,
+                    const std::vector<std::vector<GridCell>> &trajectories) {
+  BIMac bimac{5, 4};
+  for (int e{0}; e < (int)eps.size(); ++e) {
+    std::vector<BIMacObservation> obs{};
+    std::set<GridCell> prevSeen{};
+    int numSteps{(int)eps.at(e).size()};
+    if (!trajectories.empty()) {
+      numSteps = std::min(numSteps, (int)trajectories.at(e).size());
+    }
+    std::vector<std::vector<int>> counts(20, std::vector<int>(6, 0));
+    for (int ts{0}; ts < numSteps; ++ts) {
+      std::set<GridCell> seen{};
+      for (int x{0}; x < 5; ++x) {
+        for (int y{0}; y < 4; ++y) {
+          seen.insert(GridCell{x, y});
+        }
+      }
+      if (!trajectories.empty()) {
+        seen.clear();
+        for (const GridCell &offset : fov) {
+          GridCell cell{trajectories.at(e).at(ts) + offset};
+          if (!cell.outOfBounds(0, 5, 0, 4)) {
+            seen.insert(cell);
+          }
+        }
+      }
+      for (const GridCell &cell : seen) {
+        int curr{eps.at(e).at(ts)(cell.y, cell.x)};
+        std::vector<int> &c{counts.at(cell.x * 4 + cell.y)};
+        if (ts == 0) {
+          ++c.at(4 + curr);
+        } else if (prevSeen.count(cell) == 1) {
+          int prev{eps.at(e).at(ts - 1)(cell.y, cell.x)};
+          ++c.at(prev * 2 + curr);
+        }
+      }
+      prevSeen = seen;
+    }
+    for (int idx{0}; idx < 20; ++idx) {
+      const std::vector<int> &c{counts.at(idx)};
+      // freeToOccupied, freeToFree, occupiedToFree, occupiedToOccupied,
+      // initFree, initOccupied
+      obs.push_back(BIMacObservation{GridCell{idx / 4, idx % 4}, c[1], c[0],
+                                     c[2], c[3], c[4], c[5]});
+    }
+    bimac.updatePosterior(obs);
+  }
+  return bimac;
+}
+
+} // namespace
+
+TEST_CASE("Tests for training BIMacs from full traces", "[BIMacTrainer]") {
+  std::vector<std::vector<Eigen::MatrixXi>> eps{};
+  std::vector<std::filesystem::path> csvFiles{
+      writeEpisodes("/tmp/bimac_trainer_csv_", ".csv", 7, eps)};
+  BIMac expected{expectedBIMac(eps, {}, {})};
+
+  requireSameCounts(*BIMacTrainer::train(csvFiles, 5, 4), expected);
+  requireSameCounts(*BIMacTrainer::train(csvFiles, 5, 4, 3), expected);
+  requireSameCounts(*BIMacTrainer::train(csvFiles, 5, 4, 16), expected);
+
+  // Binary traces give the same result
+  std::vector<std::filesystem::path> traceFiles{
+      writeEpisodes("/tmp/bimac_trainer_trace_", ".trace", 4, eps)};
+  requireSameCounts(*BIMacTrainer::train(traceFiles, 5, 4, 2),
+                    expectedBIMac(eps, {}, {}));
+
+  // No traces leaves the prior
+  requireSameCounts(*BIMacTrainer::train({}, 5, 4, 4), BIMac{5, 4});
+
+  // Errors are passed back from worker threads
+  REQUIRE_THROWS(BIMacTrainer::train(csvFiles, 4, 5, 3));
+  REQUIRE_THROWS(BIMacTrainer::train(traceFiles, 4, 5, 3));
+  std::vector<std::filesystem::path> missing{csvFiles};
+  missing.push_back("/tmp/bimac_trainer_missing.csv");
+  REQUIRE_THROWS(BIMacTrainer::train(missing, 5, 4, 2));
+
+  for (const std::filesystem::path &file : csvFiles) {
+    std::filesystem::remove(file);
+  }
+  for (const std::filesystem::path &file : traceFiles) {
+    std::filesystem::remove(file);
+  }
+}
+
+TEST_CASE("Tests for training BIMacs from a robot's FOV",
+          "[BIMacTrainer-fov]") {
+  std::vector<std::vector<Eigen::MatrixXi>> eps{};
+  std::vector<std::filesystem::path> files{
+      writeEpisodes("/tmp/bimac_trainer_fov_", ".csv", 3, eps)};
+
+  std::vector<GridCell> fov{GridCell{-1, 0}, GridCell{0, -1}, GridCell{1, 0},
+                            GridCell{0, 1}};
+
+  // Write a trajectory in the same format as logVisitedLocations
+  std::filesystem::path visitedFile{"/tmp/bimac_trainer_visited.csv"};
+  {
+    std::ofstream f{visitedFile};
+    for (int x : {0, 1, 2, 2, 3, 4}) {
+      f << x << ',' << (x % 2) << '\n';
+    }
+  }
+  std::vector<GridCell> trajectory{BIMacTrainer::readTrajectory(visitedFile)};
+  REQUIRE(trajectory.size() == 6);
+  REQUIRE(trajectory.at(1) == GridCell{1, 1});
+  REQUIRE(trajectory.at(5) == GridCell{4, 0});
+
+  // Trajectories shorter than the episode stop counting early
+  std::vector<std::vector<GridCell>> trajectories{
+      trajectory, {GridCell{2, 2}, GridCell{2, 2}, GridCell{2, 1}}, {}};
+  BIMac expected{expectedBIMac(eps, fov, trajectories)};
+  requireSameCounts(*BIMacTrainer::train(files, 5, 4, fov, trajectories),
+                    expected);
+  requireSameCounts(*BIMacTrainer::train(files, 5, 4, fov, trajectories, 2),
+                    expected);
+
+  REQUIRE_THROWS(BIMacTrainer::train(files, 5, 4, fov, {trajectory}));
+  REQUIRE_THROWS(BIMacTrainer::readTrajectory("/tmp/bimac_trainer_none.csv"));
+
+  std::filesystem::remove(visitedFile);
+  for (const std::filesystem::path &file : files) {
+    std::filesystem::remove(file);
+  }
+}
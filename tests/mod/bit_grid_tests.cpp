@@ -0,0 +1,298 @@
+/**
+ * Tests for the BitGrid class.
+ *
+ * @author Charlie Street
+ */
+#include "coverage_plan/mod/bit_grid.h"
+#include "coverage_plan/mod/grid_cell.h"
+#include <Eigen/Dense>
+#include <catch2/catch.hpp>
+#include <set>
+#include <thread>
+
+namespace {
+
+/**
+ * Allocates and frees a heap backed grid when destroyed. As a thread_local
+ * constructed before the grid pool, it is destroyed after the pool.
+ *
+ * Members:
+ * * count: The number of cells set in the grid allocated on destruction
+ */
+struct LateAllocator {
+  int *count{};
+
+  ~LateAllocator() {
+    BitGrid grid{20, 30};
+    grid.set(GridCell{2, 3});
+    BitGrid copy{grid};
+    copy.set(GridCell{4, 5});
+    *count = copy.count();
+  }
+};
+
+} // namespace
+
+TEST_CASE("Tests for BitGrid constructors", "[BitGrid-constructors]") {
+  BitGrid empty{};
+  REQUIRE(empty.rows() == 0);
+  REQUIRE(empty.cols() == 0);
+  REQUIRE(empty.size() == 0);
+  REQUIRE(empty.count() == 0);
+
+  BitGrid zeros{3, 4};
+  REQUIRE(zeros.rows() == 3);
+  REQUIRE(zeros.cols() == 4);
+  REQUIRE(zeros.size() == 12);
+  REQUIRE(zeros.numWords() == 1);
+  REQUIRE(zeros.count() == 0);
+
+  // Out of bounds cells should be dropped
+  BitGrid fromSet{2, 3,
+                  std::set<GridCell>{GridCell{0, 0}, GridCell{2, 1},
+                                     GridCell{3, 0}, GridCell{-1, 1}}};
+  REQUIRE(fromSet.count() == 2);
+  REQUIRE(fromSet.test(GridCell{0, 0}));
+  REQUIRE(fromSet.test(GridCell{2, 1}));
+  REQUIRE(fromSet(1, 2) == 1);
+  REQUIRE(fromSet(0, 1) == 0);
+
+  Eigen::MatrixXi mat{2, 3};
+  mat << 0, 1, 0, 5, 0, 1;
+  BitGrid fromMat{mat};
+  REQUIRE(fromMat.rows() == 2);
+  REQUIRE(fromMat.cols() == 3);
+  REQUIRE(fromMat.count() == 3);
+  REQUIRE(fromMat(0, 1) == 1);
+  REQUIRE(fromMat(1, 0) == 1);
+  REQUIRE(fromMat(1, 2) == 1);
+  REQUIRE(fromMat(0, 0) == 0);
+
+  // Expressions can be packed too
+  BitGrid fromExpr{Eigen::MatrixXi::Ones(2, 2)};
+  REQUIRE(fromExpr.all());
+}
+
+TEST_CASE("Tests for BitGrid element access", "[BitGrid-access]") {
+  BitGrid grid{3, 3};
+
+  grid(1, 2) = 1;
+  REQUIRE(grid(1, 2) == 1);
+  REQUIRE(grid.test(GridCell{2, 1}));
+  REQUIRE(grid.count() == 1);
+
+  grid(1, 2) = 0;
+  REQUIRE(grid(1, 2) == 0);
+  REQUIRE(grid.count() == 0);
+
+  grid.set(GridCell{0, 2});
+  REQUIRE(grid(2, 0) == 1);
+  grid(0, 0) = grid(2, 0);
+  REQUIRE(grid(0, 0) == 1);
+  grid.set(GridCell{0, 2}, false);
+  REQUIRE(!grid.test(GridCell{0, 2}));
+  REQUIRE(grid.count() == 1);
+
+  REQUIRE(grid.inBounds(GridCell{2, 2}));
+  REQUIRE(!grid.inBounds(GridCell{3, 0}));
+  REQUIRE(!grid.inBounds(GridCell{0, -1}));
+
+  grid.clear();
+  REQUIRE(grid.count() == 0);
+  REQUIRE(grid.rows() == 3);
+  REQUIRE(grid.cols() == 3);
+}
+
+TEST_CASE("Tests for large BitGrids", "[BitGrid-large]") {
+  // Too large for the inline storage
+  BitGrid grid{20, 30};
+  REQUIRE(grid.numWords() == 10);
+  REQUIRE(grid.count() == 0);
+
+  for (int x{0}; x < 30; ++x) {
+    for (int y{0}; y < 20; ++y) {
+      grid.set(GridCell{x, y});
+    }
+  }
+  REQUIRE(grid.count() == 600);
+  REQUIRE(grid.all());
+
+  BitGrid copy{grid};
+  REQUIRE(copy == grid);
+  copy(19, 29) = 0;
+  REQUIRE(copy != grid);
+  REQUIRE(grid(19, 29) == 1);
+  REQUIRE(!copy.all());
+
+  // Assigning a matrix of the same size reuses the storage
+  const uint64_t *words{grid.data()};
+  Eigen::MatrixXi mat{Eigen::MatrixXi::Zero(20, 30)};
+  mat(5, 7) = 1;
+  grid = mat;
+  REQUIRE(grid.data() == words);
+  REQUIRE(grid.count() == 1);
+  REQUIRE(grid(5, 7) == 1);
+
+  // Assigning a different size resizes
+  grid = Eigen::MatrixXi::Ones(2, 3);
+  REQUIRE(grid.rows() == 2);
+  REQUIRE(grid.cols() == 3);
+  REQUIRE(grid.count() == 6);
+}
+
+TEST_CASE("Tests for copy-on-write BitGrids", "[BitGrid-cow]") {
+  BitGrid grid{20, 30};
+  grid.set(GridCell{3, 4});
+
+  // Copies share heap storage until written to
+  BitGrid copy{grid};
+  BitGrid assigned{};
+  assigned = grid;
+  REQUIRE(copy.sharesStorage(grid));
+  REQUIRE(assigned.sharesStorage(grid));
+  REQUIRE(copy == grid);
+
+  // Reads and no-op writes don't clone
+  const BitGrid &constCopy{copy};
+  const BitGrid &constGrid{grid};
+  REQUIRE(constCopy.data() == constGrid.data());
+  REQUIRE(copy(4, 3) == 1);
+  copy(4, 3) = 1;
+  copy.set(GridCell{3, 4});
+  copy.set(GridCell{5, 5}, false);
+  REQUIRE(copy.sharesStorage(grid));
+
+  // The first real write clones
+  copy.set(GridCell{5, 5});
+  REQUIRE(!copy.sharesStorage(grid));
+  REQUIRE(copy.test(GridCell{5, 5}));
+  REQUIRE(!grid.test(GridCell{5, 5}));
+  REQUIRE(assigned.sharesStorage(grid));
+  copy(0, 0) = 1;
+  REQUIRE(copy.count() == 3);
+  REQUIRE(grid.count() == 1);
+
+  // Writing through data() clones, clear() gives fresh storage
+  uint64_t *words{assigned.data()};
+  REQUIRE(!assigned.sharesStorage(grid));
+  words[0] = 1;
+  REQUIRE(grid(0, 0) == 0);
+  BitGrid cleared{grid};
+  cleared.clear();
+  REQUIRE(cleared.count() == 0);
+  REQUIRE(grid.count() == 1);
+
+  // Moves take the storage
+  BitGrid moved{std::move(copy)};
+  REQUIRE(moved.count() == 3);
+  REQUIRE(copy.size() == 0);
+  copy = std::move(moved);
+  REQUIRE(copy.count() == 3);
+
+  // Small grids are stored inline, so never share
+  BitGrid small{4, 4};
+  BitGrid smallCopy{small};
+  REQUIRE(!smallCopy.sharesStorage(small));
+
+  // Grids still work after a thread's pool is destroyed at thread exit
+  int lateCount{0};
+  std::thread thread{[&lateCount]() {
+    thread_local LateAllocator late{};
+    late.count = &lateCount;
+    BitGrid pooled{20, 30};
+  }};
+  thread.join();
+  REQUIRE(lateCount == 2);
+}
+
+TEST_CASE("Tests for BitGrid comparisons and conversion",
+          "[BitGrid-comparison]") {
+  Eigen::MatrixXi mat{Eigen::MatrixXi::Zero(3, 2)};
+  mat(2, 1) = 1;
+  mat(0, 0) = 1;
+
+  BitGrid grid{mat};
+  REQUIRE(grid.toMatrix() == mat);
+
+  BitGrid same{3, 2, std::set<GridCell>{GridCell{1, 2}, GridCell{0, 0}}};
+  REQUIRE(grid == same);
+  REQUIRE(!(grid != same));
+
+  // Same bits but different dimensions
+  BitGrid transposed{2, 3, std::set<GridCell>{GridCell{2, 1}, GridCell{0, 0}}};
+  REQUIRE(grid != transposed);
+
+  same.set(GridCell{1, 1});
+  REQUIRE(grid != same);
+}
+
+TEST_CASE("Tests for padded BitGrids", "[BitGrid-padded]") {
+  Eigen::MatrixXi mat{Eigen::MatrixXi::Zero(3, 4)};
+  mat(0, 0) = 1;
+  mat(2, 3) = 1;
+  mat(1, 2) = 1;
+  BitGrid grid{mat};
+  REQUIRE(grid.padding() == 0);
+  REQUIRE(grid.stride() == 3);
+  REQUIRE(grid.index(GridCell{2, 1}) == 7);
+
+  BitGrid padded{BitGrid::padded(grid, true)};
+  REQUIRE(padded.padding() == 1);
+  REQUIRE(padded.border());
+  REQUIRE(padded.rows() == 3);
+  REQUIRE(padded.cols() == 4);
+  REQUIRE(padded.size() == 12);
+  REQUIRE(padded.stride() == 5);
+  REQUIRE(padded.numWords() == 1);
+
+  // The border is invisible to the public (x,y) API
+  REQUIRE(padded.count() == 3);
+  REQUIRE(padded.toMatrix() == mat);
+  REQUIRE(padded == grid);
+  REQUIRE(grid == padded);
+  REQUIRE(BitGrid::unpadded(padded) == grid);
+  REQUIRE(BitGrid::unpadded(padded).padding() == 0);
+  REQUIRE(!padded.all());
+
+  // But border cells can be read, and neighbours are constant offsets
+  for (int x{-1}; x <= 4; ++x) {
+    REQUIRE(padded.test(GridCell{x, -1}));
+    REQUIRE(padded.test(GridCell{x, 3}));
+  }
+  for (int y{-1}; y <= 3; ++y) {
+    REQUIRE(padded.test(GridCell{-1, y}));
+    REQUIRE(padded.test(GridCell{4, y}));
+  }
+  int idx{padded.index(GridCell{2, 1})};
+  REQUIRE(padded.cellAt(idx) == GridCell{2, 1});
+  REQUIRE(padded.testIndex(idx));
+  REQUIRE(!padded.testIndex(idx + padded.stride()));
+  REQUIRE(padded.testIndex(idx + 1) == padded.test(GridCell{2, 2}));
+  REQUIRE(padded.cellAt(0) == GridCell{-1, -1});
+
+  // Writes, clearing and reassignment keep the border
+  padded.set(GridCell{0, 0}, false);
+  padded(1, 1) = 1;
+  REQUIRE(padded.count() == 3);
+  REQUIRE(padded.test(GridCell{1, 1}));
+  padded.clear();
+  REQUIRE(padded.count() == 0);
+  REQUIRE(padded.test(GridCell{-1, 0}));
+  padded = Eigen::MatrixXi::Ones(4, 5);
+  REQUIRE(padded.padding() == 1);
+  REQUIRE(padded.all());
+  REQUIRE(padded.count() == 20);
+  REQUIRE(padded.test(GridCell{5, 2}));
+
+  // A clear border reads as 0, and padding a padded grid shares storage
+  BitGrid clearBorder{BitGrid::padded(grid, false)};
+  REQUIRE(!clearBorder.test(GridCell{-1, 0}));
+  REQUIRE(clearBorder.count() == 3);
+  REQUIRE(clearBorder == BitGrid::padded(grid, true));
+  BitGrid large{BitGrid::padded(BitGrid{30, 30}, true)};
+  REQUIRE(BitGrid::padded(large, true).sharesStorage(large));
+  REQUIRE(large.count() == 0);
+  large.set(GridCell{29, 29});
+  REQUIRE(large.count() == 1);
+  REQUIRE(large.test(GridCell{30, 29}));
+}
@@ -0,0 +1,158 @@
+/**
+ * Tests for the episode cache in episode_cache.h.
+ *
+ * @author Charlie Street
+ */
+#include "coverage_plan/mod/episode_cache.h"
+#include "coverage_plan/mod/fixed_imac_executor.h"
+#include "coverage_plan/mod/imac.h"
+#include "coverage_plan/mod/imac_executor.h"
+#include <Eigen/Dense>
+#include <catch2/catch.hpp>
+#include <filesystem>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/**
+ * Write a random episode to file.
+ *
+ * @param file The file to write to
+ * @param numSteps The number of timesteps after the initial state
+ *
+ * @returns The episode
+ */
+std::vector<Eigen::MatrixXi> writeEpisode(const std::filesystem::path &file,
+                                          int numSteps) {
+  Eigen::MatrixXd imacMat{Eigen::MatrixXd::Constant(3, 4, 0.5)};
+  IMacExecutor exec{std::make_shared<IMac>(imacMat, imacMat, imacMat)};
+  std::vector<Eigen::MatrixXi> episode{};
+  episode.push_back(exec.restart());
+  for (int ts{0}; ts < numSteps; ++ts) {
+    episode.push_back(exec.updateState(std::vector<IMacObservation>{}));
+  }
+  exec.logMapDynamics(file);
+  return episode;
+}
+
+} // namespace
+
+TEST_CASE("Tests for loading and sharing episodes", "[EpisodeCache]") {
+  EpisodeCache::clear();
+  std::filesystem::path csvFile{"/tmp/episode_cache_test.csv"};
+  std::vector<Eigen::MatrixXi> episode{writeEpisode(csvFile, 5)};
+
+  REQUIRE(!EpisodeCache::contains(csvFile));
+  std::shared_ptr<const Episode> first{EpisodeCache::get(csvFile)};
+  REQUIRE(EpisodeCache::contains(csvFile));
+  REQUIRE(EpisodeCache::size() == 1);
+  REQUIRE(*first == episode);
+
+  // Decoded once and shared
+  std::shared_ptr<const Episode> second{EpisodeCache::get(csvFile)};
+  REQUIRE(first == second);
+  REQUIRE(EpisodeCache::size() == 1);
+
+  // Prefetching something already cached does nothing
+  EpisodeCache::prefetch(csvFile);
+  REQUIRE(EpisodeCache::size() == 1);
+
+  // Binary traces are preferred when present
+  std::filesystem::path traceFile{"/tmp/episode_cache_test.trace"};
+  std::vector<Eigen::MatrixXi> traceEpisode{writeEpisode(traceFile, 7)};
+  std::shared_ptr<const Episode> fromTrace{EpisodeCache::get(csvFile)};
+  REQUIRE(*fromTrace == traceEpisode);
+  REQUIRE(fromTrace != first);
+  std::filesystem::remove(traceFile);
+
+  // Episodes handed out survive clearing the cache
+  EpisodeCache::clear();
+  REQUIRE(EpisodeCache::size() == 0);
+  REQUIRE(*first == episode);
+
+  // Missing files throw when retrieved, including after a prefetch
+  std::filesystem::path missing{"/tmp/episode_cache_missing.csv"};
+  REQUIRE_THROWS(EpisodeCache::get(missing));
+  EpisodeCache::prefetch(missing);
+  REQUIRE_THROWS(EpisodeCache::get(missing));
+
+  EpisodeCache::clear();
+  std::filesystem::remove(csvFile);
+}
+
+TEST_CASE("Tests for prefetching episodes", "[EpisodeCache-prefetch]") {
+  EpisodeCache::clear();
+  std::vector<std::filesystem::path> files{};
+  std::vector<std::vector<Eigen::MatrixXi>> episodes{};
+  for (int i{0}; i < 4; ++i) {
+    files.push_back("/tmp/episode_cache_prefetch_" + std::to_string(i) +
+                    ".csv");
+    episodes.push_back(writeEpisode(files.back(), 3 + i));
+  }
+
+  for (const std::filesystem::path &file : files) {
+    EpisodeCache::prefetch(file);
+  }
+  REQUIRE(EpisodeCache::size() == 4);
+
+  // Many threads asking for the same episodes get the same copies
+  std::vector<std::shared_ptr<const Episode>> results(16);
+  std::vector<std::thread> threads{};
+  for (int t{0}; t < 16; ++t) {
+    threads.emplace_back([&files, &results, t]() {
+      results.at(t) = EpisodeCache::get(files.at(t % 4));
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  for (int t{0}; t < 16; ++t) {
+    REQUIRE(*results.at(t) == episodes.at(t % 4));
+    REQUIRE(results.at(t) == results.at(t % 4));
+  }
+  REQUIRE(EpisodeCache::size() == 4);
+
+  EpisodeCache::clear();
+  for (const std::filesystem::path &file : files) {
+    std::filesystem::remove(file);
+  }
+}
+
+TEST_CASE("Tests for FixedIMacExecutors sharing episodes",
+          "[EpisodeCache-executor]") {
+  EpisodeCache::clear();
+  std::vector<std::filesystem::path> files{"/tmp/episode_cache_exec_0.csv",
+                                           "/tmp/episode_cache_exec_1.csv"};
+  std::vector<Eigen::MatrixXi> episodeOne{writeEpisode(files.at(0), 4)};
+  std::vector<Eigen::MatrixXi> episodeTwo{writeEpisode(files.at(1), 4)};
+
+  FixedIMacExecutor execOne{files, 4, 3};
+  FixedIMacExecutor execTwo{files, 4, 3};
+
+  // The first episode is prefetched on construction
+  REQUIRE(EpisodeCache::contains(files.at(0)));
+
+  REQUIRE(execOne.restart() == episodeOne.at(0));
+  REQUIRE(EpisodeCache::contains(files.at(1)));
+  REQUIRE(execTwo.restart() == episodeOne.at(0));
+  for (int ts{1}; ts <= 4; ++ts) {
+    REQUIRE(execOne.updateState(std::vector<IMacObservation>{}) ==
+            episodeOne.at(ts));
+    REQUIRE(execTwo.updateState(std::vector<IMacObservation>{}) ==
+            episodeOne.at(ts));
+  }
+  REQUIRE(execOne.restart() == episodeTwo.at(0));
+  REQUIRE(execOne.restart() == episodeOne.at(0)); // Wraps around
+  REQUIRE(EpisodeCache::size() == 2);
+
+  // Wrong dimensions
+  FixedIMacExecutor wrongDims{files, 3, 4};
+  REQUIRE_THROWS(wrongDims.restart());
+
+  EpisodeCache::clear();
+  for (const std::filesystem::path &file : files) {
+    std::filesystem::remove(file);
+  }
+}
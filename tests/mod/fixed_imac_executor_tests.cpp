@@ -83,4 +83,54 @@ TEST_CASE("Test for FixedIMacExecutor", "[FixedIMacExecutor]") {
       }
     }
   }
-}
\ No newline at end of file
+}
+TEST_CASE("Test for FixedIMacExecutor with binary traces",
+          "[FixedIMacExecutor-trace]") {
+  Eigen::MatrixXd imacMat{Eigen::MatrixXd::Constant(3, 2, 0.5)};
+  std::shared_ptr<IMac> imac{std::make_shared<IMac>(imacMat, imacMat, imacMat)};
+
+  std::shared_ptr<IMacExecutor> exec{std::make_shared<IMacExecutor>(imac)};
+
+  // Episode one is only stored as a binary trace
+  std::filesystem::path pathOne{"/tmp/traceEpisodeOne.trace"};
+  std::vector<Eigen::MatrixXi> episodeOne{};
+  episodeOne.push_back(exec->restart());
+  for (int ts{1}; ts <= 5; ++ts) {
+    episodeOne.push_back(exec->updateState(std::vector<IMacObservation>{}));
+  }
+  exec->logMapDynamics(pathOne);
+
+  // Episode two has a CSV and a binary trace, the binary one should be used
+  std::filesystem::path pathTwo{"/tmp/traceEpisodeTwo.csv"};
+  std::vector<Eigen::MatrixXi> episodeTwo{};
+  episodeTwo.push_back(exec->restart());
+  for (int ts{1}; ts <= 5; ++ts) {
+    episodeTwo.push_back(exec->updateState(std::vector<IMacObservation>{}));
+  }
+  exec->logMapDynamics(pathTwo);
+  exec->logMapDynamics("/tmp/traceEpisodeTwo.trace");
+  std::filesystem::remove(pathTwo);
+
+  std::vector<std::filesystem::path> files{pathOne, pathTwo};
+  FixedIMacExecutor fixedExec{files, 2, 3};
+
+  for (int episode{0}; episode < 4; ++episode) {
+    const std::vector<Eigen::MatrixXi> &expected{
+        episode % 2 == 0 ? episodeOne : episodeTwo};
+    REQUIRE(fixedExec.restart() == expected.at(0));
+    for (int ts{1}; ts <= 5; ++ts) {
+      REQUIRE(fixedExec.updateState(std::vector<IMacObservation>{}) ==
+              expected.at(ts));
+    }
+    if (episode == 3) {
+      REQUIRE_THROWS(fixedExec.updateState(std::vector<IMacObservation>{}));
+    }
+  }
+
+  // Dimensions must match the trace
+  FixedIMacExecutor wrongDims{files, 3, 2};
+  REQUIRE_THROWS(wrongDims.restart());
+
+  std::filesystem::remove(pathOne);
+  std::filesystem::remove("/tmp/traceEpisodeTwo.trace");
+}
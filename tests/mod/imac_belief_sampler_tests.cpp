@@ -4,11 +4,14 @@
  * @author Charlie Street
  */
 
+#include "coverage_plan/mod/bit_grid.h"
 #include "coverage_plan/mod/grid_cell.h"
+#include "coverage_plan/mod/imac.h"
 #include "coverage_plan/mod/imac_belief_sampler.h"
 #include "coverage_plan/mod/imac_executor.h"
 #include <Eigen/Dense>
 #include <catch2/catch.hpp>
+#include <memory>
 #include <vector>
 
 TEST_CASE("Test deprecated functions.", "[IMacBeliefSampler::deprecated]") {
@@ -60,4 +63,73 @@ TEST_CASE("Test sampleFromBelief.", "[IMacBeliefSampler::sampleFromBelief]") {
   REQUIRE(matFour(0, 1) == 1);
   REQUIRE(matFour(1, 0) == 1);
   REQUIRE(matFour(1, 1) == 1);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Test forwardStepAndSample.",
+          "[IMacBeliefSampler::forwardStepAndSample]") {
+  IMacBeliefSampler sampler{};
+
+  Eigen::MatrixXd entry{Eigen::MatrixXd::Constant(3, 4, 0.4)};
+  Eigen::MatrixXd exit{Eigen::MatrixXd::Constant(3, 4, 0.3)};
+  IMac imac{entry, exit, Eigen::MatrixXd::Zero(3, 4)};
+
+  Eigen::MatrixXi mat{Eigen::MatrixXi::Zero(3, 4)};
+  mat(0, 0) = 1;
+  mat(2, 3) = 1;
+
+  // Should match sampleFromBelief on the forward step with the same seed
+  for (double seed : {0.1, 0.5, 0.73}) {
+    BitGrid map{mat};
+    sampler.forwardStepAndSample(imac, map, seed);
+    Eigen::MatrixXi expected{
+        sampler.sampleFromBelief(imac.forwardStep(mat.cast<double>()), seed)};
+    REQUIRE(map.toMatrix() == expected);
+  }
+
+  // Same seed gives the same sample
+  BitGrid mapOne{mat};
+  BitGrid mapTwo{mat};
+  sampler.forwardStepAndSample(imac, mapOne, 0.5);
+  sampler.forwardStepAndSample(imac, mapTwo, 0.5);
+  REQUIRE(mapOne == mapTwo);
+}
+
+TEST_CASE("Test sampleFromBelief with static cells.",
+          "[IMacBeliefSampler::sampleFromBelief-static]") {
+  Eigen::MatrixXd entry{Eigen::MatrixXd::Constant(4, 4, 0.4)};
+  Eigen::MatrixXd exit{Eigen::MatrixXd::Constant(4, 4, 0.3)};
+  Eigen::MatrixXd init{Eigen::MatrixXd::Constant(4, 4, 0.5)};
+  // Static free first column, static occupied cell at (2,2)
+  entry.col(0).setZero();
+  exit.col(0).setOnes();
+  init.col(0).setZero();
+  entry(2, 2) = 1.0;
+  exit(2, 2) = 0.0;
+  init(2, 2) = 1.0;
+  std::shared_ptr<IMac> imac{std::make_shared<IMac>(entry, exit, init)};
+  IMacBeliefSampler sampler{imac};
+
+  Eigen::MatrixXi mat{Eigen::MatrixXi::Zero(4, 4)};
+  mat(2, 2) = 1;
+  mat(1, 3) = 1;
+
+  // Fused kernel should match sampleFromBelief on the forward step
+  for (double seed : {0.2, 0.6, 0.95}) {
+    BitGrid map{mat};
+    sampler.forwardStepAndSample(*imac, map, seed);
+    Eigen::MatrixXi expected{
+        sampler.sampleFromBelief(imac->forwardStep(mat.cast<double>()), seed)};
+    REQUIRE(map.toMatrix() == expected);
+    REQUIRE(expected.col(0).sum() == 0);
+    REQUIRE(expected(2, 2) == 1);
+  }
+
+  // Static cells follow the belief if it has been overridden (e.g. by an
+  // observation), as it is still deterministic
+  Eigen::MatrixXd belief{imac->getInitialBelief()};
+  belief(0, 0) = 1.0;
+  Eigen::MatrixXi sample{sampler.sampleFromBelief(belief, 0.3)};
+  REQUIRE(sample(0, 0) == 1);
+  REQUIRE(sample(1, 0) == 0);
+  REQUIRE(sample(2, 2) == 1);
+}
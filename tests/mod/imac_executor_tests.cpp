@@ -4,11 +4,13 @@
  * @author Charlie Street
  */
 
+#include "coverage_plan/mod/bit_grid.h"
 #include "coverage_plan/mod/grid_cell.h"
 #include "coverage_plan/mod/imac.h"
 #include "coverage_plan/mod/imac_executor.h"
 #include <Eigen/Dense>
 #include <catch2/catch.hpp>
+#include <filesystem>
 #include <fstream>
 #include <memory>
 #include <string>
@@ -304,4 +306,53 @@ TEST_CASE("Tests for clearRobotPosition in IMacExecutor",
   for (int i{0}; i < mapElems.size(); ++i) {
     REQUIRE(mapElems.at(i) == expected.at(i));
   }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Tests for IMacExecutor state references and history",
+          "[IMacExecutor-history]") {
+  Eigen::MatrixXd imacMat{Eigen::MatrixXd::Constant(3, 4, 0.5)};
+  std::shared_ptr<IMac> imac{std::make_shared<IMac>(imacMat, imacMat, imacMat)};
+  IMacExecutor exec{imac};
+
+  // State is returned by reference, not copied
+  const Eigen::MatrixXi &initState{exec.restart()};
+  REQUIRE(&initState == &exec.getCurrentState());
+  const Eigen::MatrixXi &nextState{
+      exec.updateState(std::vector<IMacObservation>{})};
+  REQUIRE(&nextState == &exec.getCurrentState());
+  REQUIRE(&exec.clearRobotPosition(GridCell{1, 2}) == &exec.getCurrentState());
+  REQUIRE(exec.getCurrentState()(2, 1) == 0);
+
+  // The history holds every step, including the cleared cell
+  std::vector<Eigen::MatrixXi> states{};
+  exec.restart();
+  states.push_back(exec.getCurrentState());
+  for (int t{0}; t < 20; ++t) {
+    exec.updateState(std::vector<IMacObservation>{});
+    exec.clearRobotPosition(GridCell{t % 4, t % 3});
+    states.push_back(exec.getCurrentState());
+  }
+  REQUIRE(exec.getMapDynamics().numSteps() == 21);
+  BitGrid map{};
+  for (int t{0}; t < 21; ++t) {
+    exec.getMapDynamics().applyStep(t, map);
+    REQUIRE(map.toMatrix() == states.at(t));
+  }
+
+  // With the history switched off, nothing is recorded or logged
+  exec.setKeepHistory(false);
+  exec.restart();
+  for (int t{0}; t < 20; ++t) {
+    exec.updateState(std::vector<IMacObservation>{});
+    exec.clearRobotPosition(GridCell{0, 0});
+  }
+  REQUIRE(exec.getMapDynamics().numSteps() == 0);
+  REQUIRE(exec.getMapDynamics().numBytes() == 0);
+  REQUIRE_THROWS(exec.logMapDynamics("/tmp/noHistory.csv"));
+  REQUIRE(!std::filesystem::exists("/tmp/noHistory.csv"));
+
+  exec.setKeepHistory(true);
+  exec.restart();
+  exec.updateState(std::vector<IMacObservation>{});
+  REQUIRE(exec.getMapDynamics().numSteps() == 2);
+}
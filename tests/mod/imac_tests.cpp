@@ -4,9 +4,13 @@
  * @author Charlie Street
  */
 
+#include "coverage_plan/mod/bit_grid.h"
 #include "coverage_plan/mod/imac.h"
+#include "util/allocation_counter.h"
 #include <Eigen/Dense>
 #include <catch2/catch.hpp>
+#include <random>
+#include <vector>
 
 TEST_CASE("Tests for basic IMac functionality", "[imac]") {
 
@@ -75,6 +79,61 @@ TEST_CASE("Tests for basic IMac functionality", "[imac]") {
   REQUIRE_THAT(initGot(1, 1), Catch::Matchers::WithinRel(0.8, 0.001));
 }
 
+TEST_CASE("Tests for IMac accessors and forwardStep without allocation",
+          "[IMac-noalloc]") {
+  Eigen::MatrixXd entry{2, 3};
+  entry << 0.2, 0.0, 0.3, 1.0, 0.4, 0.5;
+  Eigen::MatrixXd exit{2, 3};
+  exit << 0.4, 1.0, 0.5, 0.0, 0.6, 0.7;
+  Eigen::MatrixXd initBelief{2, 3};
+  initBelief << 0.5, 0.0, 0.6, 1.0, 0.7, 0.8;
+  IMac imac{entry, exit, initBelief};
+
+  Eigen::MatrixXd current{2, 3};
+  current << 0.1, 0.0, 0.3, 1.0, 0.5, 0.7;
+  Eigen::MatrixXd expected{imac.forwardStep(current)};
+  Eigen::MatrixXd next{2, 3};
+  Eigen::Map<const Eigen::MatrixXd> currentView{current.data(), 2, 3};
+
+  AllocationCounter::start();
+  const Eigen::MatrixXd &entryRef{imac.getEntryMatrix()};
+  const Eigen::MatrixXd &exitRef{imac.getExitMatrix()};
+  const Eigen::MatrixXd &initRef{imac.getInitialBelief()};
+  imac.forwardStep(current, next);
+  Eigen::MatrixXd viewNext{next};
+  imac.forwardStep(currentView, next);
+  long numAllocations{AllocationCounter::stop()};
+
+  // Only the explicit copy to viewNext allocates
+  if (AllocationCounter::supported()) {
+    REQUIRE(numAllocations == 1);
+  }
+  REQUIRE(&entryRef == &imac.getEntryMatrix());
+  REQUIRE(&exitRef == &imac.getExitMatrix());
+  REQUIRE(&initRef == &imac.getInitialBelief());
+  REQUIRE(entryRef == entry);
+  REQUIRE(exitRef == exit);
+  REQUIRE(initRef == initBelief);
+  REQUIRE(viewNext.isApprox(expected));
+  REQUIRE(next.isApprox(expected));
+
+  // Stepping in place gives the same result
+  AllocationCounter::start();
+  imac.forwardStep(current, current);
+  numAllocations = AllocationCounter::stop();
+  if (AllocationCounter::supported()) {
+    REQUIRE(numAllocations == 0);
+  }
+  REQUIRE(current.isApprox(expected));
+
+  // Wrong dimensions and non-contiguous blocks are rejected
+  Eigen::MatrixXd wrongSize{3, 2};
+  Eigen::MatrixXd larger{Eigen::MatrixXd::Zero(3, 3)};
+  REQUIRE_THROWS(imac.forwardStep(wrongSize, next));
+  REQUIRE_THROWS(imac.forwardStep(current, wrongSize));
+  REQUIRE_THROWS(imac.forwardStep(larger.topLeftCorner(2, 3), next));
+}
+
 TEST_CASE("Tests for reading and writing IMac objects", "[IMac::readWrite]") {
 
   Eigen::MatrixXd entry{Eigen::MatrixXd::Random(3, 2)};
@@ -109,3 +168,284 @@ TEST_CASE("Tests for reading and writing IMac objects", "[IMac::readWrite]") {
     }
   }
 }
+
+TEST_CASE("Tests for IMac::forwardStepAndSample",
+          "[IMac::forwardStepAndSample]") {
+  // Deterministic dynamics, 10x10 so the BitGrid spans two words
+  // Left half: cells always become occupied, right half: cells flip
+  Eigen::MatrixXd entry{Eigen::MatrixXd::Ones(10, 10)};
+  Eigen::MatrixXd exit{Eigen::MatrixXd::Zero(10, 10)};
+  entry.rightCols(5).setOnes();
+  exit.rightCols(5).setOnes();
+  entry.leftCols(5).setOnes();
+  exit.leftCols(5).setZero();
+  IMac imac{entry, exit, Eigen::MatrixXd::Zero(10, 10)};
+
+  Eigen::MatrixXi mapMat{Eigen::MatrixXi::Zero(10, 10)};
+  mapMat(0, 0) = 1;
+  mapMat(3, 7) = 1;
+  mapMat(9, 9) = 1;
+  BitGrid map{mapMat};
+  std::mt19937_64 gen{5};
+
+  imac.forwardStepAndSample(map, gen);
+  imac.forwardStepAndSample(mapMat, gen);
+  for (int x{0}; x < 10; ++x) {
+    for (int y{0}; y < 10; ++y) {
+      int expected{(x < 5 || GridCell{x, y} == GridCell{7, 3} ||
+                    GridCell{x, y} == GridCell{9, 9})
+                       ? 1
+                       : 0};
+      if (x >= 5) {
+        expected = 1 - expected;
+      }
+      REQUIRE(map(y, x) == expected);
+      REQUIRE(mapMat(y, x) == expected);
+    }
+  }
+  REQUIRE(map.count() == 50 + 48);
+
+  // Stochastic dynamics should match forwardStep followed by sampling
+  Eigen::MatrixXd entryTwo{Eigen::MatrixXd::Constant(9, 9, 0.3)};
+  Eigen::MatrixXd exitTwo{Eigen::MatrixXd::Constant(9, 9, 0.6)};
+  IMac imacTwo{entryTwo, exitTwo, Eigen::MatrixXd::Zero(9, 9)};
+  Eigen::MatrixXi start{Eigen::MatrixXi::Zero(9, 9)};
+  start.topRows(4).setOnes();
+
+  BitGrid fused{start};
+  Eigen::MatrixXi fusedMat{start};
+  std::mt19937_64 genOne{42};
+  std::mt19937_64 genTwo{42};
+  std::mt19937_64 genThree{42};
+  std::uniform_real_distribution<double> sampler{0.0, 1.0};
+  for (int t{0}; t < 5; ++t) {
+    imacTwo.forwardStepAndSample(fused, genOne);
+    imacTwo.forwardStepAndSample(fusedMat, genTwo);
+    Eigen::MatrixXd probs{imacTwo.forwardStep(start.cast<double>())};
+    start = Eigen::MatrixXi::NullaryExpr(9, 9, [&](Eigen::Index i) {
+      return (sampler(genThree) <= probs(i)) ? 1 : 0;
+    });
+    REQUIRE(fused.toMatrix() == start);
+    REQUIRE(fusedMat == start);
+  }
+}
+
+TEST_CASE("Tests for counter-based IMac::forwardStepAndSample",
+          "[IMac::forwardStepAndSample-counter]") {
+  // Deterministic dynamics: left half always occupied, right half flips
+  Eigen::MatrixXd entry{Eigen::MatrixXd::Ones(10, 10)};
+  Eigen::MatrixXd exit{Eigen::MatrixXd::Zero(10, 10)};
+  exit.rightCols(5).setOnes();
+  IMac imac{entry, exit, Eigen::MatrixXd::Zero(10, 10)};
+
+  Eigen::MatrixXi mapMat{Eigen::MatrixXi::Zero(10, 10)};
+  mapMat(3, 7) = 1;
+  BitGrid map{mapMat};
+  imac.forwardStepAndSample(map, 17, 0);
+  for (int x{0}; x < 10; ++x) {
+    for (int y{0}; y < 10; ++y) {
+      int expected{(x < 5 || GridCell{x, y} != GridCell{7, 3}) ? 1 : 0};
+      REQUIRE(map(y, x) == expected);
+    }
+  }
+
+  // Stochastic dynamics: reproducible and keyed by seed and time
+  Eigen::MatrixXd entryTwo{Eigen::MatrixXd::Constant(20, 20, 0.3)};
+  Eigen::MatrixXd exitTwo{Eigen::MatrixXd::Constant(20, 20, 0.6)};
+  IMac imacTwo{entryTwo, exitTwo, Eigen::MatrixXd::Zero(20, 20)};
+  BitGrid start{20, 20};
+
+  BitGrid one{start};
+  BitGrid two{start};
+  imacTwo.forwardStepAndSample(one, 42, 3);
+  imacTwo.forwardStepAndSample(two, 42, 3);
+  REQUIRE(one == two);
+
+  BitGrid otherSeed{start};
+  imacTwo.forwardStepAndSample(otherSeed, 43, 3);
+  REQUIRE(one != otherSeed);
+
+  BitGrid otherTime{start};
+  imacTwo.forwardStepAndSample(otherTime, 42, 4);
+  REQUIRE(one != otherTime);
+
+  // Check the empirical occupancy probabilities
+  int occupiedFromFree{0};
+  int occupiedFromOccupied{0};
+  BitGrid full{Eigen::MatrixXi::Ones(20, 20)};
+  int numRuns{100};
+  for (int seed{0}; seed < numRuns; ++seed) {
+    BitGrid fromFree{start};
+    imacTwo.forwardStepAndSample(fromFree, seed, 0);
+    occupiedFromFree += fromFree.count();
+    BitGrid fromOccupied{full};
+    imacTwo.forwardStepAndSample(fromOccupied, seed, 0);
+    occupiedFromOccupied += fromOccupied.count();
+  }
+  REQUIRE_THAT((double)occupiedFromFree / (400 * numRuns),
+               Catch::Matchers::WithinAbs(0.3, 0.01));
+  REQUIRE_THAT((double)occupiedFromOccupied / (400 * numRuns),
+               Catch::Matchers::WithinAbs(0.4, 0.01));
+}
+
+TEST_CASE("Tests for IMac::forwardSteps", "[IMac::forwardSteps]") {
+  Eigen::MatrixXd entry{2, 3};
+  entry << 0.2, 0.0, 0.9, 0.5, 1.0, 0.05;
+  Eigen::MatrixXd exit{2, 3};
+  exit << 0.3, 0.0, 0.8, 0.5, 1.0, 0.1;
+  Eigen::MatrixXd initBelief{2, 3};
+  initBelief << 0.1, 0.6, 0.3, 1.0, 0.0, 0.7;
+  IMac imac{entry, exit, initBelief};
+
+  // Cached stationary probabilities and mixing factors
+  Eigen::MatrixXd stationary{imac.getStationaryMatrix()};
+  Eigen::MatrixXd mixing{imac.getMixingMatrix()};
+  REQUIRE_THAT(stationary(0, 0), Catch::Matchers::WithinRel(0.4, 0.001));
+  REQUIRE(stationary(0, 1) == 0.0);
+  REQUIRE_THAT(stationary(0, 2), Catch::Matchers::WithinRel(0.9 / 1.7, 0.001));
+  REQUIRE_THAT(stationary(1, 0), Catch::Matchers::WithinRel(0.5, 0.001));
+  REQUIRE_THAT(stationary(1, 1), Catch::Matchers::WithinRel(0.5, 0.001));
+  REQUIRE_THAT(stationary(1, 2), Catch::Matchers::WithinRel(1.0 / 3.0, 0.001));
+  REQUIRE_THAT(mixing(0, 0), Catch::Matchers::WithinRel(0.5, 0.001));
+  REQUIRE_THAT(mixing(0, 1), Catch::Matchers::WithinRel(1.0, 0.001));
+  REQUIRE_THAT(mixing(0, 2), Catch::Matchers::WithinRel(-0.7, 0.001));
+  REQUIRE_THAT(mixing(1, 1), Catch::Matchers::WithinRel(-1.0, 0.001));
+
+  // Closed form should match repeated single steps
+  Eigen::MatrixXd stepped{initBelief};
+  for (int k{0}; k <= 20; ++k) {
+    Eigen::MatrixXd jumped{imac.forwardSteps(initBelief, k)};
+    for (int y{0}; y < 2; ++y) {
+      for (int x{0}; x < 3; ++x) {
+        REQUIRE_THAT(jumped(y, x),
+                     Catch::Matchers::WithinAbs(stepped(y, x), 1e-9));
+        REQUIRE_THAT(imac.forwardSteps(GridCell{x, y}, initBelief(y, x), k),
+                     Catch::Matchers::WithinAbs(stepped(y, x), 1e-9));
+      }
+    }
+    stepped = imac.forwardStep(stepped);
+  }
+
+  // Far in the future we reach the stationary distribution (where it exists)
+  Eigen::MatrixXd farFuture{imac.forwardSteps(initBelief, 1000)};
+  REQUIRE_THAT(farFuture(0, 0), Catch::Matchers::WithinAbs(0.4, 1e-9));
+  REQUIRE_THAT(farFuture(1, 2), Catch::Matchers::WithinAbs(1.0 / 3.0, 1e-9));
+  REQUIRE_THAT(farFuture(0, 1), Catch::Matchers::WithinAbs(0.6, 1e-9));
+
+  REQUIRE_THROWS(imac.forwardSteps(initBelief, -1));
+  REQUIRE_THROWS(imac.forwardSteps(GridCell{0, 0}, 0.5, -1));
+}
+
+TEST_CASE("Tests for IMac static cell classification",
+          "[IMac::getCellDynamics]") {
+  // Column 0 static free, (0,1) static occupied, the rest dynamic
+  Eigen::MatrixXd entry{2, 3};
+  entry << 0.0, 1.0, 0.2, 0.0, 1.0, 0.0;
+  Eigen::MatrixXd exit{2, 3};
+  exit << 1.0, 0.0, 0.3, 1.0, 0.0, 1.0;
+  Eigen::MatrixXd initBelief{2, 3};
+  initBelief << 0.0, 1.0, 0.5, 0.0, 0.0, 0.3;
+  IMac imac{entry, exit, initBelief};
+
+  REQUIRE(imac.getCellDynamics(GridCell{0, 0}) == CellDynamics::staticFree);
+  REQUIRE(imac.getCellDynamics(GridCell{0, 1}) == CellDynamics::staticFree);
+  REQUIRE(imac.getCellDynamics(GridCell{1, 0}) ==
+          CellDynamics::staticOccupied);
+  // Static dynamics but the initial belief doesn't match
+  REQUIRE(imac.getCellDynamics(GridCell{1, 1}) == CellDynamics::dynamic);
+  REQUIRE(imac.getCellDynamics(GridCell{2, 0}) == CellDynamics::dynamic);
+  REQUIRE(imac.getCellDynamics(GridCell{2, 1}) == CellDynamics::dynamic);
+
+  // Index lists are column major
+  REQUIRE(imac.getStaticCells() == std::vector<int>{0, 1, 2});
+  REQUIRE(imac.getDynamicCells() == std::vector<int>{3, 4, 5});
+
+  // forwardStep should match the unmasked computation
+  Eigen::MatrixXd belief{2, 3};
+  belief << 0.6, 0.2, 0.4, 0.9, 0.5, 0.1;
+  Eigen::MatrixXd expected{
+      (1.0 - belief.array()) * entry.array() +
+      belief.array() * (1.0 - exit.array())};
+  Eigen::MatrixXd next{imac.forwardStep(belief)};
+  for (int i{0}; i < 6; ++i) {
+    REQUIRE_THAT(next(i), Catch::Matchers::WithinAbs(expected(i), 1e-12));
+  }
+
+  // Sampling always sets static cells to their static value
+  std::mt19937_64 gen{3};
+  for (int t{0}; t < 20; ++t) {
+    Eigen::MatrixXi mapMat{Eigen::MatrixXi::Ones(2, 3)};
+    mapMat(0, 1) = 0;
+    BitGrid map{mapMat};
+    BitGrid mapTwo{mapMat};
+    imac.forwardStepAndSample(mapMat, gen);
+    imac.forwardStepAndSample(map, gen);
+    imac.forwardStepAndSample(mapTwo, 7, t);
+    REQUIRE(mapMat(0, 0) == 0);
+    REQUIRE(mapMat(1, 0) == 0);
+    REQUIRE(mapMat(0, 1) == 1);
+    REQUIRE(mapMat(1, 2) == 0);
+    for (const BitGrid &grid : {map, mapTwo}) {
+      REQUIRE(grid(0, 0) == 0);
+      REQUIRE(grid(1, 0) == 0);
+      REQUIRE(grid(0, 1) == 1);
+      REQUIRE(grid(1, 2) == 0);
+    }
+  }
+}
+
+TEST_CASE("Tests for IMac with padded maps", "[IMac-padded]") {
+  // Column 0 static free, (0,1) static occupied, the rest dynamic
+  Eigen::MatrixXd entry{Eigen::MatrixXd::Constant(9, 7, 0.4)};
+  Eigen::MatrixXd exit{Eigen::MatrixXd::Constant(9, 7, 0.3)};
+  Eigen::MatrixXd initBelief{Eigen::MatrixXd::Constant(9, 7, 0.5)};
+  entry.col(0).setZero();
+  exit.col(0).setOnes();
+  initBelief.col(0).setZero();
+  entry(0, 1) = 1.0;
+  exit(0, 1) = 0.0;
+  initBelief(0, 1) = 1.0;
+  IMac imac{entry, exit, initBelief};
+
+  // The padded matrices have a static occupied border
+  const Eigen::MatrixXd &paddedEntry{imac.getPaddedEntryMatrix()};
+  const Eigen::MatrixXd &paddedExit{imac.getPaddedExitMatrix()};
+  REQUIRE(paddedEntry.rows() == 11);
+  REQUIRE(paddedEntry.cols() == 9);
+  REQUIRE(paddedEntry.block(1, 1, 9, 7) == entry);
+  REQUIRE(paddedExit.block(1, 1, 9, 7) == exit);
+  REQUIRE(paddedEntry.row(0).minCoeff() == 1.0);
+  REQUIRE(paddedEntry.col(8).minCoeff() == 1.0);
+  REQUIRE(paddedExit.row(10).maxCoeff() == 0.0);
+  REQUIRE(paddedExit.col(0).maxCoeff() == 0.0);
+
+  // Element i of the padded matrices is bit i of a padded map
+  BitGrid padded{BitGrid::padded(BitGrid{9, 7}, true)};
+  REQUIRE(paddedEntry(padded.index(GridCell{3, 5})) == entry(5, 3));
+
+  // Sampling a padded map gives the same cells, and leaves the border alone
+  Eigen::MatrixXi mapMat{Eigen::MatrixXi::Zero(9, 7)};
+  mapMat(4, 4) = 1;
+  mapMat(2, 0) = 1;
+  for (bool border : {true, false}) {
+    BitGrid map{mapMat};
+    BitGrid paddedMap{BitGrid::padded(map, border)};
+    std::mt19937_64 gen{5};
+    std::mt19937_64 genTwo{5};
+    for (int t{0}; t < 10; ++t) {
+      imac.forwardStepAndSample(map, gen);
+      imac.forwardStepAndSample(paddedMap, genTwo);
+      REQUIRE(paddedMap == map);
+      REQUIRE(paddedMap.padding() == 1);
+      REQUIRE(paddedMap.test(GridCell{-1, 4}) == border);
+      REQUIRE(paddedMap.test(GridCell{7, 8}) == border);
+      REQUIRE(paddedMap.test(GridCell{1, 0}));
+
+      imac.forwardStepAndSample(map, 11, t);
+      imac.forwardStepAndSample(paddedMap, 11, t);
+      REQUIRE(paddedMap == map);
+      REQUIRE(paddedMap.test(GridCell{3, -1}) == border);
+      REQUIRE(paddedMap.count() == map.count());
+    }
+  }
+}
@@ -0,0 +1,216 @@
+/**
+ * Tests for the binary map dynamics trace format.
+ *
+ * @author Charlie Street
+ */
+#include "coverage_plan/mod/bit_grid.h"
+#include "coverage_plan/mod/imac.h"
+#include "coverage_plan/mod/imac_executor.h"
+#include "coverage_plan/mod/map_trace.h"
+#include <Eigen/Dense>
+#include <catch2/catch.hpp>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <vector>
+
+TEST_CASE("Tests for writing and reading binary traces", "[MapTrace-rw]") {
+  // Large enough to use the heap storage in BitGrid
+  std::mt19937_64 gen{7};
+  std::uniform_int_distribution<int> cellDist{0, 20 * 15 - 1};
+  std::vector<Eigen::MatrixXi> maps{};
+  Eigen::MatrixXi map{Eigen::MatrixXi::Zero(20, 15)};
+  for (int ts{0}; ts < 50; ++ts) {
+    // Flip a few cells each step
+    for (int i{0}; i < 3; ++i) {
+      int idx{cellDist(gen)};
+      map(idx % 20, idx / 20) = 1 - map(idx % 20, idx / 20);
+    }
+    maps.push_back(map);
+  }
+
+  std::filesystem::path outFile{"/tmp/map_trace_test.trace"};
+  MapTrace::write(maps, outFile, 16);
+
+  // Deltas should be much smaller than the full maps
+  REQUIRE(std::filesystem::file_size(outFile) < 50 * 300 / 8);
+
+  MapTraceReader reader{outFile};
+  REQUIRE(reader.rows() == 20);
+  REQUIRE(reader.cols() == 15);
+  REQUIRE(reader.numSteps() == 50);
+  REQUIRE(reader.isKeyframe(0));
+  REQUIRE(reader.isKeyframe(16));
+  REQUIRE(reader.isKeyframe(32));
+  REQUIRE(!reader.isKeyframe(1));
+
+  // Streaming through the trace
+  BitGrid streamed{};
+  for (int ts{0}; ts < 50; ++ts) {
+    reader.applyStep(ts, streamed);
+    REQUIRE(streamed.toMatrix() == maps.at(ts));
+  }
+
+  // Seeking to arbitrary steps
+  REQUIRE(reader.getStep(0).toMatrix() == maps.at(0));
+  REQUIRE(reader.getStep(37).toMatrix() == maps.at(37));
+  REQUIRE(reader.getStep(15).toMatrix() == maps.at(15));
+  REQUIRE(reader.getStep(49).toMatrix() == maps.at(49));
+  REQUIRE_THROWS(reader.getStep(50));
+  REQUIRE_THROWS(reader.getStep(-1));
+
+  std::filesystem::remove(outFile);
+}
+
+TEST_CASE("Tests for recording traces in memory", "[MapTrace-recorder]") {
+  std::mt19937_64 gen{11};
+  std::uniform_int_distribution<int> cellDist{0, 20 * 15 - 1};
+  std::vector<Eigen::MatrixXi> maps{};
+  Eigen::MatrixXi map{Eigen::MatrixXi::Zero(20, 15)};
+  MapTraceRecorder recorder{16};
+  REQUIRE(recorder.numSteps() == 0);
+  REQUIRE_THROWS(recorder.setCell(GridCell{0, 0}, true));
+
+  for (int ts{0}; ts < 40; ++ts) {
+    for (int i{0}; i < 3; ++i) {
+      int idx{cellDist(gen)};
+      map(idx % 20, idx / 20) = 1 - map(idx % 20, idx / 20);
+    }
+    if (ts % 2 == 0) {
+      recorder.addStep(map);
+    } else {
+      recorder.addStep(BitGrid{map});
+    }
+    // The latest step can still be edited
+    if (ts % 5 == 0) {
+      map(3, 4) = 1;
+      recorder.setCell(GridCell{4, 3}, true);
+    }
+    maps.push_back(map);
+  }
+  REQUIRE(recorder.numSteps() == 40);
+  REQUIRE_THROWS(recorder.addStep(Eigen::MatrixXi::Zero(15, 20)));
+  REQUIRE_THROWS(recorder.setCell(GridCell{15, 0}, true));
+
+  // Deltas should be much smaller than the full maps
+  REQUIRE(recorder.numBytes() < 40 * 300 / 8);
+
+  BitGrid streamed{};
+  for (int ts{0}; ts < 40; ++ts) {
+    recorder.applyStep(ts, streamed);
+    REQUIRE(streamed.toMatrix() == maps.at(ts));
+  }
+  REQUIRE_THROWS(recorder.applyStep(40, streamed));
+
+  // Files written from the recorder match MapTrace::write
+  std::filesystem::path recorded{"/tmp/map_trace_recorded.trace"};
+  std::filesystem::path written{"/tmp/map_trace_written.trace"};
+  recorder.write(recorded);
+  MapTrace::write(maps, written, 16);
+  REQUIRE(std::filesystem::file_size(recorded) ==
+          std::filesystem::file_size(written));
+  MapTraceReader reader{recorded};
+  REQUIRE(reader.numSteps() == 40);
+  REQUIRE(reader.isKeyframe(16));
+  for (int ts{0}; ts < 40; ++ts) {
+    reader.applyStep(ts, streamed);
+    REQUIRE(streamed.toMatrix() == maps.at(ts));
+  }
+
+  // Clearing allows maps of a different size
+  recorder.clear();
+  REQUIRE(recorder.numSteps() == 0);
+  recorder.addStep(Eigen::MatrixXi::Ones(2, 3));
+  recorder.write(recorded);
+  MapTraceReader small{recorded};
+  REQUIRE(small.numSteps() == 1);
+  REQUIRE(small.getStep(0).toMatrix() == Eigen::MatrixXi::Ones(2, 3));
+
+  std::filesystem::remove(recorded);
+  std::filesystem::remove(written);
+}
+
+TEST_CASE("Tests for traces with large changes", "[MapTrace-keyframes]") {
+  // Alternating all zeros and all ones, so deltas are larger than keyframes
+  std::vector<Eigen::MatrixXi> maps{};
+  for (int ts{0}; ts < 6; ++ts) {
+    maps.push_back(Eigen::MatrixXi::Constant(4, 4, ts % 2));
+  }
+  maps.push_back(Eigen::MatrixXi::Constant(4, 4, 1)); // No change
+
+  std::filesystem::path outFile{"/tmp/map_trace_keyframe_test.trace"};
+  MapTrace::write(maps, outFile);
+
+  MapTraceReader reader{outFile};
+  for (int ts{0}; ts < 6; ++ts) {
+    REQUIRE(reader.isKeyframe(ts));
+  }
+  REQUIRE(!reader.isKeyframe(6));
+  for (int ts{0}; ts < 7; ++ts) {
+    REQUIRE(reader.getStep(ts).toMatrix() == maps.at(ts));
+  }
+
+  // Mismatched dimensions
+  maps.push_back(Eigen::MatrixXi::Zero(3, 4));
+  REQUIRE_THROWS(MapTrace::write(maps, outFile));
+
+  std::filesystem::remove(outFile);
+}
+
+TEST_CASE("Tests for invalid trace files", "[MapTrace-invalid]") {
+  std::filesystem::path outFile{"/tmp/map_trace_invalid_test.trace"};
+  REQUIRE_THROWS(MapTraceReader{"/tmp/map_trace_missing.trace"});
+
+  std::vector<Eigen::MatrixXi> maps{Eigen::MatrixXi::Zero(3, 3),
+                                    Eigen::MatrixXi::Identity(3, 3)};
+  MapTrace::write(maps, outFile);
+  {
+    std::fstream f(outFile, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(0);
+    f.put('X');
+  }
+  REQUIRE_THROWS(MapTraceReader{outFile});
+
+  MapTrace::write(maps, outFile);
+  std::filesystem::resize_file(outFile,
+                               std::filesystem::file_size(outFile) - 8);
+  REQUIRE_THROWS(MapTraceReader{outFile});
+
+  std::filesystem::remove(outFile);
+}
+
+TEST_CASE("Tests for converting CSV traces", "[MapTrace-convert]") {
+  Eigen::MatrixXd imacMat{Eigen::MatrixXd::Constant(4, 3, 0.5)};
+  std::shared_ptr<IMac> imac{std::make_shared<IMac>(imacMat, imacMat, imacMat)};
+  IMacExecutor exec{imac};
+
+  std::vector<Eigen::MatrixXi> episode{};
+  episode.push_back(exec.restart());
+  for (int ts{0}; ts < 10; ++ts) {
+    episode.push_back(exec.updateState(std::vector<IMacObservation>{}));
+  }
+
+  std::filesystem::path csvFile{"/tmp/map_trace_convert_test.csv"};
+  std::filesystem::path traceFile{"/tmp/map_trace_convert_test.trace"};
+  std::filesystem::path directFile{"/tmp/map_trace_direct_test.trace"};
+  exec.logMapDynamics(csvFile);
+  exec.logMapDynamics(directFile);
+
+  std::vector<Eigen::MatrixXi> fromCSV{MapTrace::readCSV(csvFile)};
+  REQUIRE(fromCSV == episode);
+
+  MapTrace::convertCSV(csvFile, traceFile);
+  MapTraceReader converted{traceFile};
+  MapTraceReader direct{directFile};
+  REQUIRE(converted.numSteps() == 11);
+  REQUIRE(direct.numSteps() == 11);
+  for (int ts{0}; ts <= 10; ++ts) {
+    REQUIRE(converted.getStep(ts).toMatrix() == episode.at(ts));
+    REQUIRE(direct.getStep(ts).toMatrix() == episode.at(ts));
+  }
+
+  std::filesystem::remove(csvFile);
+  std::filesystem::remove(traceFile);
+  std::filesystem::remove(directFile);
+}
@@ -0,0 +1,183 @@
+/**
+ * Tests for the binary model file format.
+ *
+ * @author Charlie Street
+ */
+#include "coverage_plan/mod/bimac.h"
+#include "coverage_plan/mod/imac.h"
+#include "coverage_plan/mod/model_file.h"
+#include <Eigen/Dense>
+#include <catch2/catch.hpp>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+
+TEST_CASE("Tests for the model file checksum", "[ModelFile::checksum]") {
+  // Known FNV-1a 64 bit values
+  REQUIRE(ModelFile::checksum("", 0) == 0xCBF29CE484222325);
+  REQUIRE(ModelFile::checksum("a", 1) == 0xAF63DC4C8601EC8C);
+  REQUIRE(ModelFile::checksum("foobar", 6) == 0x85944171F73967E8);
+}
+
+TEST_CASE("Tests for reading and writing IMac model files",
+          "[ModelFile-imac]") {
+  Eigen::MatrixXd entry{2, 3};
+  entry << 0.1, 0.2, 0.3, 0.4, 0.5, 0.6;
+  Eigen::MatrixXd exit{2, 3};
+  exit << 0.9, 0.8, 0.7, 0.6, 0.5, 0.4;
+  Eigen::MatrixXd initialBelief{2, 3};
+  initialBelief << 0.0, 1.0, 0.25, 0.5, 0.75, 1.0 / 3.0;
+  IMac imac{entry, exit, initialBelief};
+
+  std::filesystem::path outFile{"/tmp/model_file_test_imac.bin"};
+  ModelFile::writeIMac(imac, outFile);
+  REQUIRE(std::filesystem::file_size(outFile) ==
+          sizeof(ModelFileHeader) + 3 * 6 * sizeof(double));
+
+  MappedModelFile file{outFile};
+  REQUIRE(file.type() == ModelType::imac);
+  REQUIRE(file.rows() == 2);
+  REQUIRE(file.cols() == 3);
+  REQUIRE(file.numArrays() == 3);
+  REQUIRE(file.doubleArray(0) == entry);
+  REQUIRE(file.doubleArray(1) == exit);
+  REQUIRE(file.doubleArray(2) == initialBelief);
+  REQUIRE_THROWS(file.doubleArray(3));
+  REQUIRE_THROWS(file.intArray(0));
+
+  // Round trip is exact
+  std::shared_ptr<IMac> readBack{ModelFile::readIMac(outFile)};
+  REQUIRE(readBack->getEntryMatrix() == entry);
+  REQUIRE(readBack->getExitMatrix() == exit);
+  REQUIRE(readBack->getInitialBelief() == initialBelief);
+
+  std::filesystem::remove(outFile);
+}
+
+TEST_CASE("Tests for reading and writing BIMac model files",
+          "[ModelFile-bimac]") {
+  Eigen::MatrixXi alphaEntry{Eigen::MatrixXi::Constant(3, 2, 1)};
+  Eigen::MatrixXi betaEntry{Eigen::MatrixXi::Constant(3, 2, 2)};
+  Eigen::MatrixXi alphaExit{Eigen::MatrixXi::Constant(3, 2, 3)};
+  Eigen::MatrixXi betaExit{Eigen::MatrixXi::Constant(3, 2, 4)};
+  Eigen::MatrixXi alphaInit{Eigen::MatrixXi::Constant(3, 2, 5)};
+  Eigen::MatrixXi betaInit{Eigen::MatrixXi::Constant(3, 2, 6)};
+  alphaEntry(2, 1) = 100;
+  betaInit(0, 1) = 42;
+  BIMac bimac{alphaEntry, betaEntry, alphaExit, betaExit, alphaInit, betaInit};
+
+  std::filesystem::path outFile{"/tmp/model_file_test_bimac.bin"};
+  ModelFile::writeBIMac(bimac, outFile);
+
+  MappedModelFile file{outFile};
+  REQUIRE(file.type() == ModelType::bimac);
+  REQUIRE(file.rows() == 3);
+  REQUIRE(file.cols() == 2);
+  REQUIRE(file.numArrays() == 6);
+  REQUIRE(file.intArray(0) == alphaEntry);
+  REQUIRE(file.intArray(5) == betaInit);
+  REQUIRE_THROWS(file.doubleArray(0));
+
+  std::shared_ptr<BIMac> readBack{ModelFile::readBIMac(outFile)};
+  REQUIRE(readBack->getAlphaEntry() == alphaEntry);
+  REQUIRE(readBack->getBetaEntry() == betaEntry);
+  REQUIRE(readBack->getAlphaExit() == alphaExit);
+  REQUIRE(readBack->getBetaExit() == betaExit);
+  REQUIRE(readBack->getAlphaInit() == alphaInit);
+  REQUIRE(readBack->getBetaInit() == betaInit);
+
+  std::filesystem::remove(outFile);
+}
+
+TEST_CASE("Tests for invalid model files", "[ModelFile-invalid]") {
+  Eigen::MatrixXd probs{Eigen::MatrixXd::Constant(2, 2, 0.5)};
+  IMac imac{probs, probs, probs};
+  std::filesystem::path outFile{"/tmp/model_file_test_invalid.bin"};
+
+  REQUIRE_THROWS(MappedModelFile{"/tmp/model_file_test_missing.bin"});
+
+  // Flip a byte in the payload
+  ModelFile::writeIMac(imac, outFile);
+  {
+    std::fstream f(outFile, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(sizeof(ModelFileHeader) + 5);
+    f.put((char)0x7F);
+  }
+  REQUIRE_THROWS(MappedModelFile{outFile});
+
+  // Bad magic
+  ModelFile::writeIMac(imac, outFile);
+  {
+    std::fstream f(outFile, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(0);
+    f.put('X');
+  }
+  REQUIRE_THROWS(MappedModelFile{outFile});
+
+  // Truncated file
+  ModelFile::writeIMac(imac, outFile);
+  std::filesystem::resize_file(outFile, sizeof(ModelFileHeader) + 8);
+  REQUIRE_THROWS(MappedModelFile{outFile});
+
+  // Too small for a header
+  std::filesystem::resize_file(outFile, 10);
+  REQUIRE_THROWS(MappedModelFile{outFile});
+
+  std::filesystem::remove(outFile);
+}
+
+TEST_CASE("Tests for converting CSV model directories",
+          "[ModelFile-convert]") {
+  std::filesystem::path modelDir{"/tmp/model_file_test_dir"};
+  std::filesystem::create_directories(modelDir);
+
+  Eigen::MatrixXd entry{Eigen::MatrixXd::Zero(3, 3)};
+  entry(1, 2) = 0.123456789012345;
+  Eigen::MatrixXd exit{Eigen::MatrixXd::Ones(3, 3)};
+  exit(0, 1) = 0.987654321098765;
+  Eigen::MatrixXd initialBelief{Eigen::MatrixXd::Zero(3, 3)};
+  initialBelief(2, 0) = 0.1;
+  IMac imac{entry, exit, initialBelief};
+  imac.writeIMac(modelDir);
+
+  BIMac bimac{3, 3};
+  bimac.updatePosterior(
+      std::vector<BIMacObservation>{BIMacObservation{GridCell{1, 2}, 1, 2, 3,
+                                                      4, 5, 6}});
+  bimac.writeBIMac(modelDir);
+
+  // Without a binary file, loading falls back to the CSV files
+  std::filesystem::remove(modelDir / ModelFile::imacFileName);
+  std::filesystem::remove(modelDir / ModelFile::bimacFileName);
+  std::shared_ptr<IMac> fromCSV{ModelFile::loadIMac(modelDir)};
+  std::shared_ptr<BIMac> bimacFromCSV{ModelFile::loadBIMac(modelDir)};
+
+  ModelFile::convertIMacDirectory(modelDir,
+                                  modelDir / ModelFile::imacFileName);
+  ModelFile::convertBIMacDirectory(modelDir,
+                                   modelDir / ModelFile::bimacFileName);
+  REQUIRE(std::filesystem::exists(modelDir / ModelFile::imacFileName));
+  REQUIRE(std::filesystem::exists(modelDir / ModelFile::bimacFileName));
+
+  // Conversion is lossless w.r.t. the CSV files
+  std::shared_ptr<IMac> fromBin{ModelFile::loadIMac(modelDir)};
+  REQUIRE(fromBin->getEntryMatrix() == fromCSV->getEntryMatrix());
+  REQUIRE(fromBin->getExitMatrix() == fromCSV->getExitMatrix());
+  REQUIRE(fromBin->getInitialBelief() == fromCSV->getInitialBelief());
+  REQUIRE(fromBin->getEntryMatrix() == entry);
+  REQUIRE(fromBin->getExitMatrix() == exit);
+  REQUIRE(fromBin->getInitialBelief() == initialBelief);
+
+  std::shared_ptr<BIMac> bimacFromBin{ModelFile::loadBIMac(modelDir)};
+  REQUIRE(bimacFromBin->getAlphaEntry() == bimacFromCSV->getAlphaEntry());
+  REQUIRE(bimacFromBin->getBetaEntry() == bimacFromCSV->getBetaEntry());
+  REQUIRE(bimacFromBin->getAlphaExit() == bimacFromCSV->getAlphaExit());
+  REQUIRE(bimacFromBin->getBetaExit() == bimacFromCSV->getBetaExit());
+  REQUIRE(bimacFromBin->getAlphaInit() == bimacFromCSV->getAlphaInit());
+  REQUIRE(bimacFromBin->getBetaInit() == bimacFromCSV->getBetaInit());
+  REQUIRE(bimacFromBin->getAlphaEntry() == bimac.getAlphaEntry());
+  REQUIRE(bimacFromBin->getBetaInit() == bimac.getBetaInit());
+
+  std::filesystem::remove_all(modelDir);
+}
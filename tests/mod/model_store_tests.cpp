@@ -0,0 +1,131 @@
+/**
+ * Tests for the shared memory model store.
+ *
+ * @author Charlie Street
+ */
+#include "coverage_plan/mod/bimac.h"
+#include "coverage_plan/mod/imac.h"
+#include "coverage_plan/mod/model_file.h"
+#include "coverage_plan/mod/model_store.h"
+#include <Eigen/Dense>
+#include <catch2/catch.hpp>
+#include <memory>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+/**
+ * Get a key which won't clash with other test runs.
+ *
+ * @param name The base name of the key
+ *
+ * @returns The key
+ */
+std::string testKey(const std::string &name) {
+  return "test." + name + "." + std::to_string(getpid());
+}
+
+} // namespace
+
+TEST_CASE("Tests for publishing and mapping IMac models",
+          "[ModelStore-imac]") {
+  Eigen::MatrixXd entry{2, 3};
+  entry << 0.1, 0.2, 0.3, 0.4, 0.5, 0.6;
+  Eigen::MatrixXd exit{2, 3};
+  exit << 0.9, 0.8, 0.7, 0.6, 0.5, 0.4;
+  Eigen::MatrixXd initialBelief{2, 3};
+  initialBelief << 0.0, 1.0, 0.25, 0.5, 0.75, 1.0 / 3.0;
+  IMac imac{entry, exit, initialBelief};
+
+  std::string key{testKey("imac")};
+  ModelStore::remove(key);
+  REQUIRE(!ModelStore::contains(key));
+  REQUIRE_THROWS(ModelStore::map(key));
+
+  ModelStore::publishIMac(key, imac);
+  REQUIRE(ModelStore::contains(key));
+  REQUIRE_THROWS(ModelStore::publishIMac(key, imac));
+
+  std::shared_ptr<const MappedModelFile> model{ModelStore::map(key)};
+  REQUIRE(model->type() == ModelType::imac);
+  REQUIRE(model->rows() == 2);
+  REQUIRE(model->cols() == 3);
+  REQUIRE(model->doubleArray(0) == entry);
+  REQUIRE(model->doubleArray(1) == exit);
+  REQUIRE(model->doubleArray(2) == initialBelief);
+
+  // Views from two mappings in one process see the same values
+  std::shared_ptr<const MappedModelFile> other{ModelStore::map(key)};
+  REQUIRE(other->doubleArray(0) == model->doubleArray(0));
+
+  std::shared_ptr<IMac> loaded{ModelStore::loadIMac(key)};
+  REQUIRE(loaded->getEntryMatrix() == entry);
+  REQUIRE(loaded->getExitMatrix() == exit);
+  REQUIRE(loaded->getInitialBelief() == initialBelief);
+
+  // Other processes can map the model
+  pid_t pid{fork()};
+  if (pid == 0) {
+    bool ok{false};
+    try {
+      std::shared_ptr<const MappedModelFile> child{ModelStore::map(key)};
+      ok = child->doubleArray(0) == entry &&
+           child->doubleArray(2) == initialBelief;
+    } catch (...) {
+    }
+    _exit(ok ? 0 : 1);
+  }
+  int status{0};
+  REQUIRE(waitpid(pid, &status, 0) == pid);
+  REQUIRE(WIFEXITED(status));
+  REQUIRE(WEXITSTATUS(status) == 0);
+
+  // Existing mappings survive removal
+  ModelStore::remove(key);
+  REQUIRE(!ModelStore::contains(key));
+  REQUIRE(model->doubleArray(1) == exit);
+  REQUIRE_THROWS(ModelStore::loadIMac(key));
+}
+
+TEST_CASE("Tests for publishing and mapping BIMac models",
+          "[ModelStore-bimac]") {
+  Eigen::MatrixXi alphaEntry{Eigen::MatrixXi::Constant(3, 2, 2)};
+  Eigen::MatrixXi betaEntry{Eigen::MatrixXi::Constant(3, 2, 3)};
+  Eigen::MatrixXi alphaExit{Eigen::MatrixXi::Constant(3, 2, 4)};
+  Eigen::MatrixXi betaExit{Eigen::MatrixXi::Constant(3, 2, 5)};
+  Eigen::MatrixXi alphaInit{Eigen::MatrixXi::Constant(3, 2, 6)};
+  Eigen::MatrixXi betaInit{Eigen::MatrixXi::Constant(3, 2, 7)};
+  alphaEntry(2, 1) = 10;
+  BIMac bimac{alphaEntry, betaEntry, alphaExit, betaExit, alphaInit, betaInit};
+
+  std::string key{testKey("bimac")};
+  ModelStore::remove(key);
+  ModelStore::publishBIMac(key, bimac);
+
+  std::shared_ptr<const MappedModelFile> model{ModelStore::map(key)};
+  REQUIRE(model->type() == ModelType::bimac);
+  REQUIRE(model->intArray(0) == alphaEntry);
+  REQUIRE(model->intArray(5) == betaInit);
+  REQUIRE_THROWS(model->doubleArray(0));
+  REQUIRE_THROWS(ModelStore::loadIMac(key));
+
+  std::shared_ptr<BIMac> loaded{ModelStore::loadBIMac(key)};
+  REQUIRE(loaded->getAlphaEntry() == alphaEntry);
+  REQUIRE(loaded->getBetaEntry() == betaEntry);
+  REQUIRE(loaded->getAlphaExit() == alphaExit);
+  REQUIRE(loaded->getBetaExit() == betaExit);
+  REQUIRE(loaded->getAlphaInit() == alphaInit);
+  REQUIRE(loaded->getBetaInit() == betaInit);
+
+  ModelStore::remove(key);
+}
+
+TEST_CASE("Tests for invalid model store keys", "[ModelStore-keys]") {
+  REQUIRE(ModelStore::objectName("abc") == "/coverage_plan.abc");
+  REQUIRE_THROWS(ModelStore::objectName(""));
+  REQUIRE_THROWS(ModelStore::objectName("a/b"));
+  REQUIRE_THROWS(ModelStore::publishBIMac("a/b", BIMac{2, 2}));
+  ModelStore::remove(testKey("missing")); // No-op
+}
@@ -0,0 +1,153 @@
+/**
+ * Tests for the TransitionCounter class.
+ *
+ * @author Charlie Street
+ */
+
+#include "coverage_plan/mod/bimac.h"
+#include "coverage_plan/mod/grid_cell.h"
+#include "coverage_plan/mod/imac_executor.h"
+#include "coverage_plan/mod/transition_counter.h"
+#include <catch2/catch.hpp>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace {
+
+/**
+ * Reference implementation which replays a full observation history using
+ * maps keyed on the grid cell.
+ *
+ * @param obs The observations at each timestep
+ * @param xDim The x dimension of the map
+ * @param yDim The y dimension of the map
+ *
+ * @returns The BIMacObservations for the history
+ */
+std::vector<BIMacObservation>
+replayObservations(const std::vector<std::vector<IMacObservation>> &obs,
+                   int xDim, int yDim) {
+  std::map<GridCell, BIMacObservation> biMacObsMap{};
+  std::map<GridCell, int> prevObsMap{};
+  for (int i{0}; i < (int)obs.size(); ++i) {
+    std::map<GridCell, int> currentObsMap{};
+    for (const IMacObservation &o : obs.at(i)) {
+      if (o.cell.outOfBounds(0, xDim, 0, yDim)) {
+        continue;
+      }
+      currentObsMap[o.cell] = o.occupied;
+      if (i == 0) {
+        biMacObsMap.emplace(o.cell, BIMacObservation{o.cell});
+        biMacObsMap[o.cell].initOccupied += o.occupied;
+        biMacObsMap[o.cell].initFree += 1 - o.occupied;
+      }
+    }
+    for (const auto &elem : prevObsMap) {
+      if (i > 0 && currentObsMap.count(elem.first) > 0) {
+        biMacObsMap.emplace(elem.first, BIMacObservation{elem.first});
+        BIMacObservation &b{biMacObsMap[elem.first]};
+        int next{currentObsMap[elem.first]};
+        b.freeToFree += elem.second == 0 && next == 0;
+        b.freeToOccupied += elem.second == 0 && next == 1;
+        b.occupiedToFree += elem.second == 1 && next == 0;
+        b.occupiedToOccupied += elem.second == 1 && next == 1;
+      }
+    }
+    prevObsMap = currentObsMap;
+  }
+
+  std::vector<BIMacObservation> result{};
+  for (const auto &elem : biMacObsMap) {
+    result.push_back(elem.second);
+  }
+  return result;
+}
+
+/**
+ * Check two BIMacObservation batches are identical.
+ *
+ * @param a The first batch
+ * @param b The second batch
+ */
+void requireSameBatch(const std::vector<BIMacObservation> &a,
+                      const std::vector<BIMacObservation> &b) {
+  REQUIRE(a.size() == b.size());
+  for (int i{0}; i < (int)a.size(); ++i) {
+    REQUIRE(a.at(i).cell == b.at(i).cell);
+    REQUIRE(a.at(i).freeToOccupied == b.at(i).freeToOccupied);
+    REQUIRE(a.at(i).freeToFree == b.at(i).freeToFree);
+    REQUIRE(a.at(i).occupiedToFree == b.at(i).occupiedToFree);
+    REQUIRE(a.at(i).occupiedToOccupied == b.at(i).occupiedToOccupied);
+    REQUIRE(a.at(i).initFree == b.at(i).initFree);
+    REQUIRE(a.at(i).initOccupied == b.at(i).initOccupied);
+  }
+}
+
+} // namespace
+
+TEST_CASE("Tests for counting transitions", "[TransitionCounter]") {
+  TransitionCounter counter{3, 2};
+  REQUIRE(counter.getBIMacObservations().empty());
+
+  counter.addObservations({IMacObservation{GridCell{0, 0}, 1},
+                           IMacObservation{GridCell{2, 1}, 0},
+                           IMacObservation{GridCell{3, 0}, 1}});
+  counter.addObservations({IMacObservation{GridCell{0, 0}, 0},
+                           IMacObservation{GridCell{1, 1}, 1}});
+  // Gap in observations of (2,1), so no transition
+  counter.addObservations({IMacObservation{GridCell{0, 0}, 0},
+                           IMacObservation{GridCell{1, 1}, 1},
+                           IMacObservation{GridCell{2, 1}, 1}});
+
+  std::vector<BIMacObservation> batch{counter.getBIMacObservations()};
+  REQUIRE(batch.size() == 3);
+  REQUIRE(batch.at(0).cell == GridCell{0, 0});
+  REQUIRE(batch.at(0).initOccupied == 1);
+  REQUIRE(batch.at(0).occupiedToFree == 1);
+  REQUIRE(batch.at(0).freeToFree == 1);
+  REQUIRE(batch.at(1).cell == GridCell{1, 1});
+  REQUIRE(batch.at(1).occupiedToOccupied == 1);
+  REQUIRE(batch.at(1).initOccupied == 0);
+  REQUIRE(batch.at(2).cell == GridCell{2, 1});
+  REQUIRE(batch.at(2).initFree == 1);
+  REQUIRE(batch.at(2).freeToOccupied == 0);
+
+  // Resetting starts a new episode
+  counter.reset();
+  REQUIRE(counter.getBIMacObservations().empty());
+  counter.addObservations({IMacObservation{GridCell{2, 1}, 1}});
+  batch = counter.getBIMacObservations();
+  REQUIRE(batch.size() == 1);
+  REQUIRE(batch.at(0).cell == GridCell{2, 1});
+  REQUIRE(batch.at(0).initOccupied == 1);
+  REQUIRE(batch.at(0).freeToOccupied == 0);
+}
+
+TEST_CASE("Tests for TransitionCounter against a full replay",
+          "[TransitionCounter-replay]") {
+  std::mt19937 gen{11};
+  std::uniform_int_distribution<int> xDist{-1, 6};
+  std::uniform_int_distribution<int> yDist{-1, 4};
+  std::uniform_int_distribution<int> occDist{0, 1};
+  std::uniform_int_distribution<int> sizeDist{0, 12};
+
+  TransitionCounter counter{6, 4};
+  for (int episode{0}; episode < 5; ++episode) {
+    counter.reset();
+    std::vector<std::vector<IMacObservation>> history{};
+    for (int t{0}; t < 40; ++t) {
+      // Random cells, including duplicates and out of bounds cells
+      std::vector<IMacObservation> obs{};
+      int numObs{sizeDist(gen)};
+      for (int i{0}; i < numObs; ++i) {
+        obs.push_back(
+            IMacObservation{GridCell{xDist(gen), yDist(gen)}, occDist(gen)});
+      }
+      history.push_back(obs);
+      counter.addObservations(obs);
+    }
+    requireSameBatch(counter.getBIMacObservations(),
+                     replayObservations(history, 6, 4));
+  }
+}
@@ -5,17 +5,20 @@
  * @author Charlie Street
  */
 
+#include "coverage_plan/mod/bit_grid.h"
 #include "coverage_plan/mod/grid_cell.h"
 #include "coverage_plan/mod/imac.h"
 #include "coverage_plan/planning/action.h"
 #include "coverage_plan/planning/coverage_belief.h"
 #include "coverage_plan/planning/coverage_pomdp.h"
 #include "coverage_plan/planning/coverage_state.h"
+#include "util/allocation_counter.h"
 #include <Eigen/Dense>
 #include <catch2/catch.hpp>
 #include <despot/interface/belief.h>
 #include <despot/interface/pomdp.h>
 #include <memory>
+#include <set>
 #include <vector>
 
 TEST_CASE("Tests for CoverageBelief::Sample.", "[CoverageBelief::Sample]") {
@@ -37,7 +40,8 @@ TEST_CASE("Tests for CoverageBelief::Sample.", "[CoverageBelief::Sample]") {
   const CoveragePOMDP *pomdp{new CoveragePOMDP{fov, imac, 5}};
 
   std::unique_ptr<CoverageBelief> belief{std::make_unique<CoverageBelief>(
-      pomdp, GridCell{0, 0}, 1, std::set<GridCell>{GridCell{0, 0}},
+      pomdp, GridCell{0, 0}, 1,
+      BitGrid{1, 2, std::set<GridCell>{GridCell{0, 0}}},
       imac->getInitialBelief(), imac, fov)};
 
   // Sample 5 states
@@ -49,8 +53,8 @@ TEST_CASE("Tests for CoverageBelief::Sample.", "[CoverageBelief::Sample]") {
     CoverageState *coverState{static_cast<CoverageState *>(state)};
     REQUIRE(coverState->robotPosition == GridCell{0, 0});
     REQUIRE(coverState->time == 1);
-    REQUIRE(coverState->covered.size() == 1);
-    REQUIRE(coverState->covered.count(GridCell{0, 0}) == 1);
+    REQUIRE(coverState->covered.count() == 1);
+    REQUIRE(coverState->covered.test(GridCell{0, 0}));
     REQUIRE(coverState->map.size() == 2);
     REQUIRE(coverState->map(0, 0) == 0);
     REQUIRE((coverState->map(0, 1) == 0 || coverState->map(0, 1) == 1));
@@ -85,7 +89,8 @@ TEST_CASE("Tests for CoverageBelief::MakeCopy", "[CoverageBelief::MakeCopy]") {
 
   // Test copying using sampling and deterministic belief
   std::unique_ptr<CoverageBelief> belief{std::make_unique<CoverageBelief>(
-      pomdp, GridCell{0, 0}, 1, std::set<GridCell>{GridCell{0, 0}},
+      pomdp, GridCell{0, 0}, 1,
+      BitGrid{1, 2, std::set<GridCell>{GridCell{0, 0}}},
       imac->getInitialBelief(), imac, fov)};
 
   std::vector<despot::State *> particles{belief->Sample(1)};
@@ -100,7 +105,7 @@ TEST_CASE("Tests for CoverageBelief::MakeCopy", "[CoverageBelief::MakeCopy]") {
   REQUIRE(coverState->weight == coverStateCp->weight);
   REQUIRE(coverState->robotPosition == coverStateCp->robotPosition);
   REQUIRE(coverState->time == coverStateCp->time);
-  REQUIRE(coverState->covered.size() == coverStateCp->covered.size());
+  REQUIRE(coverState->covered.count() == coverStateCp->covered.count());
   REQUIRE(coverState->covered == coverStateCp->covered);
   REQUIRE(coverState->map.size() == coverStateCp->map.size());
   REQUIRE(coverState->map(0, 0) == coverStateCp->map(0, 0));
@@ -136,7 +141,8 @@ TEST_CASE("Tests for CoverageBelief::text", "[CoverageBelief::text]") {
 
   // Test copying using sampling and deterministic belief
   std::unique_ptr<CoverageBelief> belief{std::make_unique<CoverageBelief>(
-      pomdp, GridCell{0, 1}, 1, std::set<GridCell>{GridCell{0, 0}},
+      pomdp, GridCell{0, 1}, 1,
+      BitGrid{1, 2, std::set<GridCell>{GridCell{0, 0}}},
       imac->getInitialBelief(), imac, fov)};
 
   REQUIRE(belief->text() == "Robot Position: (0, 1); Time: 1; Covered: 50%; "
@@ -165,7 +171,8 @@ TEST_CASE("Tests for CoverageBelief::Update", "[CoverageBelief::Update]") {
 
   // Test copying using sampling and deterministic belief
   std::unique_ptr<CoverageBelief> belief{std::make_unique<CoverageBelief>(
-      pomdp, GridCell{0, 0}, 1, std::set<GridCell>{GridCell{0, 0}},
+      pomdp, GridCell{0, 0}, 1,
+      BitGrid{1, 2, std::set<GridCell>{GridCell{0, 0}}},
       imac->getInitialBelief(), imac, fov)};
 
   // Check update with success
@@ -176,9 +183,9 @@ TEST_CASE("Tests for CoverageBelief::Update", "[CoverageBelief::Update]") {
     CoverageState *coverState{static_cast<CoverageState *>(state)};
     REQUIRE(coverState->robotPosition == GridCell{1, 0});
     REQUIRE(coverState->time == 2);
-    REQUIRE(coverState->covered.size() == 2);
-    REQUIRE(coverState->covered.count(GridCell{0, 0}) == 1);
-    REQUIRE(coverState->covered.count(GridCell{1, 0}) == 1);
+    REQUIRE(coverState->covered.count() == 2);
+    REQUIRE(coverState->covered.test(GridCell{0, 0}));
+    REQUIRE(coverState->covered.test(GridCell{1, 0}));
     REQUIRE(coverState->map.size() == 2);
     REQUIRE(coverState->map(0, 0) == 1);
     REQUIRE(coverState->map(0, 1) == 0);
@@ -191,9 +198,9 @@ TEST_CASE("Tests for CoverageBelief::Update", "[CoverageBelief::Update]") {
     CoverageState *coverState{static_cast<CoverageState *>(state)};
     REQUIRE(coverState->robotPosition == GridCell{1, 0});
     REQUIRE(coverState->time == 3);
-    REQUIRE(coverState->covered.size() == 2);
-    REQUIRE(coverState->covered.count(GridCell{0, 0}) == 1);
-    REQUIRE(coverState->covered.count(GridCell{1, 0}) == 1);
+    REQUIRE(coverState->covered.count() == 2);
+    REQUIRE(coverState->covered.test(GridCell{0, 0}));
+    REQUIRE(coverState->covered.test(GridCell{1, 0}));
     REQUIRE(coverState->map.size() == 2);
     REQUIRE(coverState->map(0, 0) == 0);
     REQUIRE(coverState->map(0, 1) == 0);
@@ -213,7 +220,8 @@ TEST_CASE("Tests for CoverageBelief::Update", "[CoverageBelief::Update]") {
       new CoveragePOMDP{std::vector<GridCell>{}, imacTwo, 5}};
 
   std::unique_ptr<CoverageBelief> beliefTwo{std::make_unique<CoverageBelief>(
-      pomdpTwo, GridCell{1, 0}, 1, std::set<GridCell>{GridCell{1, 0}},
+      pomdpTwo, GridCell{1, 0}, 1,
+      BitGrid{1, 2, std::set<GridCell>{GridCell{1, 0}}},
       imacTwo->getInitialBelief(), imacTwo, std::vector<GridCell>{})};
 
   beliefTwo->Update(ActionHelpers::toInt(Action::wait), 1);
@@ -222,8 +230,8 @@ TEST_CASE("Tests for CoverageBelief::Update", "[CoverageBelief::Update]") {
     CoverageState *coverState{static_cast<CoverageState *>(state)};
     REQUIRE(coverState->robotPosition == GridCell{1, 0});
     REQUIRE(coverState->time == 2);
-    REQUIRE(coverState->covered.size() == 1);
-    REQUIRE(coverState->covered.count(GridCell{1, 0}) == 1);
+    REQUIRE(coverState->covered.count() == 1);
+    REQUIRE(coverState->covered.test(GridCell{1, 0}));
     REQUIRE(coverState->map.size() == 2);
     REQUIRE(coverState->map(0, 0) == 1);
     REQUIRE(coverState->map(0, 1) == 0);
@@ -264,10 +272,17 @@ TEST_CASE("Tests for CoverageBelief::getMapBelief",
 
   // Test copying using sampling and deterministic belief
   std::unique_ptr<CoverageBelief> belief{std::make_unique<CoverageBelief>(
-      pomdp, GridCell{0, 1}, 1, std::set<GridCell>{GridCell{0, 0}},
+      pomdp, GridCell{0, 1}, 1,
+      BitGrid{1, 2, std::set<GridCell>{GridCell{0, 0}}},
       imac->getInitialBelief(), imac, fov)};
 
-  Eigen::MatrixXd mapBelief{belief->getMapBelief()};
+  AllocationCounter::start();
+  const Eigen::MatrixXd &mapBelief{belief->getMapBelief()};
+  long numAllocations{AllocationCounter::stop()};
+  if (AllocationCounter::supported()) {
+    REQUIRE(numAllocations == 0);
+  }
+  REQUIRE(&mapBelief == &belief->getMapBelief());
   REQUIRE(mapBelief(0, 0) == 0.7);
   REQUIRE(mapBelief(0, 1) == 0.4);
 
@@ -5,12 +5,14 @@
  * @author Charlie Street
  */
 
+#include "coverage_plan/mod/bit_grid.h"
 #include "coverage_plan/mod/grid_cell.h"
 #include "coverage_plan/mod/imac.h"
 #include "coverage_plan/planning/action.h"
 #include "coverage_plan/planning/coverage_bounds.h"
 #include "coverage_plan/planning/coverage_pomdp.h"
 #include "coverage_plan/planning/coverage_state.h"
+#include "util/allocation_counter.h"
 #include <Eigen/Dense>
 #include <catch2/catch.hpp>
 #include <despot/core/globals.h>
@@ -38,7 +40,7 @@ TEST_CASE("Tests for MaxCellsUpperBound", "[MaxCellsUpperBound]") {
 
   state.time = 8;
   for (int i{0}; i < 8; ++i) {
-    state.covered.insert(GridCell{i, i});
+    state.covered.set(GridCell{i % 3, i / 3});
   }
   REQUIRE_THAT(bound.Value(state), Catch::Matchers::WithinRel(2.0, 0.001));
 }
@@ -72,7 +74,15 @@ TEST_CASE("Tests for GreedyCoverageDefaultPolicy",
 
   ZeroParticleLowerBound zeroBound{};
 
+  // The policy shares the IMac rather than copying its matrices
+  long useCount{imac.use_count()};
+  AllocationCounter::start();
   GreedyCoverageDefaultPolicy policy{pomdp.get(), &zeroBound, imac};
+  long numAllocations{AllocationCounter::stop()};
+  if (AllocationCounter::supported()) {
+    REQUIRE(numAllocations == 0);
+  }
+  REQUIRE(imac.use_count() == useCount + 1);
 
   despot::History history{};
   despot::RandomStreams streams{3, 10};
@@ -85,9 +95,10 @@ TEST_CASE("Tests for GreedyCoverageDefaultPolicy",
     state->robotPosition = GridCell{1, 1};
     state->time = 3;
     state->map = Eigen::MatrixXi::Zero(3, 3);
+    state->covered = BitGrid{3, 3};
     for (int x{0}; x < 3; ++x) {
       for (int y{0}; y < 3; ++y) {
-        state->covered.insert(GridCell{x, y});
+        state->covered.set(GridCell{x, y});
       }
     }
     particles.push_back(state);
@@ -119,7 +130,7 @@ TEST_CASE("Tests for GreedyCoverageDefaultPolicy",
     state->map = Eigen::MatrixXi::Zero(3, 3);
     state->map(1, 0) = 1;
     state->map(2, 1) = 1;
-    state->covered = std::set<GridCell>{GridCell{1, 1}};
+    state->covered = BitGrid{3, 3, std::set<GridCell>{GridCell{1, 1}}};
     particles.push_back(state);
   }
 
@@ -129,7 +140,7 @@ TEST_CASE("Tests for GreedyCoverageDefaultPolicy",
   // Test 3: Make best action lead to a covered cell, giving us different action
   for (int i{0}; i < 5; ++i) {
     CoverageState *state{static_cast<CoverageState *>(particles.at(i))};
-    state->covered.insert(GridCell{1, 0});
+    state->covered.set(GridCell{1, 0});
   }
 
   action = policy.Action(particles, streams, history);
@@ -148,7 +159,7 @@ TEST_CASE("Tests for GreedyCoverageDefaultPolicy",
   stateOne->map = Eigen::MatrixXi::Zero(3, 3);
   stateOne->map(1, 0) = 1;
   stateOne->map(2, 1) = 1;
-  stateOne->covered = std::set<GridCell>{GridCell{1, 1}};
+  stateOne->covered = BitGrid{3, 3, std::set<GridCell>{GridCell{1, 1}}};
   particles.push_back(stateOne);
 
   CoverageState *stateTwo{
@@ -158,7 +169,7 @@ TEST_CASE("Tests for GreedyCoverageDefaultPolicy",
   stateTwo->map = Eigen::MatrixXi::Zero(3, 3);
   stateTwo->map(2, 2) = 1;
   stateTwo->map(0, 2) = 1;
-  stateTwo->covered = std::set<GridCell>{GridCell{2, 1}};
+  stateTwo->covered = BitGrid{3, 3, std::set<GridCell>{GridCell{2, 1}}};
   particles.push_back(stateTwo);
 
   action = policy.Action(particles, streams, history);
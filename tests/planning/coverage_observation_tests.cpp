@@ -5,12 +5,16 @@
  * @author Charlie Street
  */
 
+#include "coverage_plan/mod/bit_grid.h"
+#include "coverage_plan/mod/grid_cell.h"
 #include "coverage_plan/planning/action.h"
 #include "coverage_plan/planning/coverage_observation.h"
+#include "util/allocation_counter.h"
 #include <Eigen/Dense>
 #include <catch2/catch.hpp>
 #include <despot/core/globals.h>
 #include <tuple>
+#include <vector>
 
 TEST_CASE("Unit test for Observation::fromObsType",
           "[Observation::fromObsType]") {
@@ -153,6 +157,48 @@ TEST_CASE("Unit test for Observation::toObsType", "[Observation::toObsType]") {
   outcome = ActionOutcome{Action::up, true, GridCell{1, 1}};
 
   REQUIRE_THROWS(Observation::toObsType(obsVector, outcome));
+
+  // FOVs wider than an int still encode correctly
+  obsVector.assign(40, IMacObservation{GridCell{0, 0}, 0});
+  obsVector.at(0).occupied = 1;
+  REQUIRE(Observation::toObsType(obsVector, outcome) ==
+          ((despot::OBS_TYPE{1} << 40) | (despot::OBS_TYPE{1} << 39)));
+}
+
+TEST_CASE("Unit test for Observation::decode", "[Observation::decode]") {
+  // 369 = 101110001 in binary
+  std::vector<GridCell> fov{GridCell{-1, -1}, GridCell{-1, 0}, GridCell{-1, 1},
+                            GridCell{0, -1},  GridCell{0, 1},  GridCell{1, -1},
+                            GridCell{1, 0},   GridCell{1, 1}};
+  REQUIRE(Observation::actionSucceeded(369, 8));
+  REQUIRE(!Observation::actionSucceeded(369 - 256, 8));
+  REQUIRE(Observation::cellOccupied(369, 8, 0) == 0);
+  REQUIRE(Observation::cellOccupied(369, 8, 1) == 1);
+  REQUIRE(Observation::cellOccupied(369, 8, 7) == 1);
+
+  std::vector<IMacObservation> obsVector{};
+  REQUIRE(Observation::decode(369, fov, GridCell{2, 3}, obsVector));
+  std::pair<std::vector<IMacObservation>, bool> expected{
+      Observation::fromObsType(369, fov, GridCell{2, 3})};
+  REQUIRE(obsVector.size() == 8);
+  for (int i{0}; i < 8; ++i) {
+    REQUIRE(obsVector.at(i).cell == std::get<0>(expected).at(i).cell);
+    REQUIRE(obsVector.at(i).occupied == std::get<0>(expected).at(i).occupied);
+  }
+
+  // Decoding into the same vector again doesn't allocate
+  AllocationCounter::start();
+  bool succ{Observation::decode(2, fov, GridCell{0, 0}, obsVector)};
+  long numAllocations{AllocationCounter::stop()};
+  if (AllocationCounter::supported()) {
+    REQUIRE(numAllocations == 0);
+  }
+  REQUIRE(!succ);
+  REQUIRE(obsVector.at(6).occupied == 1);
+  REQUIRE(obsVector.at(7).cell == GridCell{1, 1});
+
+  std::vector<GridCell> bigFov(64, GridCell{0, 0});
+  REQUIRE_THROWS(Observation::decode(0, bigFov, GridCell{0, 0}, obsVector));
 }
 
 TEST_CASE("Unit test for Observation::computeObservation",
@@ -182,4 +228,196 @@ TEST_CASE("Unit test for Observation::computeObservation",
   outcome.success = false;
   obs = Observation::computeObservation(map, robotPos, outcome, fov);
   REQUIRE(obs == 5);
-}
\ No newline at end of file
+}
+TEST_CASE("Unit test for Observation::matchesMap and ObservationCodec",
+          "[ObservationCodec]") {
+  std::vector<GridCell> fov{GridCell{-1, -1}, GridCell{0, -1}, GridCell{1, -1},
+                            GridCell{-1, 0},  GridCell{1, 0},  GridCell{-1, 1},
+                            GridCell{0, 1},   GridCell{1, 1},  GridCell{0, 2}};
+  Eigen::MatrixXi mat{5, 4};
+  for (int y{0}; y < 5; ++y) {
+    for (int x{0}; x < 4; ++x) {
+      mat(y, x) = (x * 7 + y * 3) % 4 == 0;
+    }
+  }
+  BitGrid map{mat};
+  ObservationCodec codec{fov, 5, 4};
+
+  // The codec matches computeObservation everywhere, including the border
+  for (int x{0}; x < 4; ++x) {
+    for (int y{0}; y < 5; ++y) {
+      GridCell pos{x, y};
+      for (bool success : {true, false}) {
+        despot::OBS_TYPE obs{Observation::computeObservation(
+            mat, pos, ActionOutcome{Action::up, success, pos}, fov)};
+        REQUIRE(Observation::computeObservation(
+                    map, pos, ActionOutcome{Action::up, success, pos}, fov) ==
+                obs);
+        REQUIRE(codec.encode(map, pos, success) == obs);
+        REQUIRE(codec.matches(obs, map, pos));
+        REQUIRE(codec.matches(obs ^ (despot::OBS_TYPE{1} << 9), map, pos));
+        REQUIRE(Observation::matchesMap(obs, map, pos, fov));
+        for (int i{0}; i < 9; ++i) {
+          despot::OBS_TYPE flipped{obs ^ (despot::OBS_TYPE{1} << i)};
+          REQUIRE(!codec.matches(flipped, map, pos));
+          REQUIRE(!Observation::matchesMap(flipped, map, pos, fov));
+        }
+      }
+    }
+  }
+
+  // Maps of a different size fall back to bounds checks
+  BitGrid other{Eigen::MatrixXi::Ones(4, 5)};
+  GridCell pos{2, 1};
+  despot::OBS_TYPE obs{Observation::computeObservation(
+      other, pos, ActionOutcome{Action::up, true, pos}, fov)};
+  REQUIRE(codec.encode(other, pos, true) == obs);
+
+  // Encoding and matching don't allocate
+  AllocationCounter::start();
+  despot::OBS_TYPE encoded{codec.encode(map, GridCell{1, 1}, true)};
+  bool matched{codec.matches(encoded, map, GridCell{1, 1})};
+  despot::OBS_TYPE computed{Observation::computeObservation(
+      map, GridCell{1, 1}, ActionOutcome{Action::up, true, GridCell{1, 1}},
+      fov)};
+  long numAllocations{AllocationCounter::stop()};
+  if (AllocationCounter::supported()) {
+    REQUIRE(numAllocations == 0);
+  }
+  REQUIRE(matched);
+  REQUIRE(encoded == computed);
+
+  // FOVs of 64 cells or more use the wide encoding
+  std::vector<GridCell> bigFov(64, GridCell{0, 0});
+  REQUIRE(ObservationCodec(bigFov, 5, 4).isWide());
+}
+
+TEST_CASE("Unit test for wide FOVs in ObservationCodec",
+          "[ObservationCodec-wide]") {
+  // A 9x9 window, excluding the robot's cell (80 cells)
+  std::vector<GridCell> fov{};
+  for (int x{-4}; x <= 4; ++x) {
+    for (int y{-4}; y <= 4; ++y) {
+      if (x != 0 || y != 0) {
+        fov.push_back(GridCell{x, y});
+      }
+    }
+  }
+  Eigen::MatrixXi mat{12, 11};
+  for (int y{0}; y < 12; ++y) {
+    for (int x{0}; x < 11; ++x) {
+      mat(y, x) = (x * 5 + y * 3) % 7 < 2;
+    }
+  }
+  BitGrid map{mat};
+  ObservationCodec codec{fov, 12, 11};
+  REQUIRE(codec.isWide());
+  REQUIRE(!ObservationCodec(std::vector<GridCell>(63), 12, 11).isWide());
+  REQUIRE_THROWS(Observation::computeObservation(
+      map, GridCell{0, 0}, ActionOutcome{Action::up, true, GridCell{0, 0}},
+      fov));
+
+  // Every cell of a recorded observation round trips, in the middle of the
+  // map and at its border
+  std::vector<IMacObservation> obsVector{};
+  std::vector<despot::OBS_TYPE> seen{};
+  for (GridCell pos : {GridCell{5, 6}, GridCell{0, 0}, GridCell{10, 3}}) {
+    despot::OBS_TYPE obs{codec.record(map, pos, true)};
+    REQUIRE(obs == codec.encode(map, pos, true));
+    REQUIRE(codec.actionSucceeded(obs));
+    REQUIRE(Observation::actionSucceeded(obs, (int)fov.size()));
+    REQUIRE(codec.matches(obs, map, pos));
+    REQUIRE(codec.decode(obs, pos, obsVector));
+    REQUIRE(obsVector.size() == fov.size());
+    for (int i{0}; i < (int)fov.size(); ++i) {
+      GridCell cell{pos + fov.at(i)};
+      int occupied{map.inBounds(cell) ? map.test(cell) : 1};
+      REQUIRE(obsVector.at(i).cell == cell);
+      REQUIRE(obsVector.at(i).occupied == occupied);
+      REQUIRE(codec.cellOccupied(obs, i) == occupied);
+    }
+
+    // The same cells give the same observation, with or without success
+    despot::OBS_TYPE failed{codec.encode(map, pos, false)};
+    REQUIRE(!codec.actionSucceeded(failed));
+    REQUIRE((failed | (despot::OBS_TYPE{1} << 63)) == obs);
+    seen.push_back(failed);
+  }
+  REQUIRE(seen.at(0) != seen.at(1));
+  REQUIRE(seen.at(1) != seen.at(2));
+
+  // A change to any cell in the FOV changes the observation
+  GridCell pos{5, 6};
+  despot::OBS_TYPE obs{codec.encode(map, pos, true)};
+  BitGrid changed{map};
+  changed.set(GridCell{9, 10}, !map.test(GridCell{9, 10}));
+  REQUIRE(!codec.matches(obs, changed, pos));
+  despot::OBS_TYPE changedObs{codec.encode(changed, pos, true)};
+  REQUIRE(changedObs != obs);
+  REQUIRE(codec.matches(changedObs, changed, pos));
+
+  // Only recorded observations can be decoded
+  REQUIRE_THROWS(codec.decode(changedObs, pos, obsVector));
+
+  // Copies share the table, so observations can be decoded by either
+  ObservationCodec copy{codec};
+  despot::OBS_TYPE fromCopy{copy.record(map, GridCell{3, 3}, true)};
+  REQUIRE(codec.matches(fromCopy, map, GridCell{3, 3}));
+  REQUIRE(codec.decode(fromCopy, GridCell{3, 3}, obsVector));
+  REQUIRE_THROWS(ObservationCodec(fov, 12, 11).decode(fromCopy, pos,
+                                                       obsVector));
+
+  // Observations are encoded and checked without allocating or recording
+  uint64_t numRecorded{codec.numWideObservations()};
+  AllocationCounter::start();
+  despot::OBS_TYPE again{codec.encode(map, pos, true)};
+  bool matched{codec.matches(again, map, pos)};
+  long numAllocations{AllocationCounter::stop()};
+  if (AllocationCounter::supported()) {
+    REQUIRE(numAllocations == 0);
+  }
+  REQUIRE(again == obs);
+  REQUIRE(matched);
+  for (int x{0}; x < 11; ++x) {
+    for (int y{0}; y < 12; ++y) {
+      despot::OBS_TYPE other{codec.encode(map, GridCell{x, y}, true)};
+      REQUIRE(codec.matches(other, map, GridCell{x, y}));
+    }
+  }
+  REQUIRE(codec.numWideObservations() == numRecorded);
+
+  // Clearing the table forgets every recorded observation, in every copy
+  REQUIRE(numRecorded == 4);
+  REQUIRE(copy.numWideObservations() == numRecorded);
+  copy.clearWideObservations();
+  REQUIRE(codec.numWideObservations() == 0);
+  REQUIRE_THROWS(codec.decode(obs, pos, obsVector));
+  REQUIRE(codec.matches(obs, map, pos));
+  despot::OBS_TYPE afterClear{codec.record(changed, pos, true)};
+  REQUIRE(codec.record(changed, pos, false) != afterClear);
+  REQUIRE(codec.numWideObservations() == 1);
+  REQUIRE(codec.decode(afterClear, pos, obsVector));
+  REQUIRE(!codec.matches(afterClear, map, pos));
+  REQUIRE(ObservationCodec(fov, 12, 11).numWideObservations() == 0);
+  REQUIRE(ObservationCodec(std::vector<GridCell>(8), 12, 11)
+              .numWideObservations() == 0);
+
+  // A radius 5 disk also works
+  std::vector<GridCell> disk{};
+  for (int x{-5}; x <= 5; ++x) {
+    for (int y{-5}; y <= 5; ++y) {
+      if (x * x + y * y <= 25) {
+        disk.push_back(GridCell{x, y});
+      }
+    }
+  }
+  ObservationCodec diskCodec{disk, 12, 11};
+  despot::OBS_TYPE diskObs{diskCodec.encode(map, pos, false)};
+  REQUIRE(diskCodec.matches(diskObs, map, pos));
+  // (9,10) is in the 9x9 window, but outside the disk
+  REQUIRE(diskCodec.matches(diskObs, changed, pos));
+  changed.set(GridCell{7, 8}, !map.test(GridCell{7, 8}));
+  REQUIRE(!diskCodec.matches(diskObs, changed, pos));
+
+  REQUIRE_THROWS(ObservationCodec{std::vector<GridCell>(1025), 12, 11});
+}
@@ -66,7 +66,8 @@ TEST_CASE("Test for CoveragePlanner::InitializeWorld",
 
   REQUIRE(coverState->robotPosition == GridCell{1, 1});
   REQUIRE(coverState->time == 0);
-  REQUIRE(coverState->covered == std::set<GridCell>{GridCell{1, 1}});
+  REQUIRE(coverState->covered.count() == 1);
+  REQUIRE(coverState->covered.test(GridCell{1, 1}));
   REQUIRE(coverState->map.size() == 9);
 
   // Deallocate everything
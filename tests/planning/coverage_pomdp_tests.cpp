@@ -5,6 +5,7 @@
  * @author Charlie Street
  */
 
+#include "coverage_plan/mod/bit_grid.h"
 #include "coverage_plan/mod/grid_cell.h"
 #include "coverage_plan/mod/imac.h"
 #include "coverage_plan/mod/imac_executor.h"
@@ -49,16 +50,17 @@ TEST_CASE("Test for CoveragePOMDP::Step", "[CoveragePOMDP::Step]") {
   REQUIRE(pomdp->Step(state, 0.5, action, reward, obs));
   std::pair<std::vector<IMacObservation>, bool> obsInfo{
       Observation::fromObsType(obs, fov, state.robotPosition)};
-  REQUIRE(reward == 0.0);
   REQUIRE(state.time == 5);
-  REQUIRE(state.covered.size() == 1);
+  REQUIRE(state.covered.count() == 1);
   if (state.robotPosition == GridCell{1, 1}) { // Action fail
+    REQUIRE(reward == 0.0);
     REQUIRE(state.map(1, 1) == 0);
-    REQUIRE(state.covered.count(GridCell{1, 1}) == 1);
+    REQUIRE(state.covered.test(GridCell{1, 1}));
     REQUIRE(!std::get<1>(obsInfo));
   } else if (state.robotPosition == GridCell{2, 1}) { // Action success
+    REQUIRE(reward == 1.0);
     REQUIRE(state.map(1, 2) == 0);
-    REQUIRE(state.covered.count(GridCell{2, 1}) == 1);
+    REQUIRE(state.covered.test(GridCell{2, 1}));
     REQUIRE(std::get<1>(obsInfo));
   } else {
     REQUIRE(false);
@@ -84,15 +86,15 @@ TEST_CASE("Test for CoveragePOMDP::Step", "[CoveragePOMDP::Step]") {
   REQUIRE(pomdp->Step(state, 0.4, action, reward, obs));
   obsInfo = Observation::fromObsType(obs, fov, state.robotPosition);
   REQUIRE(reward == 0.0);
-  REQUIRE(state.covered.size() == 9);
+  REQUIRE(state.covered.count() == 9);
   REQUIRE(state.time == 4);
   if (state.robotPosition == GridCell{1, 1}) { // Action fail
     REQUIRE(state.map(1, 1) == 0);
-    REQUIRE(state.covered.count(GridCell{1, 1}) == 1);
+    REQUIRE(state.covered.test(GridCell{1, 1}));
     REQUIRE(!std::get<1>(obsInfo));
   } else if (state.robotPosition == GridCell{2, 1}) { // Action success
     REQUIRE(state.map(1, 2) == 0);
-    REQUIRE(state.covered.count(GridCell{2, 1}) == 1);
+    REQUIRE(state.covered.test(GridCell{2, 1}));
     REQUIRE(std::get<1>(obsInfo));
   } else {
     REQUIRE(false);
@@ -109,17 +111,17 @@ TEST_CASE("Test for CoveragePOMDP::Step", "[CoveragePOMDP::Step]") {
   // Wait actions always succeed
   state = CoverageState{GridCell{0, 1}, 1, Eigen::MatrixXi::Zero(3, 3),
                         std::set<GridCell>{GridCell{1, 1}}, 1.0};
-  REQUIRE(!pomdp->Step(state, 0.3, ActionHelpers::toInt(Action::wait), reward,
+  REQUIRE(!pomdp->Step(state, 0.35, ActionHelpers::toInt(Action::wait), reward,
                        obs));
   obsInfo = Observation::fromObsType(obs, fov, state.robotPosition);
   // Reward for wait should always be 0 in practice, but because I've spammed
   // the covered list with complete nonsense, the robot's waiting location isn't
-  // included. As seed 0.3 leads to action success, we get a reward of 1
+  // included. As seed 0.35 leads to action success, we get a reward of 1
   // so this still demonstrates the intended behaviour
   REQUIRE(reward == 1.0);
   REQUIRE(state.robotPosition == GridCell{0, 1});
-  REQUIRE(state.covered.size() == 2);
-  REQUIRE(state.covered.count(GridCell{0, 1}) == 1);
+  REQUIRE(state.covered.count() == 2);
+  REQUIRE(state.covered.test(GridCell{0, 1}));
   REQUIRE(state.time == 2);
   REQUIRE(std::get<1>(obsInfo));
   for (const IMacObservation &imacObs : std::get<0>(obsInfo)) {
@@ -129,6 +131,142 @@ TEST_CASE("Test for CoveragePOMDP::Step", "[CoveragePOMDP::Step]") {
       REQUIRE(imacObs.occupied == 1);
     }
   }
+
+  // Step should be a pure function of the state and random number
+  CoverageState stateOne{GridCell{1, 1}, 1, Eigen::MatrixXi::Zero(3, 3),
+                         std::set<GridCell>{GridCell{1, 1}}, 1.0};
+  CoverageState stateTwo{stateOne};
+  double rewardTwo{0.0};
+  despot::OBS_TYPE obsTwo{0};
+  for (int i{0}; i < 3; ++i) {
+    double randNum{0.1 + 0.2 * i};
+    pomdp->Step(stateOne, randNum, ActionHelpers::toInt(Action::up), reward,
+                obs);
+    // A step with a different random number in between shouldn't matter
+    CoverageState other{stateTwo};
+    pomdp->Step(other, 0.9, ActionHelpers::toInt(Action::up), rewardTwo,
+                obsTwo);
+    pomdp->Step(stateTwo, randNum, ActionHelpers::toInt(Action::up), rewardTwo,
+                obsTwo);
+    REQUIRE(stateOne.map == stateTwo.map);
+    REQUIRE(stateOne.robotPosition == stateTwo.robotPosition);
+    REQUIRE(reward == rewardTwo);
+    REQUIRE(obs == obsTwo);
+  }
+}
+
+TEST_CASE("Test for the state hash in CoveragePOMDP::Step",
+          "[CoveragePOMDP::Step-hash]") {
+  // Entry probability 0 keeps the map free, so every move succeeds
+  std::shared_ptr<IMac> imac{std::make_shared<IMac>(
+      Eigen::MatrixXd::Zero(5, 5), Eigen::MatrixXd::Constant(5, 5, 0.5),
+      Eigen::MatrixXd::Zero(5, 5))};
+  std::unique_ptr<CoveragePOMDP> pomdp{std::make_unique<CoveragePOMDP>(
+      std::vector<GridCell>{GridCell{1, 0}}, imac, 100)};
+  despot::OBS_TYPE obs{0};
+  double reward{0.0};
+
+  // The incremental hash always matches a full recompute
+  CoverageState state{GridCell{2, 2}, 0, Eigen::MatrixXi::Zero(5, 5),
+                      std::set<GridCell>{GridCell{2, 2}}, 1.0};
+  for (int i{0}; i < 40; ++i) {
+    pomdp->Step(state, 0.01 * i, (i * 7) % 5, reward, obs);
+    REQUIRE(state.hash == state.computeHash());
+  }
+
+  // Different paths to the same position, covered set, and time collide
+  std::vector<Action> pathOne{Action::right, Action::down, Action::left,
+                              Action::up};
+  std::vector<Action> pathTwo{Action::down, Action::right, Action::up,
+                              Action::left};
+  CoverageState stateOne{GridCell{0, 0}, 0, Eigen::MatrixXi::Zero(5, 5),
+                         std::set<GridCell>{GridCell{0, 0}}, 1.0};
+  CoverageState stateTwo{stateOne};
+  for (int i{0}; i < 4; ++i) {
+    pomdp->Step(stateOne, 0.3, ActionHelpers::toInt(pathOne.at(i)), reward,
+                obs);
+    pomdp->Step(stateTwo, 0.6, ActionHelpers::toInt(pathTwo.at(i)), reward,
+                obs);
+    if (i < 3) {
+      REQUIRE(stateOne.hash != stateTwo.hash);
+    }
+  }
+  REQUIRE(stateOne.robotPosition == GridCell{0, 0});
+  REQUIRE(stateOne.covered == stateTwo.covered);
+  REQUIRE(stateOne.hash == stateTwo.hash);
+}
+
+TEST_CASE("Test for CoveragePOMDP with a wide FOV",
+          "[CoveragePOMDP-wideFOV]") {
+  // A 9x9 window is too wide to fit in an OBS_TYPE directly
+  std::vector<GridCell> fov{};
+  for (int x{-4}; x <= 4; ++x) {
+    for (int y{-4}; y <= 4; ++y) {
+      fov.push_back(GridCell{x, y});
+    }
+  }
+  std::shared_ptr<IMac> imac{std::make_shared<IMac>(
+      Eigen::MatrixXd::Constant(10, 10, 0.2),
+      Eigen::MatrixXd::Constant(10, 10, 0.4),
+      Eigen::MatrixXd::Constant(10, 10, 0.3))};
+  std::unique_ptr<CoveragePOMDP> pomdp{
+      std::make_unique<CoveragePOMDP>(fov, imac, 20)};
+  REQUIRE(pomdp->getObservationCodec().isWide());
+
+  CoverageState state{GridCell{5, 5}, 0, Eigen::MatrixXi::Zero(10, 10),
+                      std::set<GridCell>{GridCell{5, 5}}, 1.0};
+  const ObservationCodec &codec{pomdp->getObservationCodec()};
+  despot::Belief *belief{pomdp->InitialBelief(&state)};
+  REQUIRE(codec.numWideObservations() == 1);
+  despot::OBS_TYPE obs{0};
+  double reward{0.0};
+  for (int i{0}; i < 5; ++i) {
+    // Searching doesn't record observations, so the table stays bounded by
+    // the number of real steps however many simulations are run
+    uint64_t numRecorded{codec.numWideObservations()};
+    for (int sim{0}; sim < 50; ++sim) {
+      CoverageState simState{state};
+      for (int t{0}; t < 5; ++t) {
+        despot::ACT_TYPE simAction{(sim + t) % pomdp->NumActions()};
+        pomdp->Step(simState, ((sim * 7 + t * 3) % 10) / 10.0, simAction,
+                    reward, obs);
+        REQUIRE(pomdp->ObsProb(obs, simState, simAction) == 1.0);
+      }
+    }
+    REQUIRE(codec.numWideObservations() == numRecorded);
+
+    despot::ACT_TYPE action{ActionHelpers::toInt(Action::left)};
+    pomdp->Step(state, 0.1 + 0.15 * i, action, reward, obs);
+    REQUIRE(pomdp->ObsProb(obs, state, action) == 1.0);
+    CoverageState other{state};
+    other.map.set(other.robotPosition + GridCell{1, 2},
+                  !other.map.test(other.robotPosition + GridCell{1, 2}));
+    REQUIRE(pomdp->ObsProb(obs, other, action) == 0.0);
+
+    // The real observation is recorded (as by CoverageWorld), so the belief
+    // can read it through the shared codec
+    REQUIRE(codec.record(state.map, state.robotPosition,
+                         codec.actionSucceeded(obs)) == obs);
+    REQUIRE(codec.numWideObservations() <= numRecorded + 1);
+    belief->Update(action, obs);
+    const Eigen::MatrixXd &mapBelief{
+        static_cast<CoverageBelief *>(belief)->getMapBelief()};
+    for (const GridCell &cell : fov) {
+      GridCell absCell{state.robotPosition + cell};
+      if (state.map.inBounds(absCell)) {
+        REQUIRE(mapBelief(absCell.y, absCell.x) == state.map.test(absCell));
+      }
+    }
+  }
+  delete belief;
+
+  // A new episode starts with an empty table
+  REQUIRE(codec.numWideObservations() > 1);
+  CoverageState start{GridCell{5, 5}, 0, Eigen::MatrixXi::Zero(10, 10),
+                      std::set<GridCell>{GridCell{5, 5}}, 1.0};
+  belief = pomdp->InitialBelief(&start);
+  REQUIRE(codec.numWideObservations() == 1);
+  delete belief;
 }
 
 TEST_CASE("Test for CoveragePOMDP::NumActions", "[CoveragePOMDP::NumActions]") {
@@ -222,8 +360,8 @@ TEST_CASE("Test for CoveragePOMDP::InitialBelief",
 
   REQUIRE(sample->robotPosition == GridCell{1, 1});
   REQUIRE(sample->time == 2);
-  REQUIRE(sample->covered.size() == 1);
-  REQUIRE(sample->covered.count(GridCell{1, 1}) == 1);
+  REQUIRE(sample->covered.count() == 1);
+  REQUIRE(sample->covered.test(GridCell{1, 1}));
   REQUIRE(sample->weight == 1.0 / 1.0);
   REQUIRE(sample->state_id == -1);
   REQUIRE(sample->map.size() == 9);
@@ -359,7 +497,8 @@ TEST_CASE("Tests for CoveragePOMDP::CreateScenarioLowerBound",
     state->map = Eigen::MatrixXi::Zero(3, 3);
     state->map(1, 0) = 1;
     state->map(2, 1) = 1;
-    state->covered = std::set<GridCell>{GridCell{1, 1}, GridCell{1, 0}};
+    state->covered =
+        BitGrid{3, 3, std::set<GridCell>{GridCell{1, 1}, GridCell{1, 0}}};
     particles.push_back(state);
   }
 
@@ -399,7 +538,7 @@ TEST_CASE("Tests for CoveragePOMDP::PrintState",
   std::ostringstream stream{};
   pomdp->PrintState(state, stream);
 
-  std::string expected{"Time: 3; Coverage: 100%\n\x1b[1;32m- \033[1;0m- "
+  std::string expected{"Time: 3; Coverage: 75%\n\x1b[1;32m- \033[1;0m- "
                        "\n\x1b[1;32m- \x1b[1;32mR \n\033[1;0m"};
 
   REQUIRE(stream.str() == expected);
@@ -476,7 +615,8 @@ TEST_CASE("Test for CoveragePOMDP::PrintBelief",
 
   // Test copying using sampling and deterministic belief
   std::unique_ptr<CoverageBelief> belief{std::make_unique<CoverageBelief>(
-      pomdp, GridCell{0, 1}, 1, std::set<GridCell>{GridCell{0, 0}},
+      pomdp, GridCell{0, 1}, 1,
+      BitGrid{1, 2, std::set<GridCell>{GridCell{0, 0}}},
       imac->getInitialBelief(), imac, fov)};
 
   // Same as test in CoverageBelief but through CoveragePOMDP
@@ -512,9 +652,9 @@ TEST_CASE("Test for CoveragePOMDP::Copy", "[CoveragePOMDP::Copy]") {
   despot::State *state{pomdp->Allocate(5, 0.2)};
   CoverageState *coverState{static_cast<CoverageState *>(state)};
   coverState->map = Eigen::MatrixXi::Zero(2, 2);
-  coverState->robotPosition = GridCell{2, 1};
+  coverState->robotPosition = GridCell{1, 1};
   coverState->time = 3;
-  coverState->covered = std::set<GridCell>{GridCell{2, 1}};
+  coverState->covered = BitGrid{2, 2, std::set<GridCell>{GridCell{1, 1}}};
 
   despot::State *stateTwo{pomdp->Copy(coverState)};
   CoverageState *coverStateTwo{static_cast<CoverageState *>(stateTwo)};
@@ -523,7 +663,7 @@ TEST_CASE("Test for CoveragePOMDP::Copy", "[CoveragePOMDP::Copy]") {
   REQUIRE(coverState->state_id == coverStateTwo->state_id);
   REQUIRE(coverState->robotPosition == coverStateTwo->robotPosition);
   REQUIRE(coverState->time == coverStateTwo->time);
-  REQUIRE(coverState->covered.size() == coverStateTwo->covered.size());
+  REQUIRE(coverState->covered.count() == coverStateTwo->covered.count());
   REQUIRE(coverState->covered == coverStateTwo->covered);
   coverStateTwo->time = 4;
   REQUIRE(coverState->time != coverStateTwo->time);
@@ -533,6 +673,68 @@ TEST_CASE("Test for CoveragePOMDP::Copy", "[CoveragePOMDP::Copy]") {
   pomdp->Free(coverStateTwo);
 }
 
+TEST_CASE("Test for copy-on-write particles in CoveragePOMDP",
+          "[CoveragePOMDP::Copy-cow]") {
+  // Large enough for the grids to use shared heap storage
+  // Free cells never become occupied, so the robot can always move
+  Eigen::MatrixXd entry{Eigen::MatrixXd::Zero(20, 20)};
+  Eigen::MatrixXd exit{Eigen::MatrixXd::Constant(20, 20, 0.5)};
+  std::shared_ptr<IMac> imac{std::make_shared<IMac>(entry, exit, entry)};
+  std::unique_ptr<CoveragePOMDP> pomdp{std::make_unique<CoveragePOMDP>(
+      std::vector<GridCell>{GridCell{1, 0}}, imac, 50)};
+
+  CoverageState *state{static_cast<CoverageState *>(pomdp->Allocate(5, 0.2))};
+  state->map = Eigen::MatrixXi::Zero(20, 20);
+  state->robotPosition = GridCell{3, 4};
+  state->time = 3;
+  state->covered = BitGrid{20, 20, std::set<GridCell>{GridCell{3, 4}}};
+  BitGrid origMap{state->map};
+  BitGrid origCovered{state->covered};
+
+  // Copies share storage and are otherwise equal
+  std::vector<CoverageState *> copies{};
+  for (int i{0}; i < 10; ++i) {
+    copies.push_back(static_cast<CoverageState *>(pomdp->Copy(state)));
+    REQUIRE(copies.back()->map.sharesStorage(state->map));
+    REQUIRE(copies.back()->covered.sharesStorage(state->covered));
+    REQUIRE(copies.back()->robotPosition == state->robotPosition);
+    REQUIRE(copies.back()->time == state->time);
+    REQUIRE(copies.back()->weight == state->weight);
+  }
+
+  // Stepping a copy clones its grids, leaving the others untouched
+  double reward{};
+  despot::OBS_TYPE obs{};
+  pomdp->Step(*copies.at(0), 0.3, ActionHelpers::toInt(Action::right), reward,
+              obs);
+  REQUIRE(!copies.at(0)->map.sharesStorage(state->map));
+  REQUIRE(!copies.at(0)->covered.sharesStorage(state->covered));
+  REQUIRE(copies.at(1)->map.sharesStorage(state->map));
+  REQUIRE(state->map == origMap);
+  REQUIRE(state->covered == origCovered);
+  REQUIRE(copies.at(1)->covered == origCovered);
+  REQUIRE(copies.at(0)->robotPosition == GridCell{4, 4});
+  REQUIRE(copies.at(0)->time == 4);
+  REQUIRE(state->time == 3);
+
+  // Re-covering a covered cell doesn't clone
+  copies.at(1)->covered.set(GridCell{3, 4});
+  REQUIRE(copies.at(1)->covered.sharesStorage(state->covered));
+
+  // Freed particles release their storage, so writing to the last user of
+  // it doesn't clone
+  for (CoverageState *copy : copies) {
+    pomdp->Free(copy);
+  }
+  origCovered = BitGrid{};
+  const BitGrid &covered{state->covered};
+  const uint64_t *words{covered.data()};
+  state->covered.set(GridCell{0, 0});
+  REQUIRE(covered.data() == words);
+  pomdp->Free(state);
+  REQUIRE(pomdp->NumActiveParticles() == 0);
+}
+
 TEST_CASE("Test for CoveragePOMDP::NumActiveParticles",
           "[CoveragePOMDP::NumActiveParticles]") {
   std::unique_ptr<CoveragePOMDP> pomdp{
@@ -4,6 +4,7 @@
  * @author Charlie Street
  */
 
+#include "coverage_plan/mod/bimac.h"
 #include "coverage_plan/mod/imac.h"
 #include "coverage_plan/mod/imac_executor.h"
 #include "coverage_plan/planning/action.h"
@@ -18,11 +19,14 @@
 class TestCoverageRobotOne : public CoverageRobot {
 
 private:
+  long _planUseCount{-1};
+
   Action _planFn(const GridCell &currentLoc,
                  const std::vector<Action> &enabledActions, int ts,
-                 int timeBound, std::shared_ptr<IMac> imac,
+                 int timeBound, const std::shared_ptr<IMac> &imac,
                  const std::vector<GridCell> &visited,
                  const std::vector<IMacObservation> &currentObs) {
+    this->_planUseCount = imac.use_count();
     return Action::up;
   }
 
@@ -38,6 +42,8 @@ public:
   TestCoverageRobotOne(const GridCell &currentLoc, int timeBound, int xDim,
                        int yDim)
       : CoverageRobot{currentLoc, timeBound, xDim, yDim} {}
+
+  long getPlanUseCount() const { return this->_planUseCount; }
 };
 
 class TestCoverageRobotTwo : public CoverageRobot {
@@ -45,7 +51,7 @@ class TestCoverageRobotTwo : public CoverageRobot {
 private:
   Action _planFn(const GridCell &currentLoc,
                  const std::vector<Action> &enabledActions, int ts,
-                 int timeBound, std::shared_ptr<IMac> imac,
+                 int timeBound, const std::shared_ptr<IMac> &imac,
                  const std::vector<GridCell> &visited,
                  const std::vector<IMacObservation> &currentObs) {
     return Action::up;
@@ -71,7 +77,7 @@ class TestCoverageRobotThree : public CoverageRobot {
 private:
   Action _planFn(const GridCell &currentLoc,
                  const std::vector<Action> &enabledActions, int ts,
-                 int timeBound, std::shared_ptr<IMac> imac,
+                 int timeBound, const std::shared_ptr<IMac> &imac,
                  const std::vector<GridCell> &visited,
                  const std::vector<IMacObservation> &currentObs) {
     return Action::up;
@@ -98,7 +104,7 @@ class TestCoverageRobotFour : public CoverageRobot {
 private:
   Action _planFn(const GridCell &currentLoc,
                  const std::vector<Action> &enabledActions, int ts,
-                 int timeBound, std::shared_ptr<IMac> imac,
+                 int timeBound, const std::shared_ptr<IMac> &imac,
                  const std::vector<GridCell> &visited,
                  const std::vector<IMacObservation> &currentObs) {
     return enabledActions.at(enabledActions.size() - 1);
@@ -129,7 +135,7 @@ private:
   int _count{0};
   Action _planFn(const GridCell &currentLoc,
                  const std::vector<Action> &enabledActions, int ts,
-                 int timeBound, std::shared_ptr<IMac> imac,
+                 int timeBound, const std::shared_ptr<IMac> &imac,
                  const std::vector<GridCell> &visited,
                  const std::vector<IMacObservation> &currentObs) {
     return Action::up;
@@ -160,6 +166,13 @@ TEST_CASE("Tests for plan-execute-observe wrapper functions",
   REQUIRE(robot->planNextAction(1, nullptr, std::vector<IMacObservation>{}) ==
           Action::up);
 
+  // The IMac is passed through by reference, without sharing ownership
+  std::shared_ptr<IMac> imac{robot->getBIMac()->posteriorMean()};
+  long useCount{imac.use_count()};
+  REQUIRE(robot->planNextAction(1, imac, std::vector<IMacObservation>{}) ==
+          Action::up);
+  REQUIRE(robot->getPlanUseCount() == useCount);
+
   ActionOutcome outcome{robot->executeAction(Action::left)};
   REQUIRE(outcome.action == Action::left);
   REQUIRE(outcome.location.x == 2);
@@ -279,6 +292,14 @@ TEST_CASE("Test for runCoverageEpisode",
       REQUIRE_THAT(entry(i, j), Catch::Matchers::WithinRel(0.5, 0.001));
     }
   }
+
+  // The episode's observations are all the BIMac has seen
+  BIMac replayed{5, 5};
+  replayed.updatePosterior(robot->getEpisodeObservations());
+  REQUIRE(replayed.getAlphaInit() == robot->getBIMac()->getAlphaInit());
+  REQUIRE(replayed.getBetaInit() == robot->getBIMac()->getBetaInit());
+  REQUIRE(replayed.getAlphaExit() == robot->getBIMac()->getAlphaExit());
+  REQUIRE(replayed.getBetaExit() == robot->getBIMac()->getBetaExit());
 }
 
 TEST_CASE("Tests for _getEnabledActions function",
@@ -19,28 +19,31 @@ TEST_CASE("Tests for the CoverageState constructors",
   // Full constructor where we set everything
   Eigen::MatrixXi map{2, 2};
   map(0, 0) = 1;
-  map(0, 1) = 2;
-  map(1, 0) = 3;
-  map(1, 1) = 4;
-  CoverageState stateTwo{GridCell{1, 2}, 3, map,
+  map(0, 1) = 0;
+  map(1, 0) = 0;
+  map(1, 1) = 1;
+  CoverageState stateTwo{GridCell{1, 1}, 3, map,
                          std::set<GridCell>{GridCell{0, 0}, GridCell{0, 1},
                                             GridCell{1, 1}, GridCell{1, 2}},
                          0.5};
 
   REQUIRE(stateTwo.robotPosition.x == 1);
-  REQUIRE(stateTwo.robotPosition.y == 2);
+  REQUIRE(stateTwo.robotPosition.y == 1);
   REQUIRE(stateTwo.time == 3);
   REQUIRE(stateTwo.map.rows() == 2);
   REQUIRE(stateTwo.map.cols() == 2);
   REQUIRE(stateTwo.map(0, 0) == 1);
-  REQUIRE(stateTwo.map(0, 1) == 2);
-  REQUIRE(stateTwo.map(1, 0) == 3);
-  REQUIRE(stateTwo.map(1, 1) == 4);
-  REQUIRE(stateTwo.covered.size() == 4);
-  REQUIRE(stateTwo.covered.count(GridCell{0, 0}) == 1);
-  REQUIRE(stateTwo.covered.count(GridCell{0, 1}) == 1);
-  REQUIRE(stateTwo.covered.count(GridCell{1, 1}) == 1);
-  REQUIRE(stateTwo.covered.count(GridCell{1, 2}) == 1);
+  REQUIRE(stateTwo.map(0, 1) == 0);
+  REQUIRE(stateTwo.map(1, 0) == 0);
+  REQUIRE(stateTwo.map(1, 1) == 1);
+  REQUIRE(stateTwo.covered.rows() == 2);
+  REQUIRE(stateTwo.covered.cols() == 2);
+  // Cells outside the map are dropped
+  REQUIRE(stateTwo.covered.count() == 3);
+  REQUIRE(stateTwo.covered.test(GridCell{0, 0}));
+  REQUIRE(stateTwo.covered.test(GridCell{0, 1}));
+  REQUIRE(stateTwo.covered.test(GridCell{1, 1}));
+  REQUIRE(!stateTwo.covered.test(GridCell{1, 0}));
   REQUIRE(stateTwo.state_id == -1);
   REQUIRE(stateTwo.weight == 0.5);
 }
@@ -52,7 +55,86 @@ TEST_CASE("Tests for the CoverageState text function", "[CoverageState-text]") {
                                          GridCell{1, 1}, GridCell{1, 2}},
                       0.5};
 
-  std::string expected{"Time: 3; Coverage: 100%\n\x1b[1;32m- \033[1;0m- "
+  std::string expected{"Time: 3; Coverage: 75%\n\x1b[1;32m- \033[1;0m- "
                        "\n\x1b[1;32m- \x1b[1;32mR \n\033[1;0m"};
   REQUIRE(state.text() == expected);
-}
\ No newline at end of file
+}
+TEST_CASE("Tests for the CoverageState hash", "[CoverageState-hash]") {
+  Eigen::MatrixXi map{Eigen::MatrixXi::Zero(3, 4)};
+  std::set<GridCell> covered{GridCell{0, 0}, GridCell{3, 2}, GridCell{1, 1}};
+  CoverageState state{GridCell{1, 1}, 3, map, covered, 0.5};
+  REQUIRE(state.hash == state.computeHash());
+
+  uint64_t expected{CoverageState::positionKey(GridCell{1, 1}) ^
+                    CoverageState::timeKey(3)};
+  for (const GridCell &cell : covered) {
+    expected ^= CoverageState::coveredKey(cell);
+  }
+  REQUIRE(state.hash == expected);
+
+  // The map isn't hashed, but every other field is
+  map(2, 2) = 1;
+  REQUIRE(CoverageState{GridCell{1, 1}, 3, map, covered, 1.0}.hash ==
+          state.hash);
+  REQUIRE(CoverageState{GridCell{1, 0}, 3, map, covered, 1.0}.hash !=
+          state.hash);
+  REQUIRE(CoverageState{GridCell{1, 1}, 4, map, covered, 1.0}.hash !=
+          state.hash);
+  covered.insert(GridCell{2, 0});
+  REQUIRE(CoverageState{GridCell{1, 1}, 3, map, covered, 1.0}.hash !=
+          state.hash);
+
+  // Position, time, and covered keys don't coincide
+  REQUIRE(CoverageState::positionKey(GridCell{0, 0}) !=
+          CoverageState::coveredKey(GridCell{0, 0}));
+  REQUIRE(CoverageState::timeKey(0) !=
+          CoverageState::positionKey(GridCell{0, 0}));
+
+  // Fields set directly need a rehash
+  state.time = 4;
+  REQUIRE(state.hash != state.computeHash());
+  state.hash = state.computeHash();
+  REQUIRE(state.hash == (expected ^ CoverageState::timeKey(3) ^
+                         CoverageState::timeKey(4)));
+}
+
+TEST_CASE("Tests for the padded CoverageState layout", "[CoverageState-pad]") {
+  Eigen::MatrixXi map{Eigen::MatrixXi::Zero(3, 4)};
+  map(0, 2) = 1;
+  std::set<GridCell> covered{GridCell{0, 0}, GridCell{1, 1}};
+  CoverageState state{GridCell{1, 1}, 3, map, covered, 0.5};
+
+  // The constructors pad the grids, with occupied and covered borders
+  REQUIRE(state.map.padding() == 1);
+  REQUIRE(state.covered.padding() == 1);
+  REQUIRE(state.map.test(GridCell{-1, 1}));
+  REQUIRE(state.covered.test(GridCell{1, 3}));
+  REQUIRE(state.map == BitGrid{map});
+  REQUIRE(state.covered.count() == 2);
+
+  // The border doesn't affect the hash
+  uint64_t hash{state.hash};
+  state.covered = BitGrid{3, 4, covered};
+  REQUIRE(state.computeHash() == hash);
+
+  // Unpadded grids are padded in place
+  state.map = map;
+  REQUIRE(state.map.padding() == 1); // Assignment keeps the layout
+  state.map = BitGrid{map};
+  REQUIRE(state.map.padding() == 0);
+  state.pad();
+  REQUIRE(state.map.padding() == 1);
+  REQUIRE(state.covered.padding() == 1);
+  REQUIRE(state.map.border());
+  REQUIRE(state.covered.border());
+  REQUIRE(state.map == BitGrid{map});
+  REQUIRE(state.covered == BitGrid{3, 4, covered});
+  REQUIRE(state.computeHash() == hash);
+
+  // Padding a padded state keeps its (heap) storage
+  CoverageState large{GridCell{0, 0}, 0, Eigen::MatrixXi::Zero(20, 20),
+                      std::set<GridCell>{}, 1.0};
+  BitGrid before{large.map};
+  large.pad();
+  REQUIRE(large.map.sharesStorage(before));
+}
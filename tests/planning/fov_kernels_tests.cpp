@@ -0,0 +1,103 @@
+/**
+ * Unit tests for the FOV kernels in fov_kernels.h.
+ * @see fov_kernels.h
+ *
+ * @author Charlie Street
+ */
+
+#include "coverage_plan/mod/bit_grid.h"
+#include "coverage_plan/mod/grid_cell.h"
+#include "coverage_plan/planning/action.h"
+#include "coverage_plan/planning/coverage_observation.h"
+#include "coverage_plan/planning/fov_kernels.h"
+#include <Eigen/Dense>
+#include <catch2/catch.hpp>
+#include <despot/core/globals.h>
+#include <vector>
+
+namespace {
+
+/**
+ * Get a shape's cells as a runtime FOV.
+ *
+ * @returns The shape's cells as a vector
+ */
+template <typename S> std::vector<GridCell> toFOV() {
+  return std::vector<GridCell>(S::cells.begin(), S::cells.end());
+}
+
+/**
+ * Check a shape's kernels against the generic code at every map position.
+ *
+ * @param fov The FOV with a specialised kernel
+ * @param shape The expected shape of fov
+ */
+void checkKernels(const std::vector<GridCell> &fov, FOVKernels::Shape shape) {
+  Eigen::MatrixXi mat{7, 9};
+  for (int y{0}; y < 7; ++y) {
+    for (int x{0}; x < 9; ++x) {
+      mat(y, x) = (x * 5 + y * 3) % 4 == 1;
+    }
+  }
+  BitGrid map{mat};
+
+  ObservationCodec codec{fov, 7, 9};
+  REQUIRE(codec.getShape() == shape);
+
+  for (int x{0}; x < 9; ++x) {
+    for (int y{0}; y < 7; ++y) {
+      GridCell pos{x, y};
+      despot::OBS_TYPE obs{Observation::computeObservation(
+          mat, pos, ActionOutcome{Action::wait, true, pos}, fov)};
+      REQUIRE(codec.encode(map, pos, true) == obs);
+      REQUIRE(codec.matches(obs, map, pos));
+
+      // Writing the observation into a belief matches the generic loop
+      Eigen::MatrixXd belief{Eigen::MatrixXd::Constant(7, 9, 0.5)};
+      Eigen::MatrixXd expected{belief};
+      for (const GridCell &cell : fov) {
+        GridCell absCell{pos + cell};
+        if (!absCell.outOfBounds(0, 9, 0, 7)) {
+          expected(absCell.y, absCell.x) = mat(absCell.y, absCell.x);
+        }
+      }
+      codec.applyObservation(obs, pos, belief);
+      REQUIRE(belief == expected);
+    }
+  }
+}
+
+} // namespace
+
+TEST_CASE("Tests for matching FOV shapes", "[FOVKernels::match]") {
+  std::vector<GridCell> eight{toFOV<FOVKernels::EightNeighbour>()};
+  std::vector<GridCell> four{toFOV<FOVKernels::FourNeighbour>()};
+  REQUIRE(FOVKernels::match(eight) == FOVKernels::Shape::eightNeighbour);
+  REQUIRE(FOVKernels::match(four) == FOVKernels::Shape::fourNeighbour);
+  REQUIRE(FOVKernels::match(std::vector<GridCell>{}) ==
+          FOVKernels::Shape::generic);
+
+  // The order matters, as it sets the bit order of observations
+  std::swap(eight.at(0), eight.at(7));
+  REQUIRE(FOVKernels::match(eight) == FOVKernels::Shape::generic);
+  four.push_back(GridCell{2, 0});
+  REQUIRE(FOVKernels::match(four) == FOVKernels::Shape::generic);
+
+  // The 8-neighbour FOV used in the experiments
+  std::vector<GridCell> fov{GridCell{-1, -1}, GridCell{0, -1}, GridCell{1, -1},
+                            GridCell{-1, 0},  GridCell{1, 0},  GridCell{-1, 1},
+                            GridCell{0, 1},   GridCell{1, 1}};
+  REQUIRE(FOVKernels::match(fov) == FOVKernels::Shape::eightNeighbour);
+}
+
+TEST_CASE("Tests for the specialised FOV kernels", "[FOVKernels-kernels]") {
+  checkKernels(toFOV<FOVKernels::EightNeighbour>(),
+               FOVKernels::Shape::eightNeighbour);
+  checkKernels(toFOV<FOVKernels::FourNeighbour>(),
+               FOVKernels::Shape::fourNeighbour);
+
+  // A custom FOV uses the generic path
+  checkKernels(std::vector<GridCell>{GridCell{0, -2}, GridCell{2, 1},
+                                     GridCell{-1, 0}},
+               FOVKernels::Shape::generic);
+}
@@ -0,0 +1,274 @@
+/**
+ * Unit tests for ScenarioBatch in scenario_batch.h, and the code which steps
+ * and rolls out batches.
+ * @see scenario_batch.h
+ *
+ * @author Charlie Street
+ */
+
+#include "coverage_plan/mod/bit_grid.h"
+#include "coverage_plan/mod/grid_cell.h"
+#include "coverage_plan/mod/imac.h"
+#include "coverage_plan/planning/action.h"
+#include "coverage_plan/planning/coverage_bounds.h"
+#include "coverage_plan/planning/coverage_pomdp.h"
+#include "coverage_plan/planning/coverage_state.h"
+#include "coverage_plan/planning/scenario_batch.h"
+#include <Eigen/Dense>
+#include <catch2/catch.hpp>
+#include <despot/core/globals.h>
+#include <despot/core/history.h>
+#include <despot/interface/lower_bound.h>
+#include <despot/interface/pomdp.h>
+#include <despot/random_streams.h>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace {
+
+/**
+ * A particle lower bound which values each particle by its covered cells,
+ * so rollouts which end in different states have different values.
+ */
+class CoveredLowerBound : public despot::ParticleLowerBound {
+public:
+  CoveredLowerBound() : ParticleLowerBound(nullptr) {}
+
+  despot::ValuedAction
+  Value(const std::vector<despot::State *> &particles) const {
+    double value{0.0};
+    for (const despot::State *particle : particles) {
+      const CoverageState *state{
+          static_cast<const CoverageState *>(particle)};
+      value += state->covered.count() * state->weight;
+    }
+    return despot::ValuedAction(ActionHelpers::toInt(Action::wait), value);
+  }
+};
+
+/**
+ * Check a particle in a batch matches a CoverageState.
+ *
+ * @param batch The batch
+ * @param i The particle's index in batch
+ * @param state The expected state
+ */
+void checkParticle(const ScenarioBatch &batch, int i,
+                   const CoverageState &state) {
+  CoverageState batchState{};
+  batch.toState(i, batchState);
+  REQUIRE(batchState.robotPosition == state.robotPosition);
+  REQUIRE(batchState.time == state.time);
+  REQUIRE(batchState.scenario_id == state.scenario_id);
+  REQUIRE(batchState.weight == state.weight);
+  REQUIRE(batchState.map == state.map);
+  REQUIRE(batchState.covered == state.covered);
+  REQUIRE(batchState.hash == state.hash);
+  REQUIRE(batchState.hash == batchState.computeHash());
+  REQUIRE(batch.numCovered[i] == state.covered.count());
+}
+
+} // namespace
+
+TEST_CASE("Tests for filling a ScenarioBatch", "[ScenarioBatch-assign]") {
+  Eigen::MatrixXi map{Eigen::MatrixXi::Zero(3, 4)};
+  map(2, 1) = 1;
+  CoverageState one{GridCell{0, 0}, 2, map,
+                    std::set<GridCell>{GridCell{0, 0}, GridCell{3, 2}}, 0.25,
+                    4};
+  CoverageState two{GridCell{3, 1}, 1, Eigen::MatrixXi::Zero(3, 4),
+                    std::set<GridCell>{GridCell{3, 1}}, 0.75, 5};
+  one.scenario_id = 0;
+  two.scenario_id = 1;
+
+  ScenarioBatch batch{};
+  batch.assign({&one, &two});
+  REQUIRE(batch.size() == 2);
+  REQUIRE(batch.rows() == 3);
+  REQUIRE(batch.cols() == 4);
+  REQUIRE(batch.stride() == 5);
+  REQUIRE(batch.numWords() == one.map.numWords());
+  REQUIRE(batch.index(0) == one.map.index(one.robotPosition));
+  REQUIRE(batch.index(1) == two.map.index(two.robotPosition));
+  REQUIRE(batch.map(0).test(GridCell{1, 2}));
+  REQUIRE(!batch.map(1).test(GridCell{1, 2}));
+  REQUIRE(batch.map(0).test(GridCell{-1, 0})); // The border is occupied
+  checkParticle(batch, 0, one);
+  checkParticle(batch, 1, two);
+
+  // Unpadded particles are padded on the way in
+  CoverageState unpadded{one};
+  unpadded.map = BitGrid::unpadded(one.map);
+  unpadded.covered = BitGrid::unpadded(one.covered);
+  batch.assign({&unpadded});
+  REQUIRE(batch.size() == 1);
+  checkParticle(batch, 0, one);
+
+  // Writing to the batch leaves the particles alone
+  batch.assign({&one});
+  batch.mapWords(0)[0] = 0;
+  REQUIRE(one.map(2, 1) == 1);
+
+  // All particles must share the map dimensions
+  CoverageState other{GridCell{0, 0}, 0, Eigen::MatrixXi::Zero(4, 3),
+                      std::set<GridCell>{}, 0.5};
+  REQUIRE_THROWS(batch.assign({&one, &other}));
+
+  batch.assign({});
+  REQUIRE(batch.size() == 0);
+}
+
+TEST_CASE("Tests for CoveragePOMDP::StepBatch", "[CoveragePOMDP::StepBatch]") {
+  std::vector<GridCell> fov{GridCell{-1, -1}, GridCell{0, -1}, GridCell{1, -1},
+                            GridCell{-1, 0},  GridCell{1, 0},  GridCell{-1, 1},
+                            GridCell{0, 1},   GridCell{1, 1}};
+  Eigen::MatrixXd entry{4, 5};
+  Eigen::MatrixXd exit{4, 5};
+  for (int y{0}; y < 4; ++y) {
+    for (int x{0}; x < 5; ++x) {
+      entry(y, x) = ((x * 3 + y * 5) % 7) / 10.0;
+      exit(y, x) = ((x * 2 + y) % 5 + 1) / 10.0;
+    }
+  }
+  entry(0, 2) = 1.0; // Static occupied
+  exit(0, 2) = 0.0;
+  std::shared_ptr<IMac> imac{std::make_shared<IMac>(entry, exit, entry)};
+  std::unique_ptr<CoveragePOMDP> pomdp{
+      std::make_unique<CoveragePOMDP>(fov, imac, 6)};
+
+  std::vector<despot::State *> particles{};
+  for (int i{0}; i < 6; ++i) {
+    Eigen::MatrixXi map{Eigen::MatrixXi::Zero(4, 5)};
+    for (int y{0}; y < 4; ++y) {
+      for (int x{0}; x < 5; ++x) {
+        map(y, x) = (x + y + i) % 3 == 0;
+      }
+    }
+    map(0, 2) = 1;
+    GridCell pos{i % 5, (i * 3) % 4};
+    map(pos.y, pos.x) = 0;
+    CoverageState *state{
+        static_cast<CoverageState *>(pomdp->Allocate(-1, 1.0 / 6.0))};
+    *state = CoverageState{pos, i % 2, map, std::set<GridCell>{pos},
+                           1.0 / 6.0};
+    state->SetAllocated(); // The assignment cleared it, as in Copy
+    state->scenario_id = i;
+    particles.push_back(state);
+  }
+
+  for (int a{0}; a < pomdp->NumActions(); ++a) {
+    despot::RandomStreams streams{6, 10};
+    ScenarioBatch batch{};
+    batch.assign(particles);
+    std::vector<despot::State *> expected{};
+    for (despot::State *particle : particles) {
+      expected.push_back(pomdp->Copy(particle));
+    }
+
+    // Step every particle a few times, including to the time bound
+    std::vector<int> all{0, 1, 2, 3, 4, 5};
+    for (int t{0}; t < 6; ++t) {
+      pomdp->StepBatch(batch, all, streams, a);
+      for (int i{0}; i < 6; ++i) {
+        double reward{};
+        despot::OBS_TYPE obs{};
+        bool terminal{pomdp->Step(*expected.at(i),
+                                  streams.Entry(expected.at(i)->scenario_id),
+                                  a, reward, obs)};
+        REQUIRE(batch.reward[i] == reward);
+        REQUIRE(batch.obs[i] == obs);
+        REQUIRE((batch.terminal[i] != 0) == terminal);
+        checkParticle(batch, i,
+                      *static_cast<CoverageState *>(expected.at(i)));
+      }
+      streams.Advance();
+    }
+
+    // Only the active particles are stepped
+    batch.assign(particles);
+    pomdp->StepBatch(batch, std::vector<int>{1, 4}, streams, a);
+    for (int i{0}; i < 6; ++i) {
+      CoverageState batchState{};
+      batch.toState(i, batchState);
+      REQUIRE((batchState.time != particles.at(i)->scenario_id % 2) ==
+              (i == 1 || i == 4));
+    }
+
+    for (despot::State *state : expected) {
+      pomdp->Free(state);
+    }
+  }
+
+  for (despot::State *state : particles) {
+    pomdp->Free(state);
+  }
+}
+
+TEST_CASE("Tests for batched GreedyCoverageDefaultPolicy rollouts",
+          "[ScenarioBatch-rollout]") {
+  // A corridor along the middle row, so moving right is always best and
+  // the rollout doesn't depend on random tie breaks
+  std::vector<GridCell> fov{GridCell{-1, 0}, GridCell{1, 0}, GridCell{0, -1},
+                            GridCell{0, 1}};
+  Eigen::MatrixXd entry{Eigen::MatrixXd::Ones(3, 10)};
+  Eigen::MatrixXd exit{Eigen::MatrixXd::Zero(3, 10)};
+  entry.row(1).setConstant(0.2);
+  exit.row(1).setConstant(0.5);
+  std::shared_ptr<IMac> imac{std::make_shared<IMac>(entry, exit, entry)};
+  std::unique_ptr<CoveragePOMDP> pomdp{
+      std::make_unique<CoveragePOMDP>(fov, imac, 8)};
+
+  std::vector<despot::State *> particles{};
+  for (int i{0}; i < 8; ++i) {
+    Eigen::MatrixXi map{Eigen::MatrixXi::Ones(3, 10)};
+    map.row(1).setZero();
+    map(1, 1 + i % 3) = i % 2;
+    CoverageState *state{
+        static_cast<CoverageState *>(pomdp->Allocate(-1, 1.0 / 8.0))};
+    *state = CoverageState{GridCell{0, 1}, 0, map,
+                           std::set<GridCell>{GridCell{0, 1}}, 1.0 / 8.0};
+    state->SetAllocated(); // The assignment cleared it, as in Copy
+    state->scenario_id = i;
+    particles.push_back(state);
+  }
+  std::vector<uint64_t> hashes{};
+  for (despot::State *state : particles) {
+    hashes.push_back(static_cast<CoverageState *>(state)->hash);
+  }
+
+  despot::RandomStreams streams{8, 12};
+  despot::History history{};
+  int simLenBefore{despot::Globals::config.max_policy_sim_len};
+  ZeroParticleLowerBound zeroBound{};
+  CoveredLowerBound coveredBound{};
+  for (despot::ParticleLowerBound *bound :
+       std::vector<despot::ParticleLowerBound *>{&zeroBound, &coveredBound}) {
+    GreedyCoverageDefaultPolicy policy{pomdp.get(), bound, imac};
+    for (int simLen : {3, 20}) { // Stopped by the sim length or time bound
+      despot::Globals::config.max_policy_sim_len = simLen;
+      despot::ValuedAction batched{policy.Value(particles, streams, history)};
+      despot::ValuedAction single{
+          policy.DefaultPolicy::Value(particles, streams, history)};
+      REQUIRE(batched.action == ActionHelpers::toInt(Action::right));
+      REQUIRE(batched.action == single.action);
+      REQUIRE(batched.value == single.value);
+      REQUIRE(batched.value > 0.0);
+      REQUIRE(history.Size() == 0);
+    }
+  }
+  despot::Globals::config.max_policy_sim_len = simLenBefore;
+
+  // The rollouts leave the particles alone
+  for (int i{0}; i < 8; ++i) {
+    const CoverageState *state{
+        static_cast<const CoverageState *>(particles.at(i))};
+    REQUIRE(state->robotPosition == GridCell{0, 1});
+    REQUIRE(state->time == 0);
+    REQUIRE(state->hash == hashes.at(i));
+  }
+
+  for (despot::State *state : particles) {
+    pomdp->Free(state);
+  }
+}
@@ -0,0 +1,142 @@
+/**
+ * Unit tests for TranspositionTable in transposition_table.h.
+ * @see transposition_table.h
+ *
+ * @author Charlie Street
+ */
+
+#include "coverage_plan/mod/bit_grid.h"
+#include "coverage_plan/mod/grid_cell.h"
+#include "coverage_plan/mod/imac.h"
+#include "coverage_plan/planning/coverage_bounds.h"
+#include "coverage_plan/planning/coverage_pomdp.h"
+#include "coverage_plan/planning/coverage_state.h"
+#include "coverage_plan/planning/transposition_table.h"
+#include <Eigen/Dense>
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <despot/core/globals.h>
+#include <despot/core/history.h>
+#include <despot/interface/pomdp.h>
+#include <despot/random_streams.h>
+#include <memory>
+#include <set>
+#include <vector>
+
+TEST_CASE("Tests for TranspositionTable lookups",
+          "[TranspositionTable-lookup]") {
+  TranspositionTable table{4};
+  despot::ValuedAction result{};
+
+  REQUIRE(!table.lookup(7, result));
+  table.store(7, despot::ValuedAction(2, 3.5));
+  REQUIRE(table.lookup(7, result));
+  REQUIRE(result.action == 2);
+  REQUIRE(result.value == 3.5);
+  REQUIRE(table.hits() == 1);
+  REQUIRE(table.misses() == 1);
+
+  // Keys in the same slot replace each other
+  table.store(7 + 16, despot::ValuedAction(1, 1.0));
+  REQUIRE(!table.lookup(7, result));
+  REQUIRE(table.lookup(7 + 16, result));
+  REQUIRE(result.action == 1);
+
+  // Key 0 isn't found in an empty table
+  REQUIRE(!table.lookup(0, result));
+
+  // Clearing empties the table and resets the counts
+  table.clear();
+  REQUIRE(table.hits() == 0);
+  REQUIRE(table.misses() == 0);
+  REQUIRE(!table.lookup(7 + 16, result));
+  table.store(7 + 16, despot::ValuedAction(4, 2.0));
+  REQUIRE(table.lookup(7 + 16, result));
+  REQUIRE(result.action == 4);
+
+  REQUIRE_THROWS(TranspositionTable{-1});
+  REQUIRE_THROWS(TranspositionTable{31});
+}
+
+TEST_CASE("Tests for TranspositionTable::particlesKey",
+          "[TranspositionTable::particlesKey]") {
+  CoverageState one{GridCell{0, 0}, 2, Eigen::MatrixXi::Zero(3, 3),
+                    std::set<GridCell>{GridCell{0, 0}}, 0.5};
+  CoverageState two{GridCell{1, 0}, 2, Eigen::MatrixXi::Zero(3, 3),
+                    std::set<GridCell>{GridCell{0, 0}, GridCell{1, 0}}, 0.5};
+  one.scenario_id = 0;
+  two.scenario_id = 1;
+
+  uint64_t key{TranspositionTable::particlesKey({&one, &two})};
+  REQUIRE(TranspositionTable::particlesKey({&two, &one}) == key);
+  REQUIRE(TranspositionTable::particlesKey({&one}) != key);
+  REQUIRE(TranspositionTable::particlesKey({}) !=
+          TranspositionTable::particlesKey({&one}));
+
+  // The same states in different scenarios have different keys
+  one.scenario_id = 1;
+  two.scenario_id = 0;
+  REQUIRE(TranspositionTable::particlesKey({&one, &two}) != key);
+}
+
+TEST_CASE("Tests for memoising GreedyCoverageDefaultPolicy rollouts",
+          "[TranspositionTable-policy]") {
+  std::vector<GridCell> fov{GridCell{-1, 0}, GridCell{1, 0}, GridCell{0, -1},
+                            GridCell{0, 1}};
+  std::shared_ptr<IMac> imac{std::make_shared<IMac>(
+      Eigen::MatrixXd::Constant(3, 3, 0.1),
+      Eigen::MatrixXd::Constant(3, 3, 0.5), Eigen::MatrixXd::Zero(3, 3))};
+  std::unique_ptr<CoveragePOMDP> pomdp{
+      std::make_unique<CoveragePOMDP>(fov, imac, 8)};
+
+  std::vector<despot::State *> particles{};
+  for (int i{0}; i < 3; ++i) {
+    CoverageState *state{
+        static_cast<CoverageState *>(pomdp->Allocate(-1, 1.0 / 3.0))};
+    state->scenario_id = i;
+    state->robotPosition = GridCell{1, 1};
+    state->time = 0;
+    state->map = Eigen::MatrixXi::Zero(3, 3);
+    state->covered = BitGrid{3, 3, std::set<GridCell>{GridCell{1, 1}}};
+    state->hash = state->computeHash();
+    particles.push_back(state);
+  }
+
+  despot::RandomStreams streams{3, 10};
+  despot::History history{};
+  const std::shared_ptr<TranspositionTable> &table{
+      pomdp->getTranspositionTable()};
+
+  despot::ScenarioLowerBound *bound{pomdp->CreateScenarioLowerBound()};
+  despot::ValuedAction first{bound->Value(particles, streams, history)};
+  REQUIRE(table->misses() == 1);
+  REQUIRE(table->hits() == 0);
+
+  // The rollout leaves the particles alone, so the same set hits
+  despot::ValuedAction second{bound->Value(particles, streams, history)};
+  REQUIRE(table->hits() == 1);
+  REQUIRE(second.action == first.action);
+  REQUIRE(second.value == first.value);
+
+  // A different particle set misses
+  std::vector<despot::State *> subset{particles.at(0), particles.at(1)};
+  bound->Value(subset, streams, history);
+  REQUIRE(table->misses() == 2);
+
+  // Clearing between searches forgets the rollouts
+  pomdp->clearTranspositionTable();
+  bound->Value(particles, streams, history);
+  REQUIRE(table->hits() == 0);
+  REQUIRE(table->misses() == 1);
+  delete bound;
+
+  // Without a table, nothing is memoised
+  ZeroParticleLowerBound zeroBound{};
+  GreedyCoverageDefaultPolicy policy{pomdp.get(), &zeroBound, imac};
+  policy.Value(particles, streams, history);
+  REQUIRE(table->misses() == 1);
+
+  for (despot::State *state : particles) {
+    pomdp->Free(state);
+  }
+}
@@ -0,0 +1,64 @@
+/**
+ * Implementation of the allocation counter in allocation_counter.h.
+ * @see allocation_counter.h
+ *
+ * @author Charlie Street
+ */
+#include "util/allocation_counter.h"
+#include <cstddef>
+
+namespace {
+
+// Plain thread locals in the executable, so reading them never allocates
+thread_local bool counting{false};
+thread_local long numAllocations{0};
+
+} // namespace
+
+#ifdef __GLIBC__
+
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t num, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size) {
+  if (counting) {
+    ++numAllocations;
+  }
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t num, size_t size) {
+  if (counting) {
+    ++numAllocations;
+  }
+  return __libc_calloc(num, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+  if (counting) {
+    ++numAllocations;
+  }
+  return __libc_realloc(ptr, size);
+}
+}
+
+bool AllocationCounter::supported() { return true; }
+
+#else
+
+bool AllocationCounter::supported() { return false; }
+
+#endif
+
+void AllocationCounter::start() {
+  numAllocations = 0;
+  counting = true;
+}
+
+long AllocationCounter::stop() {
+  counting = false;
+  return numAllocations;
+}
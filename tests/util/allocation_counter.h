@@ -0,0 +1,39 @@
+/**
+ * @file allocation_counter.h
+ *
+ * @brief Counts heap allocations on the current thread, for tests which check
+ * that hot paths don't allocate.
+ *
+ * Both malloc (used by Eigen) and operator new (which calls malloc) are
+ * counted. Counting relies on glibc, where malloc can be replaced by the test
+ * executable; elsewhere, supported() is false and no allocations are seen.
+ *
+ * @author Charlie Street
+ */
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+namespace AllocationCounter {
+
+/**
+ * Check if allocations can be counted on this platform.
+ *
+ * @returns True if allocations are counted
+ */
+bool supported();
+
+/**
+ * Start counting allocations made by this thread.
+ */
+void start();
+
+/**
+ * Stop counting allocations made by this thread.
+ *
+ * @returns The number of allocations since start was called
+ */
+long stop();
+
+} // namespace AllocationCounter
+
+#endif
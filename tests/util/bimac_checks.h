@@ -0,0 +1,29 @@
+/**
+ * @file bimac_checks.h
+ *
+ * @brief Checks shared by the tests which rebuild BIMacs from stored data.
+ *
+ * @author Charlie Street
+ */
+#ifndef BIMAC_CHECKS_H
+#define BIMAC_CHECKS_H
+
+#include "coverage_plan/mod/bimac.h"
+#include <catch2/catch.hpp>
+
+/**
+ * Check two BIMacs have the same counts.
+ *
+ * @param a The first BIMac
+ * @param b The second BIMac
+ */
+inline void requireSameCounts(const BIMac &a, const BIMac &b) {
+  REQUIRE(a.getAlphaEntry() == b.getAlphaEntry());
+  REQUIRE(a.getBetaEntry() == b.getBetaEntry());
+  REQUIRE(a.getAlphaExit() == b.getAlphaExit());
+  REQUIRE(a.getBetaExit() == b.getBetaExit());
+  REQUIRE(a.getAlphaInit() == b.getAlphaInit());
+  REQUIRE(a.getBetaInit() == b.getBetaInit());
+}
+
+#endif
@@ -0,0 +1,78 @@
+/**
+ * Unit tests for the functions in counter_rng.h.
+ * @see counter_rng.h
+ *
+ * @author Charlie Street
+ */
+
+#include "coverage_plan/util/counter_rng.h"
+#include <algorithm>
+#include <array>
+#include <catch2/catch.hpp>
+#include <cstdint>
+
+TEST_CASE("Tests for CounterRNG::philox4x32", "[CounterRNG::philox4x32]") {
+  // Known answer tests from the Random123 reference implementation
+  std::array<uint32_t, 4> out{CounterRNG::philox4x32({0, 0, 0, 0}, {0, 0})};
+  REQUIRE(out == std::array<uint32_t, 4>{0x6627e8d5, 0xe169c58d, 0xbc57ac4c,
+                                         0x9b00dbd8});
+
+  out = CounterRNG::philox4x32(
+      {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+      {0xffffffff, 0xffffffff});
+  REQUIRE(out == std::array<uint32_t, 4>{0x408f276d, 0x41c83b0e, 0xa20bc7c6,
+                                         0x6d5451fd});
+
+  out = CounterRNG::philox4x32(
+      {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344},
+      {0xa4093822, 0x299f31d0});
+  REQUIRE(out == std::array<uint32_t, 4>{0xd16cfe09, 0x94fdcceb, 0x5001e420,
+                                         0x24126ea1});
+}
+
+TEST_CASE("Tests for CounterRNG::toUniform", "[CounterRNG::toUniform]") {
+  REQUIRE(CounterRNG::toUniform(0, 0) == 0.0);
+  REQUIRE(CounterRNG::toUniform(0x80000000, 0) == 0.5);
+  REQUIRE(CounterRNG::toUniform(0xffffffff, 0xffffffff) < 1.0);
+}
+
+TEST_CASE("Tests for CounterRNG::uniformPair", "[CounterRNG::uniformPair]") {
+  double first{};
+  double second{};
+  double firstTwo{};
+  double secondTwo{};
+
+  // Same inputs give the same draws
+  CounterRNG::uniformPair(5, 3, 7, first, second);
+  CounterRNG::uniformPair(5, 3, 7, firstTwo, secondTwo);
+  REQUIRE(first == firstTwo);
+  REQUIRE(second == secondTwo);
+  REQUIRE(first != second);
+
+  // Changing any input changes the draws
+  CounterRNG::uniformPair(6, 3, 7, firstTwo, secondTwo);
+  REQUIRE(first != firstTwo);
+  CounterRNG::uniformPair(5, 4, 7, firstTwo, secondTwo);
+  REQUIRE(first != firstTwo);
+  CounterRNG::uniformPair(5, 3, 8, firstTwo, secondTwo);
+  REQUIRE(first != firstTwo);
+
+  // Check the draws look uniform
+  double total{0.0};
+  double minDraw{1.0};
+  double maxDraw{0.0};
+  int below{0};
+  int numPairs{50000};
+  for (int i{0}; i < numPairs; ++i) {
+    CounterRNG::uniformPair(1234, 0, i, first, second);
+    minDraw = std::min({minDraw, first, second});
+    maxDraw = std::max({maxDraw, first, second});
+    total += first + second;
+    below += (first < 0.25) + (second < 0.25);
+  }
+  REQUIRE(minDraw >= 0.0);
+  REQUIRE(maxDraw < 1.0);
+  REQUIRE_THAT(total / (2 * numPairs), Catch::Matchers::WithinAbs(0.5, 0.01));
+  REQUIRE_THAT((double)below / (2 * numPairs),
+               Catch::Matchers::WithinAbs(0.25, 0.01));
+}